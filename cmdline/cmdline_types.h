@@ -442,6 +442,8 @@ static gc::CollectorType ParseCollectorType(const std::string& option) {
     return gc::kCollectorTypeCMS;
   } else if (option == "SS") {
     return gc::kCollectorTypeSS;
+  } else if (option == "CMC") {
+    return gc::kCollectorTypeCMC;
   } else if (option == "CC") {
     return gc::kCollectorTypeCC;
   } else {
@@ -1254,6 +1254,7 @@ bool OptimizingCompiler::JitCompile(Thread* self,
                              stack_map.size(),
                              /* number_of_roots= */ 0,
                              method,
+                             jit::JitCodeKind::kStub,
                              /*out*/ &reserved_code,
                              /*out*/ &reserved_data)) {
       MaybeRecordStat(compilation_stats_.get(), MethodCompilationStat::kJitOutOfMemoryForCommit);
@@ -1345,12 +1346,16 @@ bool OptimizingCompiler::JitCompile(Thread* self,
 
   ArrayRef<const uint8_t> reserved_code;
   ArrayRef<const uint8_t> reserved_data;
+  jit::JitCodeKind code_kind = codegen->GetGraph()->IsCompilingBaseline()
+      ? jit::JitCodeKind::kBaseline
+      : jit::JitCodeKind::kOptimized;
   if (!code_cache->Reserve(self,
                            region,
                            code_allocator.GetMemory().size(),
                            stack_map.size(),
                            /*number_of_roots=*/codegen->GetNumberOfJitRoots(),
                            method,
+                           code_kind,
                            /*out*/ &reserved_code,
                            /*out*/ &reserved_data)) {
     MaybeRecordStat(compilation_stats_.get(), MethodCompilationStat::kJitOutOfMemoryForCommit);
@@ -1472,9 +1472,12 @@ class ParallelCompilationManager {
     CHECK_GT(work_units, 0U);
 
     index_.store(begin, std::memory_order_relaxed);
+    std::vector<Task*> tasks;
+    tasks.reserve(work_units);
     for (size_t i = 0; i < work_units; ++i) {
-      thread_pool_->AddTask(self, new ForAllClosureLambda<Fn>(this, end, fn));
+      tasks.push_back(new ForAllClosureLambda<Fn>(this, end, fn));
     }
+    thread_pool_->AddTasks(self, tasks);
     thread_pool_->StartWorkers(self);
 
     // Ensure we're suspended while we're blocked waiting for the other threads to finish (worker
@@ -38,6 +38,9 @@ static constexpr size_t kStackAlignment = 16;
 // compile-time constant so the compiler can generate better code.
 static constexpr int kPageSize = 4096;
 
+// Size of a transparent huge page: a PMD mapping with 4 KiB pages, on all supported ISAs.
+static constexpr size_t kHugePageSize = 2 * MB;
+
 // Clion, clang analyzer, etc can falsely believe that "if (kIsDebugBuild)" always
 // returns the same value. By wrapping into a call to another constexpr function, we force it
 // to realize that is not actually always evaluating to the same value.
@@ -840,6 +840,17 @@ int MemMap::MadviseDontFork() {
   return -1;
 }
 
+int MemMap::MadviseHugePages(bool enable) {
+#if defined(__linux__)
+  if (base_begin_ != nullptr || base_size_ != 0) {
+    return madvise(base_begin_, base_size_, enable ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+  }
+#else
+  UNUSED(enable);
+#endif
+  return -1;
+}
+
 bool MemMap::Sync() {
 #ifdef _WIN32
   // TODO: add FlushViewOfFile support.
@@ -233,6 +233,10 @@ class MemMap {
   void MadviseDontNeedAndZero();
   int MadviseDontFork();
 
+  // Ask the kernel to back the huge page aligned parts of the map with transparent huge pages,
+  // or to stop doing so when `enable` is false. Returns the result of madvise.
+  int MadviseHugePages(bool enable);
+
   int GetProtect() const {
     return prot_;
   }
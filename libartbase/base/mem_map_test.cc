@@ -16,14 +16,18 @@
 
 #include "mem_map.h"
 
+#include <string.h>
+
 #include <memory>
 #include <random>
+#include <vector>
 
 #include "bit_utils.h"
 #include "common_art_test.h"
 #include "logging.h"
 #include "memory_tool.h"
 #include "mman.h"
+#include "time_utils.h"
 #include "unix_file/fd_file.h"
 
 namespace art {
@@ -872,6 +876,72 @@ TEST_F(MemMapTest, Reservation) {
   ASSERT_FALSE(map2.IsValid());
 }
 
+// Map `size` bytes aligned by kHugePageSize and link one pointer per page into a single random
+// cycle, so that following it touches a different page, and likely misses the TLB, every step.
+static MemMap MapPointerChasingCycle(const char* name, size_t size, bool use_huge_pages) {
+  std::string error_msg;
+  MemMap map = MemMap::MapAnonymous(name,
+                                    size + kHugePageSize,
+                                    PROT_READ | PROT_WRITE,
+                                    /*low_4gb=*/ false,
+                                    &error_msg);
+  CHECK(map.IsValid()) << error_msg;
+  map.AlignBy(kHugePageSize);
+  map.SetSize(size);
+  if (use_huge_pages && map.MadviseHugePages(/*enable=*/ true) != 0) {
+    LOG(INFO) << "Transparent huge pages are not supported: " << strerror(errno);
+  }
+  // Sattolo's algorithm, which yields a permutation with a single cycle.
+  const size_t num_pages = size / kPageSize;
+  std::vector<size_t> order(num_pages);
+  for (size_t i = 0; i != num_pages; ++i) {
+    order[i] = i;
+  }
+  std::mt19937 rng(42);
+  for (size_t i = num_pages - 1u; i != 0u; --i) {
+    size_t j = std::uniform_int_distribution<size_t>(0u, i - 1u)(rng);
+    std::swap(order[i], order[j]);
+  }
+  // Vary the offset within the pages so that the pointers do not all share cache sets.
+  auto node = [&map](size_t page) {
+    size_t offset = ((page * 7u) % (kPageSize / sizeof(void*))) * sizeof(void*);
+    return reinterpret_cast<void**>(map.Begin() + page * kPageSize + offset);
+  };
+  for (size_t i = 0; i != num_pages; ++i) {
+    *node(i) = node(order[i]);
+  }
+  return map;
+}
+
+// Not a pass or fail test: compare the time per access of a pointer chasing workload with and
+// without transparent huge pages, which mostly measures the TLB misses saved.
+TEST_F(MemMapTest, MadviseHugePagesPointerChasingBenchmark) {
+  CommonInit();
+  const size_t size = (sizeof(void*) == 8u) ? 256 * MB : 64 * MB;
+  static constexpr size_t kNumAccesses = 4 * MB;
+  for (bool use_huge_pages : { false, true }) {
+    MemMap map = MapPointerChasingCycle("MemMapTest_PointerChasing", size, use_huge_pages);
+    void** const start = reinterpret_cast<void**>(*reinterpret_cast<void**>(map.Begin()));
+    // Warm up: walk the whole cycle once, which also checks that it is a single cycle.
+    size_t cycle_length = 0u;
+    void** cur = start;
+    do {
+      cur = reinterpret_cast<void**>(*cur);
+      ++cycle_length;
+    } while (cur != start);
+    EXPECT_EQ(size / kPageSize, cycle_length);
+    uint64_t start_time = NanoTime();
+    for (size_t i = 0; i != kNumAccesses; ++i) {
+      cur = reinterpret_cast<void**>(*cur);
+    }
+    uint64_t elapsed = NanoTime() - start_time;
+    // Use the result so that the loop is not optimized away.
+    EXPECT_NE(cur, nullptr);
+    LOG(INFO) << (use_huge_pages ? "Huge" : "Small") << " pages: "
+              << static_cast<double>(elapsed) / kNumAccesses << " ns per access";
+  }
+}
+
 }  // namespace art
 
 namespace {
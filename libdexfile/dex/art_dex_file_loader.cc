@@ -551,7 +551,7 @@ std::unique_ptr<DexFile> ArtDexFileLoader::OpenCommon(const uint8_t* base,
                                                       bool verify_checksum,
                                                       std::string* error_msg,
                                                       std::unique_ptr<DexFileContainer> container,
-                                                      VerifyResult* verify_result) {
+                                                      VerifyResult* verify_result) const {
   return DexFileLoader::OpenCommon(base,
                                    size,
                                    data_base,
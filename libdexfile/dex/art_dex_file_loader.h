@@ -137,18 +137,18 @@ class ArtDexFileLoader : public DexFileLoader {
                                                        std::string* error_msg,
                                                        DexFileLoaderErrorCode* error_code) const;
 
-  static std::unique_ptr<DexFile> OpenCommon(const uint8_t* base,
-                                             size_t size,
-                                             const uint8_t* data_base,
-                                             size_t data_size,
-                                             const std::string& location,
-                                             uint32_t location_checksum,
-                                             const OatDexFile* oat_dex_file,
-                                             bool verify,
-                                             bool verify_checksum,
-                                             std::string* error_msg,
-                                             std::unique_ptr<DexFileContainer> container,
-                                             VerifyResult* verify_result);
+  std::unique_ptr<DexFile> OpenCommon(const uint8_t* base,
+                                      size_t size,
+                                      const uint8_t* data_base,
+                                      size_t data_size,
+                                      const std::string& location,
+                                      uint32_t location_checksum,
+                                      const OatDexFile* oat_dex_file,
+                                      bool verify,
+                                      bool verify_checksum,
+                                      std::string* error_msg,
+                                      std::unique_ptr<DexFileContainer> container,
+                                      VerifyResult* verify_result) const;
 };
 
 }  // namespace art
@@ -16,6 +16,7 @@
 
 #include "art_dex_file_loader.h"
 
+#include <string.h>
 #include <sys/mman.h>
 
 #include <memory>
@@ -32,6 +33,7 @@
 #include "dex/dex_file.h"
 #include "dex/dex_file-inl.h"
 #include "dex/dex_file_loader.h"
+#include "dex/dex_file_verifier.h"
 
 namespace art {
 
@@ -52,6 +54,56 @@ class ArtDexFileLoaderTest : public CommonArtTest {
   const DexFile* java_lang_dex_file_;
 };
 
+// Returns a copy of `dex_file` with a hiddenapi class data section, with zero flags for all the
+// members. The section goes where the map list was, which must be the last section.
+static std::vector<uint8_t> AddHiddenapiClassData(const DexFile& dex_file) {
+  const DexFile::Header& header = dex_file.GetHeader();
+  const dex::MapList* map = dex_file.GetMapList();
+  CHECK_EQ(header.map_off_ + sizeof(uint32_t) + map->size_ * sizeof(dex::MapItem),
+           header.file_size_);
+  // The section size and an offset per class def, then a one byte uleb128 per member.
+  std::vector<uint8_t> section((dex_file.NumClassDefs() + 1u) * sizeof(uint32_t), 0u);
+  for (uint32_t i = 0; i != dex_file.NumClassDefs(); ++i) {
+    const dex::ClassDef& class_def = dex_file.GetClassDef(i);
+    if (dex_file.GetClassData(class_def) == nullptr) {
+      continue;
+    }
+    const uint32_t offset = section.size();
+    memcpy(section.data() + (i + 1u) * sizeof(uint32_t), &offset, sizeof(offset));
+    ClassAccessor accessor(dex_file, class_def);
+    section.resize(section.size() + accessor.NumFields() + accessor.NumMethods(), 0u);
+  }
+  const uint32_t section_size = section.size();
+  memcpy(section.data(), &section_size, sizeof(section_size));
+
+  std::vector<uint8_t> data(dex_file.Begin(), dex_file.Begin() + header.map_off_);
+  const uint32_t section_off = data.size();
+  data.insert(data.end(), section.begin(), section.end());
+  data.resize(RoundUp(data.size(), sizeof(uint32_t)), 0u);
+  const uint32_t map_off = data.size();
+  auto append = [&data](const void* value, size_t size) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(value);
+    data.insert(data.end(), bytes, bytes + size);
+  };
+  const uint32_t map_size = map->size_ + 1u;
+  append(&map_size, sizeof(map_size));
+  for (uint32_t i = 0; i != map->size_; ++i) {
+    dex::MapItem item = map->list_[i];
+    if (item.type_ == DexFile::kDexTypeMapList) {
+      dex::MapItem hiddenapi_item = { DexFile::kDexTypeHiddenapiClassData, 0u, 1u, section_off };
+      append(&hiddenapi_item, sizeof(hiddenapi_item));
+      item.offset_ = map_off;
+    }
+    append(&item, sizeof(item));
+  }
+
+  DexFile::Header* new_header = reinterpret_cast<DexFile::Header*>(data.data());
+  new_header->data_size_ += data.size() - header.file_size_;
+  new_header->file_size_ = data.size();
+  new_header->map_off_ = map_off;
+  return data;
+}
+
 TEST_F(ArtDexFileLoaderTest, Open) {
   std::unique_ptr<const DexFile> dex(OpenTestDexFile("Nested"));
   ASSERT_TRUE(dex.get() != nullptr);
@@ -312,4 +364,139 @@ TEST_F(ArtDexFileLoaderTest, GetDexCanonicalLocation) {
   ASSERT_EQ(0, unlink(dex_location_sym.c_str()));
 }
 
+TEST_F(ArtDexFileLoaderTest, ParallelVerification) {
+  // The first boot class path dex file is large enough to be verified on several threads.
+  const DexFile* dex_file = java_lang_dex_file_;
+  std::string error_msg;
+  ASSERT_TRUE(dex::Verify(dex_file,
+                          dex_file->Begin(),
+                          dex_file->Size(),
+                          dex_file->GetLocation().c_str(),
+                          /*verify_checksum=*/ true,
+                          &error_msg,
+                          /*num_threads=*/ 4u)) << error_msg;
+
+  // Corrupt the first non-empty string. Both ways of verifying must report the same error.
+  std::vector<uint8_t> data(dex_file->Begin(), dex_file->Begin() + dex_file->Size());
+  ArtDexFileLoader dex_file_loader;
+  std::unique_ptr<const DexFile> copy = dex_file_loader.Open(data.data(),
+                                                             data.size(),
+                                                             dex_file->GetLocation(),
+                                                             dex_file->GetLocationChecksum(),
+                                                             /*oat_dex_file=*/ nullptr,
+                                                             /*verify=*/ false,
+                                                             /*verify_checksum=*/ false,
+                                                             &error_msg);
+  ASSERT_TRUE(copy != nullptr) << error_msg;
+  for (uint32_t i = 0; i != copy->NumStringIds(); ++i) {
+    uint32_t utf16_length;
+    const char* string_data =
+        copy->GetStringDataAndUtf16Length(copy->GetStringId(dex::StringIndex(i)), &utf16_length);
+    if (utf16_length != 0u) {
+      data[reinterpret_cast<const uint8_t*>(string_data) - copy->Begin()] = 0x80u;
+      break;
+    }
+  }
+  std::string serial_error_msg;
+  std::string parallel_error_msg;
+  EXPECT_FALSE(dex::Verify(copy.get(),
+                           copy->Begin(),
+                           copy->Size(),
+                           copy->GetLocation().c_str(),
+                           /*verify_checksum=*/ false,
+                           &serial_error_msg));
+  EXPECT_FALSE(dex::Verify(copy.get(),
+                           copy->Begin(),
+                           copy->Size(),
+                           copy->GetLocation().c_str(),
+                           /*verify_checksum=*/ false,
+                           &parallel_error_msg,
+                           /*num_threads=*/ 4u));
+  EXPECT_NE(serial_error_msg.find("Illegal start byte"), std::string::npos) << serial_error_msg;
+  EXPECT_EQ(serial_error_msg, parallel_error_msg);
+
+  // The loader passes its number of threads to the verifier.
+  dex_file_loader.SetVerificationThreads(4u);
+  EXPECT_TRUE(dex_file_loader.Open(copy->Begin(),
+                                   copy->Size(),
+                                   copy->GetLocation(),
+                                   copy->GetLocationChecksum(),
+                                   /*oat_dex_file=*/ nullptr,
+                                   /*verify=*/ true,
+                                   /*verify_checksum=*/ false,
+                                   &error_msg) == nullptr);
+}
+
+TEST_F(ArtDexFileLoaderTest, ParallelVerificationOfBootClassPath) {
+  // The boot class path dex files are large enough to be verified on several threads, and must be
+  // accepted the same way as when they are verified on one thread.
+  for (const std::unique_ptr<const DexFile>& dex_file : dex_files_) {
+    for (size_t num_threads : { 1u, 4u }) {
+      std::string error_msg;
+      EXPECT_TRUE(dex::Verify(dex_file.get(),
+                              dex_file->Begin(),
+                              dex_file->Size(),
+                              dex_file->GetLocation().c_str(),
+                              /*verify_checksum=*/ true,
+                              &error_msg,
+                              num_threads)) << dex_file->GetLocation() << " on " << num_threads
+                                            << " threads: " << error_msg;
+    }
+  }
+}
+
+TEST_F(ArtDexFileLoaderTest, ParallelVerificationOfHiddenapiClassData) {
+  // Hiddenapi class data is read through the class data, which must be verified first.
+  std::vector<uint8_t> data = AddHiddenapiClassData(*java_lang_dex_file_);
+  std::string error_msg;
+  ArtDexFileLoader dex_file_loader;
+  std::unique_ptr<const DexFile> dex_file = dex_file_loader.Open(data.data(),
+                                                                 data.size(),
+                                                                 java_lang_dex_file_->GetLocation(),
+                                                                 /*location_checksum=*/ 0u,
+                                                                 /*oat_dex_file=*/ nullptr,
+                                                                 /*verify=*/ false,
+                                                                 /*verify_checksum=*/ false,
+                                                                 &error_msg);
+  ASSERT_TRUE(dex_file != nullptr) << error_msg;
+  ASSERT_TRUE(dex_file->GetHiddenapiClassData() != nullptr);
+  for (size_t num_threads : { 1u, 4u }) {
+    EXPECT_TRUE(dex::Verify(dex_file.get(),
+                            dex_file->Begin(),
+                            dex_file->Size(),
+                            dex_file->GetLocation().c_str(),
+                            /*verify_checksum=*/ false,
+                            &error_msg,
+                            num_threads)) << num_threads << " threads: " << error_msg;
+  }
+
+  // Make the first class data item claim more static fields than it has, which also shifts the
+  // members the hiddenapi flags are read for.
+  for (uint32_t i = 0; i != dex_file->NumClassDefs(); ++i) {
+    const uint8_t* class_data = dex_file->GetClassData(dex_file->GetClassDef(i));
+    if (class_data != nullptr) {
+      ASSERT_NE(*class_data, 0x7fu);
+      data[class_data - dex_file->Begin()] = 0x7fu;
+      break;
+    }
+  }
+  std::string serial_error_msg;
+  std::string parallel_error_msg;
+  EXPECT_FALSE(dex::Verify(dex_file.get(),
+                           dex_file->Begin(),
+                           dex_file->Size(),
+                           dex_file->GetLocation().c_str(),
+                           /*verify_checksum=*/ false,
+                           &serial_error_msg));
+  EXPECT_FALSE(dex::Verify(dex_file.get(),
+                           dex_file->Begin(),
+                           dex_file->Size(),
+                           dex_file->GetLocation().c_str(),
+                           /*verify_checksum=*/ false,
+                           &parallel_error_msg,
+                           /*num_threads=*/ 4u));
+  EXPECT_EQ(serial_error_msg.find("Hiddenapi"), std::string::npos) << serial_error_msg;
+  EXPECT_EQ(serial_error_msg, parallel_error_msg);
+}
+
 }  // namespace art
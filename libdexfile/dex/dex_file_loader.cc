@@ -324,7 +324,7 @@ std::unique_ptr<DexFile> DexFileLoader::OpenCommon(const uint8_t* base,
                                                    bool verify_checksum,
                                                    std::string* error_msg,
                                                    std::unique_ptr<DexFileContainer> container,
-                                                   VerifyResult* verify_result) {
+                                                   VerifyResult* verify_result) const {
   if (verify_result != nullptr) {
     *verify_result = VerifyResult::kVerifyNotAttempted;
   }
@@ -375,7 +375,8 @@ std::unique_ptr<DexFile> DexFileLoader::OpenCommon(const uint8_t* base,
                              dex_file->Size(),
                              location.c_str(),
                              verify_checksum,
-                             error_msg)) {
+                             error_msg,
+                             verification_threads_)) {
     if (verify_result != nullptr) {
       *verify_result = VerifyResult::kVerifyFailed;
     }
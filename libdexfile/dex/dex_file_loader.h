@@ -105,6 +105,12 @@ class DexFileLoader {
 
   virtual ~DexFileLoader() { }
 
+  // Set the number of threads that may be used to verify each dex file opened by this loader.
+  // Only large dex files are verified on more than one thread.
+  void SetVerificationThreads(size_t num_threads) {
+    verification_threads_ = num_threads;
+  }
+
   // Returns the checksums of a file for comparison with GetLocationChecksum().
   // For .dex files, this is the single header checksum.
   // For zip files, this is the zip entry CRC32 checksum for classes.dex and
@@ -164,18 +170,18 @@ class DexFileLoader {
     kVerifyFailed
   };
 
-  static std::unique_ptr<DexFile> OpenCommon(const uint8_t* base,
-                                             size_t size,
-                                             const uint8_t* data_base,
-                                             size_t data_size,
-                                             const std::string& location,
-                                             uint32_t location_checksum,
-                                             const OatDexFile* oat_dex_file,
-                                             bool verify,
-                                             bool verify_checksum,
-                                             std::string* error_msg,
-                                             std::unique_ptr<DexFileContainer> container,
-                                             VerifyResult* verify_result);
+  std::unique_ptr<DexFile> OpenCommon(const uint8_t* base,
+                                      size_t size,
+                                      const uint8_t* data_base,
+                                      size_t data_size,
+                                      const std::string& location,
+                                      uint32_t location_checksum,
+                                      const OatDexFile* oat_dex_file,
+                                      bool verify,
+                                      bool verify_checksum,
+                                      std::string* error_msg,
+                                      std::unique_ptr<DexFileContainer> container,
+                                      VerifyResult* verify_result) const;
 
  private:
   // Open all classesXXX.dex files from a zip archive.
@@ -196,6 +202,8 @@ class DexFileLoader {
                                                        bool verify_checksum,
                                                        DexFileLoaderErrorCode* error_code,
                                                        std::string* error_msg) const;
+
+  size_t verification_threads_ = 1u;
 };
 
 }  // namespace art
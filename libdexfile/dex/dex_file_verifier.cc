@@ -17,9 +17,11 @@
 #include "dex_file_verifier.h"
 
 #include <algorithm>
+#include <atomic>
 #include <bitset>
 #include <limits>
 #include <memory>
+#include <thread>
 
 #include "android-base/logging.h"
 #include "android-base/macros.h"
@@ -46,6 +48,10 @@ namespace {
 
 constexpr uint32_t kTypeIdLimit = std::numeric_limits<uint16_t>::max();
 
+// Smaller dex files are verified on the calling thread even when more threads are allowed,
+// as starting the threads would cost more than it saves.
+constexpr size_t kMinParallelVerificationSize = 1u << 20;
+
 constexpr bool IsValidOrNoTypeId(uint16_t low, uint16_t high) {
   return (high == 0) || ((high == 0xffffU) && (low == 0xffffU));
 }
@@ -195,13 +201,16 @@ class DexFileVerifier {
                   const uint8_t* begin,
                   size_t size,
                   const char* location,
-                  bool verify_checksum)
+                  bool verify_checksum,
+                  size_t num_threads = 1u)
       : dex_file_(dex_file),
         begin_(begin),
         size_(size),
         location_(location),
         verify_checksum_(verify_checksum),
+        num_threads_(num_threads),
         header_(&dex_file->GetHeader()),
+        shared_(this),
         ptr_(nullptr),
         previous_item_(nullptr),
         init_indices_{std::numeric_limits<size_t>::max(),
@@ -313,7 +322,12 @@ class DexFileVerifier {
   bool CheckIntraIdSection(size_t offset, uint32_t count);
   template <DexFile::MapItemType kType>
   bool CheckIntraDataSection(size_t offset, uint32_t count);
+  // Check the items of one map section, starting at `ptr_`. On success, `*offset` is set to the
+  // end of the section; it is left unchanged for unknown section types.
+  bool CheckIntraSectionItems(const dex::MapItem& item, size_t* offset);
   bool CheckIntraSection();
+  // Same as `CheckIntraSection()`, but checks the data sections on worker threads.
+  bool CheckIntraSectionParallel();
 
   bool CheckOffsetToTypeMap(size_t offset, uint16_t type);
 
@@ -336,6 +350,22 @@ class DexFileVerifier {
   bool CheckInterSectionIterate(size_t offset, uint32_t count, DexFile::MapItemType type);
   bool CheckInterSection();
 
+  bool UseParallelVerification() const {
+    return num_threads_ > 1u && size_ >= kMinParallelVerificationSize;
+  }
+
+  // Create a verifier for a worker thread. It shares the results of the intra-section checks
+  // done so far by this verifier, which must not change while the worker is in use.
+  std::unique_ptr<DexFileVerifier> CreateWorker() const;
+
+  // Run `check(worker, item)` for each of the map `items` on up to `num_threads_` threads, each
+  // with its own verifier from `CreateWorker()`, returned in `workers`. On failure, this verifier
+  // gets the failure reason of the first failing item in map order.
+  template <typename CheckFn>
+  bool CheckSectionsInParallel(const std::vector<const dex::MapItem*>& items,
+                               /*out*/ std::vector<std::unique_ptr<DexFileVerifier>>* workers,
+                               CheckFn check);
+
   void ErrorStringPrintf(const char* fmt, ...)
       __attribute__((__format__(__printf__, 2, 3))) COLD_ATTR {
     va_list ap;
@@ -377,8 +407,13 @@ class DexFileVerifier {
   const size_t size_;
   const char* const location_;
   const bool verify_checksum_;
+  const size_t num_threads_;
   const DexFile::Header* const header_;
 
+  // The verifier holding the offset map and defined classes. This is a worker's parent verifier,
+  // or this verifier itself.
+  const DexFileVerifier* shared_;
+
   struct OffsetTypeMapEmptyFn {
     // Make a hash map slot empty by making the offset 0. Offset 0 is a valid dex file offset that
     // is in the offset of the dex file header. However, we only store data section items in the
@@ -2297,6 +2332,154 @@ bool DexFileVerifier::CheckIntraDataSection(size_t offset, uint32_t count) {
   return true;
 }
 
+std::unique_ptr<DexFileVerifier> DexFileVerifier::CreateWorker() const {
+  std::unique_ptr<DexFileVerifier> worker(
+      new DexFileVerifier(dex_file_, begin_, size_, location_, verify_checksum_));
+  worker->shared_ = this;
+  worker->init_indices_ = init_indices_;
+  worker->verified_type_descriptors_.resize(header_->type_ids_size_, 0);
+  return worker;
+}
+
+template <typename CheckFn>
+bool DexFileVerifier::CheckSectionsInParallel(
+    const std::vector<const dex::MapItem*>& items,
+    /*out*/ std::vector<std::unique_ptr<DexFileVerifier>>* workers,
+    CheckFn check) {
+  if (items.empty()) {
+    return true;
+  }
+  size_t num_workers = std::min(num_threads_, items.size());
+  size_t hardware_threads = std::thread::hardware_concurrency();
+  if (hardware_threads != 0u) {
+    num_workers = std::min(num_workers, hardware_threads);
+  }
+  for (size_t i = 0; i != num_workers; ++i) {
+    workers->push_back(CreateWorker());
+  }
+
+  // Items are handed out in map order, so when an item fails all the items before it have
+  // been checked and the first failure in map order is reported, whatever the number of threads.
+  std::vector<std::string> failures(items.size());
+  std::atomic<size_t> next_item(0u);
+  std::atomic<bool> failed(false);
+  auto run = [&](DexFileVerifier* worker) {
+    while (!failed.load(std::memory_order_relaxed)) {
+      size_t i = next_item.fetch_add(1u, std::memory_order_relaxed);
+      if (i >= items.size()) {
+        break;
+      }
+      if (!check(worker, *items[i])) {
+        failures[i] = std::move(worker->failure_reason_);
+        worker->failure_reason_.clear();
+        failed.store(true, std::memory_order_relaxed);
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i != num_workers; ++i) {
+    threads.emplace_back(run, (*workers)[i].get());
+  }
+  run((*workers)[0].get());
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  for (std::string& failure : failures) {
+    if (!failure.empty()) {
+      failure_reason_ = std::move(failure);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DexFileVerifier::CheckIntraSectionItems(const dex::MapItem& item, size_t* offset) {
+  uint32_t section_offset = item.offset_;
+  uint32_t section_count = item.size_;
+  DexFile::MapItemType type = static_cast<DexFile::MapItemType>(item.type_);
+
+  // Check each item based on its type.
+  switch (type) {
+    case DexFile::kDexTypeHeaderItem:
+      if (UNLIKELY(section_count != 1)) {
+        ErrorStringPrintf("Multiple header items");
+        return false;
+      }
+      if (UNLIKELY(section_offset != 0)) {
+        ErrorStringPrintf("Header at %x, not at start of file", section_offset);
+        return false;
+      }
+      ptr_ = begin_ + header_->header_size_;
+      *offset = header_->header_size_;
+      break;
+
+#define CHECK_INTRA_ID_SECTION_CASE(type)                                 \
+    case type:                                                            \
+      if (!CheckIntraIdSection<type>(section_offset, section_count)) {    \
+        return false;                                                     \
+      }                                                                   \
+      *offset = ptr_ - begin_;                                            \
+      break;
+    CHECK_INTRA_ID_SECTION_CASE(DexFile::kDexTypeStringIdItem)
+    CHECK_INTRA_ID_SECTION_CASE(DexFile::kDexTypeTypeIdItem)
+    CHECK_INTRA_ID_SECTION_CASE(DexFile::kDexTypeProtoIdItem)
+    CHECK_INTRA_ID_SECTION_CASE(DexFile::kDexTypeFieldIdItem)
+    CHECK_INTRA_ID_SECTION_CASE(DexFile::kDexTypeMethodIdItem)
+    CHECK_INTRA_ID_SECTION_CASE(DexFile::kDexTypeClassDefItem)
+#undef CHECK_INTRA_ID_SECTION_CASE
+
+    case DexFile::kDexTypeMapList: {
+      if (UNLIKELY(section_count != 1)) {
+        ErrorStringPrintf("Multiple map list items");
+        return false;
+      }
+      if (UNLIKELY(section_offset != header_->map_off_)) {
+        ErrorStringPrintf("Map not at header-defined offset: %x, expected %x",
+                          section_offset, header_->map_off_);
+        return false;
+      }
+      const dex::MapList* map = reinterpret_cast<const dex::MapList*>(begin_ + header_->map_off_);
+      ptr_ += sizeof(uint32_t) + (map->size_ * sizeof(dex::MapItem));
+      *offset = section_offset + sizeof(uint32_t) + (map->size_ * sizeof(dex::MapItem));
+      break;
+    }
+
+#define CHECK_INTRA_SECTION_ITERATE_CASE(type)                               \
+    case type:                                                               \
+      if (!CheckIntraSectionIterate<type>(section_offset, section_count)) {  \
+        return false;                                                        \
+      }                                                                      \
+      *offset = ptr_ - begin_;                                               \
+      break;
+    CHECK_INTRA_SECTION_ITERATE_CASE(DexFile::kDexTypeMethodHandleItem)
+    CHECK_INTRA_SECTION_ITERATE_CASE(DexFile::kDexTypeCallSiteIdItem)
+#undef CHECK_INTRA_SECTION_ITERATE_CASE
+
+#define CHECK_INTRA_DATA_SECTION_CASE(type)                               \
+    case type:                                                            \
+      if (!CheckIntraDataSection<type>(section_offset, section_count)) {  \
+        return false;                                                     \
+      }                                                                   \
+      *offset = ptr_ - begin_;                                            \
+      break;
+    CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeTypeList)
+    CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeAnnotationSetRefList)
+    CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeAnnotationSetItem)
+    CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeClassDataItem)
+    CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeCodeItem)
+    CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeStringDataItem)
+    CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeDebugInfoItem)
+    CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeAnnotationItem)
+    CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeEncodedArrayItem)
+    CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeAnnotationsDirectoryItem)
+    CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeHiddenapiClassData)
+#undef CHECK_INTRA_DATA_SECTION_CASE
+  }
+
+  return true;
+}
+
 bool DexFileVerifier::CheckIntraSection() {
   const dex::MapList* map = reinterpret_cast<const dex::MapList*>(begin_ + header_->map_off_);
   const dex::MapItem* item = map->list_;
@@ -2315,7 +2498,6 @@ bool DexFileVerifier::CheckIntraSection() {
   for (; count != 0u; --count) {
     const size_t current_offset = offset;
     uint32_t section_offset = item->offset_;
-    uint32_t section_count = item->size_;
     DexFile::MapItemType type = static_cast<DexFile::MapItemType>(item->type_);
 
     // Check for padding and overlap between items.
@@ -2330,80 +2512,8 @@ bool DexFileVerifier::CheckIntraSection() {
       FindStringRangesForMethodNames();
     }
 
-    // Check each item based on its type.
-    switch (type) {
-      case DexFile::kDexTypeHeaderItem:
-        if (UNLIKELY(section_count != 1)) {
-          ErrorStringPrintf("Multiple header items");
-          return false;
-        }
-        if (UNLIKELY(section_offset != 0)) {
-          ErrorStringPrintf("Header at %x, not at start of file", section_offset);
-          return false;
-        }
-        ptr_ = begin_ + header_->header_size_;
-        offset = header_->header_size_;
-        break;
-
-#define CHECK_INTRA_ID_SECTION_CASE(type)                                   \
-      case type:                                                            \
-        if (!CheckIntraIdSection<type>(section_offset, section_count)) {    \
-          return false;                                                     \
-        }                                                                   \
-        offset = ptr_ - begin_;                                             \
-        break;
-      CHECK_INTRA_ID_SECTION_CASE(DexFile::kDexTypeStringIdItem)
-      CHECK_INTRA_ID_SECTION_CASE(DexFile::kDexTypeTypeIdItem)
-      CHECK_INTRA_ID_SECTION_CASE(DexFile::kDexTypeProtoIdItem)
-      CHECK_INTRA_ID_SECTION_CASE(DexFile::kDexTypeFieldIdItem)
-      CHECK_INTRA_ID_SECTION_CASE(DexFile::kDexTypeMethodIdItem)
-      CHECK_INTRA_ID_SECTION_CASE(DexFile::kDexTypeClassDefItem)
-#undef CHECK_INTRA_ID_SECTION_CASE
-
-      case DexFile::kDexTypeMapList:
-        if (UNLIKELY(section_count != 1)) {
-          ErrorStringPrintf("Multiple map list items");
-          return false;
-        }
-        if (UNLIKELY(section_offset != header_->map_off_)) {
-          ErrorStringPrintf("Map not at header-defined offset: %x, expected %x",
-                            section_offset, header_->map_off_);
-          return false;
-        }
-        ptr_ += sizeof(uint32_t) + (map->size_ * sizeof(dex::MapItem));
-        offset = section_offset + sizeof(uint32_t) + (map->size_ * sizeof(dex::MapItem));
-        break;
-
-#define CHECK_INTRA_SECTION_ITERATE_CASE(type)                                 \
-      case type:                                                               \
-        if (!CheckIntraSectionIterate<type>(section_offset, section_count)) {  \
-          return false;                                                        \
-        }                                                                      \
-        offset = ptr_ - begin_;                                                \
-        break;
-      CHECK_INTRA_SECTION_ITERATE_CASE(DexFile::kDexTypeMethodHandleItem)
-      CHECK_INTRA_SECTION_ITERATE_CASE(DexFile::kDexTypeCallSiteIdItem)
-#undef CHECK_INTRA_SECTION_ITERATE_CASE
-
-#define CHECK_INTRA_DATA_SECTION_CASE(type)                                 \
-      case type:                                                            \
-        if (!CheckIntraDataSection<type>(section_offset, section_count)) {  \
-          return false;                                                     \
-        }                                                                   \
-        offset = ptr_ - begin_;                                             \
-        break;
-      CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeTypeList)
-      CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeAnnotationSetRefList)
-      CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeAnnotationSetItem)
-      CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeClassDataItem)
-      CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeCodeItem)
-      CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeStringDataItem)
-      CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeDebugInfoItem)
-      CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeAnnotationItem)
-      CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeEncodedArrayItem)
-      CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeAnnotationsDirectoryItem)
-      CHECK_INTRA_DATA_SECTION_CASE(DexFile::kDexTypeHiddenapiClassData)
-#undef CHECK_INTRA_DATA_SECTION_CASE
+    if (!CheckIntraSectionItems(*item, &offset)) {
+      return false;
     }
 
     if (offset == current_offset) {
@@ -2417,10 +2527,103 @@ bool DexFileVerifier::CheckIntraSection() {
   return true;
 }
 
+bool DexFileVerifier::CheckIntraSectionParallel() {
+  const dex::MapList* map = reinterpret_cast<const dex::MapList*>(begin_ + header_->map_off_);
+  const uint32_t count = map->size_;
+
+  offset_to_type_map_.reserve(
+      std::min(header_->class_defs_size_, 65535u) +
+      std::min(header_->string_ids_size_, 65535u) +
+      2 * std::min(header_->method_ids_size_, 65535u));
+
+  // `CheckMap()` guarantees that section offsets are increasing and within the file, so each
+  // section can be checked on its own starting at its offset. The header, id and map sections
+  // are checked first, on this thread, as the class defs fill `defined_classes_`. The data
+  // sections other than class data do not depend on each other and are checked concurrently.
+  // Class data needs the string ranges found from verified string data, and is checked after
+  // them. Hiddenapi class data is read with a ClassAccessor, and is checked last.
+  std::vector<size_t> end_offsets(count);
+  std::vector<const dex::MapItem*> data_items;
+  const dex::MapItem* class_data_item = nullptr;
+  const dex::MapItem* hiddenapi_class_data_item = nullptr;
+  for (uint32_t i = 0; i != count; ++i) {
+    const dex::MapItem& item = map->list_[i];
+    DexFile::MapItemType type = static_cast<DexFile::MapItemType>(item.type_);
+    end_offsets[i] = item.offset_;
+    if (type == DexFile::kDexTypeClassDataItem) {
+      class_data_item = &item;
+    } else if (type == DexFile::kDexTypeHiddenapiClassData) {
+      hiddenapi_class_data_item = &item;
+    } else if (IsDataSectionType(type) &&
+               type != DexFile::kDexTypeMapList &&
+               type != DexFile::kDexTypeCallSiteIdItem &&
+               type != DexFile::kDexTypeMethodHandleItem) {
+      data_items.push_back(&item);
+    } else {
+      ptr_ = begin_ + item.offset_;
+      if (!CheckIntraSectionItems(item, &end_offsets[i])) {
+        return false;
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<DexFileVerifier>> workers;
+  auto check_data_section = [&](DexFileVerifier* worker, const dex::MapItem& item) {
+    worker->ptr_ = begin_ + item.offset_;
+    return worker->CheckIntraSectionItems(item, &end_offsets[&item - map->list_]);
+  };
+  if (!CheckSectionsInParallel(data_items, &workers, check_data_section)) {
+    return false;
+  }
+
+  if (class_data_item != nullptr) {
+    FindStringRangesForMethodNames();
+    ptr_ = begin_ + class_data_item->offset_;
+    if (!CheckIntraSectionItems(*class_data_item, &end_offsets[class_data_item - map->list_])) {
+      return false;
+    }
+  }
+  if (hiddenapi_class_data_item != nullptr) {
+    ptr_ = begin_ + hiddenapi_class_data_item->offset_;
+    if (!CheckIntraSectionItems(*hiddenapi_class_data_item,
+                                &end_offsets[hiddenapi_class_data_item - map->list_])) {
+      return false;
+    }
+  }
+
+  // Check for padding and overlap between items, now that the end of each section is known.
+  size_t offset = 0u;
+  for (uint32_t i = 0; i != count; ++i) {
+    uint32_t section_offset = map->list_[i].offset_;
+    DexFile::MapItemType type = static_cast<DexFile::MapItemType>(map->list_[i].type_);
+    ptr_ = begin_ + offset;
+    if (!CheckPadding(offset, section_offset, type)) {
+      return false;
+    } else if (UNLIKELY(offset > section_offset)) {
+      ErrorStringPrintf("Section overlap or out-of-order map: %zx, %x", offset, section_offset);
+      return false;
+    }
+    if (end_offsets[i] == offset) {
+      ErrorStringPrintf("Unknown map item type %x", type);
+      return false;
+    }
+    offset = end_offsets[i];
+  }
+
+  // Sections do not overlap, so the data items found by the workers are all distinct.
+  for (const std::unique_ptr<DexFileVerifier>& worker : workers) {
+    for (const std::pair<uint32_t, uint16_t>& entry : worker->offset_to_type_map_) {
+      DCHECK(offset_to_type_map_.find(entry.first) == offset_to_type_map_.end());
+      offset_to_type_map_.insert(entry);
+    }
+  }
+  return true;
+}
+
 bool DexFileVerifier::CheckOffsetToTypeMap(size_t offset, uint16_t type) {
   DCHECK_NE(offset, 0u);
-  auto it = offset_to_type_map_.find(offset);
-  if (UNLIKELY(it == offset_to_type_map_.end())) {
+  auto it = shared_->offset_to_type_map_.find(offset);
+  if (UNLIKELY(it == shared_->offset_to_type_map_.end())) {
     ErrorStringPrintf("No data map entry found @ %zx; expected %x", offset, type);
     return false;
   }
@@ -2980,13 +3183,14 @@ bool DexFileVerifier::CheckInterClassDataItem() {
   if (defining_class == kDexNoIndex) {
     return true;  // Empty definitions are OK (but useless) and could be shared by multiple classes.
   }
-  if (!defined_classes_[defining_class]) {
+  if (!shared_->defined_classes_[defining_class]) {
       // Should really have a class definition for this class data item.
       ErrorStringPrintf("Could not find declaring class for non-empty class data item.");
       return false;
   }
   const dex::TypeIndex class_type_index(defining_class);
-  const dex::ClassDef& class_def = dex_file_->GetClassDef(defined_class_indexes_[defining_class]);
+  const dex::ClassDef& class_def =
+      dex_file_->GetClassDef(shared_->defined_class_indexes_[defining_class]);
 
   for (const ClassAccessor::Field& read_field : accessor.GetFields()) {
     // The index has already been checked in `CheckIntraClassDataItemFields()`.
@@ -3251,6 +3455,8 @@ bool DexFileVerifier::CheckInterSection() {
   const dex::MapList* map = reinterpret_cast<const dex::MapList*>(begin_ + header_->map_off_);
   const dex::MapItem* item = map->list_;
   uint32_t count = map->size_;
+  const bool parallel = UseParallelVerification();
+  std::vector<const dex::MapItem*> parallel_items;
 
   // Cross check the items listed in the map.
   for (; count != 0u; --count) {
@@ -3283,7 +3489,9 @@ bool DexFileVerifier::CheckInterSection() {
       case DexFile::kDexTypeClassDataItem:
       case DexFile::kDexTypeAnnotationsDirectoryItem:
       case DexFile::kDexTypeHiddenapiClassData: {
-        if (!CheckInterSectionIterate(section_offset, section_count, type)) {
+        if (parallel) {
+          parallel_items.push_back(item);
+        } else if (!CheckInterSectionIterate(section_offset, section_count, type)) {
           return false;
         }
         found = true;
@@ -3299,6 +3507,18 @@ bool DexFileVerifier::CheckInterSection() {
     item++;
   }
 
+  if (!parallel_items.empty()) {
+    // The intra-section checks are complete, so the workers can share their results.
+    std::vector<std::unique_ptr<DexFileVerifier>> workers;
+    auto check_section = [](DexFileVerifier* worker, const dex::MapItem& map_item) {
+      return worker->CheckInterSectionIterate(
+          map_item.offset_, map_item.size_, static_cast<DexFile::MapItemType>(map_item.type_));
+    };
+    if (!CheckSectionsInParallel(parallel_items, &workers, check_section)) {
+      return false;
+    }
+  }
+
   return true;
 }
 
@@ -3318,7 +3538,7 @@ bool DexFileVerifier::Verify() {
   defined_class_indexes_.resize(header_->type_ids_size_);
 
   // Check structure within remaining sections.
-  if (!CheckIntraSection()) {
+  if (!(UseParallelVerification() ? CheckIntraSectionParallel() : CheckIntraSection())) {
     return false;
   }
 
@@ -3688,9 +3908,10 @@ bool Verify(const DexFile* dex_file,
             size_t size,
             const char* location,
             bool verify_checksum,
-            std::string* error_msg) {
+            std::string* error_msg,
+            size_t num_threads) {
   std::unique_ptr<DexFileVerifier> verifier(
-      new DexFileVerifier(dex_file, begin, size, location, verify_checksum));
+      new DexFileVerifier(dex_file, begin, size, location, verify_checksum, num_threads));
   if (!verifier->Verify()) {
     *error_msg = verifier->FailureReason();
     return false;
@@ -27,12 +27,16 @@ class DexFile;
 
 namespace dex {
 
+// Verify the dex file at `begin`. With `num_threads` > 1, large dex files have their sections
+// verified concurrently on up to `num_threads` threads. The result does not depend on the
+// number of threads, but for dex files with several errors the reported one may differ.
 bool Verify(const DexFile* dex_file,
             const uint8_t* begin,
             size_t size,
             const char* location,
             bool verify_checksum,
-            std::string* error_msg);
+            std::string* error_msg,
+            size_t num_threads = 1u);
 
 }  // namespace dex
 }  // namespace art
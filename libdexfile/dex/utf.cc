@@ -16,10 +16,24 @@
 
 #include "utf.h"
 
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
+#include "base/bit_utils.h"
 #include "base/casts.h"
 #include "utf-inl.h"
 
@@ -27,6 +41,78 @@ namespace art {
 
 using android::base::StringAppendF;
 
+// Returns the number of leading ASCII bytes (including '\0') in `utf8[0, byte_count)`.
+// Most strings in dex files are ASCII, so this scans whole vectors where possible and the
+// callers only fall back to decoding byte by byte for multi-byte sequences.
+static ALWAYS_INLINE size_t CountAsciiPrefix(const char* utf8, size_t byte_count) {
+  size_t i = 0u;
+#if defined(__AVX2__)
+  for (; byte_count - i >= 32u; i += 32u) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(utf8 + i));
+    uint32_t non_ascii = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+    if (non_ascii != 0u) {
+      return i + CTZ(non_ascii);
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  for (; byte_count - i >= 16u; i += 16u) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(utf8 + i));
+    uint32_t non_ascii = static_cast<uint32_t>(_mm_movemask_epi8(v));
+    if (non_ascii != 0u) {
+      return i + CTZ(non_ascii);
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; byte_count - i >= 16u; i += 16u) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(utf8 + i));
+    if (vmaxvq_u8(v) >= 0x80u) {
+      break;  // Find the exact position below.
+    }
+  }
+#endif
+  // Eight bytes at a time. All supported ISAs are little-endian, so the lowest set bit
+  // belongs to the first non-ASCII byte.
+  for (; byte_count - i >= sizeof(uint64_t); i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, utf8 + i, sizeof(word));
+    uint64_t non_ascii = word & UINT64_C(0x8080808080808080);
+    if (non_ascii != 0u) {
+      return i + CTZ(non_ascii) / kBitsPerByte;
+    }
+  }
+  while (i != byte_count && (utf8[i] & 0x80) == 0) {
+    ++i;
+  }
+  return i;
+}
+
+// Widens `count` ASCII bytes to UTF-16 characters.
+static ALWAYS_INLINE void ConvertAsciiToUtf16(uint16_t* utf16_out,
+                                              const char* utf8_in,
+                                              size_t count) {
+  size_t i = 0u;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  for (; count - i >= 16u; i += 16u) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(utf8_in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(utf16_out + i), _mm_unpacklo_epi8(v, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(utf16_out + i + 8u), _mm_unpackhi_epi8(v, zero));
+  }
+#elif defined(__ARM_NEON)
+  for (; count - i >= 16u; i += 16u) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(utf8_in + i));
+    vst1q_u16(utf16_out + i, vmovl_u8(vget_low_u8(v)));
+    vst1q_u16(utf16_out + i + 8u, vmovl_u8(vget_high_u8(v)));
+  }
+#endif
+  for (; i != count; ++i) {
+    // Safe even if char is signed because ASCII characters always have
+    // the high bit cleared.
+    utf16_out[i] = dchecked_integral_cast<uint16_t>(utf8_in[i]);
+  }
+}
+
 // This is used only from debugger and test code.
 size_t CountModifiedUtf8Chars(const char* utf8) {
   return CountModifiedUtf8Chars(utf8, strlen(utf8));
@@ -52,6 +138,12 @@ size_t CountModifiedUtf8Chars(const char* utf8, size_t byte_count) {
   size_t len = 0;
   const char* end = utf8 + byte_count;
   for (; utf8 < end; ++utf8) {
+    size_t ascii_count = CountAsciiPrefix(utf8, end - utf8);
+    len += ascii_count;
+    utf8 += ascii_count;
+    if (utf8 == end) {
+      break;
+    }
     int ic = *utf8;
     len++;
     if (LIKELY((ic & 0x80) == 0)) {
@@ -100,16 +192,19 @@ void ConvertModifiedUtf8ToUtf16(uint16_t* utf16_data_out, size_t out_chars,
 
   if (LIKELY(out_chars == in_bytes)) {
     // Common case where all characters are ASCII.
-    for (const char *p = in_start; p < in_end;) {
-      // Safe even if char is signed because ASCII characters always have
-      // the high bit cleared.
-      *out_p++ = dchecked_integral_cast<uint16_t>(*p++);
-    }
+    ConvertAsciiToUtf16(out_p, in_start, in_bytes);
     return;
   }
 
-  // String contains non-ASCII characters.
+  // String contains non-ASCII characters. Copy the ASCII runs between them in bulk.
   for (const char *p = in_start; p < in_end;) {
+    size_t ascii_count = CountAsciiPrefix(p, in_end - p);
+    ConvertAsciiToUtf16(out_p, p, ascii_count);
+    out_p += ascii_count;
+    p += ascii_count;
+    if (p == in_end) {
+      break;
+    }
     const uint32_t ch = GetUtf16FromUtf8(&p);
     const uint16_t leading = GetLeadingUtf16Char(ch);
     const uint16_t trailing = GetTrailingUtf16Char(ch);
@@ -191,11 +286,61 @@ int32_t ComputeUtf16HashFromModifiedUtf8(const char* utf8, size_t utf16_length)
   return static_cast<int32_t>(hash);
 }
 
+static constexpr uint32_t PowerOf31(size_t exponent) {
+  uint32_t result = 1u;
+  for (size_t i = 0; i != exponent; ++i) {
+    result *= 31u;
+  }
+  return result;
+}
+
 uint32_t ComputeModifiedUtf8Hash(const char* chars) {
+  // The length comes from the (vectorized) strlen() of the C library. Knowing it lets us
+  // hash 16 bytes at a time without reading past the terminating null:
+  //   hash(s + b[0..15]) = hash(s) * 31^16 + sum(b[i] * 31^(15 - i))
+  // Arithmetic is modulo 2^32, so this is exactly the same as hashing byte by byte.
+  size_t length = strlen(chars);
   uint32_t hash = 0;
-  while (*chars != '\0') {
-    hash = hash * 31 + static_cast<uint8_t>(*chars);
-    ++chars;
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(chars);
+  const uint8_t* end = bytes + length;
+#if defined(__SSE4_1__) || (defined(__ARM_NEON) && defined(__aarch64__))
+  alignas(16) static constexpr uint32_t kPowers[] = {
+      PowerOf31(15), PowerOf31(14), PowerOf31(13), PowerOf31(12),
+      PowerOf31(11), PowerOf31(10), PowerOf31(9), PowerOf31(8),
+      PowerOf31(7), PowerOf31(6), PowerOf31(5), PowerOf31(4),
+      PowerOf31(3), PowerOf31(2), PowerOf31(1), PowerOf31(0),
+  };
+  static constexpr uint32_t kBlockMultiplier = PowerOf31(16);
+#if defined(__SSE4_1__)
+  const __m128i* powers = reinterpret_cast<const __m128i*>(kPowers);
+  for (; end - bytes >= 16; bytes += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+    __m128i sum = _mm_mullo_epi32(_mm_cvtepu8_epi32(v), _mm_load_si128(powers));
+    sum = _mm_add_epi32(
+        sum, _mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4)), _mm_load_si128(powers + 1)));
+    sum = _mm_add_epi32(
+        sum, _mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(v, 8)), _mm_load_si128(powers + 2)));
+    sum = _mm_add_epi32(
+        sum, _mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(v, 12)), _mm_load_si128(powers + 3)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    hash = hash * kBlockMultiplier + static_cast<uint32_t>(_mm_cvtsi128_si32(sum));
+  }
+#else
+  for (; end - bytes >= 16; bytes += 16) {
+    uint8x16_t v = vld1q_u8(bytes);
+    uint16x8_t low = vmovl_u8(vget_low_u8(v));
+    uint16x8_t high = vmovl_high_u8(v);
+    uint32x4_t sum = vmulq_u32(vmovl_u16(vget_low_u16(low)), vld1q_u32(kPowers));
+    sum = vmlaq_u32(sum, vmovl_high_u16(low), vld1q_u32(kPowers + 4));
+    sum = vmlaq_u32(sum, vmovl_u16(vget_low_u16(high)), vld1q_u32(kPowers + 8));
+    sum = vmlaq_u32(sum, vmovl_high_u16(high), vld1q_u32(kPowers + 12));
+    hash = hash * kBlockMultiplier + vaddvq_u32(sum);
+  }
+#endif
+#endif
+  for (; bytes != end; ++bytes) {
+    hash = hash * 31 + *bytes;
   }
   return hash;
 }
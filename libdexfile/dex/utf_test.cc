@@ -19,8 +19,10 @@
 #include <map>
 #include <vector>
 
+#include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 
+#include "base/time_utils.h"
 #include "gtest/gtest.h"
 #include "utf-inl.h"
 
@@ -229,6 +231,29 @@ size_t CountModifiedUtf8Chars_reference(const char* utf8) {
   return len;
 }
 
+static void ConvertModifiedUtf8ToUtf16_reference(uint16_t* utf16_data_out,
+                                                 const char* utf8_data_in,
+                                                 size_t in_bytes) {
+  const char* in_end = utf8_data_in + in_bytes;
+  while (utf8_data_in < in_end) {
+    const uint32_t ch = GetUtf16FromUtf8(&utf8_data_in);
+    *utf16_data_out++ = GetLeadingUtf16Char(ch);
+    const uint16_t trailing = GetTrailingUtf16Char(ch);
+    if (trailing != 0) {
+      *utf16_data_out++ = trailing;
+    }
+  }
+}
+
+static uint32_t ComputeModifiedUtf8Hash_reference(const char* chars) {
+  uint32_t hash = 0;
+  while (*chars != '\0') {
+    hash = hash * 31 + static_cast<uint8_t>(*chars);
+    ++chars;
+  }
+  return hash;
+}
+
 static size_t CountUtf8Bytes_reference(const uint16_t* chars, size_t char_count) {
   size_t result = 0;
   while (char_count--) {
@@ -405,4 +430,92 @@ TEST_F(UtfTest, PrintableStringUtf8) {
   EXPECT_EQ(expected, printable);
 }
 
+// Strings mixing ASCII runs of every length up to a few vectors with multi-byte sequences,
+// so that the vectorized paths see non-ASCII bytes at every position.
+static std::vector<std::string> MakeMixedStrings() {
+  static const char* const kSequences[] = {
+      "\xc0\x80",  // U+0000
+      "\xc2\xa2",
+      "\xe2\x82\xac",
+      "\xf0\x9f\x8f\xa0",
+  };
+  std::vector<std::string> result;
+  for (size_t ascii_length = 0; ascii_length != 70u; ++ascii_length) {
+    std::string ascii;
+    for (size_t i = 0; i != ascii_length; ++i) {
+      ascii += static_cast<char>('!' + (i * 7) % 94);
+    }
+    result.push_back(ascii);
+    for (const char* sequence : kSequences) {
+      result.push_back(ascii + sequence);
+      result.push_back(sequence + ascii);
+      result.push_back(ascii + sequence + ascii + sequence + ascii.substr(ascii_length / 2));
+    }
+  }
+  return result;
+}
+
+TEST_F(UtfTest, VectorizedMatchesReference) {
+  for (const std::string& str : MakeMixedStrings()) {
+    const char* utf8 = str.c_str();
+    size_t char_count = CountModifiedUtf8Chars_reference(utf8);
+    EXPECT_EQ(char_count, CountModifiedUtf8Chars(utf8, str.size())) << PrintableString(utf8);
+    EXPECT_EQ(ComputeModifiedUtf8Hash_reference(utf8), ComputeModifiedUtf8Hash(utf8))
+        << PrintableString(utf8);
+
+    // One extra element to catch writes past the end.
+    std::vector<uint16_t> expected(char_count + 1u, 0xffffu);
+    std::vector<uint16_t> actual(char_count + 1u, 0xffffu);
+    ConvertModifiedUtf8ToUtf16_reference(expected.data(), utf8, str.size());
+    ConvertModifiedUtf8ToUtf16(actual.data(), char_count, utf8, str.size());
+    EXPECT_EQ(expected, actual) << PrintableString(utf8);
+  }
+}
+
+TEST_F(UtfTest, DecodingBenchmark) {
+  // Report the time taken by the optimized and reference functions on descriptor-like strings.
+  static constexpr size_t kIterations = 2000u;
+  std::vector<std::string> strings;
+  for (size_t i = 0; i != 100u; ++i) {
+    strings.push_back(
+        android::base::StringPrintf("Lcom/example/package%zu/SomeClassName%zu;", i, i));
+    strings.push_back(android::base::StringPrintf("Lcom/example/\xc3\xa9t\xc3\xa9%zu;", i));
+  }
+  std::vector<uint16_t> utf16(256u);
+  uint32_t checksum = 0u;
+  auto time = [&](const char* name, auto&& fn) {
+    uint64_t start = NanoTime();
+    for (size_t i = 0; i != kIterations; ++i) {
+      for (const std::string& str : strings) {
+        checksum += fn(str);
+      }
+    }
+    uint64_t duration = NanoTime() - start;
+    LOG(INFO) << name << ": " << duration / (kIterations * strings.size()) << "ns per string";
+  };
+  time("ComputeModifiedUtf8Hash", [](const std::string& str) {
+    return ComputeModifiedUtf8Hash(str.c_str());
+  });
+  time("ComputeModifiedUtf8Hash_reference", [](const std::string& str) {
+    return ComputeModifiedUtf8Hash_reference(str.c_str());
+  });
+  time("CountModifiedUtf8Chars", [](const std::string& str) {
+    return CountModifiedUtf8Chars(str.c_str(), str.size());
+  });
+  time("CountModifiedUtf8Chars_reference", [](const std::string& str) {
+    return CountModifiedUtf8Chars_reference(str.c_str());
+  });
+  time("ConvertModifiedUtf8ToUtf16", [&](const std::string& str) {
+    ConvertModifiedUtf8ToUtf16(
+        utf16.data(), CountModifiedUtf8Chars(str.c_str(), str.size()), str.c_str(), str.size());
+    return utf16[0];
+  });
+  time("ConvertModifiedUtf8ToUtf16_reference", [&](const std::string& str) {
+    ConvertModifiedUtf8ToUtf16_reference(utf16.data(), str.c_str(), str.size());
+    return utf16[0];
+  });
+  // Keep the results alive.
+  EXPECT_NE(0u, checksum);
+}
+
 }  // namespace art
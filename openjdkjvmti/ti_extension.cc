@@ -396,6 +396,30 @@ jvmtiError ExtensionUtil::GetExtensionFunctions(jvmtiEnv* env,
     return error;
   }
 
+  // GetHeapCensus
+  error = add_extension(
+      reinterpret_cast<jvmtiExtensionFunction>(HeapExtensions::GetHeapCensus),
+      "com.android.art.heap.get_heap_census",
+      "Retrieves the per-class census of the objects marked by the last full garbage collection."
+      " The runtime must have been started with -XX:HeapCensus. The descriptors_out list gives"
+      " the class descriptors, most bytes first, and the instances_out and bytes_out lists give"
+      " the number and total size of their instances. Objects of the boot image and the zygote"
+      " are not counted. The lists and all descriptors must be deallocated by the caller.",
+      {
+        { "class_count_out", JVMTI_KIND_OUT, JVMTI_TYPE_JINT, false },
+        { "descriptors_out", JVMTI_KIND_ALLOC_ALLOC_BUF, JVMTI_TYPE_CCHAR, false },
+        { "instances_out", JVMTI_KIND_ALLOC_BUF, JVMTI_TYPE_JLONG, false },
+        { "bytes_out", JVMTI_KIND_ALLOC_BUF, JVMTI_TYPE_JLONG, false },
+      },
+      {
+         ERR(NULL_POINTER),
+         ERR(NOT_AVAILABLE),
+         ERR(OUT_OF_MEMORY),
+      });
+  if (error != ERR(NONE)) {
+    return error;
+  }
+
   // These require index-ids and debuggable to function
   art::Runtime* runtime = art::Runtime::Current();
   if (runtime->GetJniIdType() == art::JniIdType::kIndices &&
@@ -18,6 +18,7 @@
 
 #include <ios>
 #include <unordered_map>
+#include <vector>
 
 #include "android-base/logging.h"
 #include "android-base/thread_annotations.h"
@@ -37,6 +38,7 @@
 #include "gc/gc_cause.h"
 #include "gc/heap-visit-objects-inl.h"
 #include "gc/heap-inl.h"
+#include "gc/heap_census.h"
 #include "gc/scoped_gc_critical_section.h"
 #include "gc_root-inl.h"
 #include "handle.h"
@@ -1977,6 +1979,57 @@ jvmtiError HeapExtensions::ChangeArraySize(jvmtiEnv* env, jobject arr, jsize new
   return OK;
 }
 
+jvmtiError HeapExtensions::GetHeapCensus(jvmtiEnv* env,
+                                         jint* class_count_ptr,
+                                         char*** descriptors_ptr,
+                                         jlong** instances_ptr,
+                                         jlong** bytes_ptr) {
+  if (class_count_ptr == nullptr ||
+      descriptors_ptr == nullptr ||
+      instances_ptr == nullptr ||
+      bytes_ptr == nullptr) {
+    return ERR(NULL_POINTER);
+  }
+  art::gc::HeapCensus* census = art::Runtime::Current()->GetHeap()->GetHeapCensus();
+  if (census == nullptr) {
+    JVMTI_LOG(INFO, env) << "The heap census is only taken with -XX:HeapCensus";
+    return ERR(NOT_AVAILABLE);
+  }
+  std::vector<art::gc::HeapCensus::ClassCount> class_counts = census->GetClassCounts();
+  const size_t count = class_counts.size();
+  jvmtiError res = OK;
+  std::vector<JvmtiUniquePtr<char[]>> descriptors;
+  descriptors.reserve(count);
+  for (const art::gc::HeapCensus::ClassCount& class_count : class_counts) {
+    descriptors.push_back(CopyString(env, class_count.descriptor.c_str(), &res));
+    if (res != OK) {
+      return res;
+    }
+  }
+  JvmtiUniquePtr<char*[]> out_descriptors = AllocJvmtiUniquePtr<char*[]>(env, count, &res);
+  if (res != OK) {
+    return res;
+  }
+  JvmtiUniquePtr<jlong[]> out_instances = AllocJvmtiUniquePtr<jlong[]>(env, count, &res);
+  if (res != OK) {
+    return res;
+  }
+  JvmtiUniquePtr<jlong[]> out_bytes = AllocJvmtiUniquePtr<jlong[]>(env, count, &res);
+  if (res != OK) {
+    return res;
+  }
+  for (size_t i = 0; i != count; ++i) {
+    out_descriptors[i] = descriptors[i].release();
+    out_instances[i] = static_cast<jlong>(class_counts[i].instances);
+    out_bytes[i] = static_cast<jlong>(class_counts[i].bytes);
+  }
+  *class_count_ptr = static_cast<jint>(count);
+  *descriptors_ptr = out_descriptors.release();
+  *instances_ptr = out_instances.release();
+  *bytes_ptr = out_bytes.release();
+  return OK;
+}
+
 void HeapExtensions::Register(EventHandler* eh) {
   gEventHandler = eh;
 }
@@ -91,6 +91,12 @@ class HeapExtensions {
 
   static jvmtiError JNICALL ChangeArraySize(jvmtiEnv* env, jobject arr, jsize new_size);
 
+  static jvmtiError JNICALL GetHeapCensus(jvmtiEnv* env,
+                                          jint* class_count_ptr,
+                                          char*** descriptors_ptr,
+                                          jlong** instances_ptr,
+                                          jlong** bytes_ptr);
+
   static void ReplaceReferences(
       art::Thread* self,
       const std::unordered_map<art::ObjPtr<art::mirror::Object>,
@@ -2555,7 +2555,7 @@ ObjPtr<mirror::Class> ClassLinker::AllocClass(Thread* self,
                                               const PreFenceVisitor& pre_fence_visitor) {
   DCHECK_GE(class_size, sizeof(mirror::Class));
   gc::Heap* heap = Runtime::Current()->GetHeap();
-  ObjPtr<mirror::Object> k = (kMovingClasses && kMovable) ?
+  ObjPtr<mirror::Object> k = (kMovable && heap->CanMoveClasses()) ?
       heap->AllocObject(self, java_lang_Class, class_size, pre_fence_visitor) :
       heap->AllocNonMovableObject(self, java_lang_Class, class_size, pre_fence_visitor);
   if (UNLIKELY(k == nullptr)) {
@@ -22,15 +22,33 @@
 
 namespace art {
 
-ClassTable::ClassTable() : lock_("Class loader classes", kClassLoaderClassesLock) {
+ClassTable::ClassTable()
+    : lock_("Class loader classes", kClassLoaderClassesLock),
+      frozen_snapshot_(nullptr),
+      frozen_sets_sequence_(0u) {
   Runtime* const runtime = Runtime::Current();
   classes_.push_back(ClassSet(runtime->GetHashTableMinLoadFactor(),
                               runtime->GetHashTableMaxLoadFactor()));
+  // Nothing is frozen yet.
+  snapshots_.push_back(std::make_unique<FrozenSnapshot>());
+  frozen_snapshot_.store(snapshots_.back().get(), std::memory_order_release);
 }
 
 void ClassTable::FreezeSnapshot() {
   WriterMutexLock mu(Thread::Current(), lock_);
   classes_.push_back(ClassSet());
+  PublishFrozenSnapshotLocked();
+}
+
+void ClassTable::PublishFrozenSnapshotLocked() {
+  std::unique_ptr<FrozenSnapshot> snapshot = std::make_unique<FrozenSnapshot>();
+  snapshot->sets.reserve(classes_.size() - 1u);
+  for (size_t i = 0; i + 1u < classes_.size(); ++i) {
+    snapshot->sets.push_back(&classes_[i]);
+  }
+  // The release store makes the contents of the frozen sets visible to readers of the snapshot.
+  frozen_snapshot_.store(snapshot.get(), std::memory_order_release);
+  snapshots_.push_back(std::move(snapshot));
 }
 
 bool ClassTable::Contains(ObjPtr<mirror::Class> klass) {
@@ -38,11 +56,42 @@ bool ClassTable::Contains(ObjPtr<mirror::Class> klass) {
 }
 
 ObjPtr<mirror::Class> ClassTable::LookupByDescriptor(ObjPtr<mirror::Class> klass) {
+  const uint32_t hash = TableSlot::HashDescriptor(klass);
+  return LookupWithHash(TableSlot(klass, hash), hash);
+}
+
+template <typename Key>
+ObjPtr<mirror::Class> ClassTable::LookupWithHash(const Key& key, uint32_t hash) {
+  // Classes from the zygote and the images live in frozen sets, which are searched without the
+  // lock. Only a concurrent Remove from one of them may disturb the search, which the sequence
+  // count detects, in which case we fall back to searching everything under the lock.
+  const uint32_t sequence = frozen_sets_sequence_.load(std::memory_order_acquire);
+  const FrozenSnapshot* snapshot = frozen_snapshot_.load(std::memory_order_acquire);
+  if ((sequence & 1u) == 0u) {
+    for (const ClassSet* class_set : snapshot->sets) {
+      auto it = class_set->FindWithHash(key, hash);
+      if (it != class_set->end()) {
+        ObjPtr<mirror::Class> klass = it->Read();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (frozen_sets_sequence_.load(std::memory_order_relaxed) == sequence) {
+          return klass;
+        }
+        break;
+      }
+    }
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
   ReaderMutexLock mu(Thread::Current(), lock_);
-  TableSlot slot(klass);
-  for (ClassSet& class_set : classes_) {
-    auto it = class_set.find(slot);
-    if (it != class_set.end()) {
+  // If the frozen sets we searched are still the frozen sets and were not modified meanwhile,
+  // only the set that is inserted into is left to search.
+  const bool searched_frozen_sets =
+      (sequence & 1u) == 0u &&
+      frozen_sets_sequence_.load(std::memory_order_relaxed) == sequence &&
+      frozen_snapshot_.load(std::memory_order_relaxed) == snapshot;
+  auto begin = searched_frozen_sets ? classes_.end() - 1 : classes_.begin();
+  for (auto set_it = begin; set_it != classes_.end(); ++set_it) {
+    auto it = set_it->FindWithHash(key, hash);
+    if (it != set_it->end()) {
       return it->Read();
     }
   }
@@ -117,14 +166,7 @@ size_t ClassTable::NumReferencedNonZygoteClasses() const {
 
 ObjPtr<mirror::Class> ClassTable::Lookup(const char* descriptor, size_t hash) {
   DescriptorHashPair pair(descriptor, hash);
-  ReaderMutexLock mu(Thread::Current(), lock_);
-  for (ClassSet& class_set : classes_) {
-    auto it = class_set.FindWithHash(pair, hash);
-    if (it != class_set.end()) {
-      return it->Read();
-    }
-  }
-  return nullptr;
+  return LookupWithHash(pair, hash);
 }
 
 ObjPtr<mirror::Class> ClassTable::TryInsert(ObjPtr<mirror::Class> klass) {
@@ -175,7 +217,15 @@ bool ClassTable::Remove(const char* descriptor) {
   for (ClassSet& class_set : classes_) {
     auto it = class_set.find(pair);
     if (it != class_set.end()) {
-      class_set.erase(it);
+      if (&class_set != &classes_.back()) {
+        // Erasing shuffles elements around, tell lock-free readers of the frozen sets.
+        frozen_sets_sequence_.fetch_add(1u, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        class_set.erase(it);
+        frozen_sets_sequence_.fetch_add(1u, std::memory_order_release);
+      } else {
+        class_set.erase(it);
+      }
       return true;
     }
   }
@@ -283,7 +333,8 @@ size_t ClassTable::ReadFromMemory(uint8_t* ptr) {
 
 void ClassTable::AddClassSet(ClassSet&& set) {
   WriterMutexLock mu(Thread::Current(), lock_);
-  classes_.insert(classes_.begin(), std::move(set));
+  classes_.push_front(std::move(set));
+  PublishFrozenSnapshotLocked();
 }
 
 void ClassTable::ClearStrongRoots() {
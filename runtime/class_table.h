@@ -17,11 +17,14 @@
 #ifndef ART_RUNTIME_CLASS_TABLE_H_
 #define ART_RUNTIME_CLASS_TABLE_H_
 
+#include <deque>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "base/allocator.h"
+#include "base/atomic.h"
 #include "base/hash_set.h"
 #include "base/macros.h"
 #include "base/mutex.h"
@@ -200,6 +203,7 @@ class ClassTable {
       REQUIRES_SHARED(Locks::mutator_lock_);
 
   // Return the first class that matches the descriptor. Returns null if there are none.
+  // The frozen class sets are searched without taking the lock, see FrozenSnapshot.
   ObjPtr<mirror::Class> Lookup(const char* descriptor, size_t hash)
       REQUIRES(!lock_)
       REQUIRES_SHARED(Locks::mutator_lock_);
@@ -269,6 +273,25 @@ class ClassTable {
   }
 
  private:
+  // Immutable list of the class sets that are no longer inserted into, i.e. all but the last one.
+  // A new snapshot is published whenever the list changes, and readers search the snapshot they
+  // loaded without holding `lock_`. The sets themselves are only mutated in place by Remove, which
+  // readers detect through `frozen_sets_sequence_`. Snapshots are kept alive until the table is
+  // destroyed since readers may still be using a replaced one; they are replaced rarely (zygote
+  // fork and app image loading).
+  struct FrozenSnapshot {
+    std::vector<const ClassSet*> sets;
+  };
+
+  // Search the frozen sets lock-free, then the remaining sets under the lock.
+  template <typename Key>
+  ObjPtr<mirror::Class> LookupWithHash(const Key& key, uint32_t hash)
+      REQUIRES(!lock_)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Publish a new snapshot of `classes_` after the set of frozen tables changed.
+  void PublishFrozenSnapshotLocked() REQUIRES(lock_);
+
   // Only copies classes.
   void CopyWithoutLocks(const ClassTable& source_table) NO_THREAD_SAFETY_ANALYSIS;
   void InsertWithoutLocks(ObjPtr<mirror::Class> klass) NO_THREAD_SAFETY_ANALYSIS;
@@ -285,8 +308,16 @@ class ClassTable {
 
   // Lock to guard inserting and removing.
   mutable ReaderWriterMutex lock_;
-  // We have a vector to help prevent dirty pages after the zygote forks by calling FreezeSnapshot.
-  std::vector<ClassSet> classes_ GUARDED_BY(lock_);
+  // We have several sets to help prevent dirty pages after the zygote forks by calling
+  // FreezeSnapshot. This is a deque so that adding sets at either end never moves the existing
+  // ones, which lock-free readers may be searching.
+  std::deque<ClassSet> classes_ GUARDED_BY(lock_);
+  // Current snapshot of the frozen sets, see FrozenSnapshot.
+  Atomic<const FrozenSnapshot*> frozen_snapshot_;
+  // Odd while a frozen set is being modified in place, incremented before and after.
+  Atomic<uint32_t> frozen_sets_sequence_;
+  // All snapshots ever published, including the current one.
+  std::vector<std::unique_ptr<FrozenSnapshot>> snapshots_ GUARDED_BY(lock_);
   // Extra strong roots that can be either dex files or dex caches. Dex files used by the class
   // loader which may not be owned by the class loader must be held strongly live. Also dex caches
   // are held live to prevent them being unloading once they have classes in them.
@@ -140,9 +140,11 @@ TEST_F(ClassTableTest, ClassTable) {
   });
   EXPECT_EQ(classes.size(), 1u);
 
-  // Test remove.
+  // Test remove, h_X is in the frozen zygote snapshot.
   table.Remove(descriptor_x);
   EXPECT_FALSE(table.Contains(h_X.Get()));
+  EXPECT_TRUE(table.Lookup(descriptor_x, ComputeModifiedUtf8Hash(descriptor_x)) == nullptr);
+  EXPECT_OBJ_PTR_EQ(table.Lookup(descriptor_y, ComputeModifiedUtf8Hash(descriptor_y)), h_Y.Get());
 
   // Test that WriteToMemory and ReadFromMemory work.
   table.Insert(h_X.Get());
@@ -155,6 +157,9 @@ TEST_F(ClassTableTest, ClassTable) {
   // Strong roots are not serialized, only classes.
   EXPECT_TRUE(table2.Contains(h_X.Get()));
   EXPECT_TRUE(table2.Contains(h_Y.Get()));
+  // The set read from memory is frozen, inserting goes to a separate set.
+  EXPECT_EQ(table2.NumZygoteClasses(class_loader.Get()), 2u);
+  EXPECT_OBJ_PTR_EQ(table2.Lookup(descriptor_x, ComputeModifiedUtf8Hash(descriptor_x)), h_X.Get());
 
   // TODO: Add tests for UpdateClass, InsertOatFile.
 }
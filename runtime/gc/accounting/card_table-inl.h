@@ -19,6 +19,15 @@
 
 #include "card_table.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include <android-base/logging.h>
 
 #include "base/atomic.h"
@@ -51,6 +60,59 @@ static inline bool byte_cas(uint8_t old_value, uint8_t new_value, uint8_t* addre
 #endif
 }
 
+// Returns the first card in [card_cur, card_end) with a value of at least `minimum_age`, or
+// `card_end` if there is none. Most cards of a large heap are clean, so whole vectors of cards
+// are skipped with an unsigned compare before looking at individual cards.
+static inline uint8_t* FindCardWithMinimumAge(uint8_t* card_cur,
+                                              uint8_t* const card_end,
+                                              const uint8_t minimum_age) {
+#if defined(__AVX2__)
+  const __m256i min_age_32 = _mm256_set1_epi8(static_cast<char>(minimum_age));
+  while (card_end - card_cur >= 32) {
+    __m256i cards = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(card_cur));
+    // max(card, minimum_age) == card if and only if card >= minimum_age.
+    __m256i aged = _mm256_cmpeq_epi8(_mm256_max_epu8(cards, min_age_32), cards);
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(aged));
+    if (mask != 0u) {
+      return card_cur + CTZ(mask);
+    }
+    card_cur += 32;
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i min_age_16 = _mm_set1_epi8(static_cast<char>(minimum_age));
+  while (card_end - card_cur >= 16) {
+    __m128i cards = _mm_loadu_si128(reinterpret_cast<const __m128i*>(card_cur));
+    __m128i aged = _mm_cmpeq_epi8(_mm_max_epu8(cards, min_age_16), cards);
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(aged));
+    if (mask != 0u) {
+      return card_cur + CTZ(mask);
+    }
+    card_cur += 16;
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint8x16_t min_age_16 = vdupq_n_u8(minimum_age);
+  while (card_end - card_cur >= 32) {
+    uint8x16_t cards_lo = vld1q_u8(card_cur);
+    uint8x16_t cards_hi = vld1q_u8(card_cur + 16);
+    if (vmaxvq_u8(vmaxq_u8(cards_lo, cards_hi)) >= minimum_age) {
+      break;  // Find the exact card below.
+    }
+    card_cur += 32;
+  }
+  while (card_end - card_cur >= 16) {
+    if (vmaxvq_u8(vcgeq_u8(vld1q_u8(card_cur), min_age_16)) != 0u) {
+      break;
+    }
+    card_cur += 16;
+  }
+#endif
+  while (card_cur < card_end && *card_cur < minimum_age) {
+    ++card_cur;
+  }
+  return card_cur;
+}
+
 template <bool kClearCard, typename Visitor>
 inline size_t CardTable::Scan(ContinuousSpaceBitmap* bitmap,
                               uint8_t* const scan_begin,
@@ -67,57 +129,20 @@ inline size_t CardTable::Scan(ContinuousSpaceBitmap* bitmap,
   CheckCardValid(card_end);
   size_t cards_scanned = 0;
 
-  // Handle any unaligned cards at the start.
-  while (!IsAligned<sizeof(intptr_t)>(card_cur) && card_cur < card_end) {
-    if (*card_cur >= minimum_age) {
-      uintptr_t start = reinterpret_cast<uintptr_t>(AddrFromCard(card_cur));
-      bitmap->VisitMarkedRange(start, start + kCardSize, visitor);
-      ++cards_scanned;
-    }
-    ++card_cur;
-  }
-
-  uint8_t* aligned_end = card_end -
-      (reinterpret_cast<uintptr_t>(card_end) & (sizeof(uintptr_t) - 1));
-
-  uintptr_t* word_end = reinterpret_cast<uintptr_t*>(aligned_end);
-  for (uintptr_t* word_cur = reinterpret_cast<uintptr_t*>(card_cur); word_cur < word_end;
-      ++word_cur) {
-    while (LIKELY(*word_cur == 0)) {
-      ++word_cur;
-      if (UNLIKELY(word_cur >= word_end)) {
-        goto exit_for;
-      }
+  while (true) {
+    card_cur = FindCardWithMinimumAge(card_cur, card_end, minimum_age);
+    if (card_cur == card_end) {
+      break;
     }
-
-    // Find the first dirty card.
-    uintptr_t start_word = *word_cur;
-    uintptr_t start = reinterpret_cast<uintptr_t>(AddrFromCard(reinterpret_cast<uint8_t*>(word_cur)));
-    // TODO: Investigate if processing continuous runs of dirty cards with a single bitmap visit is
-    // more efficient.
-    for (size_t i = 0; i < sizeof(uintptr_t); ++i) {
-      if (static_cast<uint8_t>(start_word) >= minimum_age) {
-        auto* card = reinterpret_cast<uint8_t*>(word_cur) + i;
-        DCHECK(*card == static_cast<uint8_t>(start_word) || *card == kCardDirty)
-            << "card " << static_cast<size_t>(*card) << " intptr_t " << (start_word & 0xFF);
-        bitmap->VisitMarkedRange(start, start + kCardSize, visitor);
-        ++cards_scanned;
-      }
-      start_word >>= 8;
-      start += kCardSize;
-    }
-  }
-  exit_for:
-
-  // Handle any unaligned cards at the end.
-  card_cur = reinterpret_cast<uint8_t*>(word_end);
-  while (card_cur < card_end) {
-    if (*card_cur >= minimum_age) {
-      uintptr_t start = reinterpret_cast<uintptr_t>(AddrFromCard(card_cur));
-      bitmap->VisitMarkedRange(start, start + kCardSize, visitor);
-      ++cards_scanned;
+    // Visit a run of cards to scan with a single bitmap walk.
+    uint8_t* run_end = card_cur + 1;
+    while (run_end < card_end && *run_end >= minimum_age) {
+      ++run_end;
     }
-    ++card_cur;
+    uintptr_t start = reinterpret_cast<uintptr_t>(AddrFromCard(card_cur));
+    bitmap->VisitMarkedRange(start, start + (run_end - card_cur) * kCardSize, visitor);
+    cards_scanned += run_end - card_cur;
+    card_cur = run_end;
   }
 
   if (kClearCard) {
@@ -179,6 +204,17 @@ inline void CardTable::ModifyCardsAtomic(uint8_t* scan_begin,
 
   // TODO: Parallelize.
   while (word_cur < word_end) {
+    if (*word_cur == 0) {
+      // Skip the clean cards a vector at a time, then resume at the word of the next
+      // non-clean card.
+      uint8_t* card = FindCardWithMinimumAge(reinterpret_cast<uint8_t*>(word_cur),
+                                             reinterpret_cast<uint8_t*>(word_end),
+                                             static_cast<uint8_t>(kCardClean + 1));
+      word_cur = reinterpret_cast<uintptr_t*>(AlignDown(card, sizeof(uintptr_t)));
+      if (word_cur == word_end) {
+        break;
+      }
+    }
     while (true) {
       expected_word = *word_cur;
       static_assert(kCardClean == 0);
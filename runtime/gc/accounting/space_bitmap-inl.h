@@ -19,6 +19,16 @@
 
 #include "space_bitmap.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
 #include <memory>
 
 #include <android-base/logging.h>
@@ -119,19 +129,7 @@ inline void SpaceBitmap<kAlignment>::VisitMarkedRange(uintptr_t visit_begin,
     }
 
     // Traverse the middle, full part.
-    for (size_t i = index_start + 1; i < index_end; ++i) {
-      uintptr_t w = bitmap_begin_[i].load(std::memory_order_relaxed);
-      if (w != 0) {
-        const uintptr_t ptr_base = IndexToOffset(i) + heap_begin_;
-        // Iterate on the bits set in word `w`, from the least to the most significant bit.
-        do {
-          const size_t shift = CTZ(w);
-          mirror::Object* obj = reinterpret_cast<mirror::Object*>(ptr_base + shift * kAlignment);
-          visitor(obj);
-          w ^= (static_cast<uintptr_t>(1)) << shift;
-        } while (w != 0);
-      }
-    }
+    VisitMarkedWords(index_start + 1, index_end, visitor);
 
     // Right edge is unique.
     // But maybe we don't have anything to do: visit_end starts in a new word...
@@ -167,19 +165,89 @@ void SpaceBitmap<kAlignment>::Walk(Visitor&& visitor) {
   CHECK(bitmap_begin_ != nullptr);
 
   uintptr_t end = OffsetToIndex(HeapLimit() - heap_begin_ - 1);
-  Atomic<uintptr_t>* bitmap_begin = bitmap_begin_;
-  for (uintptr_t i = 0; i <= end; ++i) {
-    uintptr_t w = bitmap_begin[i].load(std::memory_order_relaxed);
-    if (w != 0) {
-      uintptr_t ptr_base = IndexToOffset(i) + heap_begin_;
-      do {
-        const size_t shift = CTZ(w);
-        mirror::Object* obj = reinterpret_cast<mirror::Object*>(ptr_base + shift * kAlignment);
-        visitor(obj);
-        w ^= (static_cast<uintptr_t>(1)) << shift;
-      } while (w != 0);
+  VisitMarkedWords(0u, end + 1u, visitor);
+}
+
+// Returns the index of the first non-zero word in [index, index_end), or `index_end`.
+static inline size_t FindNonZeroBitmapWord(const Atomic<uintptr_t>* bitmap,
+                                           size_t index,
+                                           size_t index_end) {
+  // Racy reads of words being marked concurrently are fine, like the relaxed loads of the
+  // scalar walk: a word that is seen as zero here is visited with the bits it had then.
+#if defined(__AVX2__)
+  static constexpr size_t kWordsPer256 = 32u / sizeof(uintptr_t);
+  for (; index_end - index >= kWordsPer256; index += kWordsPer256) {
+    __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bitmap + index));
+    if (!_mm256_testz_si256(words, words)) {
+      break;
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  static constexpr size_t kWordsPer128 = 16u / sizeof(uintptr_t);
+  const __m128i zero = _mm_setzero_si128();
+  for (; index_end - index >= kWordsPer128; index += kWordsPer128) {
+    __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bitmap + index));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(words, zero)) != 0xffff) {
+      break;
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  static constexpr size_t kWordsPer128 = 16u / sizeof(uintptr_t);
+  for (; index_end - index >= 2u * kWordsPer128; index += 2u * kWordsPer128) {
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(bitmap + index);
+    if (vmaxvq_u32(vorrq_u32(vld1q_u32(words), vld1q_u32(words + 4))) != 0u) {
+      break;
+    }
+  }
+#endif
+  while (index != index_end && bitmap[index].load(std::memory_order_relaxed) == 0u) {
+    ++index;
+  }
+  return index;
+}
+
+template<size_t kAlignment>
+template<typename Visitor>
+inline void SpaceBitmap<kAlignment>::VisitMarkedWords(size_t index_begin,
+                                                      size_t index_end,
+                                                      Visitor&& visitor) const {
+  // How many objects ahead of the visitor to prefetch. The visitor usually reads at least the
+  // class of each object, which misses the cache when walking a large heap.
+  static constexpr size_t kPrefetchDistance = 8u;
+  // Room for the objects of two words, the batch is visited once it holds more than one word.
+  mirror::Object* batch[2u * kBitsPerIntPtrT];
+  size_t batch_size = 0u;
+  auto visit_batch = [&]() NO_THREAD_SAFETY_ANALYSIS {
+    for (size_t j = 0, e = std::min(batch_size, kPrefetchDistance); j != e; ++j) {
+      __builtin_prefetch(batch[j]);
+    }
+    for (size_t j = 0; j != batch_size; ++j) {
+      if (j + kPrefetchDistance < batch_size) {
+        __builtin_prefetch(batch[j + kPrefetchDistance]);
+      }
+      visitor(batch[j]);
+    }
+    batch_size = 0u;
+  };
+  for (size_t i = index_begin; ; ++i) {
+    i = FindNonZeroBitmapWord(bitmap_begin_, i, index_end);
+    if (i == index_end) {
+      break;
+    }
+    uintptr_t w = bitmap_begin_[i].load(std::memory_order_relaxed);
+    const uintptr_t ptr_base = IndexToOffset(i) + heap_begin_;
+    // Collect the bits set in word `w`, from the least to the most significant bit.
+    while (w != 0) {
+      const size_t shift = CTZ(w);
+      batch[batch_size++] = reinterpret_cast<mirror::Object*>(ptr_base + shift * kAlignment);
+      w ^= (static_cast<uintptr_t>(1)) << shift;
+    }
+    if (batch_size > static_cast<size_t>(kBitsPerIntPtrT)) {
+      visit_batch();
     }
   }
+  visit_batch();
 }
 
 template<size_t kAlignment>
@@ -131,7 +131,8 @@ class SpaceBitmap {
     }
   }
 
-  // Visit the live objects in the range [visit_begin, visit_end).
+  // Visit the live objects in the range [visit_begin, visit_end). Bitmap words are read a batch
+  // ahead of the visitor, so bits set by the visitor may or may not be visited.
   // TODO: Use lock annotations when clang is fixed.
   // REQUIRES(Locks::heap_bitmap_lock_) REQUIRES_SHARED(Locks::mutator_lock_);
   template <typename Visitor>
@@ -241,6 +242,12 @@ class SpaceBitmap {
   template<bool kSetBit>
   bool Modify(const mirror::Object* obj);
 
+  // Visit the objects of the bitmap words [index_begin, index_end). Runs of zero words are
+  // skipped a vector at a time, and the objects are prefetched ahead of the visitor.
+  template <typename Visitor>
+  void VisitMarkedWords(size_t index_begin, size_t index_end, Visitor&& visitor) const
+      NO_THREAD_SAFETY_ANALYSIS;
+
   // Backing storage for bitmap.
   MemMap mem_map_;
 
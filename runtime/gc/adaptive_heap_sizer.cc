@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "adaptive_heap_sizer.h"
+
+#include <algorithm>
+
+namespace art {
+namespace gc {
+
+// Weight of the latest measurement in the moving averages. Large enough that the heap shrinks back
+// within a few GCs after an allocation burst.
+static constexpr double kSmoothingWeight = 0.5;
+
+static double Smooth(double average, double value) {
+  return average == 0.0 ? value : kSmoothingWeight * value + (1.0 - kSmoothingWeight) * average;
+}
+
+// The GC performance info, including the GC CPU times, may be reset in between.
+static uint64_t Increase(uint64_t now, uint64_t before) {
+  return now >= before ? now - before : now;
+}
+
+AdaptiveHeapSizer::AdaptiveHeapSizer(double gc_cpu_percent_target,
+                                     uint64_t min_free,
+                                     uint64_t process_cpu_time_ns)
+    : target_(gc_cpu_percent_target / 100.0),
+      min_free_(min_free),
+      last_total_gc_cpu_time_ns_(0u),
+      window_bytes_allocated_ever_(0u),
+      window_process_cpu_time_ns_(process_cpu_time_ns),
+      window_total_gc_cpu_time_ns_(0u),
+      smoothed_allocation_rate_(0.0),
+      smoothed_gc_cpu_time_ns_(0.0),
+      smoothed_sticky_gc_cpu_time_ns_(0.0),
+      grow_bytes_(min_free) {}
+
+uint64_t AdaptiveHeapSizer::OnGcEnd(bool sticky,
+                                    uint64_t bytes_allocated_ever,
+                                    uint64_t total_gc_cpu_time_ns,
+                                    uint64_t process_cpu_time_ns,
+                                    uint64_t max_free) {
+  // GCs do not overlap, so the GC CPU time since the end of the previous one is that of this GC.
+  const uint64_t gc_cpu_time_ns = Increase(total_gc_cpu_time_ns, last_total_gc_cpu_time_ns_);
+  last_total_gc_cpu_time_ns_ = total_gc_cpu_time_ns;
+  if (sticky) {
+    smoothed_sticky_gc_cpu_time_ns_ = Smooth(smoothed_sticky_gc_cpu_time_ns_, gc_cpu_time_ns);
+    return std::min(grow_bytes_, max_free);
+  }
+
+  const uint64_t process_time_ns = Increase(process_cpu_time_ns, window_process_cpu_time_ns_);
+  const uint64_t window_gc_time_ns = Increase(total_gc_cpu_time_ns, window_total_gc_cpu_time_ns_);
+  if (process_time_ns > window_gc_time_ns && bytes_allocated_ever >= window_bytes_allocated_ever_) {
+    const double allocation_rate =
+        static_cast<double>(bytes_allocated_ever - window_bytes_allocated_ever_) /
+        static_cast<double>(process_time_ns - window_gc_time_ns);
+    smoothed_allocation_rate_ = Smooth(smoothed_allocation_rate_, allocation_rate);
+  }
+  smoothed_gc_cpu_time_ns_ = Smooth(smoothed_gc_cpu_time_ns_, gc_cpu_time_ns);
+  window_bytes_allocated_ever_ = bytes_allocated_ever;
+  window_process_cpu_time_ns_ = process_cpu_time_ns;
+  window_total_gc_cpu_time_ns_ = total_gc_cpu_time_ns;
+
+  const double mutator_time_ns = smoothed_gc_cpu_time_ns_ * (1.0 - target_) / target_;
+  const double grow_bytes = smoothed_allocation_rate_ * mutator_time_ns;
+  // Clamp as doubles, the product may not fit in 64 bits.
+  grow_bytes_ = static_cast<uint64_t>(
+      std::min(std::max(grow_bytes, static_cast<double>(min_free_)),
+               static_cast<double>(std::max(max_free, min_free_))));
+  return grow_bytes_;
+}
+
+}  // namespace gc
+}  // namespace art
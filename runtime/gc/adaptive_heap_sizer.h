@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_ADAPTIVE_HEAP_SIZER_H_
+#define ART_RUNTIME_GC_ADAPTIVE_HEAP_SIZER_H_
+
+#include <stdint.h>
+
+#include "base/macros.h"
+
+namespace art {
+namespace gc {
+
+// Heap sizing for -XX:GcCpuPercentTarget. After each non-sticky GC, chooses the free bytes to leave
+// so that non-sticky GCs take the target share of the CPU time at the measured allocation rate:
+//   gc_cpu_time / (gc_cpu_time + free_bytes / allocation_rate) = target
+// The allocation rate is in bytes per nanosecond of mutator CPU time, which is the process CPU
+// time minus the CPU time of all the GCs since the previous non-sticky GC.
+//
+// Sticky GCs only reclaim the objects allocated since the previous GC, and their cost does not
+// depend on the heap size. Their CPU time is tracked separately and left out of the mutator time,
+// and they keep the free bytes chosen by the last non-sticky GC.
+//
+// Not thread safe, the heap calls it with the process state update lock held.
+class AdaptiveHeapSizer {
+ public:
+  AdaptiveHeapSizer(double gc_cpu_percent_target, uint64_t min_free, uint64_t process_cpu_time_ns);
+
+  // Record the end of a GC. `total_gc_cpu_time_ns` is the CPU time of all the GCs so far, so its
+  // increase since the previous call is the CPU time of the GC that just ended. Returns the free
+  // bytes to leave after the GC, at least min free and at most `max_free`.
+  uint64_t OnGcEnd(bool sticky,
+                   uint64_t bytes_allocated_ever,
+                   uint64_t total_gc_cpu_time_ns,
+                   uint64_t process_cpu_time_ns,
+                   uint64_t max_free);
+
+  // Moving average of the allocation rate in bytes per second of mutator CPU time.
+  double GetAllocationRate() const {
+    return smoothed_allocation_rate_ * 1e9;
+  }
+
+  // Moving averages of the CPU time of the non-sticky and sticky GCs.
+  uint64_t GetGcCpuTimeNs() const {
+    return static_cast<uint64_t>(smoothed_gc_cpu_time_ns_);
+  }
+  uint64_t GetStickyGcCpuTimeNs() const {
+    return static_cast<uint64_t>(smoothed_sticky_gc_cpu_time_ns_);
+  }
+
+  // Free bytes chosen at the last non-sticky GC.
+  uint64_t GetGrowBytes() const {
+    return grow_bytes_;
+  }
+
+ private:
+  const double target_;
+  const uint64_t min_free_;
+  // GC CPU time of all the GCs at the end of the previous GC.
+  uint64_t last_total_gc_cpu_time_ns_;
+  // Bytes allocated ever, process CPU time and GC CPU time of all the GCs at the end of the
+  // previous non-sticky GC, where the allocation rate measurement starts.
+  uint64_t window_bytes_allocated_ever_;
+  uint64_t window_process_cpu_time_ns_;
+  uint64_t window_total_gc_cpu_time_ns_;
+  // Moving averages, zero until measured.
+  double smoothed_allocation_rate_;
+  double smoothed_gc_cpu_time_ns_;
+  double smoothed_sticky_gc_cpu_time_ns_;
+  uint64_t grow_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(AdaptiveHeapSizer);
+};
+
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_ADAPTIVE_HEAP_SIZER_H_
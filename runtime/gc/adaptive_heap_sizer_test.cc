@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "adaptive_heap_sizer.h"
+
+#include "gtest/gtest.h"
+
+namespace art {
+namespace gc {
+
+static constexpr uint64_t kMs = 1000 * 1000;
+static constexpr uint64_t kMinFree = 512 * 1024;
+static constexpr uint64_t kMaxFree = UINT64_C(1) << 40;
+
+class AdaptiveHeapSizerTest : public testing::Test {
+ protected:
+  // The sizer, in a simulated process where the mutators allocate `rate` bytes per nanosecond of
+  // their CPU time.
+  AdaptiveHeapSizerTest() : sizer_(10.0, kMinFree, 0u) {}
+
+  void RunMutator(uint64_t cpu_time_ns, double rate) {
+    bytes_allocated_ever_ += static_cast<uint64_t>(cpu_time_ns * rate);
+    process_cpu_time_ns_ += cpu_time_ns;
+  }
+
+  uint64_t RunGc(bool sticky, uint64_t cpu_time_ns) {
+    total_gc_cpu_time_ns_ += cpu_time_ns;
+    process_cpu_time_ns_ += cpu_time_ns;
+    return sizer_.OnGcEnd(
+        sticky, bytes_allocated_ever_, total_gc_cpu_time_ns_, process_cpu_time_ns_, kMaxFree);
+  }
+
+  AdaptiveHeapSizer sizer_;
+  uint64_t bytes_allocated_ever_ = 0u;
+  uint64_t total_gc_cpu_time_ns_ = 0u;
+  uint64_t process_cpu_time_ns_ = 0u;
+};
+
+TEST_F(AdaptiveHeapSizerTest, SizesForTargetCpuShare) {
+  // Allocating 1 byte per ns of mutator CPU time with GCs taking 100ms of CPU time, the GC takes
+  // 10% of the CPU time if the mutators run for 900ms between GCs, allocating 900M bytes.
+  RunMutator(900 * kMs, 1.0);
+  EXPECT_NEAR(900.0 * kMs, static_cast<double>(RunGc(/*sticky=*/ false, 100 * kMs)), 1e3);
+  EXPECT_NEAR(1e9, sizer_.GetAllocationRate(), 1.0);
+  EXPECT_EQ(100 * kMs, sizer_.GetGcCpuTimeNs());
+  EXPECT_NEAR(900.0 * kMs, static_cast<double>(sizer_.GetGrowBytes()), 1e3);
+}
+
+TEST_F(AdaptiveHeapSizerTest, StickyGcsKeepTheSize) {
+  RunMutator(900 * kMs, 1.0);
+  const uint64_t grow_bytes = RunGc(/*sticky=*/ false, 100 * kMs);
+
+  // A sticky GC keeps the size chosen by the last non-sticky GC, and its CPU time is tracked on
+  // its own.
+  RunMutator(500 * kMs, 1.0);
+  EXPECT_EQ(grow_bytes, RunGc(/*sticky=*/ true, 50 * kMs));
+  EXPECT_EQ(50 * kMs, sizer_.GetStickyGcCpuTimeNs());
+  EXPECT_EQ(100 * kMs, sizer_.GetGcCpuTimeNs());
+
+  // The CPU time of the sticky GC is not counted as mutator time, so the allocation rate measured
+  // at the next non-sticky GC is unchanged.
+  RunMutator(500 * kMs, 1.0);
+  EXPECT_NEAR(static_cast<double>(grow_bytes),
+              static_cast<double>(RunGc(/*sticky=*/ false, 100 * kMs)),
+              1e3);
+  EXPECT_NEAR(1e9, sizer_.GetAllocationRate(), 1.0);
+}
+
+TEST_F(AdaptiveHeapSizerTest, FollowsAllocationRate) {
+  RunMutator(900 * kMs, 1.0);
+  const uint64_t steady_grow_bytes = RunGc(/*sticky=*/ false, 100 * kMs);
+
+  // An allocation burst grows the heap.
+  RunMutator(900 * kMs, 4.0);
+  const uint64_t burst_grow_bytes = RunGc(/*sticky=*/ false, 100 * kMs);
+  EXPECT_GT(burst_grow_bytes, steady_grow_bytes);
+
+  // The heap shrinks back within a few GCs once the burst is over.
+  uint64_t grow_bytes = burst_grow_bytes;
+  for (size_t i = 0; i != 8u; ++i) {
+    RunMutator(900 * kMs, 1.0);
+    const uint64_t new_grow_bytes = RunGc(/*sticky=*/ false, 100 * kMs);
+    EXPECT_LT(new_grow_bytes, grow_bytes);
+    grow_bytes = new_grow_bytes;
+  }
+  EXPECT_LT(grow_bytes, steady_grow_bytes + steady_grow_bytes / 50u);
+
+  // A costlier GC, for example with more live objects to mark, also grows the heap.
+  RunMutator(900 * kMs, 1.0);
+  EXPECT_GT(RunGc(/*sticky=*/ false, 400 * kMs), grow_bytes);
+}
+
+TEST_F(AdaptiveHeapSizerTest, ClampsToMinAndMaxFree) {
+  // Without allocation, at least min free is left.
+  EXPECT_EQ(kMinFree, RunGc(/*sticky=*/ false, 100 * kMs));
+  EXPECT_EQ(kMinFree, RunGc(/*sticky=*/ true, 10 * kMs));
+
+  RunMutator(900 * kMs, 1.0);
+  EXPECT_EQ(64 * kMs,
+            sizer_.OnGcEnd(/*sticky=*/ false,
+                           bytes_allocated_ever_,
+                           total_gc_cpu_time_ns_ + 100 * kMs,
+                           process_cpu_time_ns_ + 100 * kMs,
+                           /*max_free=*/ 64 * kMs));
+}
+
+}  // namespace gc
+}  // namespace art
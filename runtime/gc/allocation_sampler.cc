@@ -0,0 +1,464 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "allocation_sampler.h"
+
+#include <string.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <ostream>
+
+#include "android-base/stringprintf.h"
+
+#include "art_method-inl.h"
+#include "base/enums.h"
+#include "base/os.h"
+#include "base/time_utils.h"
+#include "base/unix_file/fd_file.h"
+#include "base/utils.h"
+#include "gc_root-inl.h"
+#include "handle_scope-inl.h"
+#include "mirror/class.h"
+#include "mirror/object-inl.h"
+#include "obj_ptr-inl.h"
+#include "object_callbacks.h"
+#include "stack.h"
+#include "thread-current-inl.h"
+
+namespace art {
+namespace gc {
+
+using android::base::StringPrintf;
+
+namespace {
+
+// Field numbers of the pprof profile.proto messages.
+enum ProfileField : uint32_t {
+  kProfileSampleType = 1,
+  kProfileSample = 2,
+  kProfileLocation = 4,
+  kProfileFunction = 5,
+  kProfileStringTable = 6,
+  kProfileDurationNanos = 10,
+  kProfilePeriodType = 11,
+  kProfilePeriod = 12,
+};
+
+enum ValueTypeField : uint32_t {
+  kValueTypeType = 1,
+  kValueTypeUnit = 2,
+};
+
+enum SampleField : uint32_t {
+  kSampleLocationId = 1,
+  kSampleValue = 2,
+  kSampleLabel = 3,
+};
+
+enum LabelField : uint32_t {
+  kLabelKey = 1,
+  kLabelStr = 2,
+};
+
+enum LocationField : uint32_t {
+  kLocationId = 1,
+  kLocationLine = 4,
+};
+
+enum LineField : uint32_t {
+  kLineFunctionId = 1,
+  kLineLine = 2,
+};
+
+enum FunctionField : uint32_t {
+  kFunctionId = 1,
+  kFunctionName = 2,
+  kFunctionSystemName = 3,
+  kFunctionFilename = 4,
+};
+
+// Minimal protobuf encoder, for the few wire types the profile uses.
+class ProtoWriter {
+ public:
+  void AddVarint(uint32_t field, uint64_t value) {
+    AddKey(field, kWireTypeVarint);
+    AddRawVarint(value);
+  }
+
+  void AddBytes(uint32_t field, const std::string& bytes) {
+    AddKey(field, kWireTypeLengthDelimited);
+    AddRawVarint(bytes.size());
+    data_ += bytes;
+  }
+
+  void AddMessage(uint32_t field, const ProtoWriter& message) {
+    AddBytes(field, message.data_);
+  }
+
+  void AddPacked(uint32_t field, const std::vector<uint64_t>& values) {
+    ProtoWriter packed;
+    for (uint64_t value : values) {
+      packed.AddRawVarint(value);
+    }
+    AddBytes(field, packed.data_);
+  }
+
+  const std::string& GetData() const {
+    return data_;
+  }
+
+ private:
+  static constexpr uint32_t kWireTypeVarint = 0;
+  static constexpr uint32_t kWireTypeLengthDelimited = 2;
+
+  void AddKey(uint32_t field, uint32_t wire_type) {
+    AddRawVarint((field << 3) | wire_type);
+  }
+
+  void AddRawVarint(uint64_t value) {
+    while (value >= 0x80) {
+      data_ += static_cast<char>((value & 0x7f) | 0x80);
+      value >>= 7;
+    }
+    data_ += static_cast<char>(value);
+  }
+
+  std::string data_;
+};
+
+ProtoWriter ValueType(uint32_t type, uint32_t unit) {
+  ProtoWriter value_type;
+  value_type.AddVarint(kValueTypeType, type);
+  value_type.AddVarint(kValueTypeUnit, unit);
+  return value_type;
+}
+
+bool Gzip(const std::string& in, std::string* out, std::string* error_msg) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // 16 added to the window bits selects the gzip wrapper.
+  if (deflateInit2(&stream,
+                   Z_DEFAULT_COMPRESSION,
+                   Z_DEFLATED,
+                   /* windowBits= */ 15 + 16,
+                   /* memLevel= */ 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    *error_msg = "Could not initialize zlib";
+    return false;
+  }
+  out->resize(deflateBound(&stream, in.size()));
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  stream.avail_in = in.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&(*out)[0]);
+  stream.avail_out = out->size();
+  int result = deflate(&stream, Z_FINISH);
+  out->resize(stream.total_out);
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END) {
+    *error_msg = StringPrintf("Could not compress the profile: %d", result);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+AllocationSampler::AllocationSampler(size_t mean_interval)
+    : SystemWeakHolder(kGenericBottomLock),
+      mean_interval_(mean_interval),
+      bytes_until_sample_(0),
+      random_(NanoTime()),
+      interval_distribution_(1.0 / static_cast<double>(mean_interval)),
+      num_samples_(0u),
+      start_time_ns_(NanoTime()) {
+  DCHECK_NE(mean_interval, 0u);
+  strings_.push_back("");
+  string_ids_.emplace("", 0u);
+  bytes_until_sample_.store(NextInterval(), std::memory_order_relaxed);
+}
+
+int64_t AllocationSampler::NextInterval() {
+  return std::max<int64_t>(1, std::llround(interval_distribution_(random_)));
+}
+
+uint32_t AllocationSampler::InternString(const std::string& str) {
+  auto it = string_ids_.find(str);
+  if (it != string_ids_.end()) {
+    return it->second;
+  }
+  uint32_t id = strings_.size();
+  strings_.push_back(str);
+  string_ids_.emplace(str, id);
+  return id;
+}
+
+uint32_t AllocationSampler::InternLocation(ArtMethod* method, uint32_t dex_pc) {
+  auto it = location_ids_.find(std::make_pair(method, dex_pc));
+  if (it != location_ids_.end()) {
+    return it->second;
+  }
+  uint32_t function_id;
+  auto function_it = function_ids_.find(method);
+  if (function_it != function_ids_.end()) {
+    function_id = function_it->second;
+  } else {
+    const char* source_file = method->GetDeclaringClassSourceFile();
+    functions_.push_back({InternString(method->PrettyMethod()),
+                          InternString(source_file != nullptr ? source_file : "")});
+    function_id = functions_.size();
+    function_ids_.emplace(method, function_id);
+  }
+  locations_.push_back({function_id, std::max(method->GetLineNumFromDexPC(dex_pc), 0)});
+  uint32_t location_id = locations_.size();
+  location_ids_.emplace(std::make_pair(method, dex_pc), location_id);
+  return location_id;
+}
+
+void AllocationSampler::SampleAllocation(Thread* self,
+                                         ObjPtr<mirror::Object>* obj,
+                                         size_t object_size,
+                                         size_t overshoot) {
+  // Walk the stack outside of the lock, like AllocRecordObjectMap::RecordAllocation.
+  std::vector<std::pair<ArtMethod*, uint32_t>> frames;
+  frames.reserve(kMaxStackDepth);
+  {
+    StackHandleScope<1> hs(self);
+    auto obj_wrapper = hs.NewHandleWrapper(obj);
+    StackVisitor::WalkStack(
+        [&](const art::StackVisitor* stack_visitor) REQUIRES_SHARED(Locks::mutator_lock_) {
+          if (frames.size() >= kMaxStackDepth) {
+            return false;
+          }
+          ArtMethod* m = stack_visitor->GetMethod();
+          if (m != nullptr && !m->IsRuntimeMethod()) {
+            m = m->GetInterfaceMethodIfProxy(kRuntimePointerSize);
+            frames.emplace_back(m, stack_visitor->GetDexPc());
+          }
+          return true;
+        },
+        self,
+        /* context= */ nullptr,
+        art::StackVisitor::StackWalkKind::kIncludeInlinedFrames);
+  }
+  std::string class_name = (*obj)->GetClass()->PrettyDescriptor();
+
+  MutexLock mu(self, allow_disallow_lock_);
+  Wait(self);
+
+  // Only this thread can bring the countdown back above zero. Each interval drawn until then is
+  // a sample of this allocation, which includes the bytes other threads reported meanwhile.
+  uint64_t num_samples = 0u;
+  int64_t bytes_until_sample = -static_cast<int64_t>(overshoot);
+  do {
+    int64_t interval = NextInterval();
+    bytes_until_sample =
+        bytes_until_sample_.fetch_add(interval, std::memory_order_relaxed) + interval;
+    ++num_samples;
+  } while (bytes_until_sample <= 0);
+  num_samples_ += num_samples;
+
+  std::vector<uint32_t> stack;
+  stack.reserve(frames.size());
+  for (const std::pair<ArtMethod*, uint32_t>& frame : frames) {
+    stack.push_back(InternLocation(frame.first, frame.second));
+  }
+  uint32_t stack_id;
+  auto stack_it = stack_ids_.find(stack);
+  if (stack_it != stack_ids_.end()) {
+    stack_id = stack_it->second;
+  } else {
+    stack_id = stacks_.size();
+    stacks_.push_back(stack);
+    stack_ids_.emplace(std::move(stack), stack_id);
+  }
+  const uint32_t class_name_id = InternString(class_name);
+  uint32_t site_id;
+  auto site_it = site_ids_.find(std::make_pair(stack_id, class_name_id));
+  if (site_it != site_ids_.end()) {
+    site_id = site_it->second;
+  } else {
+    site_id = sites_.size();
+    sites_.push_back({stack_id, class_name_id, 0u, 0u});
+    site_ids_.emplace(std::make_pair(stack_id, class_name_id), site_id);
+  }
+
+  const uint64_t bytes = num_samples * mean_interval_;
+  const uint64_t objects = std::max<uint64_t>(bytes / std::max<size_t>(object_size, 1u), 1u);
+  sites_[site_id].alloc_objects += objects;
+  sites_[site_id].alloc_bytes += bytes;
+  live_samples_.push_back({GcRoot<mirror::Object>(*obj), site_id, objects, bytes});
+}
+
+void AllocationSampler::Sweep(IsMarkedVisitor* visitor) {
+  MutexLock mu(Thread::Current(), allow_disallow_lock_);
+  size_t num_live = 0u;
+  for (LiveSample& sample : live_samples_) {
+    // This does not need a read barrier because this is called by GC.
+    mirror::Object* old_object = sample.object.Read<kWithoutReadBarrier>();
+    mirror::Object* new_object = visitor->IsMarked(old_object);
+    if (new_object != nullptr) {
+      live_samples_[num_live] = sample;
+      live_samples_[num_live].object = GcRoot<mirror::Object>(new_object);
+      ++num_live;
+    }
+  }
+  live_samples_.resize(num_live);
+}
+
+void AllocationSampler::VisitRoots(RootVisitor* visitor) {
+  MutexLock mu(Thread::Current(), allow_disallow_lock_);
+  BufferedRootVisitor<kDefaultBufferedRootCount> buffered_visitor(visitor,
+                                                                  RootInfo(kRootVMInternal));
+  for (const auto& entry : function_ids_) {
+    entry.first->VisitRoots(buffered_visitor, kRuntimePointerSize);
+  }
+}
+
+std::string AllocationSampler::EncodeProfile() {
+  std::vector<uint64_t> inuse_objects(sites_.size(), 0u);
+  std::vector<uint64_t> inuse_bytes(sites_.size(), 0u);
+  for (const LiveSample& sample : live_samples_) {
+    inuse_objects[sample.site_id] += sample.objects;
+    inuse_bytes[sample.site_id] += sample.bytes;
+  }
+
+  // Intern the names used by the profile itself before writing the string table.
+  const uint32_t alloc_objects = InternString("alloc_objects");
+  const uint32_t alloc_space = InternString("alloc_space");
+  const uint32_t inuse_objects_name = InternString("inuse_objects");
+  const uint32_t inuse_space = InternString("inuse_space");
+  const uint32_t count = InternString("count");
+  const uint32_t bytes = InternString("bytes");
+  const uint32_t space = InternString("space");
+  const uint32_t object_class = InternString("object class");
+
+  ProtoWriter profile;
+  profile.AddMessage(kProfileSampleType, ValueType(alloc_objects, count));
+  profile.AddMessage(kProfileSampleType, ValueType(alloc_space, bytes));
+  profile.AddMessage(kProfileSampleType, ValueType(inuse_objects_name, count));
+  profile.AddMessage(kProfileSampleType, ValueType(inuse_space, bytes));
+  for (size_t i = 0; i != sites_.size(); ++i) {
+    const Site& site = sites_[i];
+    ProtoWriter sample;
+    const std::vector<uint32_t>& stack = stacks_[site.stack_id];
+    sample.AddPacked(kSampleLocationId, std::vector<uint64_t>(stack.begin(), stack.end()));
+    sample.AddPacked(kSampleValue,
+                     {site.alloc_objects, site.alloc_bytes, inuse_objects[i], inuse_bytes[i]});
+    ProtoWriter label;
+    label.AddVarint(kLabelKey, object_class);
+    label.AddVarint(kLabelStr, site.class_name);
+    sample.AddMessage(kSampleLabel, label);
+    profile.AddMessage(kProfileSample, sample);
+  }
+  for (size_t i = 0; i != locations_.size(); ++i) {
+    ProtoWriter line;
+    line.AddVarint(kLineFunctionId, locations_[i].function_id);
+    line.AddVarint(kLineLine, static_cast<uint64_t>(locations_[i].line));
+    ProtoWriter location;
+    location.AddVarint(kLocationId, i + 1u);
+    location.AddMessage(kLocationLine, line);
+    profile.AddMessage(kProfileLocation, location);
+  }
+  for (size_t i = 0; i != functions_.size(); ++i) {
+    ProtoWriter function;
+    function.AddVarint(kFunctionId, i + 1u);
+    function.AddVarint(kFunctionName, functions_[i].name);
+    function.AddVarint(kFunctionSystemName, functions_[i].name);
+    function.AddVarint(kFunctionFilename, functions_[i].filename);
+    profile.AddMessage(kProfileFunction, function);
+  }
+  for (const std::string& str : strings_) {
+    profile.AddBytes(kProfileStringTable, str);
+  }
+  profile.AddVarint(kProfileDurationNanos, NanoTime() - start_time_ns_);
+  profile.AddMessage(kProfilePeriodType, ValueType(space, bytes));
+  profile.AddVarint(kProfilePeriod, mean_interval_);
+  return profile.GetData();
+}
+
+bool AllocationSampler::DumpProfile(const std::string& path, std::string* error_msg) {
+  std::string profile;
+  {
+    MutexLock mu(Thread::Current(), allow_disallow_lock_);
+    profile = EncodeProfile();
+  }
+  std::string compressed;
+  if (!Gzip(profile, &compressed, error_msg)) {
+    return false;
+  }
+  std::unique_ptr<File> file(OS::CreateEmptyFileWriteOnly(path.c_str()));
+  if (file == nullptr) {
+    *error_msg = StringPrintf("Could not create %s: %s", path.c_str(), strerror(errno));
+    return false;
+  }
+  if (!file->WriteFully(compressed.data(), compressed.size())) {
+    *error_msg = StringPrintf("Could not write %s: %s", path.c_str(), strerror(errno));
+    file->Erase(/*unlink=*/ true);
+    return false;
+  }
+  if (file->FlushCloseOrErase() != 0) {
+    *error_msg = StringPrintf("Could not flush %s: %s", path.c_str(), strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+void AllocationSampler::DumpSummary(std::ostream& os) {
+  static constexpr size_t kMaxSitesToDump = 10;
+  MutexLock mu(Thread::Current(), allow_disallow_lock_);
+  os << "Allocation sampler: " << num_samples_ << " samples every "
+     << PrettySize(mean_interval_) << " on average, " << live_samples_.size()
+     << " sampled objects live\n";
+  std::vector<const Site*> sites;
+  sites.reserve(sites_.size());
+  for (const Site& site : sites_) {
+    sites.push_back(&site);
+  }
+  const size_t num_sites = std::min(sites.size(), kMaxSitesToDump);
+  std::partial_sort(sites.begin(),
+                    sites.begin() + num_sites,
+                    sites.end(),
+                    [](const Site* lhs, const Site* rhs) {
+                      return lhs->alloc_bytes > rhs->alloc_bytes;
+                    });
+  for (size_t i = 0; i != num_sites; ++i) {
+    const Site* site = sites[i];
+    const std::vector<uint32_t>& stack = stacks_[site->stack_id];
+    os << "  " << PrettySize(site->alloc_bytes) << " " << strings_[site->class_name];
+    if (!stack.empty()) {
+      const Location& location = locations_[stack[0] - 1u];
+      os << " at " << strings_[functions_[location.function_id - 1u].name] << ":"
+         << location.line;
+    }
+    os << "\n";
+  }
+}
+
+size_t AllocationSampler::GetNumSamples() {
+  MutexLock mu(Thread::Current(), allow_disallow_lock_);
+  return num_samples_;
+}
+
+size_t AllocationSampler::GetNumLiveSamples() {
+  MutexLock mu(Thread::Current(), allow_disallow_lock_);
+  return live_samples_.size();
+}
+
+}  // namespace gc
+}  // namespace art
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_ALLOCATION_SAMPLER_H_
+#define ART_RUNTIME_GC_ALLOCATION_SAMPLER_H_
+
+#include <iosfwd>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/atomic.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "gc_root.h"
+#include "obj_ptr.h"
+#include "system_weak.h"
+
+namespace art {
+
+class ArtMethod;
+class IsMarkedVisitor;
+class RootVisitor;
+class Thread;
+
+namespace mirror {
+class Object;
+}  // namespace mirror
+
+namespace gc {
+
+// Low overhead allocation profiler, enabled with -XX:AllocationSamplingInterval.
+//
+// Unlike AllocRecordObjectMap, which records every allocation and needs the instrumented
+// allocation entrypoints, the sampler is only told about the bytes the heap accounts for: TLAB
+// and region refills, and allocations outside of TLABs. The TLAB bump pointer fast path is not
+// slowed down. The reported bytes count down the bytes until the next sample, and the allocation
+// that takes the countdown to zero is sampled. The intervals between samples are exponentially
+// distributed with the configured mean, which makes the samples a Poisson process over the
+// allocated bytes, so they do not fall in step with the allocation pattern.
+//
+// A sample stands for the mean interval worth of allocations of its stack and class. The stack
+// is interned into a compact stack id. The sampled object is held weakly, and the system weak
+// sweep tells which samples are still live, so the profile has both allocated and in-use
+// estimates. It is written in the gzipped pprof protobuf format.
+class AllocationSampler : public SystemWeakHolder {
+ public:
+  // The heap creates the sampler before the main thread is attached, so the constructor does not
+  // take allow_disallow_lock_.
+  explicit AllocationSampler(size_t mean_interval) NO_THREAD_SAFETY_ANALYSIS;
+
+  // Report that the heap accounted for `bytes` more bytes to allocate `obj`, of `object_size`
+  // bytes, possibly sampling it.
+  ALWAYS_INLINE void ReportAllocatedBytes(Thread* self,
+                                          ObjPtr<mirror::Object>* obj,
+                                          size_t object_size,
+                                          size_t bytes)
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(!allow_disallow_lock_) {
+    const int64_t bytes_until_sample =
+        bytes_until_sample_.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    // Only the thread that takes the countdown to zero samples. The bytes of threads that find
+    // it already there count towards the next interval.
+    if (UNLIKELY(bytes_until_sample > 0 && static_cast<size_t>(bytes_until_sample) <= bytes)) {
+      SampleAllocation(self, obj, object_size, bytes - static_cast<size_t>(bytes_until_sample));
+    }
+  }
+
+  void Sweep(IsMarkedVisitor* visitor) override
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(!allow_disallow_lock_);
+
+  // Visit the declaring classes of the methods in the sampled stacks, like
+  // AllocRecordObjectMap::VisitRoots, so that they are not unloaded while the profile refers to
+  // them.
+  void VisitRoots(RootVisitor* visitor)
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(!allow_disallow_lock_);
+
+  // Write the profile to `path`.
+  bool DumpProfile(const std::string& path, std::string* error_msg)
+      REQUIRES(!allow_disallow_lock_);
+
+  // Print a summary of the samples, for SIGQUIT.
+  void DumpSummary(std::ostream& os) REQUIRES(!allow_disallow_lock_);
+
+  size_t GetMeanInterval() const {
+    return mean_interval_;
+  }
+
+  size_t GetNumSamples() REQUIRES(!allow_disallow_lock_);
+  size_t GetNumLiveSamples() REQUIRES(!allow_disallow_lock_);
+
+  // Maximum number of frames recorded for a sample, the outermost ones are dropped.
+  static constexpr size_t kMaxStackDepth = 64;
+
+ private:
+  // A method, with names as ids in the string table.
+  struct Function {
+    uint32_t name;
+    uint32_t filename;
+  };
+
+  // A source line of a method, the pprof location of a frame.
+  struct Location {
+    uint32_t function_id;
+    int32_t line;
+  };
+
+  // Allocations of a class from a stack.
+  struct Site {
+    uint32_t stack_id;
+    uint32_t class_name;
+    uint64_t alloc_objects;
+    uint64_t alloc_bytes;
+  };
+
+  // A sampled object that was live at the last sweep.
+  struct LiveSample {
+    GcRoot<mirror::Object> object;
+    uint32_t site_id;
+    uint64_t objects;
+    uint64_t bytes;
+  };
+
+  // Record the sample of `obj`, `overshoot` bytes past the end of the current interval.
+  void SampleAllocation(Thread* self,
+                        ObjPtr<mirror::Object>* obj,
+                        size_t object_size,
+                        size_t overshoot)
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(!allow_disallow_lock_);
+
+  // Draw the number of bytes to the next sample.
+  int64_t NextInterval() REQUIRES(allow_disallow_lock_);
+
+  uint32_t InternString(const std::string& str) REQUIRES(allow_disallow_lock_);
+  uint32_t InternLocation(ArtMethod* method, uint32_t dex_pc)
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(allow_disallow_lock_);
+
+  // Serialize the profile in the pprof protobuf format.
+  std::string EncodeProfile() REQUIRES(allow_disallow_lock_);
+
+  const size_t mean_interval_;
+  // Bytes left until the next sample.
+  Atomic<int64_t> bytes_until_sample_;
+
+  std::mt19937_64 random_ GUARDED_BY(allow_disallow_lock_);
+  std::exponential_distribution<double> interval_distribution_ GUARDED_BY(allow_disallow_lock_);
+
+  // The pprof string table, its first entry is the empty string.
+  std::vector<std::string> strings_ GUARDED_BY(allow_disallow_lock_);
+  std::unordered_map<std::string, uint32_t> string_ids_ GUARDED_BY(allow_disallow_lock_);
+  // Ids are one based, as pprof reserves zero.
+  std::vector<Function> functions_ GUARDED_BY(allow_disallow_lock_);
+  std::unordered_map<ArtMethod*, uint32_t> function_ids_ GUARDED_BY(allow_disallow_lock_);
+  std::vector<Location> locations_ GUARDED_BY(allow_disallow_lock_);
+  std::map<std::pair<ArtMethod*, uint32_t>, uint32_t> location_ids_
+      GUARDED_BY(allow_disallow_lock_);
+  // Stacks are lists of location ids, innermost frame first.
+  std::vector<std::vector<uint32_t>> stacks_ GUARDED_BY(allow_disallow_lock_);
+  std::map<std::vector<uint32_t>, uint32_t> stack_ids_ GUARDED_BY(allow_disallow_lock_);
+  std::vector<Site> sites_ GUARDED_BY(allow_disallow_lock_);
+  std::map<std::pair<uint32_t, uint32_t>, uint32_t> site_ids_ GUARDED_BY(allow_disallow_lock_);
+  std::vector<LiveSample> live_samples_ GUARDED_BY(allow_disallow_lock_);
+  size_t num_samples_ GUARDED_BY(allow_disallow_lock_);
+  const uint64_t start_time_ns_;
+
+  DISALLOW_COPY_AND_ASSIGN(AllocationSampler);
+};
+
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_ALLOCATION_SAMPLER_H_
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "allocation_sampler.h"
+
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "base/os.h"
+#include "base/unix_file/fd_file.h"
+#include "class_root.h"
+#include "common_runtime_test.h"
+#include "handle_scope-inl.h"
+#include "mirror/class-alloc-inl.h"
+#include "mirror/class-inl.h"
+#include "mirror/object-inl.h"
+#include "object_callbacks.h"
+#include "scoped_thread_state_change-inl.h"
+
+namespace art {
+namespace gc {
+
+class AllocationSamplerTest : public CommonRuntimeTest {};
+
+// Keeps the objects of a set alive.
+class SetIsMarkedVisitor : public IsMarkedVisitor {
+ public:
+  explicit SetIsMarkedVisitor(const std::set<mirror::Object*>& live) : live_(live) {}
+
+  mirror::Object* IsMarked(mirror::Object* obj) override {
+    return live_.find(obj) != live_.end() ? obj : nullptr;
+  }
+
+ private:
+  const std::set<mirror::Object*>& live_;
+};
+
+TEST_F(AllocationSamplerTest, SampleSweepAndDump) {
+  static constexpr size_t kInterval = 1 * KB;
+  static constexpr size_t kNumAllocations = 8;
+  Thread* self = Thread::Current();
+  ScopedObjectAccess soa(self);
+  StackHandleScope<kNumAllocations + 1> hs(self);
+  AllocationSampler sampler(kInterval);
+  Handle<mirror::Class> object_class = hs.NewHandle(GetClassRoot<mirror::Object>());
+  std::vector<Handle<mirror::Object>> objects;
+  for (size_t i = 0; i != kNumAllocations; ++i) {
+    ObjPtr<mirror::Object> obj = object_class->AllocObject(self);
+    ASSERT_TRUE(obj != nullptr);
+    // Report many intervals worth of bytes, enough to cross the next sample in all but
+    // vanishingly unlikely draws.
+    sampler.ReportAllocatedBytes(self, &obj, obj->SizeOf(), 64 * kInterval);
+    objects.push_back(hs.NewHandle(obj));
+  }
+  EXPECT_GE(sampler.GetNumSamples(), kNumAllocations);
+  EXPECT_EQ(sampler.GetNumLiveSamples(), kNumAllocations);
+
+  // Let every other sampled object die.
+  std::set<mirror::Object*> live;
+  for (size_t i = 0; i < objects.size(); i += 2) {
+    live.insert(objects[i].Get());
+  }
+  SetIsMarkedVisitor visitor(live);
+  sampler.Sweep(&visitor);
+  EXPECT_EQ(sampler.GetNumLiveSamples(), live.size());
+
+  std::ostringstream oss;
+  sampler.DumpSummary(oss);
+  EXPECT_NE(oss.str().find("java.lang.Object"), std::string::npos) << oss.str();
+
+  ScratchFile profile;
+  std::string error_msg;
+  ASSERT_TRUE(sampler.DumpProfile(profile.GetFilename(), &error_msg)) << error_msg;
+  std::unique_ptr<File> file(OS::OpenFileForReading(profile.GetFilename().c_str()));
+  ASSERT_TRUE(file != nullptr);
+  uint8_t magic[2];
+  ASSERT_TRUE(file->ReadFully(magic, sizeof(magic)));
+  // The gzip magic.
+  EXPECT_EQ(0x1f, magic[0]);
+  EXPECT_EQ(0x8b, magic[1]);
+}
+
+}  // namespace gc
+}  // namespace art
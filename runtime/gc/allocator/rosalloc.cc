@@ -16,6 +16,10 @@
 
 #include "rosalloc-inl.h"
 
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <list>
 #include <map>
 #include <sstream>
@@ -53,11 +57,20 @@ size_t RosAlloc::dedicated_full_run_storage_[kPageSize / sizeof(size_t)] = { 0 }
 RosAlloc::Run* RosAlloc::dedicated_full_run_ =
     reinterpret_cast<RosAlloc::Run*>(dedicated_full_run_storage_);
 
+// Per-CPU runs are looked up with sched_getcpu().
+#if defined(__linux__)
+static constexpr bool kPerCpuRunsSupported = true;
+#else
+static constexpr bool kPerCpuRunsSupported = false;
+#endif
+
 RosAlloc::RosAlloc(void* base, size_t capacity, size_t max_capacity,
                    PageReleaseMode page_release_mode, bool running_on_memory_tool,
-                   size_t page_release_size_threshold)
+                   bool use_per_cpu_runs, size_t page_release_size_threshold)
     : base_(reinterpret_cast<uint8_t*>(base)), footprint_(capacity),
       capacity_(capacity), max_capacity_(max_capacity),
+      use_per_cpu_runs_(use_per_cpu_runs && kPerCpuRunsSupported),
+      num_per_cpu_runs_(0u),
       lock_("rosalloc global lock", kRosAllocGlobalLock),
       bulk_free_lock_("rosalloc bulk free lock", kRosAllocBulkFreeLock),
       page_release_mode_(page_release_mode),
@@ -87,6 +100,14 @@ RosAlloc::RosAlloc(void* base, size_t capacity, size_t max_capacity,
     size_bracket_locks_[i] = new Mutex(size_bracket_lock_names_[i].c_str(), kRosAllocBracketLock);
     current_runs_[i] = dedicated_full_run_;
   }
+  if (use_per_cpu_runs_) {
+    const long num_cpus = sysconf(_SC_NPROCESSORS_CONF);  // NOLINT(runtime/int)
+    num_per_cpu_runs_ = num_cpus > 0 ? static_cast<size_t>(num_cpus) : 1u;
+    per_cpu_runs_.reset(new PerCpuRuns[num_per_cpu_runs_]);
+    for (size_t cpu = 0; cpu < num_per_cpu_runs_; ++cpu) {
+      std::fill_n(per_cpu_runs_[cpu].runs, kNumThreadLocalSizeBrackets, dedicated_full_run_);
+    }
+  }
   DCHECK_EQ(footprint_, capacity_);
   size_t num_of_pages = footprint_ / kPageSize;
   size_t max_num_of_pages = max_capacity_ / kPageSize;
@@ -595,6 +616,100 @@ RosAlloc::Run* RosAlloc::RefillRun(Thread* self, size_t idx) {
   return AllocRun(self, idx);
 }
 
+RosAlloc::Run* RosAlloc::RefreshThreadLocalRun(Thread* self, size_t idx, Run* run) {
+  size_bracket_locks_[idx]->AssertHeld(self);
+  DCHECK(run->IsFull());
+  bool is_all_free_after_merge;
+  // This is safe to do for the dedicated_full_run_ since the bitmaps are empty.
+  if (run->MergeThreadLocalFreeListToFreeList(&is_all_free_after_merge)) {
+    DCHECK_NE(run, dedicated_full_run_);
+    // Some slot got freed. Keep it.
+    DCHECK(!run->IsFull());
+    DCHECK_EQ(is_all_free_after_merge, run->IsAllFree());
+    return run;
+  }
+  // No slots got freed. Try to refill the thread-local run.
+  DCHECK(run->IsFull());
+  if (run != dedicated_full_run_) {
+    run->SetIsThreadLocal(false);
+    if (kIsDebugBuild) {
+      full_runs_[idx].insert(run);
+      if (kTraceRosAlloc) {
+        LOG(INFO) << "RosAlloc::RefreshThreadLocalRun() : Inserted run 0x" << std::hex
+                  << reinterpret_cast<intptr_t>(run)
+                  << " into full_runs_[" << std::dec << idx << "]";
+      }
+    }
+    DCHECK(non_full_runs_[idx].find(run) == non_full_runs_[idx].end());
+    DCHECK(full_runs_[idx].find(run) != full_runs_[idx].end());
+  }
+  Run* new_run = RefillRun(self, idx);
+  if (UNLIKELY(new_run == nullptr)) {
+    return nullptr;
+  }
+  DCHECK(non_full_runs_[idx].find(new_run) == non_full_runs_[idx].end());
+  DCHECK(full_runs_[idx].find(new_run) == full_runs_[idx].end());
+  new_run->SetIsThreadLocal(true);
+  DCHECK(!new_run->IsFull());
+  return new_run;
+}
+
+size_t RosAlloc::GetPerCpuRunsIndex() const {
+  DCHECK_NE(num_per_cpu_runs_, 0u);
+#if defined(__linux__)
+  const int cpu = sched_getcpu();
+  if (LIKELY(cpu >= 0)) {
+    // CPUs brought online beyond the configured ones share the runs of others.
+    return static_cast<size_t>(cpu) % num_per_cpu_runs_;
+  }
+#endif
+  return 0u;
+}
+
+void* RosAlloc::AllocFromPerCpuRun(Thread* self, size_t idx, size_t* bytes_tl_bulk_allocated) {
+  DCHECK(use_per_cpu_runs_);
+  DCHECK_LT(idx, kNumThreadLocalSizeBrackets);
+  // The thread may migrate once the CPU is read, which is harmless since the runs stay claimed
+  // for the whole allocation.
+  PerCpuRuns& cpu_runs = per_cpu_runs_[GetPerCpuRunsIndex()];
+  if (UNLIKELY(!cpu_runs.TryClaim())) {
+    // Another thread got preempted or migrated while allocating from the runs of this CPU. Do
+    // not wait for it.
+    MutexLock mu(self, *size_bracket_locks_[idx]);
+    void* slot_addr = AllocFromCurrentRunUnlocked(self, idx);
+    *bytes_tl_bulk_allocated = (slot_addr != nullptr) ? bracketSizes[idx] : 0u;
+    return slot_addr;
+  }
+  Run* run = cpu_runs.runs[idx];
+  DCHECK(run != nullptr);
+  DCHECK(run->IsThreadLocal() || run == dedicated_full_run_);
+  void* slot_addr = run->AllocSlot();
+  if (LIKELY(slot_addr != nullptr)) {
+    cpu_runs.Release();
+    // The slot is already counted. Leave it as is.
+    *bytes_tl_bulk_allocated = 0;
+    return slot_addr;
+  }
+  {
+    MutexLock bracket_mu(self, *size_bracket_locks_[idx]);
+    run = RefreshThreadLocalRun(self, idx, run);
+  }
+  if (UNLIKELY(run == nullptr)) {
+    cpu_runs.runs[idx] = dedicated_full_run_;
+    cpu_runs.Release();
+    return nullptr;
+  }
+  cpu_runs.runs[idx] = run;
+  // Account for all the free slots in the new or refreshed per-CPU run, like for the
+  // thread-local runs. Slots freed into the run meanwhile go to its thread local free list.
+  *bytes_tl_bulk_allocated = run->NumberOfFreeSlots() * bracketSizes[idx];
+  slot_addr = run->AllocSlot();
+  cpu_runs.Release();
+  // Must succeed now with a new run.
+  DCHECK(slot_addr != nullptr);
+  return slot_addr;
+}
+
 inline void* RosAlloc::AllocFromCurrentRunUnlocked(Thread* self, size_t idx) {
   Run* current_run = current_runs_[idx];
   DCHECK(current_run != nullptr);
@@ -660,7 +775,20 @@ void* RosAlloc::AllocFromRun(Thread* self, size_t size, size_t* bytes_allocated,
   size_t bracket_size;
   size_t idx = SizeToIndexAndBracketSize(size, &bracket_size);
   void* slot_addr;
-  if (LIKELY(idx < kNumThreadLocalSizeBrackets)) {
+  if (use_per_cpu_runs_ && idx < kNumThreadLocalSizeBrackets) {
+    // Use a per-CPU run.
+    slot_addr = AllocFromPerCpuRun(self, idx, bytes_tl_bulk_allocated);
+    if (kTraceRosAlloc) {
+      LOG(INFO) << "RosAlloc::AllocFromRun() per-CPU : 0x" << std::hex
+                << reinterpret_cast<intptr_t>(slot_addr)
+                << "-0x" << (reinterpret_cast<intptr_t>(slot_addr) + bracket_size)
+                << "(" << std::dec << (bracket_size) << ")";
+    }
+    if (LIKELY(slot_addr != nullptr)) {
+      *bytes_allocated = bracket_size;
+      *usable_size = bracket_size;
+    }
+  } else if (LIKELY(idx < kNumThreadLocalSizeBrackets)) {
     // Use a thread-local run.
     Run* thread_local_run = reinterpret_cast<Run*>(self->GetRosAllocRun(idx));
     // Allow invalid since this will always fail the allocation.
@@ -680,41 +808,12 @@ void* RosAlloc::AllocFromRun(Thread* self, size_t size, size_t* bytes_allocated,
       // The run got full. Try to free slots.
       DCHECK(thread_local_run->IsFull());
       MutexLock mu(self, *size_bracket_locks_[idx]);
-      bool is_all_free_after_merge;
-      // This is safe to do for the dedicated_full_run_ since the bitmaps are empty.
-      if (thread_local_run->MergeThreadLocalFreeListToFreeList(&is_all_free_after_merge)) {
-        DCHECK_NE(thread_local_run, dedicated_full_run_);
-        // Some slot got freed. Keep it.
-        DCHECK(!thread_local_run->IsFull());
-        DCHECK_EQ(is_all_free_after_merge, thread_local_run->IsAllFree());
-      } else {
-        // No slots got freed. Try to refill the thread-local run.
-        DCHECK(thread_local_run->IsFull());
-        if (thread_local_run != dedicated_full_run_) {
-          thread_local_run->SetIsThreadLocal(false);
-          if (kIsDebugBuild) {
-            full_runs_[idx].insert(thread_local_run);
-            if (kTraceRosAlloc) {
-              LOG(INFO) << "RosAlloc::AllocFromRun() : Inserted run 0x" << std::hex
-                        << reinterpret_cast<intptr_t>(thread_local_run)
-                        << " into full_runs_[" << std::dec << idx << "]";
-            }
-          }
-          DCHECK(non_full_runs_[idx].find(thread_local_run) == non_full_runs_[idx].end());
-          DCHECK(full_runs_[idx].find(thread_local_run) != full_runs_[idx].end());
-        }
-
-        thread_local_run = RefillRun(self, idx);
-        if (UNLIKELY(thread_local_run == nullptr)) {
-          self->SetRosAllocRun(idx, dedicated_full_run_);
-          return nullptr;
-        }
-        DCHECK(non_full_runs_[idx].find(thread_local_run) == non_full_runs_[idx].end());
-        DCHECK(full_runs_[idx].find(thread_local_run) == full_runs_[idx].end());
-        thread_local_run->SetIsThreadLocal(true);
-        self->SetRosAllocRun(idx, thread_local_run);
-        DCHECK(!thread_local_run->IsFull());
+      thread_local_run = RefreshThreadLocalRun(self, idx, thread_local_run);
+      if (UNLIKELY(thread_local_run == nullptr)) {
+        self->SetRosAllocRun(idx, dedicated_full_run_);
+        return nullptr;
       }
+      self->SetRosAllocRun(idx, thread_local_run);
       DCHECK(thread_local_run != nullptr);
       DCHECK(!thread_local_run->IsFull());
       DCHECK(thread_local_run->IsThreadLocal());
@@ -1517,29 +1616,55 @@ size_t RosAlloc::RevokeThreadLocalRuns(Thread* thread) {
     if (thread_local_run != dedicated_full_run_) {
       // Note the thread local run may not be full here.
       thread->SetRosAllocRun(idx, dedicated_full_run_);
-      DCHECK_EQ(thread_local_run->magic_num_, kMagicNum);
-      // Count the number of free slots left.
-      size_t num_free_slots = thread_local_run->NumberOfFreeSlots();
-      free_bytes += num_free_slots * bracketSizes[idx];
-      // The above bracket index lock guards thread local free list to avoid race condition
-      // with unioning bulk free list to thread local free list by GC thread in BulkFree.
-      // If thread local run is true, GC thread will help update thread local free list
-      // in BulkFree. And the latest thread local free list will be merged to free list
-      // either when this thread local run is full or when revoking this run here. In this
-      // case the free list wll be updated. If thread local run is false, GC thread will help
-      // merge bulk free list in next BulkFree.
-      // Thus no need to merge bulk free list to free list again here.
-      bool dont_care;
-      thread_local_run->MergeThreadLocalFreeListToFreeList(&dont_care);
-      thread_local_run->SetIsThreadLocal(false);
-      DCHECK(non_full_runs_[idx].find(thread_local_run) == non_full_runs_[idx].end());
-      DCHECK(full_runs_[idx].find(thread_local_run) == full_runs_[idx].end());
-      RevokeRun(self, idx, thread_local_run);
+      free_bytes += RevokeThreadLocalRun(self, idx, thread_local_run);
     }
   }
   return free_bytes;
 }
 
+size_t RosAlloc::RevokeThreadLocalRun(Thread* self, size_t idx, Run* run) {
+  size_bracket_locks_[idx]->AssertHeld(self);
+  DCHECK_NE(run, dedicated_full_run_);
+  DCHECK_EQ(run->magic_num_, kMagicNum);
+  // Count the number of free slots left.
+  size_t num_free_slots = run->NumberOfFreeSlots();
+  // The above bracket index lock guards thread local free list to avoid race condition
+  // with unioning bulk free list to thread local free list by GC thread in BulkFree.
+  // If thread local run is true, GC thread will help update thread local free list
+  // in BulkFree. And the latest thread local free list will be merged to free list
+  // either when this thread local run is full or when revoking this run here. In this
+  // case the free list wll be updated. If thread local run is false, GC thread will help
+  // merge bulk free list in next BulkFree.
+  // Thus no need to merge bulk free list to free list again here.
+  bool dont_care;
+  run->MergeThreadLocalFreeListToFreeList(&dont_care);
+  run->SetIsThreadLocal(false);
+  DCHECK(non_full_runs_[idx].find(run) == non_full_runs_[idx].end());
+  DCHECK(full_runs_[idx].find(run) == full_runs_[idx].end());
+  RevokeRun(self, idx, run);
+  return num_free_slots * bracketSizes[idx];
+}
+
+size_t RosAlloc::RevokePerCpuRuns() {
+  Thread* self = Thread::Current();
+  size_t free_bytes = 0U;
+  for (size_t cpu = 0; cpu < num_per_cpu_runs_; ++cpu) {
+    PerCpuRuns& cpu_runs = per_cpu_runs_[cpu];
+    cpu_runs.Claim();
+    for (size_t idx = 0; idx < kNumThreadLocalSizeBrackets; idx++) {
+      Run* run = cpu_runs.runs[idx];
+      if (run != dedicated_full_run_) {
+        MutexLock bracket_mu(self, *size_bracket_locks_[idx]);
+        DCHECK(run->IsThreadLocal());
+        cpu_runs.runs[idx] = dedicated_full_run_;
+        free_bytes += RevokeThreadLocalRun(self, idx, run);
+      }
+    }
+    cpu_runs.Release();
+  }
+  return free_bytes;
+}
+
 void RosAlloc::RevokeRun(Thread* self, size_t idx, Run* run) {
   size_bracket_locks_[idx]->AssertHeld(self);
   DCHECK(run != dedicated_full_run_);
@@ -1590,6 +1715,7 @@ size_t RosAlloc::RevokeAllThreadLocalRuns() {
   for (Thread* thread : thread_list) {
     free_bytes += RevokeThreadLocalRuns(thread);
   }
+  free_bytes += RevokePerCpuRuns();
   RevokeThreadUnsafeCurrentRuns();
   return free_bytes;
 }
@@ -1616,6 +1742,13 @@ void RosAlloc::AssertAllThreadLocalRunsAreRevoked() {
     for (Thread* t : thread_list) {
       AssertThreadLocalRunsAreRevoked(t);
     }
+    for (size_t cpu = 0; cpu < num_per_cpu_runs_; ++cpu) {
+      per_cpu_runs_[cpu].Claim();
+      for (size_t idx = 0; idx < kNumThreadLocalSizeBrackets; ++idx) {
+        CHECK_EQ(per_cpu_runs_[cpu].runs[idx], dedicated_full_run_);
+      }
+      per_cpu_runs_[cpu].Release();
+    }
     for (size_t idx = 0; idx < kNumThreadLocalSizeBrackets; ++idx) {
       MutexLock brackets_mu(self, *size_bracket_locks_[idx]);
       CHECK_EQ(current_runs_[idx], dedicated_full_run_);
@@ -1851,6 +1984,16 @@ void RosAlloc::Verify() {
             thread_local_run->size_bracket_idx_ == i);
     }
   }
+  // The mutators are suspended, so the per-CPU runs are not in use.
+  for (size_t cpu = 0; cpu < num_per_cpu_runs_; ++cpu) {
+    CHECK(!per_cpu_runs_[cpu].in_use.load(std::memory_order_relaxed));
+    for (size_t i = 0; i < kNumThreadLocalSizeBrackets; ++i) {
+      Run* cpu_run = per_cpu_runs_[cpu].runs[i];
+      CHECK(cpu_run != nullptr);
+      CHECK(cpu_run->IsThreadLocal());
+      CHECK(cpu_run == dedicated_full_run_ || cpu_run->size_bracket_idx_ == i);
+    }
+  }
   for (size_t i = 0; i < kNumOfSizeBrackets; i++) {
     MutexLock brackets_mu(self, *size_bracket_locks_[i]);
     Run* current_run = current_runs_[i];
@@ -1898,6 +2041,18 @@ void RosAlloc::Run::Verify(Thread* self, RosAlloc* rosalloc, bool running_on_mem
         }
       }
     }
+    // Or by a CPU.
+    for (size_t cpu = 0; cpu < rosalloc->num_per_cpu_runs_; ++cpu) {
+      for (size_t i = 0; i < kNumThreadLocalSizeBrackets; i++) {
+        if (rosalloc->per_cpu_runs_[cpu].runs[i] == this) {
+          CHECK(!owner_found)
+              << "A thread local run has more than one owner " << Dump();
+          CHECK_EQ(i, idx)
+              << "A mismatching size bracket index in a per-CPU run " << Dump();
+          owner_found = true;
+        }
+      }
+    }
     CHECK(owner_found) << "A thread local run has no owner thread " << Dump();
   } else {
     // If it's not thread local, check that the thread local free list is empty.
@@ -17,6 +17,7 @@
 #ifndef ART_RUNTIME_GC_ALLOCATOR_ROSALLOC_H_
 #define ART_RUNTIME_GC_ALLOCATOR_ROSALLOC_H_
 
+#include <sched.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <sys/mman.h>
@@ -29,6 +30,7 @@
 #include <android-base/logging.h>
 
 #include "base/allocator.h"
+#include "base/atomic.h"
 #include "base/bit_utils.h"
 #include "base/mem_map.h"
 #include "base/mutex.h"
@@ -733,6 +735,41 @@ class RosAlloc {
   Mutex* size_bracket_locks_[kNumOfSizeBrackets];
   // Bracket lock names (since locks only have char* names).
   std::string size_bracket_lock_names_[kNumOfSizeBrackets];
+
+  // The runs of the thread-local size brackets cached for a CPU, used in the per-CPU runs mode.
+  struct PerCpuRuns {
+    // Set by the thread allocating from, refilling or revoking the runs. It is only contended if
+    // the thread gets preempted or migrated while allocating, so an allocating thread claims the
+    // runs with a single compare-and-swap rather than a Mutex, and allocates from the shared
+    // current run if that fails. Claimed before the bracket locks.
+    Atomic<bool> in_use;
+    // The runs, guarded by in_use. They are marked thread local, so that they are left out of the
+    // run sets and the slots freed into them go to their thread local free list, as for the runs
+    // of a thread.
+    Run* runs[kNumThreadLocalSizeBrackets];
+
+    bool TryClaim() {
+      return !in_use.load(std::memory_order_relaxed) &&
+             in_use.CompareAndSet(false, true, CASMode::kStrong, std::memory_order_acquire);
+    }
+    // Wait for the runs to be released, for the paths going over the runs of all CPUs.
+    void Claim() {
+      while (!TryClaim()) {
+        sched_yield();
+      }
+    }
+    void Release() {
+      in_use.store(false, std::memory_order_release);
+    }
+  };
+  // Whether the thread-local size brackets use per-CPU runs rather than thread-local runs. With
+  // thousands of mostly idle threads, each thread holding its own partially filled runs wastes
+  // memory, while the number of per-CPU runs is bounded by the number of cores. The runs of the
+  // threads are then never set, so that the allocation fast paths always go to AllocFromRun().
+  const bool use_per_cpu_runs_;
+  // Number of entries of per_cpu_runs_, the number of configured CPUs, or 0.
+  size_t num_per_cpu_runs_;
+  std::unique_ptr<PerCpuRuns[]> per_cpu_runs_;
   // The types of page map entries.
   enum PageMapKind {
     kPageMapReleased = 0,     // Zero and released back to the OS.
@@ -804,6 +841,18 @@ class RosAlloc {
   // thread-local or current run gets full.
   Run* RefillRun(Thread* self, size_t idx) REQUIRES(!lock_);
 
+  // Called with the bracket lock when the thread-local or per-CPU run `run` of the size bracket
+  // `idx` got full. Returns `run` if slots were freed into it, otherwise a new thread-local run
+  // replacing it, or null if none could be allocated.
+  Run* RefreshThreadLocalRun(Thread* self, size_t idx, Run* run) REQUIRES(!lock_);
+
+  // Allocate a slot of the thread-local size bracket `idx` from the runs of the current CPU.
+  void* AllocFromPerCpuRun(Thread* self, size_t idx, size_t* bytes_tl_bulk_allocated)
+      REQUIRES(!lock_);
+
+  // Returns the index in per_cpu_runs_ of the CPU the calling thread runs on.
+  size_t GetPerCpuRunsIndex() const;
+
   // The internal of non-bulk Free().
   size_t FreeInternal(Thread* self, void* ptr) REQUIRES(!lock_);
 
@@ -815,6 +864,13 @@ class RosAlloc {
   // Revoke a run by adding it to non_full_runs_ or freeing the pages.
   void RevokeRun(Thread* self, size_t idx, Run* run) REQUIRES(!lock_);
 
+  // Revoke the thread-local or per-CPU run `run` of the size bracket `idx`, with the bracket lock
+  // held. Returns the bytes of its free slots.
+  size_t RevokeThreadLocalRun(Thread* self, size_t idx, Run* run) REQUIRES(!lock_);
+
+  // Revoke the runs of all the CPUs. Returns the bytes of their free slots.
+  size_t RevokePerCpuRuns() REQUIRES(!lock_);
+
   // Revoke the current runs which share an index with the thread local runs.
   void RevokeThreadUnsafeCurrentRuns() REQUIRES(!lock_);
 
@@ -828,6 +884,7 @@ class RosAlloc {
   RosAlloc(void* base, size_t capacity, size_t max_capacity,
            PageReleaseMode page_release_mode,
            bool running_on_memory_tool,
+           bool use_per_cpu_runs,
            size_t page_release_size_threshold = kDefaultPageReleaseSizeThreshold);
   ~RosAlloc();
 
@@ -896,11 +953,13 @@ class RosAlloc {
 
   // Releases the thread-local runs assigned to the given thread back to the common set of runs.
   // Returns the total bytes of free slots in the revoked thread local runs. This is to be
-  // subtracted from Heap::num_bytes_allocated_ to cancel out the ahead-of-time counting.
+  // subtracted from Heap::num_bytes_allocated_ to cancel out the ahead-of-time counting. The
+  // per-CPU runs are not owned by a thread and are only released by RevokeAllThreadLocalRuns().
   size_t RevokeThreadLocalRuns(Thread* thread) REQUIRES(!lock_, !bulk_free_lock_);
-  // Releases the thread-local runs assigned to all the threads back to the common set of runs.
-  // Returns the total bytes of free slots in the revoked thread local runs. This is to be
-  // subtracted from Heap::num_bytes_allocated_ to cancel out the ahead-of-time counting.
+  // Releases the thread-local runs assigned to all the threads, and the per-CPU runs, back to the
+  // common set of runs. Returns the total bytes of free slots in the revoked thread local runs.
+  // This is to be subtracted from Heap::num_bytes_allocated_ to cancel out the ahead-of-time
+  // counting.
   size_t RevokeAllThreadLocalRuns() REQUIRES(!Locks::thread_list_lock_, !lock_, !bulk_free_lock_);
   // Assert the thread local runs of a thread are revoked.
   void AssertThreadLocalRunsAreRevoked(Thread* thread) REQUIRES(!bulk_free_lock_);
@@ -910,6 +969,10 @@ class RosAlloc {
   static Run* GetDedicatedFullRun() {
     return dedicated_full_run_;
   }
+  // Returns true if the thread-local size brackets use per-CPU runs.
+  bool UsesPerCpuRuns() const {
+    return use_per_cpu_runs_;
+  }
   bool IsFreePage(size_t idx) const {
     DCHECK_LT(idx, capacity_ / kPageSize);
     uint8_t pm_type = page_map_[idx];
@@ -98,9 +98,10 @@ inline mirror::Object* ConcurrentCopying::MarkImmuneSpace(Thread* const self,
     // The GC-running thread doesn't (need to) gray immune objects except when updating thread roots
     // in the thread flip on behalf of suspended threads (when gc_grays_immune_objects_ is
     // true). Also, a mutator doesn't (need to) gray an immune object after GC has updated all
-    // immune space objects (when updated_all_immune_objects_ is true).
+    // immune space objects (when updated_all_immune_objects_ is true). The parallel marking
+    // threads are GC threads as well.
     if (kIsDebugBuild) {
-      if (self == thread_running_gc_) {
+      if (IsGcThread(self)) {
         DCHECK(!kGrayImmuneObject ||
                updated_all_immune_objects_.load(std::memory_order_relaxed) ||
                gc_grays_immune_objects_);
@@ -136,7 +137,7 @@ inline mirror::Object* ConcurrentCopying::Mark(Thread* const self,
   DCHECK(heap_->collector_type_ == kCollectorTypeCC);
   if (kFromGCThread) {
     DCHECK(is_active_);
-    DCHECK_EQ(self, thread_running_gc_);
+    DCHECK(IsGcThread(self));
   } else if (UNLIKELY(kUseBakerReadBarrier && !is_active_)) {
     // In the lock word forward address state, the read barrier bits
     // in the lock word are part of the stored forwarding address and
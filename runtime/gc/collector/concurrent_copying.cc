@@ -16,6 +16,8 @@
 
 #include "concurrent_copying.h"
 
+#include <algorithm>
+
 #include "art_field-inl.h"
 #include "barrier.h"
 #include "base/enums.h"
@@ -24,6 +26,7 @@
 #include "base/quasi_atomic.h"
 #include "base/stl_util.h"
 #include "base/systrace.h"
+#include "base/time_utils.h"
 #include "class_root.h"
 #include "debugger.h"
 #include "gc/accounting/atomic_stack.h"
@@ -32,9 +35,11 @@
 #include "gc/accounting/read_barrier_table.h"
 #include "gc/accounting/space_bitmap-inl.h"
 #include "gc/gc_pause_listener.h"
+#include "gc/heap_census-inl.h"
 #include "gc/reference_processor.h"
 #include "gc/space/image_space.h"
 #include "gc/space/space-inl.h"
+#include "gc/string_dedup_stats-inl.h"
 #include "gc/verification.h"
 #include "image-inl.h"
 #include "intern_table.h"
@@ -45,6 +50,7 @@
 #include "scoped_thread_state_change-inl.h"
 #include "thread-inl.h"
 #include "thread_list.h"
+#include "thread_pool.h"
 #include "well_known_classes.h"
 
 namespace art {
@@ -66,6 +72,13 @@ static constexpr size_t kReadBarrierMarkStackSize = 512 * KB;
 static constexpr size_t kSweepArrayChunkFreeSize = 1024;
 // Verify that there are no missing card marks.
 static constexpr bool kVerifyNoMissingCardMarks = kIsDebugBuild;
+// Below this number of pending mark stack entries, the GC-running thread processes the mark
+// stacks on its own since waking up the heap thread pool costs more than it saves.
+static constexpr size_t kMinParallelMarkStackSize = 8 * KB;
+
+// A parallel marking thread shares half of its mark stack with the threads waiting for work once
+// it has at least twice this number of entries.
+static constexpr size_t kMinSharedMarkStackSize = 64;
 
 ConcurrentCopying::ConcurrentCopying(Heap* heap,
                                      bool young_gen,
@@ -87,6 +100,15 @@ ConcurrentCopying::ConcurrentCopying(Heap* heap,
                                                          kReadBarrierMarkStackSize)),
       rb_mark_bit_stack_full_(false),
       mark_stack_lock_("concurrent copying mark stack lock", kMarkSweepMarkStackLock),
+      parallel_marking_(false),
+      parallel_mark_threads_lock_("concurrent copying parallel mark threads lock",
+                                  kGenericBottomLock),
+      parallel_mark_active_threads_(0u),
+      parallel_mark_idle_threads_(0u),
+      parallel_mark_work_cond_("concurrent copying parallel mark work condition variable",
+                               mark_stack_lock_),
+      parallel_mark_time_ns_total_(0u),
+      parallel_mark_objects_total_(0u),
       thread_running_gc_(nullptr),
       is_marking_(false),
       is_using_read_barrier_entrypoints_(false),
@@ -114,6 +136,8 @@ ConcurrentCopying::ConcurrentCopying(Heap* heap,
       rb_slow_path_count_gc_total_(0),
       rb_table_(heap_->GetReadBarrierTable()),
       force_evacuate_all_(false),
+      census_in_marking_phase_(false),
+      census_in_copying_phase_(false),
       gc_grays_immune_objects_(false),
       immune_gray_stack_lock_("concurrent copying immune gray stack lock",
                               kMarkSweepMarkStackLock),
@@ -367,6 +391,15 @@ void ConcurrentCopying::BindBitmaps() {
   }
 }
 
+inline void ConcurrentCopying::CensusTables::AddObject(Heap* heap, mirror::Object* obj) {
+  if (heap->GetHeapCensus() != nullptr) {
+    classes.AddObject(obj);
+  }
+  if (heap->GetStringDedupStats() != nullptr) {
+    strings.AddObject(obj);
+  }
+}
+
 void ConcurrentCopying::InitializePhase() {
   TimingLogger::ScopedTiming split("InitializePhase", GetTimings());
   num_bytes_allocated_before_gc_ = static_cast<int64_t>(heap_->GetBytesAllocated());
@@ -399,6 +432,11 @@ void ConcurrentCopying::InitializePhase() {
       force_evacuate_all_ = true;
     }
   }
+  const bool take_census =
+      (heap_->GetHeapCensus() != nullptr || heap_->GetStringDedupStats() != nullptr) && !young_gen_;
+  census_in_marking_phase_ = take_census && use_generational_cc_ && !force_evacuate_all_;
+  census_in_copying_phase_ = take_census && !census_in_marking_phase_;
+  census_tables_.Clear();
   if (kUseBakerReadBarrier) {
     updated_all_immune_objects_.store(false, std::memory_order_relaxed);
     // GC may gray immune objects in the thread flip.
@@ -872,9 +910,9 @@ inline void ConcurrentCopying::ScanImmuneObject(mirror::Object* obj) {
   if (use_generational_cc_ && young_gen_) {
     // Young GC does not care about references to unevac space. It is safe to not gray these as
     // long as scan immune objects happens after scanning the dirty cards.
-    Scan<true>(obj);
+    Scan<true>(thread_running_gc_, obj);
   } else {
-    Scan<false>(obj);
+    Scan<false>(thread_running_gc_, obj);
   }
 }
 
@@ -1167,6 +1205,9 @@ void ConcurrentCopying::AddLiveBytesAndScanRef(mirror::Object* ref) {
       region_space_->AddLiveBytes(ref, alloc_size);
     }
   }
+  if (census_in_marking_phase_) {
+    census_tables_.AddObject(heap_, ref);
+  }
   ComputeLiveBytesAndMarkRefFieldsVisitor</*kHandleInterRegionRefs*/ true>
       visitor(this, obj_region_idx);
   ref->VisitReferences</*kVisitNativeRoots=*/ true, kDefaultVerifyFlags, kWithoutReadBarrier>(
@@ -1417,7 +1458,7 @@ void ConcurrentCopying::MarkingPhase() {
 
 template <bool kNoUnEvac>
 void ConcurrentCopying::ScanDirtyObject(mirror::Object* obj) {
-  Scan<kNoUnEvac>(obj);
+  Scan<kNoUnEvac>(thread_running_gc_, obj);
   // Set the read-barrier state of a reference-type object to gray if its
   // referent is not marked yet. This is to ensure that if GetReferent() is
   // called, it triggers the read-barrier to process the referent before use.
@@ -1813,25 +1854,14 @@ void ConcurrentCopying::PushOntoMarkStack(Thread* const self, mirror::Object* to
       if (UNLIKELY(tl_mark_stack == nullptr || tl_mark_stack->IsFull())) {
         MutexLock mu(self, mark_stack_lock_);
         // Get a new thread local mark stack.
-        accounting::AtomicStack<mirror::Object>* new_tl_mark_stack;
-        if (!pooled_mark_stacks_.empty()) {
-          // Use a pooled mark stack.
-          new_tl_mark_stack = pooled_mark_stacks_.back();
-          pooled_mark_stacks_.pop_back();
-        } else {
-          // None pooled. Create a new one.
-          new_tl_mark_stack =
-              accounting::AtomicStack<mirror::Object>::Create(
-                  "thread local mark stack", 4 * KB, 4 * KB);
-        }
-        DCHECK(new_tl_mark_stack != nullptr);
-        DCHECK(new_tl_mark_stack->IsEmpty());
+        accounting::AtomicStack<mirror::Object>* new_tl_mark_stack = GetPooledMarkStack();
         new_tl_mark_stack->PushBack(to_ref);
         self->SetThreadLocalMarkStack(new_tl_mark_stack);
         if (tl_mark_stack != nullptr) {
           // Store the old full stack into a vector.
           revoked_mark_stacks_.push_back(tl_mark_stack);
           RemoveThreadMarkStackMapping(self, tl_mark_stack);
+          NotifyParallelMarkWork(self);
         }
         AddThreadMarkStackMapping(self, new_tl_mark_stack);
       } else {
@@ -1862,6 +1892,32 @@ void ConcurrentCopying::PushOntoMarkStack(Thread* const self, mirror::Object* to
   }
 }
 
+accounting::ObjectStack* ConcurrentCopying::GetPooledMarkStack() {
+  accounting::ObjectStack* mark_stack;
+  if (!pooled_mark_stacks_.empty()) {
+    // Use a pooled mark stack.
+    mark_stack = pooled_mark_stacks_.back();
+    pooled_mark_stacks_.pop_back();
+  } else {
+    // None pooled. Create a new one.
+    mark_stack = accounting::ObjectStack::Create("thread local mark stack", 4 * KB, 4 * KB);
+  }
+  DCHECK(mark_stack != nullptr);
+  DCHECK(mark_stack->IsEmpty());
+  return mark_stack;
+}
+
+void ConcurrentCopying::ReturnMarkStackToPool(accounting::ObjectStack* mark_stack) {
+  if (pooled_mark_stacks_.size() >= kMarkStackPoolSize) {
+    // The pool has enough. Delete it.
+    delete mark_stack;
+  } else {
+    // Otherwise, put it into the pool for later reuse.
+    mark_stack->Reset();
+    pooled_mark_stacks_.push_back(mark_stack);
+  }
+}
+
 accounting::ObjectStack* ConcurrentCopying::GetAllocationStack() {
   return heap_->allocation_stack_.get();
 }
@@ -2088,6 +2144,11 @@ bool ConcurrentCopying::ProcessMarkStackOnce() {
   size_t count = 0;
   MarkStackMode mark_stack_mode = mark_stack_mode_.load(std::memory_order_relaxed);
   if (mark_stack_mode == kMarkStackModeThreadLocal) {
+    const size_t thread_count = GetParallelMarkThreadCount();
+    if (thread_count > 1u) {
+      // Let the heap thread pool help with the thread-local mark stacks and the GC mark stack.
+      return ProcessMarkStackParallel(self, thread_count) == 0u;
+    }
     // Process the thread-local mark stacks and the GC mark stack.
     count += ProcessThreadLocalMarkStacks(/* disable_weak_ref_access= */ false,
                                           /* checkpoint_callback= */ nullptr,
@@ -2184,14 +2245,7 @@ size_t ConcurrentCopying::ProcessThreadLocalMarkStacks(bool disable_weak_ref_acc
     }
     {
       MutexLock mu(thread_running_gc_, mark_stack_lock_);
-      if (pooled_mark_stacks_.size() >= kMarkStackPoolSize) {
-        // The pool has enough. Delete it.
-        delete mark_stack;
-      } else {
-        // Otherwise, put it into the pool for later reuse.
-        mark_stack->Reset();
-        pooled_mark_stacks_.push_back(mark_stack);
-      }
+      ReturnMarkStackToPool(mark_stack);
     }
   }
   if (disable_weak_ref_access) {
@@ -2202,7 +2256,233 @@ size_t ConcurrentCopying::ProcessThreadLocalMarkStacks(bool disable_weak_ref_acc
   return count;
 }
 
-inline void ConcurrentCopying::ProcessMarkStackRef(mirror::Object* to_ref) {
+size_t ConcurrentCopying::GetParallelMarkThreadCount() const {
+  // Like MarkSweep, use a single thread in a background state (non jank perceptible) to leave
+  // more CPU time for the foreground apps.
+  if (heap_->GetThreadPool() == nullptr || !Runtime::Current()->InJankPerceptibleProcessState()) {
+    return 1u;
+  }
+  return heap_->GetConcGCThreadCount() + 1u;
+}
+
+class ConcurrentCopying::ParallelMarkTask : public Task {
+ public:
+  ParallelMarkTask(ConcurrentCopying* collector, Atomic<size_t>* count)
+      : collector_(collector), count_(count) {}
+
+  // Heap thread pool workers run in the native state, like the MarkSweep tasks. The GC-running
+  // thread holds the mutator lock until all the tasks are done.
+  void Run(Thread* self) override NO_THREAD_SAFETY_ANALYSIS {
+    const bool is_worker = (self != collector_->thread_running_gc_);
+    if (is_worker) {
+      MutexLock mu(self, collector_->parallel_mark_threads_lock_);
+      collector_->parallel_mark_threads_.push_back(self);
+    }
+    const uint64_t start_time = NanoTime();
+    size_t count = collector_->DrainMarkStacks</*kParallel=*/true>(self);
+    const uint64_t time_ns = NanoTime() - start_time;
+    if (is_worker) {
+      {
+        // Our thread-local mark stack is empty, put it back into the pool.
+        MutexLock mu(self, collector_->mark_stack_lock_);
+        accounting::ObjectStack* tl_mark_stack = self->GetThreadLocalMarkStack();
+        if (tl_mark_stack != nullptr) {
+          DCHECK(tl_mark_stack->IsEmpty());
+          collector_->RemoveThreadMarkStackMapping(self, tl_mark_stack);
+          self->SetThreadLocalMarkStack(nullptr);
+          collector_->ReturnMarkStackToPool(tl_mark_stack);
+        }
+      }
+      MutexLock mu(self, collector_->parallel_mark_threads_lock_);
+      auto it = std::find(collector_->parallel_mark_threads_.begin(),
+                          collector_->parallel_mark_threads_.end(),
+                          self);
+      DCHECK(it != collector_->parallel_mark_threads_.end());
+      collector_->parallel_mark_threads_.erase(it);
+    }
+    count_->fetch_add(count, std::memory_order_relaxed);
+    MutexLock mu(self, collector_->mark_stack_lock_);
+    const pid_t tid = self->GetTid();
+    for (ParallelMarkStats& stats : collector_->parallel_mark_stats_) {
+      if (stats.tid == tid) {
+        stats.time_ns += time_ns;
+        stats.objects += count;
+        return;
+      }
+    }
+    collector_->parallel_mark_stats_.push_back({tid, time_ns, count});
+  }
+
+  void Finalize() override {
+    delete this;
+  }
+
+ private:
+  ConcurrentCopying* const collector_;
+  Atomic<size_t>* const count_;
+};
+
+size_t ConcurrentCopying::ProcessMarkStackParallel(Thread* const self, size_t thread_count) {
+  DCHECK_EQ(self, thread_running_gc_);
+  DCHECK_GT(thread_count, 1u);
+  // Collect the thread-local mark stacks up front to find out how much work there is.
+  RevokeThreadLocalMarkStacks(/* disable_weak_ref_access= */ false,
+                              /* checkpoint_callback= */ nullptr);
+  size_t pending = gc_mark_stack_->Size();
+  {
+    MutexLock mu(self, mark_stack_lock_);
+    for (accounting::ObjectStack* mark_stack : revoked_mark_stacks_) {
+      pending += mark_stack->Size();
+    }
+  }
+  size_t count;
+  if (pending < kMinParallelMarkStackSize) {
+    count = DrainMarkStacks</*kParallel=*/false>(self);
+  } else {
+    // Only the GC-running thread may access the GC mark stack. Hand out its entries as revoked
+    // mark stacks, which all the threads steal from once their own mark stack is empty.
+    ShareMarkStack(self, gc_mark_stack_, /* keep= */ 0u);
+    {
+      // Count all the threads as active from the start, so that none of them finds all the others
+      // out of work before they even started.
+      MutexLock mu(self, mark_stack_lock_);
+      parallel_mark_active_threads_ = thread_count;
+    }
+    Atomic<size_t> parallel_count(0u);
+    std::vector<Task*> tasks;
+    for (size_t i = 0; i < thread_count; ++i) {
+      tasks.push_back(new ParallelMarkTask(this, &parallel_count));
+    }
+    ThreadPool* thread_pool = heap_->GetThreadPool();
+    parallel_marking_.store(true, std::memory_order_relaxed);
+    thread_pool->AddTasks(self, tasks);
+    thread_pool->SetMaxActiveWorkers(thread_count - 1);
+    thread_pool->StartWorkers(self);
+    thread_pool->Wait(self, /* do_work= */ true, /* may_hold_locks= */ true);
+    thread_pool->StopWorkers(self);
+    parallel_marking_.store(false, std::memory_order_relaxed);
+    count = parallel_count.load(std::memory_order_relaxed);
+  }
+  gc_mark_stack_->Reset();
+  return count;
+}
+
+template <bool kParallel>
+size_t ConcurrentCopying::DrainMarkStacks(Thread* const self) {
+  const bool is_gc_thread = (self == thread_running_gc_);
+  DCHECK(kParallel || is_gc_thread);
+  // Parallel marking threads count into their own census tables, merged once they are done.
+  CensusTables parallel_census_tables;
+  CensusTables* const census_tables = kParallel ? &parallel_census_tables : &census_tables_;
+  size_t count = 0;
+  while (true) {
+    // Process our own mark stack first, sharing some of it with the threads out of work, see
+    // MaybeShareMarkStack. The other threads also share their thread-local mark stack when it
+    // fills up, see PushOntoMarkStack.
+    if (is_gc_thread) {
+      while (!gc_mark_stack_->IsEmpty()) {
+        if (kParallel) {
+          MaybeShareMarkStack(self, gc_mark_stack_);
+        }
+        ProcessMarkStackRef<kParallel>(gc_mark_stack_->PopBack(), census_tables);
+        ++count;
+      }
+    } else {
+      accounting::ObjectStack* tl_mark_stack;
+      while ((tl_mark_stack = self->GetThreadLocalMarkStack()) != nullptr &&
+             !tl_mark_stack->IsEmpty()) {
+        MaybeShareMarkStack(self, tl_mark_stack);
+        ProcessMarkStackRef<kParallel>(tl_mark_stack->PopBack(), census_tables);
+        ++count;
+      }
+    }
+    // Then steal a mark stack revoked from a mutator or spilled by another GC thread.
+    accounting::ObjectStack* mark_stack = nullptr;
+    {
+      MutexLock mu(self, mark_stack_lock_);
+      if (!revoked_mark_stacks_.empty()) {
+        mark_stack = revoked_mark_stacks_.back();
+        revoked_mark_stacks_.pop_back();
+      }
+    }
+    if (mark_stack == nullptr) {
+      if (kParallel && WaitForParallelMarkWork(self)) {
+        continue;
+      }
+      break;
+    }
+    while (!mark_stack->IsEmpty()) {
+      if (kParallel) {
+        MaybeShareMarkStack(self, mark_stack);
+      }
+      ProcessMarkStackRef<kParallel>(mark_stack->PopBack(), census_tables);
+      ++count;
+    }
+    MutexLock mu(self, mark_stack_lock_);
+    ReturnMarkStackToPool(mark_stack);
+  }
+  if (kParallel && !parallel_census_tables.IsEmpty()) {
+    MutexLock mu(self, mark_stack_lock_);
+    census_tables_.Merge(parallel_census_tables);
+  }
+  return count;
+}
+
+bool ConcurrentCopying::WaitForParallelMarkWork(Thread* const self) {
+  MutexLock mu(self, mark_stack_lock_);
+  DCHECK_NE(parallel_mark_active_threads_, 0u);
+  --parallel_mark_active_threads_;
+  while (revoked_mark_stacks_.empty()) {
+    // Busy threads may still share some work. Once they are all done, anything pushed by the
+    // mutators is left for the next ProcessMarkStackOnce().
+    if (parallel_mark_active_threads_ == 0u) {
+      parallel_mark_work_cond_.Broadcast(self);
+      return false;
+    }
+    parallel_mark_idle_threads_.fetch_add(1u, std::memory_order_relaxed);
+    // The GC-running thread holds the mutator lock.
+    parallel_mark_work_cond_.WaitHoldingLocks(self);
+    parallel_mark_idle_threads_.fetch_sub(1u, std::memory_order_relaxed);
+  }
+  ++parallel_mark_active_threads_;
+  return true;
+}
+
+inline void ConcurrentCopying::MaybeShareMarkStack(Thread* const self,
+                                                   accounting::ObjectStack* mark_stack) {
+  const size_t size = mark_stack->Size();
+  if (size > 2 * kMarkStackSize) {
+    // Only the GC mark stack grows this large, keep a thread-local mark stack worth of it.
+    ShareMarkStack(self, mark_stack, kMarkStackSize);
+  } else if (size >= 2 * kMinSharedMarkStackSize &&
+             parallel_mark_idle_threads_.load(std::memory_order_relaxed) != 0u) {
+    ShareMarkStack(self, mark_stack, size / 2);
+  }
+}
+
+void ConcurrentCopying::ShareMarkStack(Thread* const self,
+                                       accounting::ObjectStack* mark_stack,
+                                       size_t keep) {
+  MutexLock mu(self, mark_stack_lock_);
+  while (mark_stack->Size() > keep) {
+    accounting::ObjectStack* shared_mark_stack = GetPooledMarkStack();
+    while (mark_stack->Size() > keep && !shared_mark_stack->IsFull()) {
+      shared_mark_stack->PushBack(mark_stack->PopBack());
+    }
+    revoked_mark_stacks_.push_back(shared_mark_stack);
+    NotifyParallelMarkWork(self);
+  }
+}
+
+void ConcurrentCopying::NotifyParallelMarkWork(Thread* const self) {
+  if (parallel_mark_idle_threads_.load(std::memory_order_relaxed) != 0u) {
+    parallel_mark_work_cond_.Signal(self);
+  }
+}
+
+template <bool kParallel>
+inline void ConcurrentCopying::ProcessMarkStackRef(mirror::Object* to_ref,
+                                                   CensusTables* census_tables) {
   DCHECK(!region_space_->IsInFromSpace(to_ref));
   space::RegionSpace::RegionType rtype = region_space_->GetRegionType(to_ref);
   if (kUseBakerReadBarrier) {
@@ -2224,8 +2504,11 @@ inline void ConcurrentCopying::ProcessMarkStackRef(mirror::Object* to_ref) {
   bool perform_scan = false;
   switch (rtype) {
     case space::RegionSpace::RegionType::kRegionTypeUnevacFromSpace:
-      // Mark the bitmap only in the GC thread here so that we don't need a CAS.
-      if (!kUseBakerReadBarrier || !region_space_bitmap_->Set(to_ref)) {
+      // Mark the bitmap only in the GC threads here so that we don't need a CAS, unless there are
+      // several of them.
+      if (!kUseBakerReadBarrier ||
+          !(kParallel ? region_space_bitmap_->AtomicTestAndSet(to_ref)
+                      : region_space_bitmap_->Set(to_ref))) {
         // It may be already marked if we accidentally pushed the same object twice due to the racy
         // bitmap read in MarkUnevacFromSpaceRegion.
         if (use_generational_cc_ && young_gen_) {
@@ -2247,7 +2530,11 @@ inline void ConcurrentCopying::ProcessMarkStackRef(mirror::Object* to_ref) {
     case space::RegionSpace::RegionType::kRegionTypeToSpace:
       if (use_generational_cc_) {
         // Copied to to-space, set the bit so that the next GC can scan objects.
-        region_space_bitmap_->Set(to_ref);
+        if (kParallel) {
+          region_space_bitmap_->AtomicTestAndSet(to_ref);
+        } else {
+          region_space_bitmap_->Set(to_ref);
+        }
       }
       perform_scan = true;
       break;
@@ -2277,23 +2564,29 @@ inline void ConcurrentCopying::ProcessMarkStackRef(mirror::Object* to_ref) {
           accounting::LargeObjectBitmap* los_bitmap =
               heap_->GetLargeObjectsSpace()->GetMarkBitmap();
           DCHECK(los_bitmap->HasAddress(to_ref));
-          // Only the GC thread could be setting the LOS bit map hence doesn't
-          // need to be atomically done.
-          perform_scan = !los_bitmap->Set(to_ref);
+          // Only the GC threads could be setting the LOS bit map hence doesn't
+          // need to be atomically done when there is a single one.
+          perform_scan = kParallel ? !los_bitmap->AtomicTestAndSet(to_ref)
+                                   : !los_bitmap->Set(to_ref);
         } else {
-          // Only the GC thread could be setting the non-moving space bit map
-          // hence doesn't need to be atomically done.
-          perform_scan = !mark_bitmap->Set(to_ref);
+          // Only the GC threads could be setting the non-moving space bit map
+          // hence doesn't need to be atomically done when there is a single one.
+          perform_scan = kParallel ? !mark_bitmap->AtomicTestAndSet(to_ref)
+                                   : !mark_bitmap->Set(to_ref);
         }
       } else {
         perform_scan = true;
       }
   }
   if (perform_scan) {
+    Thread* const self = kParallel ? Thread::Current() : thread_running_gc_;
     if (use_generational_cc_ && young_gen_) {
-      Scan<true>(to_ref);
+      Scan<true>(self, to_ref);
     } else {
-      Scan<false>(to_ref);
+      Scan<false>(self, to_ref);
+    }
+    if (census_in_copying_phase_) {
+      (census_tables != nullptr ? census_tables : &census_tables_)->AddObject(heap_, to_ref);
     }
   }
   if (kUseBakerReadBarrier) {
@@ -2334,12 +2627,16 @@ inline void ConcurrentCopying::ProcessMarkStackRef(mirror::Object* to_ref) {
 #endif
 
   if (add_to_live_bytes) {
-    // Add to the live bytes per unevacuated from-space. Note this code is always run by the
-    // GC-running thread (no synchronization required).
+    // Add to the live bytes per unevacuated from-space. Note this code is only run by the GC
+    // threads (no synchronization required unless there are several of them).
     DCHECK(region_space_bitmap_->Test(to_ref));
     size_t obj_size = to_ref->SizeOf<kDefaultVerifyFlags>();
     size_t alloc_size = RoundUp(obj_size, space::RegionSpace::kAlignment);
-    region_space_->AddLiveBytes(to_ref, alloc_size);
+    if (kParallel) {
+      region_space_->AtomicAddLiveBytes(to_ref, alloc_size);
+    } else {
+      region_space_->AddLiveBytes(to_ref, alloc_size);
+    }
   }
   if (ReadBarrier::kEnableToSpaceInvariantChecks) {
     CHECK(to_ref != nullptr);
@@ -2691,6 +2988,20 @@ void ConcurrentCopying::ReclaimPhase() {
     CheckEmptyMarkStack();
   }
 
+  if (census_in_marking_phase_ || census_in_copying_phase_) {
+    // Publish before the from-space is cleared. IsMarked() forwards the classes, and the strings
+    // counted in the marking phase are read at their from-space address.
+    if (heap_->GetHeapCensus() != nullptr) {
+      TimingLogger::ScopedTiming split2("PublishHeapCensus", GetTimings());
+      heap_->GetHeapCensus()->Publish(census_tables_.classes, this, GetName());
+    }
+    if (heap_->GetStringDedupStats() != nullptr) {
+      TimingLogger::ScopedTiming split2("PublishStringDedupStats", GetTimings());
+      heap_->GetStringDedupStats()->Publish(census_tables_.strings, GetName());
+    }
+    census_tables_.Clear();
+  }
+
   // Capture RSS at the time when memory usage is at its peak. All GC related
   // memory ranges like java heap, card table, bitmap etc. are taken into
   // account.
@@ -3065,6 +3376,18 @@ bool ConcurrentCopying::IsMarkedInNonMovingSpace(mirror::Object* from_ref) {
   return IsOnAllocStack(from_ref);
 }
 
+bool ConcurrentCopying::IsGcThread(Thread* const self) const {
+  if (self == thread_running_gc_) {
+    return true;
+  }
+  if (!parallel_marking_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  MutexLock mu(self, parallel_mark_threads_lock_);
+  return std::find(parallel_mark_threads_.begin(), parallel_mark_threads_.end(), self) !=
+      parallel_mark_threads_.end();
+}
+
 void ConcurrentCopying::AssertToSpaceInvariantInNonMovingSpace(mirror::Object* obj,
                                                                mirror::Object* ref) {
   CHECK(ref != nullptr);
@@ -3074,7 +3397,7 @@ void ConcurrentCopying::AssertToSpaceInvariantInNonMovingSpace(mirror::Object* o
     // Immune space case.
     if (kUseBakerReadBarrier) {
       // Immune object may not be gray if called from the GC.
-      if (Thread::Current() == thread_running_gc_ && !gc_grays_immune_objects_) {
+      if (IsGcThread(Thread::Current()) && !gc_grays_immune_objects_) {
         return;
       }
       bool updated_all_immune_objects = updated_all_immune_objects_.load(std::memory_order_seq_cst);
@@ -3115,7 +3438,7 @@ class ConcurrentCopying::RefFieldsVisitor {
   void operator()(mirror::Object* obj, MemberOffset offset, bool /* is_static */)
       const ALWAYS_INLINE REQUIRES_SHARED(Locks::mutator_lock_)
       REQUIRES_SHARED(Locks::heap_bitmap_lock_) {
-    collector_->Process<kNoUnEvac>(obj, offset);
+    collector_->Process<kNoUnEvac>(thread_, obj, offset);
   }
 
   void operator()(ObjPtr<mirror::Class> klass, ObjPtr<mirror::Reference> ref) const
@@ -3144,35 +3467,38 @@ class ConcurrentCopying::RefFieldsVisitor {
 };
 
 template <bool kNoUnEvac>
-inline void ConcurrentCopying::Scan(mirror::Object* to_ref) {
+inline void ConcurrentCopying::Scan(Thread* const self, mirror::Object* to_ref) {
   // Cannot have `kNoUnEvac` when Generational CC collection is disabled.
   DCHECK(!kNoUnEvac || use_generational_cc_);
   if (kDisallowReadBarrierDuringScan && !Runtime::Current()->IsActiveTransaction()) {
     // Avoid all read barriers during visit references to help performance.
     // Don't do this in transaction mode because we may read the old value of an field which may
     // trigger read barriers.
-    Thread::Current()->ModifyDebugDisallowReadBarrier(1);
+    self->ModifyDebugDisallowReadBarrier(1);
   }
   DCHECK(!region_space_->IsInFromSpace(to_ref));
-  DCHECK_EQ(Thread::Current(), thread_running_gc_);
-  RefFieldsVisitor<kNoUnEvac> visitor(this, thread_running_gc_);
+  DCHECK_EQ(Thread::Current(), self);
+  DCHECK(IsGcThread(self));
+  RefFieldsVisitor<kNoUnEvac> visitor(this, self);
   // Disable the read barrier for a performance reason.
   to_ref->VisitReferences</*kVisitNativeRoots=*/true, kDefaultVerifyFlags, kWithoutReadBarrier>(
       visitor, visitor);
   if (kDisallowReadBarrierDuringScan && !Runtime::Current()->IsActiveTransaction()) {
-    thread_running_gc_->ModifyDebugDisallowReadBarrier(-1);
+    self->ModifyDebugDisallowReadBarrier(-1);
   }
 }
 
 template <bool kNoUnEvac>
-inline void ConcurrentCopying::Process(mirror::Object* obj, MemberOffset offset) {
+inline void ConcurrentCopying::Process(Thread* const self,
+                                       mirror::Object* obj,
+                                       MemberOffset offset) {
   // Cannot have `kNoUnEvac` when Generational CC collection is disabled.
   DCHECK(!kNoUnEvac || use_generational_cc_);
-  DCHECK_EQ(Thread::Current(), thread_running_gc_);
+  DCHECK_EQ(Thread::Current(), self);
   mirror::Object* ref = obj->GetFieldObject<
       mirror::Object, kVerifyNone, kWithoutReadBarrier, false>(offset);
   mirror::Object* to_ref = Mark</*kGrayImmuneObject=*/false, kNoUnEvac, /*kFromGCThread=*/true>(
-      thread_running_gc_,
+      self,
       ref,
       /*holder=*/ obj,
       offset);
@@ -3705,6 +4031,17 @@ void ConcurrentCopying::FinishPhase() {
     CHECK(revoked_mark_stacks_.empty());
     AssertEmptyThreadMarkStackMap();
     CHECK_EQ(pooled_mark_stacks_.size(), kMarkStackPoolSize);
+    if (!parallel_mark_stats_.empty()) {
+      std::ostringstream oss;
+      for (const ParallelMarkStats& stats : parallel_mark_stats_) {
+        oss << " tid=" << stats.tid << " " << PrettyDuration(stats.time_ns) << " "
+            << stats.objects << " objects";
+        parallel_mark_time_ns_total_ += stats.time_ns;
+        parallel_mark_objects_total_ += stats.objects;
+      }
+      VLOG(gc) << "Parallel marking threads:" << oss.str();
+      parallel_mark_stats_.clear();
+    }
   }
   // kVerifyNoMissingCardMarks relies on the region space cards not being cleared to avoid false
   // positives.
@@ -3843,6 +4180,13 @@ void ConcurrentCopying::DumpPerformanceInfo(std::ostream& os) {
   if (rb_slow_path_count_gc_total_ > 0) {
     os << "GC slow path count " << rb_slow_path_count_gc_total_ << "\n";
   }
+  {
+    MutexLock mu2(Thread::Current(), mark_stack_lock_);
+    if (parallel_mark_objects_total_ > 0) {
+      os << "Parallel marking time " << PrettyDuration(parallel_mark_time_ns_total_)
+         << " for " << parallel_mark_objects_total_ << " objects\n";
+    }
+  }
 
   os << "Average " << (young_gen_ ? "minor" : "major") << " GC reclaim bytes ratio "
      << (reclaimed_bytes_ratio_sum_ / num_gc_cycles) << " over " << num_gc_cycles
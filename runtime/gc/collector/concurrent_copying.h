@@ -19,6 +19,8 @@
 
 #include "garbage_collector.h"
 #include "gc/accounting/space_bitmap.h"
+#include "gc/heap_census.h"
+#include "gc/string_dedup_stats.h"
 #include "immune_spaces.h"
 #include "offsets.h"
 
@@ -158,6 +160,27 @@ class ConcurrentCopying : public GarbageCollector {
   void AssertNoThreadMarkStackMapping(Thread* thread) REQUIRES(!mark_stack_lock_);
 
  private:
+  // The heap census and string dedup stats counts of a marking thread. Not thread safe.
+  struct CensusTables {
+    // Count `obj` in the tables of the enabled statistics.
+    ALWAYS_INLINE void AddObject(Heap* heap, mirror::Object* obj)
+        REQUIRES_SHARED(Locks::mutator_lock_);
+    void Merge(const CensusTables& other) {
+      classes.Merge(other.classes);
+      strings.Merge(other.strings);
+    }
+    bool IsEmpty() const {
+      return classes.IsEmpty() && strings.IsEmpty();
+    }
+    void Clear() {
+      classes.Clear();
+      strings.Clear();
+    }
+
+    HeapCensus::Table classes;
+    StringDedupStats::Table strings;
+  };
+
   void PushOntoMarkStack(Thread* const self, mirror::Object* obj)
       REQUIRES_SHARED(Locks::mutator_lock_)
       REQUIRES(!mark_stack_lock_);
@@ -169,7 +192,7 @@ class ConcurrentCopying : public GarbageCollector {
       REQUIRES(!mark_stack_lock_, !skipped_blocks_lock_, !immune_gray_stack_lock_);
   // Scan the reference fields of object `to_ref`.
   template <bool kNoUnEvac>
-  void Scan(mirror::Object* to_ref) REQUIRES_SHARED(Locks::mutator_lock_)
+  void Scan(Thread* const self, mirror::Object* to_ref) REQUIRES_SHARED(Locks::mutator_lock_)
       REQUIRES(!mark_stack_lock_);
   // Scan the reference fields of object 'obj' in the dirty cards during
   // card-table scan. In addition to visiting the references, it also sets the
@@ -180,7 +203,7 @@ class ConcurrentCopying : public GarbageCollector {
       REQUIRES(!mark_stack_lock_);
   // Process a field.
   template <bool kNoUnEvac>
-  void Process(mirror::Object* obj, MemberOffset offset)
+  void Process(Thread* const self, mirror::Object* obj, MemberOffset offset)
       REQUIRES_SHARED(Locks::mutator_lock_)
       REQUIRES(!mark_stack_lock_ , !skipped_blocks_lock_, !immune_gray_stack_lock_);
   void VisitRoots(mirror::Object*** roots, size_t count, const RootInfo& info) override
@@ -201,8 +224,41 @@ class ConcurrentCopying : public GarbageCollector {
   void ProcessMarkStack() override REQUIRES_SHARED(Locks::mutator_lock_)
       REQUIRES(!mark_stack_lock_);
   bool ProcessMarkStackOnce() REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!mark_stack_lock_);
-  void ProcessMarkStackRef(mirror::Object* to_ref) REQUIRES_SHARED(Locks::mutator_lock_)
+  // Process a popped mark stack entry. `kParallel` is true when other GC threads may be
+  // processing entries at the same time, in which case the mark bitmaps and live bytes are
+  // updated atomically. With the heap census or the string dedup stats, the scanned object is
+  // counted in `census_tables`, or in census_tables_ when it is null.
+  template <bool kParallel = false>
+  void ProcessMarkStackRef(mirror::Object* to_ref, CensusTables* census_tables = nullptr)
+      REQUIRES_SHARED(Locks::mutator_lock_)
       REQUIRES(!mark_stack_lock_);
+  // Number of threads, including the GC-running thread, used to process the mark stacks in the
+  // thread-local mark stack mode.
+  size_t GetParallelMarkThreadCount() const;
+  // Process the thread-local mark stacks and the GC mark stack with `thread_count` threads of
+  // the heap thread pool. Returns the number of processed entries.
+  size_t ProcessMarkStackParallel(Thread* const self, size_t thread_count)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!mark_stack_lock_);
+  // Drain the mark stack of `self` and the revoked mark stacks until both are empty. Run by every
+  // thread taking part in parallel marking. Returns the number of processed entries.
+  template <bool kParallel>
+  size_t DrainMarkStacks(Thread* const self)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!mark_stack_lock_);
+  // Called by a parallel marking thread that ran out of work. Blocks until there are revoked mark
+  // stacks to steal and returns true, or returns false once all the threads ran out of work.
+  bool WaitForParallelMarkWork(Thread* const self) REQUIRES(!mark_stack_lock_);
+  // Share half of `mark_stack`, the mark stack a parallel marking thread processes, if other
+  // threads are waiting for work, or most of it if it grew larger than a thread-local mark stack.
+  void MaybeShareMarkStack(Thread* const self, accounting::ObjectStack* mark_stack)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!mark_stack_lock_);
+  // Move all but `keep` entries of `mark_stack` to revoked mark stacks so that other threads can
+  // steal them.
+  void ShareMarkStack(Thread* const self, accounting::ObjectStack* mark_stack, size_t keep)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!mark_stack_lock_);
+  // Wake up a parallel marking thread waiting for work, after a mark stack was revoked.
+  void NotifyParallelMarkWork(Thread* const self) REQUIRES(mark_stack_lock_);
+  accounting::ObjectStack* GetPooledMarkStack() REQUIRES(mark_stack_lock_);
+  void ReturnMarkStackToPool(accounting::ObjectStack* mark_stack) REQUIRES(mark_stack_lock_);
   void GrayAllDirtyImmuneObjects()
       REQUIRES(Locks::mutator_lock_)
       REQUIRES(!mark_stack_lock_);
@@ -285,7 +341,10 @@ class ConcurrentCopying : public GarbageCollector {
   // Dump information about GC root `ref` and return it as a string.
   std::string DumpGcRoot(mirror::Object* ref) REQUIRES_SHARED(Locks::mutator_lock_);
   void AssertToSpaceInvariantInNonMovingSpace(mirror::Object* obj, mirror::Object* ref)
-      REQUIRES_SHARED(Locks::mutator_lock_);
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!parallel_mark_threads_lock_);
+  // Returns true for the GC-running thread, and for the heap thread pool workers while they
+  // process the mark stacks on its behalf.
+  bool IsGcThread(Thread* const self) const REQUIRES(!parallel_mark_threads_lock_);
   void ReenableWeakRefAccess(Thread* self) REQUIRES_SHARED(Locks::mutator_lock_);
   void DisableMarking() REQUIRES_SHARED(Locks::mutator_lock_);
   void IssueDisableMarkingCheckpoint() REQUIRES_SHARED(Locks::mutator_lock_);
@@ -304,7 +363,8 @@ class ConcurrentCopying : public GarbageCollector {
   template<bool kGrayImmuneObject>
   ALWAYS_INLINE mirror::Object* MarkImmuneSpace(Thread* const self,
                                                 mirror::Object* from_ref)
-      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!immune_gray_stack_lock_);
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(!immune_gray_stack_lock_, !parallel_mark_threads_lock_);
   void ScanImmuneObject(mirror::Object* obj)
       REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!mark_stack_lock_);
   mirror::Object* MarkFromReadBarrierWithMeasurements(Thread* const self,
@@ -374,6 +434,28 @@ class ConcurrentCopying : public GarbageCollector {
   // TODO(lokeshgidra b/140119552): remove this after bug fix.
   std::unordered_map<Thread*, accounting::ObjectStack*> thread_mark_stack_map_
       GUARDED_BY(mark_stack_lock_);
+  // True while heap thread pool workers process the mark stacks along with the GC-running thread.
+  Atomic<bool> parallel_marking_;
+  // The heap thread pool workers taking part in parallel marking, see IsGcThread. A bottom lock
+  // since the to-space invariant checks may run with any lock held.
+  mutable Mutex parallel_mark_threads_lock_ BOTTOM_MUTEX_ACQUIRED_AFTER;
+  std::vector<Thread*> parallel_mark_threads_ GUARDED_BY(parallel_mark_threads_lock_);
+  // Number of parallel marking threads that have not run out of work.
+  size_t parallel_mark_active_threads_ GUARDED_BY(mark_stack_lock_);
+  // Number of parallel marking threads waiting for work. Updated with mark_stack_lock_ held, and
+  // read without it by the busy threads to decide to share their work.
+  Atomic<size_t> parallel_mark_idle_threads_;
+  ConditionVariable parallel_mark_work_cond_ GUARDED_BY(mark_stack_lock_);
+  // Time spent and mark stack entries processed by each thread taking part in parallel marking
+  // during the current cycle. Logged and folded into the totals in FinishPhase.
+  struct ParallelMarkStats {
+    pid_t tid;
+    uint64_t time_ns;
+    uint64_t objects;
+  };
+  std::vector<ParallelMarkStats> parallel_mark_stats_ GUARDED_BY(mark_stack_lock_);
+  uint64_t parallel_mark_time_ns_total_ GUARDED_BY(mark_stack_lock_);
+  uint64_t parallel_mark_objects_total_ GUARDED_BY(mark_stack_lock_);
   Thread* thread_running_gc_;
   bool is_marking_;                       // True while marking is ongoing.
   // True while we might dispatch on the read barrier entrypoints.
@@ -459,6 +541,13 @@ class ConcurrentCopying : public GarbageCollector {
 
   accounting::ReadBarrierTable* rb_table_;
   bool force_evacuate_all_;  // True if all regions are evacuated.
+  // Heap census and string dedup stats of a full GC. The marking phase of the 2-phase full GC
+  // visits every live object once, and takes the census if there is one. Otherwise the copying
+  // phase takes it, counting the objects the first time they are scanned. The census tables of
+  // the parallel marking threads are merged into census_tables_ under mark_stack_lock_.
+  bool census_in_marking_phase_;
+  bool census_in_copying_phase_;
+  CensusTables census_tables_;
   Atomic<bool> updated_all_immune_objects_;
   bool gc_grays_immune_objects_;
   Mutex immune_gray_stack_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
@@ -490,6 +579,7 @@ class ConcurrentCopying : public GarbageCollector {
   template <bool kConcurrent> class GrayImmuneObjectVisitor;
   class ImmuneSpaceScanObjVisitor;
   class LostCopyVisitor;
+  class ParallelMarkTask;
   template <bool kNoUnEvac> class RefFieldsVisitor;
   class RevokeThreadLocalMarkStackCheckpoint;
   class ScopedGcGraysImmuneObjects;
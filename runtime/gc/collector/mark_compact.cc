@@ -0,0 +1,549 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mark_compact.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "base/bit_utils.h"
+#include "base/mutex-inl.h"
+#include "base/systrace.h"
+#include "base/timing_logger.h"
+#include "class_linker.h"
+#include "gc/accounting/atomic_stack.h"
+#include "gc/accounting/card_table.h"
+#include "gc/accounting/heap_bitmap-inl.h"
+#include "gc/accounting/mod_union_table.h"
+#include "gc/accounting/space_bitmap-inl.h"
+#include "gc/heap.h"
+#include "gc/reference_processor.h"
+#include "gc/space/bump_pointer_space-walk-inl.h"
+#include "gc/space/large_object_space.h"
+#include "gc/space/space-inl.h"
+#include "mirror/object-inl.h"
+#include "mirror/object-refvisitor-inl.h"
+#include "mirror/reference.h"
+#include "runtime.h"
+#include "thread-current-inl.h"
+
+namespace art {
+namespace gc {
+namespace collector {
+
+static constexpr size_t kBitsPerWord = kBitsPerIntPtrT;
+static constexpr size_t kAlignment = space::BumpPointerSpace::kAlignment;
+
+MarkCompact::MarkCompact(Heap* heap)
+    : MarkSweep(heap, "concurrent mark compact", /*is_concurrent=*/ true),
+      space_(nullptr),
+      live_words_(nullptr),
+      chunk_info_(nullptr),
+      black_allocations_begin_(nullptr),
+      remark_end_(nullptr),
+      moved_end_(nullptr),
+      compacted_end_(nullptr),
+      forwarded_chunks_(0u),
+      live_bytes_before_(0u),
+      objects_moved_(0u),
+      bytes_moved_(0u) {}
+
+void MarkCompact::SetSpace(space::BumpPointerSpace* space) {
+  DCHECK(space != nullptr);
+  DCHECK(space->GetMarkBitmap() != nullptr);
+  // The chunk info holds offsets in the space as 32-bit values.
+  CHECK_LE(space->NonGrowthLimitCapacity(), std::numeric_limits<uint32_t>::max())
+      << "Space too large for the mark-compact collector: " << *space;
+  space_ = space;
+  const size_t num_chunks = RoundUp(space->NonGrowthLimitCapacity(), kChunkSize) / kChunkSize;
+  std::string error_msg;
+  live_words_map_ = MemMap::MapAnonymous("mark compact live words",
+                                         RoundUp(num_chunks * sizeof(uintptr_t), kPageSize),
+                                         PROT_READ | PROT_WRITE,
+                                         /*low_4gb=*/ false,
+                                         &error_msg);
+  CHECK(live_words_map_.IsValid()) << "Couldn't allocate live words bitmap: " << error_msg;
+  live_words_ = reinterpret_cast<uintptr_t*>(live_words_map_.Begin());
+  chunk_info_map_ = MemMap::MapAnonymous("mark compact chunk info",
+                                         RoundUp(num_chunks * sizeof(uint32_t), kPageSize),
+                                         PROT_READ | PROT_WRITE,
+                                         /*low_4gb=*/ false,
+                                         &error_msg);
+  CHECK(chunk_info_map_.IsValid()) << "Couldn't allocate chunk info: " << error_msg;
+  chunk_info_ = reinterpret_cast<uint32_t*>(chunk_info_map_.Begin());
+}
+
+void MarkCompact::RunPhases() {
+  Thread* self = Thread::Current();
+  InitializePhase();
+  Locks::mutator_lock_->AssertNotHeld(self);
+  GetHeap()->PreGcVerification(this);
+  {
+    ReaderMutexLock mu(self, *Locks::mutator_lock_);
+    // The objects allocated past the current end of the space are kept, see MarkBlackAllocations.
+    black_allocations_begin_ = space_->End();
+    MarkingPhase();
+  }
+  {
+    ScopedPause pause(this);
+    GetHeap()->PrePauseRosAllocVerification(this);
+    RemarkPhase();
+  }
+  {
+    ReaderMutexLock mu(self, *Locks::mutator_lock_);
+    ForwardingPhase();
+  }
+  {
+    ScopedPause pause(this);
+    CompactionPhase();
+  }
+  {
+    ReaderMutexLock mu(self, *Locks::mutator_lock_);
+    SweepPhase();
+  }
+  GetHeap()->PostGcVerification(this);
+  FinishPhase();
+}
+
+void MarkCompact::RemarkPhase() {
+  TimingLogger::ScopedTiming t("(Paused)RemarkPhase", GetTimings());
+  Thread* self = Thread::Current();
+  Locks::mutator_lock_->AssertExclusiveHeld(self);
+  {
+    WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    MarkBlackAllocations();
+  }
+  // Finish marking like the mark sweep pause. ReMarkRoots visits the stacks of all threads again,
+  // which covers the objects allocated during the concurrent marking in TLABs handed out before
+  // it. This also blocks new system weaks and the referents until the compaction pause.
+  PausePhase();
+  // The objects allocated from now on go to new TLABs past this end. They can only be referenced
+  // by marked objects and by each other, and are all kept, see CompactionPhase.
+  RevokeAllThreadLocalBuffers();
+  remark_end_ = space_->End();
+}
+
+void MarkCompact::ForwardingPhase() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  Thread* self = Thread::Current();
+  // The referents may move, process the references before computing where.
+  ProcessReferences(self);
+  WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
+  if (census_enabled_) {
+    // Classes stay in the non-moving space with this collector, see Heap::CanMoveClasses(), so the
+    // census keys are not affected by the compaction. The marking is complete, publish it now.
+    PublishCensus();
+  }
+  // The marking is final and the mutators do not resize objects, the forwarding addresses of the
+  // marked objects do not change until the compaction.
+  objects_moved_ = 0u;
+  bytes_moved_ = 0u;
+  forwarded_chunks_ = 0u;
+  live_bytes_before_ = 0u;
+  ComputeForwardingAddresses(space_->Begin(), remark_end_, /*last=*/ false);
+}
+
+void MarkCompact::CompactionPhase() {
+  TimingLogger::ScopedTiming t("(Paused)CompactionPhase", GetTimings());
+  Thread* self = Thread::Current();
+  Locks::mutator_lock_->AssertExclusiveHeld(self);
+  // The TLABs must be revoked for the allocation counts of the space to be exact.
+  RevokeAllThreadLocalBuffers();
+  WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
+  moved_end_ = space_->End();
+  MarkNewAllocations();
+  ComputeForwardingAddresses(remark_end_, moved_end_, /*last=*/ true);
+  remark_end_ = nullptr;
+  // Updating the references and moving the objects stays in the pause: without read barriers the
+  // mutators cannot tell an old address from a new one.
+  UpdateReferences();
+  MoveObjects();
+}
+
+void MarkCompact::MarkBlackAllocations() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  DCHECK(black_allocations_begin_ != nullptr);
+  // A new object may only be referenced by other new objects, which the concurrent marking did not
+  // scan, so all of them are kept and their references marked.
+  space_->WalkFrom(black_allocations_begin_,
+                   [this](mirror::Object* obj) REQUIRES(Locks::heap_bitmap_lock_)
+                       REQUIRES(!mark_stack_lock_) REQUIRES_SHARED(Locks::mutator_lock_) {
+                     MarkObjectNonNull(obj);
+                   });
+  black_allocations_begin_ = nullptr;
+}
+
+void MarkCompact::MarkNewAllocations() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  DCHECK(remark_end_ != nullptr);
+  // Everything these objects reference is marked or new, they do not need to be traced.
+  accounting::ContinuousSpaceBitmap* mark_bitmap = space_->GetMarkBitmap();
+  space_->WalkFrom(remark_end_,
+                   [mark_bitmap](mirror::Object* obj) REQUIRES(Locks::heap_bitmap_lock_) {
+                     mark_bitmap->Set(obj);
+                   });
+}
+
+void MarkCompact::SetLiveWords(uintptr_t begin, size_t size) {
+  DCHECK_ALIGNED(size, kAlignment);
+  size_t bit = (begin - reinterpret_cast<uintptr_t>(space_->Begin())) / kAlignment;
+  const size_t end_bit = bit + size / kAlignment;
+  while (bit < end_bit) {
+    const size_t word = bit / kBitsPerWord;
+    const size_t shift = bit % kBitsPerWord;
+    const size_t count = std::min(end_bit - bit, kBitsPerWord - shift);
+    const uintptr_t mask = (count == kBitsPerWord)
+        ? ~static_cast<uintptr_t>(0)
+        : ((static_cast<uintptr_t>(1) << count) - 1) << shift;
+    live_words_[word] |= mask;
+    chunk_info_[word] += count * kAlignment;
+    bit += count;
+  }
+}
+
+mirror::Object* MarkCompact::GetForwardingAddress(mirror::Object* obj) const {
+  const size_t bit =
+      (reinterpret_cast<uintptr_t>(obj) - reinterpret_cast<uintptr_t>(space_->Begin())) /
+      kAlignment;
+  const size_t word = bit / kBitsPerWord;
+  const uintptr_t bit_mask = static_cast<uintptr_t>(1) << (bit % kBitsPerWord);
+  DCHECK_NE(live_words_[word] & bit_mask, 0u) << obj;
+  const size_t offset =
+      chunk_info_[word] + POPCOUNT(live_words_[word] & (bit_mask - 1)) * kAlignment;
+  return reinterpret_cast<mirror::Object*>(space_->Begin() + offset);
+}
+
+mirror::Object* MarkCompact::ForwardIfMoving(mirror::Object* obj) const {
+  if (obj != nullptr && space_->Contains(obj)) {
+    DCHECK(space_->GetMarkBitmap()->Test(obj)) << obj;
+    return GetForwardingAddress(obj);
+  }
+  return obj;
+}
+
+mirror::Object* MarkCompact::ForwardIfMarked(mirror::Object* obj) const {
+  uint8_t* const addr = reinterpret_cast<uint8_t*>(obj);
+  if (addr >= space_->Begin() && addr < moved_end_) {
+    return space_->GetMarkBitmap()->Test(obj) ? GetForwardingAddress(obj) : nullptr;
+  }
+  return obj;
+}
+
+void MarkCompact::ComputeForwardingAddresses(uint8_t* begin, uint8_t* end, bool last) {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  space_->GetMarkBitmap()->VisitMarkedRange(
+      reinterpret_cast<uintptr_t>(begin),
+      reinterpret_cast<uintptr_t>(end),
+      [this](mirror::Object* obj) REQUIRES_SHARED(Locks::mutator_lock_) {
+        const size_t size = RoundUp(obj->SizeOf(), kAlignment);
+        SetLiveWords(reinterpret_cast<uintptr_t>(obj), size);
+        ++objects_moved_;
+        bytes_moved_ += size;
+      });
+  // Replace the live bytes of each chunk with the live bytes before it. Unless this is the last
+  // range, the chunk `end` is in may still get live words from the next one.
+  const size_t end_offset = end - space_->Begin();
+  const size_t num_chunks =
+      (last ? RoundUp(end_offset, kChunkSize) : RoundDown(end_offset, kChunkSize)) / kChunkSize;
+  for (; forwarded_chunks_ < num_chunks; ++forwarded_chunks_) {
+    const uint32_t live_bytes = chunk_info_[forwarded_chunks_];
+    chunk_info_[forwarded_chunks_] = live_bytes_before_;
+    live_bytes_before_ += live_bytes;
+  }
+  if (last) {
+    DCHECK_EQ(live_bytes_before_, bytes_moved_);
+    compacted_end_ = space_->Begin() + bytes_moved_;
+  }
+}
+
+// Updates roots, system weaks and mod-union table references to the new addresses.
+class MarkCompact::UpdateReferenceVisitor final
+    : public RootVisitor, public IsMarkedVisitor, public MarkObjectVisitor {
+ public:
+  explicit UpdateReferenceVisitor(MarkCompact* collector) : collector_(collector) {}
+
+  void VisitRoots(mirror::Object*** roots, size_t count, const RootInfo& info ATTRIBUTE_UNUSED)
+      override REQUIRES_SHARED(Locks::mutator_lock_, Locks::heap_bitmap_lock_) {
+    for (size_t i = 0; i < count; ++i) {
+      *roots[i] = collector_->ForwardIfMoving(*roots[i]);
+    }
+  }
+
+  void VisitRoots(mirror::CompressedReference<mirror::Object>** roots,
+                  size_t count,
+                  const RootInfo& info ATTRIBUTE_UNUSED)
+      override REQUIRES_SHARED(Locks::mutator_lock_, Locks::heap_bitmap_lock_) {
+    for (size_t i = 0; i < count; ++i) {
+      roots[i]->Assign(collector_->ForwardIfMoving(roots[i]->AsMirrorPtr()));
+    }
+  }
+
+  mirror::Object* IsMarked(mirror::Object* obj)
+      override REQUIRES_SHARED(Locks::mutator_lock_, Locks::heap_bitmap_lock_) {
+    if (collector_->space_->Contains(obj)) {
+      return collector_->space_->GetMarkBitmap()->Test(obj)
+          ? collector_->GetForwardingAddress(obj)
+          : nullptr;
+    }
+    return collector_->MarkSweep::IsMarked(obj);
+  }
+
+  mirror::Object* MarkObject(mirror::Object* obj)
+      override REQUIRES_SHARED(Locks::mutator_lock_, Locks::heap_bitmap_lock_) {
+    return collector_->ForwardIfMoving(obj);
+  }
+
+  void MarkHeapReference(mirror::HeapReference<mirror::Object>* ref,
+                         bool do_atomic_update ATTRIBUTE_UNUSED)
+      override REQUIRES_SHARED(Locks::mutator_lock_, Locks::heap_bitmap_lock_) {
+    mirror::Object* obj = ref->AsMirrorPtr();
+    mirror::Object* new_obj = collector_->ForwardIfMoving(obj);
+    if (new_obj != obj) {
+      ref->Assign(new_obj);
+    }
+  }
+
+ private:
+  MarkCompact* const collector_;
+};
+
+// Updates the reference fields and the native roots of an object. The objects that die in this
+// collection only have their fields updated, references to dead moving objects are cleared.
+class MarkCompact::UpdateObjectReferencesVisitor {
+ public:
+  UpdateObjectReferencesVisitor(MarkCompact* collector, bool dead_objects)
+      : collector_(collector), dead_objects_(dead_objects) {}
+
+  void operator()(mirror::Object* obj) const
+      REQUIRES_SHARED(Locks::mutator_lock_, Locks::heap_bitmap_lock_) {
+    if (dead_objects_) {
+      obj->VisitReferences</*kVisitNativeRoots=*/ false, kVerifyNone, kWithoutReadBarrier>(
+          *this, *this);
+    } else {
+      obj->VisitReferences</*kVisitNativeRoots=*/ true, kVerifyNone, kWithoutReadBarrier>(
+          *this, *this);
+    }
+  }
+
+  void operator()(mirror::Object* obj, MemberOffset offset, bool is_static ATTRIBUTE_UNUSED) const
+      REQUIRES_SHARED(Locks::mutator_lock_, Locks::heap_bitmap_lock_) {
+    Update(obj->GetFieldObjectReferenceAddr<kVerifyNone>(offset));
+  }
+
+  void operator()(ObjPtr<mirror::Class> klass ATTRIBUTE_UNUSED,
+                  ObjPtr<mirror::Reference> ref) const
+      REQUIRES_SHARED(Locks::mutator_lock_, Locks::heap_bitmap_lock_) {
+    Update(ref->GetReferentReferenceAddr());
+  }
+
+  // TODO: Remove NO_THREAD_SAFETY_ANALYSIS when clang better understands visitors.
+  void VisitRootIfNonNull(mirror::CompressedReference<mirror::Object>* root) const
+      NO_THREAD_SAFETY_ANALYSIS {
+    if (!root->IsNull()) {
+      VisitRoot(root);
+    }
+  }
+
+  void VisitRoot(mirror::CompressedReference<mirror::Object>* root) const
+      NO_THREAD_SAFETY_ANALYSIS {
+    mirror::Object* obj = root->AsMirrorPtr();
+    mirror::Object* new_obj = collector_->ForwardIfMoving(obj);
+    if (new_obj != obj) {
+      root->Assign(new_obj);
+    }
+  }
+
+ private:
+  void Update(mirror::HeapReference<mirror::Object>* ref) const
+      REQUIRES_SHARED(Locks::mutator_lock_, Locks::heap_bitmap_lock_) {
+    mirror::Object* obj = ref->AsMirrorPtr();
+    mirror::Object* new_obj =
+        dead_objects_ ? collector_->ForwardIfMarked(obj) : collector_->ForwardIfMoving(obj);
+    if (new_obj != obj) {
+      ref->Assign(new_obj);
+    }
+  }
+
+  MarkCompact* const collector_;
+  const bool dead_objects_;
+};
+
+void MarkCompact::UpdateReferences() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  Runtime* const runtime = Runtime::Current();
+  UpdateReferenceVisitor visitor(this);
+  {
+    TimingLogger::ScopedTiming t2("UpdateRoots", GetTimings());
+    runtime->VisitRoots(&visitor);
+  }
+  UpdateObjectReferencesVisitor object_visitor(this, /*dead_objects=*/ false);
+  // Only the mod-union tables process their cards, the other cards are not needed anymore.
+  heap_->ProcessCards(GetTimings(),
+                      /*use_rem_sets=*/ false,
+                      /*process_alloc_space_cards=*/ false,
+                      /*clear_alloc_space_cards=*/ false);
+  for (space::ContinuousSpace* space : immune_spaces_.GetSpaces()) {
+    TimingLogger::ScopedTiming t2("UpdateImmuneSpaceReferences", GetTimings());
+    accounting::ModUnionTable* table = heap_->FindModUnionTableFromSpace(space);
+    if (table != nullptr) {
+      table->UpdateAndMarkReferences(&visitor);
+    } else {
+      // No mod-union table, visit all the live objects. This can only occur for app images.
+      space->GetLiveBitmap()->VisitMarkedRange(reinterpret_cast<uintptr_t>(space->Begin()),
+                                               reinterpret_cast<uintptr_t>(space->End()),
+                                               object_visitor);
+    }
+  }
+  for (space::ContinuousSpace* space : heap_->GetContinuousSpaces()) {
+    accounting::ContinuousSpaceBitmap* mark_bitmap = space->GetMarkBitmap();
+    if (immune_spaces_.ContainsSpace(space) || mark_bitmap == nullptr) {
+      continue;
+    }
+    TimingLogger::ScopedTiming t2("UpdateSpaceReferences", GetTimings());
+    mark_bitmap->VisitMarkedRange(reinterpret_cast<uintptr_t>(space->Begin()),
+                                  reinterpret_cast<uintptr_t>(space->End()),
+                                  object_visitor);
+  }
+  space::LargeObjectSpace* los = heap_->GetLargeObjectsSpace();
+  if (los != nullptr) {
+    TimingLogger::ScopedTiming t2("UpdateLargeObjectReferences", GetTimings());
+    std::pair<uint8_t*, uint8_t*> range = los->GetBeginEndAtomic();
+    los->GetMarkBitmap()->VisitMarkedRange(reinterpret_cast<uintptr_t>(range.first),
+                                           reinterpret_cast<uintptr_t>(range.second),
+                                           object_visitor);
+  }
+  {
+    TimingLogger::ScopedTiming t2("UpdateAllocationStackReferences", GetTimings());
+    // The objects allocated in the other spaces since the remark pause are not marked, but may
+    // reference moving objects.
+    accounting::ObjectStack* stack = heap_->allocation_stack_.get();
+    for (StackReference<mirror::Object>* it = stack->Begin(); it != stack->End(); ++it) {
+      mirror::Object* obj = it->AsMirrorPtr();
+      if (obj != nullptr && !space_->HasAddress(obj) && IsMarked(obj) == nullptr) {
+        object_visitor(obj);
+      }
+    }
+  }
+  {
+    TimingLogger::ScopedTiming t2("SweepSystemWeaks", GetTimings());
+    runtime->SweepSystemWeaks(&visitor);
+  }
+  heap_->GetReferenceProcessor()->UpdateRoots(&visitor);
+}
+
+void MarkCompact::MoveObjects() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  const uint64_t objects_before = space_->GetObjectsAllocated();
+  const uint64_t bytes_before = space_->GetBytesAllocated();
+  uint8_t* const begin = space_->Begin();
+  uint8_t* const end = space_->End();
+  accounting::ContinuousSpaceBitmap* mark_bitmap = space_->GetMarkBitmap();
+  // Objects only move towards the beginning of the space, an object is moved before it is
+  // overwritten by the objects after it.
+  uint8_t* dest = begin;
+  mark_bitmap->VisitMarkedRange(
+      reinterpret_cast<uintptr_t>(begin),
+      reinterpret_cast<uintptr_t>(end),
+      [&dest](mirror::Object* obj) REQUIRES_SHARED(Locks::mutator_lock_) {
+        const size_t size = RoundUp(obj->SizeOf<kVerifyNone>(), kAlignment);
+        if (dest != reinterpret_cast<uint8_t*>(obj)) {
+          memmove(dest, obj, size);
+        }
+        dest += size;
+      });
+  DCHECK_EQ(dest, compacted_end_);
+  CHECK_LE(objects_moved_, objects_before);
+  const uint64_t freed_objects = objects_before - objects_moved_;
+  const int64_t freed_bytes = static_cast<int64_t>(bytes_before) - bytes_moved_;
+  RecordFree(ObjectBytePair(freed_objects, freed_bytes));
+  space_->RecordFree(freed_objects, freed_bytes);
+  space_->SetCompactedEnd(compacted_end_);
+}
+
+void MarkCompact::UpdateDeadObjectReferences() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  UpdateObjectReferencesVisitor visitor(this, /*dead_objects=*/ true);
+  for (space::ContinuousSpace* space : heap_->GetContinuousSpaces()) {
+    accounting::ContinuousSpaceBitmap* live_bitmap = space->GetLiveBitmap();
+    accounting::ContinuousSpaceBitmap* mark_bitmap = space->GetMarkBitmap();
+    if (space == space_ || immune_spaces_.ContainsSpace(space) || live_bitmap == nullptr ||
+        live_bitmap == mark_bitmap) {
+      continue;
+    }
+    live_bitmap->VisitMarkedRange(reinterpret_cast<uintptr_t>(space->Begin()),
+                                  reinterpret_cast<uintptr_t>(space->End()),
+                                  [mark_bitmap, &visitor](mirror::Object* obj)
+                                      REQUIRES_SHARED(Locks::mutator_lock_,
+                                                      Locks::heap_bitmap_lock_) {
+                                    if (!mark_bitmap->Test(obj)) {
+                                      visitor(obj);
+                                    }
+                                  });
+  }
+  // The objects allocated before the remark pause are not in the live bitmaps until the sweep.
+  accounting::ObjectStack* live_stack = heap_->GetLiveStack();
+  for (StackReference<mirror::Object>* it = live_stack->Begin(); it != live_stack->End(); ++it) {
+    mirror::Object* obj = it->AsMirrorPtr();
+    if (obj != nullptr && !space_->HasAddress(obj) && IsMarked(obj) == nullptr) {
+      visitor(obj);
+    }
+  }
+}
+
+void MarkCompact::ResetSideTables() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  uint8_t* const begin = space_->Begin();
+  space_->GetMarkBitmap()->ClearRange(
+      reinterpret_cast<mirror::Object*>(begin),
+      reinterpret_cast<mirror::Object*>(AlignUp(moved_end_, kChunkSize)));
+  const size_t num_chunks = RoundUp(moved_end_ - begin, kChunkSize) / kChunkSize;
+  ZeroAndReleasePages(live_words_, num_chunks * sizeof(uintptr_t));
+  ZeroAndReleasePages(chunk_info_, num_chunks * sizeof(uint32_t));
+  moved_end_ = nullptr;
+}
+
+void MarkCompact::SweepPhase() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  Thread* const self = Thread::Current();
+  Runtime* const runtime = Runtime::Current();
+  // System weaks were swept in the compaction pause, clean up the class loaders they let go of.
+  runtime->AllowNewSystemWeaks();
+  {
+    // The dead objects of the other spaces still point to the old addresses until they are swept,
+    // and the side tables still map those. Update them before the class loaders go away.
+    WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    UpdateDeadObjectReferences();
+    ResetSideTables();
+  }
+  runtime->GetClassLinker()->CleanupClassLoaders();
+  WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
+  GetHeap()->RecordFreeRevoke();
+  // Reclaim the unmarked objects of the non-moving and large object spaces.
+  Sweep(false);
+  SwapBitmaps();
+  GetHeap()->UnBindBitmaps();
+}
+
+void MarkCompact::RevokeAllThreadLocalBuffers() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  GetHeap()->RevokeAllThreadLocalBuffers();
+}
+
+}  // namespace collector
+}  // namespace gc
+}  // namespace art
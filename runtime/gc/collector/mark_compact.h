@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_COLLECTOR_MARK_COMPACT_H_
+#define ART_RUNTIME_GC_COLLECTOR_MARK_COMPACT_H_
+
+#include "base/locks.h"
+#include "base/macros.h"
+#include "base/mem_map.h"
+#include "gc/space/bump_pointer_space.h"
+#include "mark_sweep.h"
+
+namespace art {
+
+namespace mirror {
+class Object;
+}  // namespace mirror
+
+namespace gc {
+
+class Heap;
+
+namespace collector {
+
+// Concurrent mark-compact collector for the bump pointer space.
+//
+// Marking is the concurrent mark sweep marking, with the same remark pause. References are then
+// processed and the forwarding addresses computed concurrently. In a second pause the references
+// are updated and the marked objects of the bump pointer space slid down towards its beginning,
+// in address order, which keeps the allocation order and leaves a single free tail to bump
+// allocate into. The non-moving and large object spaces are swept concurrently afterwards. The
+// objects allocated in the bump pointer space during the collection are all kept, like the
+// allocation stack keeps those of the other spaces.
+//
+// Forwarding addresses are not stored in the objects, which would overwrite lock words. Instead
+// a bitmap records every live word of the space, and each word of that bitmap has the number of
+// live bytes before it. The new address of an object is then the live bytes before its bitmap
+// word plus the population count of the live bits before it in that word.
+//
+// References are updated before the objects move, so visiting an object must not read through
+// an already updated pointer. Classes are therefore allocated in the non-moving space when this
+// collector is used, see Heap::CanMoveClasses.
+class MarkCompact final : public MarkSweep {
+ public:
+  explicit MarkCompact(Heap* heap);
+
+  ~MarkCompact() {}
+
+  void RunPhases() override REQUIRES(!mark_stack_lock_);
+
+  // Set the space to compact, must be called before the first collection.
+  void SetSpace(space::BumpPointerSpace* space);
+
+  GcType GetGcType() const override {
+    return kGcTypeFull;
+  }
+
+  CollectorType GetCollectorType() const override {
+    return kCollectorTypeCMC;
+  }
+
+ protected:
+  void RevokeAllThreadLocalBuffers() override;
+
+ private:
+  class UpdateReferenceVisitor;
+  class UpdateObjectReferencesVisitor;
+
+  // Bytes of the space covered by one word of the live words bitmap.
+  static constexpr size_t kChunkSize = kBitsPerIntPtrT * space::BumpPointerSpace::kAlignment;
+
+  // Finish marking and record the end of the space the forwarding addresses are computed for.
+  void RemarkPhase()
+      REQUIRES(Locks::mutator_lock_, !mark_stack_lock_);
+
+  // Process references, then compute the forwarding addresses of the marked objects.
+  void ForwardingPhase()
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!mark_stack_lock_);
+
+  // Forward the objects allocated since the remark pause, update the references to the moving
+  // objects and move them.
+  void CompactionPhase()
+      REQUIRES(Locks::mutator_lock_, !mark_stack_lock_);
+
+  // Free the dead objects of the other spaces.
+  void SweepPhase()
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!mark_stack_lock_);
+
+  // Mark the objects allocated in the space since the marking started, and push them on the mark
+  // stack for their references to be marked.
+  void MarkBlackAllocations()
+      REQUIRES(Locks::mutator_lock_, Locks::heap_bitmap_lock_, !mark_stack_lock_);
+
+  // Mark the objects allocated in the space since the remark pause, without tracing them.
+  void MarkNewAllocations()
+      REQUIRES(Locks::mutator_lock_, Locks::heap_bitmap_lock_);
+
+  // Record the live words of the marked objects in [begin, end), and the live bytes before the
+  // chunks that no later range can add to. `last` is true for the range ending at the space end.
+  void ComputeForwardingAddresses(uint8_t* begin, uint8_t* end, bool last)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(Locks::heap_bitmap_lock_);
+
+  void UpdateReferences()
+      REQUIRES(Locks::mutator_lock_, Locks::heap_bitmap_lock_);
+
+  void MoveObjects()
+      REQUIRES(Locks::mutator_lock_, Locks::heap_bitmap_lock_);
+
+  // Update the references of the unmarked objects of the other spaces, which are only freed
+  // by the sweep.
+  void UpdateDeadObjectReferences()
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(Locks::heap_bitmap_lock_);
+
+  // Clear the mark bitmap, live words and chunk info of the compacted range.
+  void ResetSideTables()
+      REQUIRES(Locks::heap_bitmap_lock_);
+
+  // Record the words [begin, begin + size) of the space as live.
+  void SetLiveWords(uintptr_t begin, size_t size);
+
+  // Return the address `obj` will have after compaction, `obj` must be marked.
+  mirror::Object* GetForwardingAddress(mirror::Object* obj) const;
+
+  // Return the new address of `obj` if it is in the compacted space, `obj` otherwise.
+  mirror::Object* ForwardIfMoving(mirror::Object* obj) const
+      REQUIRES_SHARED(Locks::heap_bitmap_lock_);
+
+  // Like ForwardIfMoving, but for the references of dead objects after the compaction: null if
+  // `obj` was in the compacted range and not marked.
+  mirror::Object* ForwardIfMarked(mirror::Object* obj) const
+      REQUIRES_SHARED(Locks::heap_bitmap_lock_);
+
+  space::BumpPointerSpace* space_;
+  // One bit per kAlignment bytes of the space, set for every word of a live object.
+  MemMap live_words_map_;
+  uintptr_t* live_words_;
+  // For each word of `live_words_`, the live bytes of the space before it once the forwarding
+  // addresses are computed. As 32-bit values, which limits the space to 4GB.
+  MemMap chunk_info_map_;
+  uint32_t* chunk_info_;
+  // End of the space when the marking started, the objects past it are live.
+  uint8_t* black_allocations_begin_;
+  // End of the space in the remark pause, the objects past it are marked in the compaction pause.
+  uint8_t* remark_end_;
+  // End of the space before compaction, until the side tables are reset.
+  uint8_t* moved_end_;
+  // End of the live objects once compacted.
+  uint8_t* compacted_end_;
+  // Chunks whose chunk info is final, and the live bytes before the first other one.
+  size_t forwarded_chunks_;
+  uint32_t live_bytes_before_;
+  size_t objects_moved_;
+  size_t bytes_moved_;
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(MarkCompact);
+};
+
+}  // namespace collector
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_COLLECTOR_MARK_COMPACT_H_
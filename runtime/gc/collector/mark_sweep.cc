@@ -36,6 +36,7 @@
 #include "gc/accounting/mod_union_table.h"
 #include "gc/accounting/space_bitmap-inl.h"
 #include "gc/heap.h"
+#include "gc/heap_census-inl.h"
 #include "gc/reference_processor.h"
 #include "gc/space/large_object_space.h"
 #include "gc/space/space-inl.h"
@@ -45,6 +46,7 @@
 #include "scoped_thread_state_change-inl.h"
 #include "thread-current-inl.h"
 #include "thread_list.h"
+#include "thread_pool.h"
 
 namespace art {
 namespace gc {
@@ -65,6 +67,13 @@ static constexpr bool kParallelRecursiveMark = true;
 // ProcessMarkStack with very small mark stacks.
 static constexpr size_t kMinimumParallelMarkStackSize = 128;
 static constexpr bool kParallelProcessMarkStack = true;
+static constexpr bool kParallelSweep = true;
+// Split each swept space into about this many chunks per thread so that workers stay balanced
+// when garbage is not spread evenly, but don't bother with chunks smaller than the minimum.
+static constexpr size_t kSweepChunksPerThread = 4;
+static constexpr size_t kMinimumSweepChunkSize = 1 * MB;
+// Likewise for the allocation stack swept by sticky collections, in number of entries.
+static constexpr size_t kMinimumSweepArrayChunkSize = 4 * KB;
 
 // Profiling and information flags.
 static constexpr bool kProfileLargeObjects = false;
@@ -92,15 +101,19 @@ void MarkSweep::BindBitmaps() {
 }
 
 MarkSweep::MarkSweep(Heap* heap, bool is_concurrent, const std::string& name_prefix)
-    : GarbageCollector(heap,
-                       name_prefix +
-                       (is_concurrent ? "concurrent mark sweep": "mark sweep")),
+    : MarkSweep(heap,
+                name_prefix + (is_concurrent ? "concurrent mark sweep": "mark sweep"),
+                is_concurrent) {}
+
+MarkSweep::MarkSweep(Heap* heap, const std::string& name, bool is_concurrent)
+    : GarbageCollector(heap, name),
       current_space_bitmap_(nullptr),
       mark_bitmap_(nullptr),
       mark_stack_(nullptr),
       gc_barrier_(new Barrier(0)),
       mark_stack_lock_("mark sweep mark stack lock", kMarkSweepMarkStackLock),
       is_concurrent_(is_concurrent),
+      census_enabled_(false),
       live_stack_freeze_size_(0) {
   std::string error_msg;
   sweep_array_free_buffer_mem_map_ = MemMap::MapAnonymous(
@@ -142,6 +155,9 @@ void MarkSweep::InitializePhase() {
     // Always clear soft references if a non-sticky collection.
     GetCurrentIteration()->SetClearSoftReferences(GetGcType() != collector::kGcTypeSticky);
   }
+  census_enabled_ =
+      GetGcType() != collector::kGcTypeSticky && heap_->GetHeapCensus() != nullptr;
+  census_table_.Clear();
 }
 
 void MarkSweep::RunPhases() {
@@ -184,6 +200,18 @@ void MarkSweep::ProcessReferences(Thread* self) {
       this);
 }
 
+void MarkSweep::PublishCensus() {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  DCHECK(census_enabled_);
+  {
+    MutexLock mu(Thread::Current(), mark_stack_lock_);
+    census_table_.Merge(parallel_census_table_);
+    parallel_census_table_.Clear();
+  }
+  GetHeap()->GetHeapCensus()->Publish(census_table_, this, GetName());
+  census_table_.Clear();
+}
+
 void MarkSweep::PausePhase() {
   TimingLogger::ScopedTiming t("(Paused)PausePhase", GetTimings());
   Thread* self = Thread::Current();
@@ -342,6 +370,10 @@ void MarkSweep::ReclaimPhase() {
   Thread* const self = Thread::Current();
   // Process the references concurrently.
   ProcessReferences(self);
+  if (census_enabled_) {
+    ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    PublishCensus();
+  }
   SweepSystemWeaks(self);
   Runtime* const runtime = Runtime::Current();
   runtime->AllowNewSystemWeaks();
@@ -407,6 +439,9 @@ inline void MarkSweep::MarkObjectNonNullParallel(mirror::Object* obj) {
   DCHECK(obj != nullptr);
   if (MarkObjectParallel(obj)) {
     MutexLock mu(Thread::Current(), mark_stack_lock_);
+    if (census_enabled_) {
+      parallel_census_table_.AddObject(obj);
+    }
     if (UNLIKELY(mark_stack_->Size() >= mark_stack_->Capacity())) {
       ExpandMarkStack();
     }
@@ -512,6 +547,9 @@ inline void MarkSweep::MarkObjectNonNull(mirror::Object* obj,
       ++mark_fastpath_count_;
     }
     if (UNLIKELY(!current_space_bitmap_->Set(obj))) {
+      if (census_enabled_) {
+        census_table_.AddObject(obj);
+      }
       PushOnMarkStack(obj);  // This object was not previously marked.
     }
   } else {
@@ -522,6 +560,9 @@ inline void MarkSweep::MarkObjectNonNull(mirror::Object* obj,
     // TODO: We already know that the object is not in the current_space_bitmap_ but MarkBitmap::Set
     // will check again.
     if (!mark_bitmap_->Set(obj, visitor)) {
+      if (census_enabled_) {
+        census_table_.AddObject(obj);
+      }
       PushOnMarkStack(obj);  // Was not already marked, push.
     }
   }
@@ -723,6 +764,9 @@ class MarkSweep::MarkStackTask : public Task {
    private:
     ALWAYS_INLINE void Mark(mirror::Object* ref) const REQUIRES_SHARED(Locks::mutator_lock_) {
       if (ref != nullptr && mark_sweep_->MarkObjectParallel(ref)) {
+        if (mark_sweep_->census_enabled_) {
+          chunk_task_->census_table_.AddObject(ref);
+        }
         if (kUseFinger) {
           std::atomic_thread_fence(std::memory_order_seq_cst);
           if (reinterpret_cast<uintptr_t>(ref) >=
@@ -771,6 +815,8 @@ class MarkSweep::MarkStackTask : public Task {
   StackReference<mirror::Object> mark_stack_[kMaxSize];
   // Mark stack position.
   size_t mark_stack_pos_;
+  // Census counts of the objects marked by this task.
+  HeapCensus::Table census_table_;
 
   ALWAYS_INLINE void MarkStackPush(mirror::Object* obj)
       REQUIRES_SHARED(Locks::mutator_lock_) {
@@ -793,7 +839,7 @@ class MarkSweep::MarkStackTask : public Task {
   }
 
   // Scans all of the objects
-  void Run(Thread* self ATTRIBUTE_UNUSED) override
+  void Run(Thread* self) override
       REQUIRES(Locks::heap_bitmap_lock_)
       REQUIRES_SHARED(Locks::mutator_lock_) {
     ScanObjectParallelVisitor visitor(this);
@@ -823,6 +869,10 @@ class MarkSweep::MarkStackTask : public Task {
       DCHECK(obj != nullptr);
       visitor(obj);
     }
+    if (!census_table_.IsEmpty()) {
+      MutexLock mu(self, mark_sweep_->mark_stack_lock_);
+      mark_sweep_->parallel_census_table_.Merge(census_table_);
+    }
   }
 };
 
@@ -1101,7 +1151,8 @@ void MarkSweep::ReMarkRoots() {
 void MarkSweep::SweepSystemWeaks(Thread* self) {
   TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
   ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
-  Runtime::Current()->SweepSystemWeaks(this);
+  Runtime::Current()->SweepSystemWeaks(
+      this, GetHeap()->GetThreadPool(), GetThreadCount(/*paused=*/ false));
 }
 
 class MarkSweep::VerifySystemWeakVisitor : public IsMarkedVisitor {
@@ -1204,17 +1255,7 @@ void MarkSweep::MarkRootsCheckpoint(Thread* self,
   Locks::heap_bitmap_lock_->ExclusiveLock(self);
 }
 
-void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitmaps) {
-  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
-  Thread* self = Thread::Current();
-  mirror::Object** chunk_free_buffer = reinterpret_cast<mirror::Object**>(
-      sweep_array_free_buffer_mem_map_.BaseBegin());
-  size_t chunk_free_pos = 0;
-  ObjectBytePair freed;
-  ObjectBytePair freed_los;
-  // How many objects are left in the array, modified after each space is swept.
-  StackReference<mirror::Object>* objects = allocations->Begin();
-  size_t count = allocations->Size();
+std::vector<space::ContinuousSpace*> MarkSweep::GetSweepArraySpaces() {
   // Change the order to ensure that the non-moving space last swept as an optimization.
   std::vector<space::ContinuousSpace*> sweep_spaces;
   space::ContinuousSpace* non_moving_space = nullptr;
@@ -1234,8 +1275,31 @@ void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitma
   if (non_moving_space != nullptr) {
     sweep_spaces.push_back(non_moving_space);
   }
+  return sweep_spaces;
+}
+
+void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitmaps) {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  const size_t thread_count = GetThreadCount(/*paused=*/ false);
+  // Keep the memory tool runs serial, like for Sweep().
+  if (kParallelSweep &&
+      thread_count > 1 &&
+      allocations->Size() > kMinimumSweepArrayChunkSize &&
+      !Runtime::Current()->IsRunningOnMemoryTool()) {
+    ParallelSweepArray(allocations, swap_bitmaps, thread_count);
+    return;
+  }
+  Thread* self = Thread::Current();
+  mirror::Object** chunk_free_buffer = reinterpret_cast<mirror::Object**>(
+      sweep_array_free_buffer_mem_map_.BaseBegin());
+  size_t chunk_free_pos = 0;
+  ObjectBytePair freed;
+  ObjectBytePair freed_los;
+  // How many objects are left in the array, modified after each space is swept.
+  StackReference<mirror::Object>* objects = allocations->Begin();
+  size_t count = allocations->Size();
   // Start by sweeping the continuous spaces.
-  for (space::ContinuousSpace* space : sweep_spaces) {
+  for (space::ContinuousSpace* space : GetSweepArraySpaces()) {
     space::AllocSpace* alloc_space = space->AsAllocSpace();
     accounting::ContinuousSpaceBitmap* live_bitmap = space->GetLiveBitmap();
     accounting::ContinuousSpaceBitmap* mark_bitmap = space->GetMarkBitmap();
@@ -1304,6 +1368,129 @@ void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitma
   sweep_array_free_buffer_mem_map_.MadviseDontNeedAndZero();
 }
 
+size_t MarkSweep::SweepArrayRange(Thread* self,
+                                  StackReference<mirror::Object>* objects,
+                                  size_t count,
+                                  const std::vector<space::ContinuousSpace*>& sweep_spaces,
+                                  bool swap_bitmaps,
+                                  ObjectBytePair* freed) {
+  // One free buffer per space since FreeList() takes objects of a single space, flushed when it
+  // holds kSweepArrayChunkFreeSize objects like the buffer of the serial sweep.
+  std::vector<std::vector<mirror::Object*>> free_buffers(sweep_spaces.size());
+  auto flush = [&](size_t space_index) REQUIRES_SHARED(Locks::mutator_lock_) {
+    std::vector<mirror::Object*>& buffer = free_buffers[space_index];
+    if (!buffer.empty()) {
+      freed->objects += buffer.size();
+      freed->bytes +=
+          sweep_spaces[space_index]->AsAllocSpace()->FreeList(self, buffer.size(), buffer.data());
+      buffer.clear();
+    }
+  };
+  StackReference<mirror::Object>* out = objects;
+  for (size_t i = 0; i < count; ++i) {
+    mirror::Object* const obj = objects[i].AsMirrorPtr();
+    if (kUseThreadLocalAllocationStack && obj == nullptr) {
+      continue;
+    }
+    size_t space_index = 0;
+    while (space_index < sweep_spaces.size() && !sweep_spaces[space_index]->HasAddress(obj)) {
+      ++space_index;
+    }
+    if (space_index == sweep_spaces.size()) {
+      // Left for the large object space.
+      (out++)->Assign(obj);
+      continue;
+    }
+    space::ContinuousSpace* space = sweep_spaces[space_index];
+    accounting::ContinuousSpaceBitmap* mark_bitmap =
+        swap_bitmaps ? space->GetLiveBitmap() : space->GetMarkBitmap();
+    if (!mark_bitmap->Test(obj)) {
+      std::vector<mirror::Object*>& buffer = free_buffers[space_index];
+      if (buffer.size() >= kSweepArrayChunkFreeSize) {
+        flush(space_index);
+      }
+      buffer.push_back(obj);
+    }
+  }
+  for (size_t space_index = 0; space_index < sweep_spaces.size(); ++space_index) {
+    flush(space_index);
+  }
+  return out - objects;
+}
+
+void MarkSweep::ParallelSweepArray(accounting::ObjectStack* allocations,
+                                   bool swap_bitmaps,
+                                   size_t thread_count) {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  Thread* self = Thread::Current();
+  ThreadPool* thread_pool = GetHeap()->GetThreadPool();
+  const std::vector<space::ContinuousSpace*> sweep_spaces = GetSweepArraySpaces();
+  StackReference<mirror::Object>* const objects = allocations->Begin();
+  const size_t count = allocations->Size();
+  const size_t chunk_size =
+      std::max(count / (thread_count * kSweepChunksPerThread), kMinimumSweepArrayChunkSize);
+  struct SweepArrayChunk {
+    size_t begin;
+    size_t end;
+    // The objects outside of the swept continuous spaces are moved to the start of the chunk.
+    size_t remaining;
+    ObjectBytePair freed;
+  };
+  std::vector<SweepArrayChunk> chunks;
+  for (size_t begin = 0; begin < count; begin += chunk_size) {
+    chunks.push_back({begin, std::min(begin + chunk_size, count), 0u, ObjectBytePair()});
+  }
+  for (SweepArrayChunk& chunk : chunks) {
+    SweepArrayChunk* const chunk_ptr = &chunk;
+    // No thread safety analysis since the workers sweep on behalf of this thread, which holds the
+    // heap bitmap lock exclusively until they are done.
+    thread_pool->AddTask(self, new FunctionTask(
+        [this, chunk_ptr, objects, &sweep_spaces, swap_bitmaps](Thread* worker)
+            NO_THREAD_SAFETY_ANALYSIS {
+          chunk_ptr->remaining = SweepArrayRange(worker,
+                                                 objects + chunk_ptr->begin,
+                                                 chunk_ptr->end - chunk_ptr->begin,
+                                                 sweep_spaces,
+                                                 swap_bitmaps,
+                                                 &chunk_ptr->freed);
+        }));
+  }
+  thread_pool->SetMaxActiveWorkers(thread_count - 1);
+  thread_pool->StartWorkers(self);
+  thread_pool->Wait(self, /* do_work= */ true, /* may_hold_locks= */ true);
+  thread_pool->StopWorkers(self);
+
+  ObjectBytePair freed;
+  ObjectBytePair freed_los;
+  space::LargeObjectSpace* large_object_space = GetHeap()->GetLargeObjectsSpace();
+  accounting::LargeObjectBitmap* large_mark_objects = nullptr;
+  if (large_object_space != nullptr) {
+    large_mark_objects = swap_bitmaps ? large_object_space->GetLiveBitmap()
+                                      : large_object_space->GetMarkBitmap();
+  }
+  for (const SweepArrayChunk& chunk : chunks) {
+    freed.Add(chunk.freed);
+    if (large_object_space == nullptr) {
+      continue;
+    }
+    // The large object space has its own lock, free from this thread what the workers left.
+    for (size_t i = chunk.begin; i < chunk.begin + chunk.remaining; ++i) {
+      mirror::Object* const obj = objects[i].AsMirrorPtr();
+      if (!large_mark_objects->Test(obj)) {
+        ++freed_los.objects;
+        freed_los.bytes += large_object_space->Free(self, obj);
+      }
+    }
+  }
+  {
+    TimingLogger::ScopedTiming t2("RecordFree", GetTimings());
+    RecordFree(freed);
+    RecordFreeLOS(freed_los);
+    t2.NewTiming("ResetStack");
+    allocations->Reset();
+  }
+}
+
 void MarkSweep::Sweep(bool swap_bitmaps) {
   TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
   // Ensure that nobody inserted items in the live stack after we swapped the stacks.
@@ -1317,8 +1504,16 @@ void MarkSweep::Sweep(bool swap_bitmaps) {
     live_stack->Reset();
     DCHECK(mark_stack_->IsEmpty());
   }
+  const size_t thread_count = GetThreadCount(/*paused=*/ false);
+  // The memory tool sweep reads the classes of all the garbage of a space before freeing any of
+  // it (b/131542326), so keep sweeping serially there.
+  if (kParallelSweep && thread_count > 1 && !Runtime::Current()->IsRunningOnMemoryTool()) {
+    ParallelSweep(swap_bitmaps, thread_count);
+    return;
+  }
   for (const auto& space : GetHeap()->GetContinuousSpaces()) {
-    if (space->IsContinuousMemMapAllocSpace()) {
+    // A bump pointer space compacted by the mark-compact collector has no live bitmap.
+    if (space->IsContinuousMemMapAllocSpace() && space->GetLiveBitmap() != nullptr) {
       space::ContinuousMemMapAllocSpace* alloc_space = space->AsContinuousMemMapAllocSpace();
       TimingLogger::ScopedTiming split(
           alloc_space->IsZygoteSpace() ? "SweepZygoteSpace" : "SweepMallocSpace",
@@ -1329,6 +1524,64 @@ void MarkSweep::Sweep(bool swap_bitmaps) {
   SweepLargeObjects(swap_bitmaps);
 }
 
+void MarkSweep::ParallelSweep(bool swap_bitmaps, size_t thread_count) {
+  TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
+  Thread* self = Thread::Current();
+  ThreadPool* thread_pool = GetHeap()->GetThreadPool();
+  // Chunk boundaries must fall on bitmap word boundaries so that no two workers clear bits in the
+  // same word of the live or mark bitmap.
+  constexpr size_t kBitmapWordCoverage = kObjectAlignment * kBitsPerIntPtrT;
+  struct SweepChunk {
+    space::ContinuousMemMapAllocSpace* space;
+    uintptr_t begin;
+    uintptr_t end;
+  };
+  std::vector<SweepChunk> chunks;
+  for (const auto& space : GetHeap()->GetContinuousSpaces()) {
+    // A bump pointer space compacted by the mark-compact collector has no live bitmap.
+    if (!space->IsContinuousMemMapAllocSpace() || space->GetLiveBitmap() == nullptr) {
+      continue;
+    }
+    // Spaces with bound bitmaps have nothing to sweep.
+    if (space->GetLiveBitmap() == space->GetMarkBitmap()) {
+      continue;
+    }
+    space::ContinuousMemMapAllocSpace* alloc_space = space->AsContinuousMemMapAllocSpace();
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(alloc_space->Begin());
+    const uintptr_t end = reinterpret_cast<uintptr_t>(alloc_space->End());
+    DCHECK_ALIGNED(begin, kBitmapWordCoverage);
+    const size_t chunk_size = RoundUp(
+        std::max((end - begin) / (thread_count * kSweepChunksPerThread), kMinimumSweepChunkSize),
+        kBitmapWordCoverage);
+    for (uintptr_t chunk_begin = begin; chunk_begin < end; chunk_begin += chunk_size) {
+      chunks.push_back({alloc_space, chunk_begin, std::min(chunk_begin + chunk_size, end)});
+    }
+  }
+  // Each task records into its own slot, summed once all the workers are done.
+  std::vector<ObjectBytePair> freed(chunks.size());
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    const SweepChunk& chunk = chunks[i];
+    ObjectBytePair* chunk_freed = &freed[i];
+    // No thread safety analysis since the workers sweep on behalf of this thread, which holds the
+    // heap bitmap lock exclusively until they are done.
+    thread_pool->AddTask(self, new FunctionTask(
+        [chunk, chunk_freed, swap_bitmaps, self](Thread*) NO_THREAD_SAFETY_ANALYSIS {
+          *chunk_freed = chunk.space->SweepRange(swap_bitmaps, chunk.begin, chunk.end, self);
+        }));
+  }
+  thread_pool->SetMaxActiveWorkers(thread_count - 1);
+  thread_pool->StartWorkers(self);
+  // The large object space has its own bitmaps and lock, sweep it while the workers run.
+  SweepLargeObjects(swap_bitmaps);
+  thread_pool->Wait(self, /* do_work= */ true, /* may_hold_locks= */ true);
+  thread_pool->StopWorkers(self);
+  ObjectBytePair total_freed;
+  for (const ObjectBytePair& chunk_freed : freed) {
+    total_freed.Add(chunk_freed);
+  }
+  RecordFree(total_freed);
+}
+
 void MarkSweep::SweepLargeObjects(bool swap_bitmaps) {
   space::LargeObjectSpace* los = heap_->GetLargeObjectsSpace();
   if (los != nullptr) {
@@ -1499,10 +1752,11 @@ void MarkSweep::FinishPhase() {
 }
 
 void MarkSweep::RevokeAllThreadLocalBuffers() {
-  if (kRevokeRosAllocThreadLocalBuffersAtCheckpoint && IsConcurrent()) {
+  if (kRevokeRosAllocThreadLocalBuffersAtCheckpoint && IsConcurrent() &&
+      !GetHeap()->UseRosAllocPerCpuRuns()) {
     // If concurrent, rosalloc thread-local buffers are revoked at the
     // thread checkpoint. Bump pointer space thread-local buffers must
-    // not be in use.
+    // not be in use. Per-CPU runs have no owner thread and are revoked below.
     GetHeap()->AssertAllBumpPointerSpaceThreadLocalBuffersAreRevoked();
   } else {
     TimingLogger::ScopedTiming t(__FUNCTION__, GetTimings());
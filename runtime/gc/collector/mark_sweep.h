@@ -18,6 +18,7 @@
 #define ART_RUNTIME_GC_COLLECTOR_MARK_SWEEP_H_
 
 #include <memory>
+#include <vector>
 
 #include "base/atomic.h"
 #include "barrier.h"
@@ -25,6 +26,7 @@
 #include "base/mutex.h"
 #include "garbage_collector.h"
 #include "gc/accounting/heap_bitmap.h"
+#include "gc/heap_census.h"
 #include "gc_root.h"
 #include "immune_spaces.h"
 #include "offsets.h"
@@ -37,6 +39,7 @@ class Object;
 class Reference;
 }  // namespace mirror
 
+template<class MirrorType> class StackReference;
 class Thread;
 enum VisitRootFlags : uint8_t;
 
@@ -150,6 +153,12 @@ class MarkSweep : public GarbageCollector {
       REQUIRES(Locks::heap_bitmap_lock_)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Sweeps the continuous spaces in bitmap word aligned chunks on the heap thread pool, and the
+  // large object space on the calling thread meanwhile.
+  void ParallelSweep(bool swap_bitmaps, size_t thread_count)
+      REQUIRES(Locks::heap_bitmap_lock_)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   // Sweeps unmarked objects to complete the garbage collection.
   void SweepLargeObjects(bool swap_bitmaps) REQUIRES(Locks::heap_bitmap_lock_);
 
@@ -158,6 +167,29 @@ class MarkSweep : public GarbageCollector {
       REQUIRES(Locks::heap_bitmap_lock_)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Sweeps the array in chunks on the heap thread pool. The workers free the objects of the
+  // continuous spaces with FreeList(), the large objects are freed on the calling thread after.
+  void ParallelSweepArray(accounting::ObjectStack* allocation_stack_,
+                          bool swap_bitmaps,
+                          size_t thread_count)
+      REQUIRES(Locks::heap_bitmap_lock_)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Frees the unmarked objects of `sweep_spaces` among the `count` first ones of `objects`, in a
+  // single pass, and adds them to `freed`. The other objects are moved to the start of `objects`,
+  // returns their number.
+  size_t SweepArrayRange(Thread* self,
+                         StackReference<mirror::Object>* objects,
+                         size_t count,
+                         const std::vector<space::ContinuousSpace*>& sweep_spaces,
+                         bool swap_bitmaps,
+                         ObjectBytePair* freed)
+      REQUIRES(Locks::heap_bitmap_lock_)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // The spaces swept by SweepArray(), in sweeping order.
+  std::vector<space::ContinuousSpace*> GetSweepArraySpaces();
+
   // Blackens an object.
   void ScanObject(mirror::Object* obj)
       REQUIRES(Locks::heap_bitmap_lock_)
@@ -230,6 +262,9 @@ class MarkSweep : public GarbageCollector {
       override REQUIRES_SHARED(Locks::heap_bitmap_lock_, Locks::mutator_lock_);
 
  protected:
+  // Used by subclasses that do not follow the mark sweep naming.
+  MarkSweep(Heap* heap, const std::string& name, bool is_concurrent);
+
   // Returns object if the object is marked in the heap bitmap, otherwise null.
   mirror::Object* IsMarked(mirror::Object* object) override
       REQUIRES_SHARED(Locks::heap_bitmap_lock_, Locks::mutator_lock_);
@@ -267,6 +302,11 @@ class MarkSweep : public GarbageCollector {
   // whether or not we care about pauses.
   size_t GetThreadCount(bool paused) const;
 
+  // Publish the heap census counted while marking, once marking is done.
+  void PublishCensus()
+      REQUIRES_SHARED(Locks::heap_bitmap_lock_, Locks::mutator_lock_)
+      REQUIRES(!mark_stack_lock_);
+
   // Push a single reference on a mark stack.
   void PushOnMarkStack(mirror::Object* obj)
       REQUIRES(!mark_stack_lock_)
@@ -347,6 +387,13 @@ class MarkSweep : public GarbageCollector {
 
   const bool is_concurrent_;
 
+  // Heap census of a non-sticky collection. The GC thread counts the objects it marks in
+  // census_table_, the marking tasks and the checkpoints merge their counts into
+  // parallel_census_table_.
+  bool census_enabled_;
+  HeapCensus::Table census_table_;
+  HeapCensus::Table parallel_census_table_ GUARDED_BY(mark_stack_lock_);
+
   // Verification.
   size_t live_stack_freeze_size_;
 
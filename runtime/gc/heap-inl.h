@@ -25,6 +25,7 @@
 #include "gc/accounting/atomic_stack.h"
 #include "gc/accounting/card_table-inl.h"
 #include "gc/allocation_record.h"
+#include "gc/allocation_sampler.h"
 #include "gc/collector/semi_space.h"
 #include "gc/space/bump_pointer_space-inl.h"
 #include "gc/space/dlmalloc_space-inl.h"
@@ -81,6 +82,9 @@ inline mirror::Object* Heap::AllocObjectWithAllocator(Thread* self,
   size_t bytes_allocated;
   size_t usable_size;
   size_t new_num_bytes_allocated = 0;
+  // Bytes allocated that includes bulk thread-local buffer allocations in addition to direct
+  // non-TLAB object allocations.
+  size_t bytes_tl_bulk_allocated = 0u;
   {
     // Do the initial pre-alloc
     pre_object_allocated();
@@ -132,9 +136,6 @@ inline mirror::Object* Heap::AllocObjectWithAllocator(Thread* self,
       no_suspend_pre_fence_visitor(obj, usable_size);
       QuasiAtomic::ThreadFenceForConstructor();
     } else {
-      // Bytes allocated that includes bulk thread-local buffer allocations in addition to direct
-      // non-TLAB object allocations.
-      size_t bytes_tl_bulk_allocated = 0u;
       obj = TryToAllocate<kInstrumented, false>(self, allocator, byte_count, &bytes_allocated,
                                                 &usable_size, &bytes_tl_bulk_allocated);
       if (UNLIKELY(obj == nullptr)) {
@@ -230,6 +231,11 @@ inline mirror::Object* Heap::AllocObjectWithAllocator(Thread* self,
   } else {
     DCHECK(!IsAllocTrackingEnabled());
   }
+  // The sampler only sees the bytes of buffer refills and non-TLAB allocations, which keeps the
+  // thread-local fast paths above untouched.
+  if (UNLIKELY(allocation_sampler_ != nullptr) && bytes_tl_bulk_allocated != 0u) {
+    allocation_sampler_->ReportAllocatedBytes(self, &obj, bytes_allocated, bytes_tl_bulk_allocated);
+  }
   if (AllocatorHasAllocationStack(allocator)) {
     PushOnAllocationStack(self, &obj);
   }
@@ -240,10 +246,8 @@ inline mirror::Object* Heap::AllocObjectWithAllocator(Thread* self,
   } else {
     DCHECK(!gc_stress_mode_);
   }
-  // IsGcConcurrent() isn't known at compile time so we can optimize by not checking it for
-  // the BumpPointer or TLAB allocators. This is nice since it allows the entire if statement to be
-  // optimized out. And for the other allocators, AllocatorMayHaveConcurrentGC is a constant since
-  // the allocator_type should be constant propagated.
+  // IsGcConcurrent() isn't known at compile time, AllocatorMayHaveConcurrentGC is a constant
+  // except for the bump pointer allocators since the allocator_type should be constant propagated.
   if (AllocatorMayHaveConcurrentGC(allocator) && IsGcConcurrent()) {
     // New_num_bytes_allocated is zero if we didn't update num_bytes_allocated_.
     // That's fine.
@@ -108,6 +108,16 @@ inline void Heap::VisitObjectsInternal(Visitor&& visitor) {
     // Visit objects in bump pointer space.
     bump_pointer_space_->Walk(visitor);
   }
+  VisitAllocationStackObjects(visitor);
+  {
+    ReaderMutexLock mu(Thread::Current(), *Locks::heap_bitmap_lock_);
+    GetLiveBitmap()->Visit<Visitor>(visitor);
+  }
+}
+
+// Visit objects in the allocation stack.
+template <typename Visitor>
+inline void Heap::VisitAllocationStackObjects(Visitor&& visitor) {
   // TODO: Switch to standard begin and end to use ranged a based loop.
   for (auto* it = allocation_stack_->Begin(), *end = allocation_stack_->End(); it < end; ++it) {
     mirror::Object* const obj = it->AsMirrorPtr();
@@ -157,10 +167,6 @@ inline void Heap::VisitObjectsInternal(Visitor&& visitor) {
       visitor(obj);
     }
   }
-  {
-    ReaderMutexLock mu(Thread::Current(), *Locks::heap_bitmap_lock_);
-    GetLiveBitmap()->Visit<Visitor>(visitor);
-  }
 }
 
 }  // namespace gc
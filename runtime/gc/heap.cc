@@ -16,6 +16,7 @@
 
 #include "heap.h"
 
+#include <functional>
 #include <limits>
 #include "android-base/thread_annotations.h"
 #if defined(__BIONIC__) || defined(__GLIBC__)
@@ -27,6 +28,7 @@
 #include "android-base/stringprintf.h"
 
 #include "allocation_listener.h"
+#include "allocation_sampler.h"
 #include "art_field-inl.h"
 #include "backtrace_helper.h"
 #include "base/allocator.h"
@@ -54,10 +56,12 @@
 #include "gc/accounting/remembered_set.h"
 #include "gc/accounting/space_bitmap-inl.h"
 #include "gc/collector/concurrent_copying.h"
+#include "gc/collector/mark_compact.h"
 #include "gc/collector/mark_sweep.h"
 #include "gc/collector/partial_mark_sweep.h"
 #include "gc/collector/semi_space.h"
 #include "gc/collector/sticky_mark_sweep.h"
+#include "gc/heap_census.h"
 #include "gc/racing_check.h"
 #include "gc/reference_processor.h"
 #include "gc/scoped_gc_critical_section.h"
@@ -69,6 +73,7 @@
 #include "gc/space/rosalloc_space-inl.h"
 #include "gc/space/space-inl.h"
 #include "gc/space/zygote_space.h"
+#include "gc/string_dedup_stats.h"
 #include "gc/task_processor.h"
 #include "gc/verification.h"
 #include "gc_pause_listener.h"
@@ -96,6 +101,7 @@
 #include "runtime.h"
 #include "scoped_thread_state_change-inl.h"
 #include "thread_list.h"
+#include "thread_pool.h"
 #include "verify_object-inl.h"
 #include "well_known_classes.h"
 
@@ -136,6 +142,13 @@ static constexpr size_t kVerifyObjectAllocationStackSize = 16 * KB /
     sizeof(mirror::HeapReference<mirror::Object>);
 static constexpr size_t kDefaultAllocationStackSize = 8 * MB /
     sizeof(mirror::HeapReference<mirror::Object>);
+// Number of classes of the heap census printed on SIGQUIT.
+static constexpr size_t kMaxCensusClassesToDump = 20;
+// Whether heap verification splits the spaces among the parallel GC threads. Each space is split
+// into about this many chunks per thread, but no smaller than the minimum chunk size.
+static constexpr bool kParallelHeapVerification = true;
+static constexpr size_t kHeapVerificationChunksPerThread = 4;
+static constexpr size_t kMinimumHeapVerificationChunkSize = 1 * MB;
 
 // For deterministic compilation, we need the heap to be at a well-known address.
 static constexpr uint32_t kAllocSpaceBeginForDeterministicAoT = 0x40000000;
@@ -244,6 +257,14 @@ Heap::Heap(size_t initial_size,
            uint64_t min_interval_homogeneous_space_compaction_by_oom,
            bool dump_region_info_before_gc,
            bool dump_region_info_after_gc,
+           size_t region_prefault_pool_size,
+           bool use_transparent_huge_pages,
+           size_t allocation_sampling_interval,
+           const std::string& allocation_profile_file,
+           double gc_cpu_percent_target,
+           bool use_heap_census,
+           bool use_rosalloc_per_cpu_runs,
+           bool use_string_dedup_stats,
            space::ImageSpaceLoadingOrder image_space_loading_order)
     : non_moving_space_(nullptr),
       rosalloc_space_(nullptr),
@@ -257,6 +278,7 @@ Heap::Heap(size_t initial_size,
       parallel_gc_threads_(parallel_gc_threads),
       conc_gc_threads_(conc_gc_threads),
       low_memory_mode_(low_memory_mode),
+      use_rosalloc_per_cpu_runs_(use_rosalloc_per_cpu_runs),
       long_pause_log_threshold_(long_pause_log_threshold),
       long_gc_log_threshold_(long_gc_log_threshold),
       process_cpu_start_time_ns_(ProcessCpuNanoTime()),
@@ -282,6 +304,8 @@ Heap::Heap(size_t initial_size,
       // this one.
       process_state_update_lock_("process state update lock", kPostMonitorLock),
       min_foreground_target_footprint_(0),
+      gc_cpu_percent_target_(gc_cpu_percent_target),
+      adaptive_heap_sizer_(gc_cpu_percent_target, min_free, ProcessCpuNanoTime()),
       concurrent_start_bytes_(std::numeric_limits<size_t>::max()),
       total_bytes_freed_ever_(0),
       total_objects_freed_ever_(0),
@@ -322,6 +346,7 @@ Heap::Heap(size_t initial_size,
       verify_object_mode_(kVerifyObjectModeDisabled),
       disable_moving_gc_count_(0),
       semi_space_collector_(nullptr),
+      mark_compact_collector_(nullptr),
       active_concurrent_copying_collector_(nullptr),
       young_concurrent_copying_collector_(nullptr),
       concurrent_copying_collector_(nullptr),
@@ -333,6 +358,7 @@ Heap::Heap(size_t initial_size,
       last_time_homogeneous_space_compaction_by_oom_(NanoTime()),
       pending_collector_transition_(nullptr),
       pending_heap_trim_(nullptr),
+      pending_region_prefault_(nullptr),
       use_homogeneous_space_compaction_for_oom_(use_homogeneous_space_compaction_for_oom),
       use_generational_cc_(use_generational_cc),
       running_collection_is_blocking_(false),
@@ -353,6 +379,14 @@ Heap::Heap(size_t initial_size,
       gc_disabled_for_shutdown_(false),
       dump_region_info_before_gc_(dump_region_info_before_gc),
       dump_region_info_after_gc_(dump_region_info_after_gc),
+      num_prefaulted_regions_(region_prefault_pool_size / space::RegionSpace::kRegionSize),
+      use_transparent_huge_pages_(use_transparent_huge_pages),
+      allocation_sampler_(allocation_sampling_interval != 0u
+                              ? new AllocationSampler(allocation_sampling_interval)
+                              : nullptr),
+      allocation_profile_file_(allocation_profile_file),
+      heap_census_(use_heap_census ? new HeapCensus() : nullptr),
+      string_dedup_stats_(use_string_dedup_stats ? new StringDedupStats() : nullptr),
       boot_image_spaces_(),
       boot_images_start_address_(0u),
       boot_images_size_(0u) {
@@ -367,6 +401,13 @@ Heap::Heap(size_t initial_size,
         << "Changing from " << foreground_collector_type_ << " to "
         << background_collector_type_ << " (or visa versa) is not supported.";
   }
+  if (!kUseReadBarrier) {
+    // The mark-compact collector does not support collector transitions.
+    CHECK_EQ(foreground_collector_type_ == kCollectorTypeCMC,
+             background_collector_type_ == kCollectorTypeCMC)
+        << "Changing from " << foreground_collector_type_ << " to "
+        << background_collector_type_ << " is not supported.";
+  }
   verification_.reset(new Verification(this));
   CHECK_GE(large_object_threshold, kMinLargeObjectThreshold);
   ScopedTrace trace(__FUNCTION__);
@@ -552,11 +593,25 @@ Heap::Heap(size_t initial_size,
     CHECK(separate_non_moving_space);
     // Reserve twice the capacity, to allow evacuating every region for explicit GCs.
     MemMap region_space_mem_map =
-        space::RegionSpace::CreateMemMap(kRegionSpaceName, capacity_ * 2, request_begin);
+        space::RegionSpace::CreateMemMap(kRegionSpaceName,
+                                         capacity_ * 2,
+                                         request_begin,
+                                         use_transparent_huge_pages_);
     CHECK(region_space_mem_map.IsValid()) << "No region space mem map";
-    region_space_ = space::RegionSpace::Create(
-        kRegionSpaceName, std::move(region_space_mem_map), use_generational_cc_);
+    region_space_ = space::RegionSpace::Create(kRegionSpaceName,
+                                               std::move(region_space_mem_map),
+                                               use_generational_cc_,
+                                               use_transparent_huge_pages_);
     AddSpace(region_space_);
+  } else if (foreground_collector_type_ == kCollectorTypeCMC) {
+    // The mark-compact collector compacts the bump pointer space in place, so it does not need a
+    // second bump pointer space to copy into.
+    bump_pointer_space_ = space::BumpPointerSpace::CreateFromMemMap("Bump pointer space 1",
+                                                                    std::move(main_mem_map_1));
+    CHECK(bump_pointer_space_ != nullptr) << "Failed to create bump pointer space";
+    bump_pointer_space_->CreateMarkBitmap();
+    AddSpace(bump_pointer_space_);
+    CHECK(separate_non_moving_space);
   } else if (IsMovingGc(foreground_collector_type_)) {
     // Create bump pointer spaces.
     // We only to create the bump pointer if the foreground collector is a compacting GC.
@@ -606,6 +661,9 @@ Heap::Heap(size_t initial_size,
     large_object_space_ = nullptr;
   }
   if (large_object_space_ != nullptr) {
+    if (use_transparent_huge_pages_) {
+      large_object_space_->EnableHugePages();
+    }
     AddSpace(large_object_space_);
   }
   // Compute heap capacity. Continuous spaces are sorted in order of Begin().
@@ -694,6 +752,11 @@ Heap::Heap(size_t initial_size,
       semi_space_collector_ = new collector::SemiSpace(this);
       garbage_collectors_.push_back(semi_space_collector_);
     }
+    if (MayUseCollector(kCollectorTypeCMC)) {
+      mark_compact_collector_ = new collector::MarkCompact(this);
+      mark_compact_collector_->SetSpace(bump_pointer_space_);
+      garbage_collectors_.push_back(mark_compact_collector_);
+    }
     if (MayUseCollector(kCollectorTypeCC)) {
       concurrent_copying_collector_ = new collector::ConcurrentCopying(this,
                                                                        /*young_gen=*/false,
@@ -795,6 +858,7 @@ space::MallocSpace* Heap::CreateMallocSpaceFromMemMap(MemMap&& mem_map,
                                                           growth_limit,
                                                           capacity,
                                                           low_memory_mode_,
+                                                          use_rosalloc_per_cpu_runs_,
                                                           can_move_objects);
   } else {
     malloc_space = space::DlMallocSpace::CreateFromMemMap(std::move(mem_map),
@@ -1045,6 +1109,9 @@ void Heap::AddSpace(space::Space* space) {
       CHECK(mark_bitmap != nullptr);
       live_bitmap_->AddContinuousSpaceBitmap(live_bitmap);
       mark_bitmap_->AddContinuousSpaceBitmap(mark_bitmap);
+    } else if (mark_bitmap != nullptr && space->IsBumpPointerSpace()) {
+      // A bump pointer space compacted by the mark-compact collector is only marked.
+      mark_bitmap_->AddContinuousSpaceBitmap(mark_bitmap);
     }
     continuous_spaces_.push_back(continuous_space);
     // Ensure that spaces remain sorted in increasing order of start address.
@@ -1086,6 +1153,8 @@ void Heap::RemoveSpace(space::Space* space) {
       DCHECK(mark_bitmap != nullptr);
       live_bitmap_->RemoveContinuousSpaceBitmap(live_bitmap);
       mark_bitmap_->RemoveContinuousSpaceBitmap(mark_bitmap);
+    } else if (mark_bitmap != nullptr && space->IsBumpPointerSpace()) {
+      mark_bitmap_->RemoveContinuousSpaceBitmap(mark_bitmap);
     }
     auto it = std::find(continuous_spaces_.begin(), continuous_spaces_.end(), continuous_space);
     DCHECK(it != continuous_spaces_.end());
@@ -1511,6 +1580,16 @@ void Heap::TrimSpaces(Thread* self) {
         total_alloc_space_size += malloc_space->Size();
       }
     }
+    if (region_space_ != nullptr && !CareAboutPauseTimes()) {
+      // The prefaulted regions only help a process that is allocating, give them back. With
+      // transparent huge pages, this is also where the huge pages kept by ClearFromSpace are
+      // split, since compaction will not reuse them before the process is in use again.
+      managed_reclaimed += region_space_->ReleasePrefaultedRegions();
+    }
+    if (large_object_space_ != nullptr) {
+      // Drop the pages cached for reuse by the large objects.
+      managed_reclaimed += large_object_space_->Trim();
+    }
   }
   total_alloc_space_allocated = GetBytesAllocated();
   if (large_object_space_ != nullptr) {
@@ -2148,7 +2227,8 @@ void Heap::ChangeCollector(CollectorType collector_type) {
         }
         break;
       }
-      case kCollectorTypeSS: {
+      case kCollectorTypeSS:
+      case kCollectorTypeCMC: {
         gc_plan_.push_back(collector::kGcTypeFull);
         if (use_tlab_) {
           ChangeAllocator(kAllocatorTypeTLAB);
@@ -2636,6 +2716,9 @@ collector::GcType Heap::CollectGarbageInternal(collector::GcType gc_type,
         semi_space_collector_->SetSwapSemiSpaces(true);
         collector = semi_space_collector_;
         break;
+      case kCollectorTypeCMC:
+        collector = mark_compact_collector_;
+        break;
       case kCollectorTypeCC:
         if (use_generational_cc_) {
           // TODO: Other threads must do the flip checkpoint before they start poking at
@@ -2649,7 +2732,7 @@ collector::GcType Heap::CollectGarbageInternal(collector::GcType gc_type,
       default:
         LOG(FATAL) << "Invalid collector type " << static_cast<size_t>(collector_type_);
     }
-    if (collector != active_concurrent_copying_collector_) {
+    if (collector == semi_space_collector_) {
       temp_space_->GetMemMap()->Protect(PROT_READ | PROT_WRITE);
       if (kIsDebugBuild) {
         // Try to read each page of the memory map in case mprotect didn't work properly b/19894268.
@@ -2671,6 +2754,7 @@ collector::GcType Heap::CollectGarbageInternal(collector::GcType gc_type,
   collector->Run(gc_cause, clear_soft_references || runtime->IsZygote());
   IncrementFreedEver();
   RequestTrim(self);
+  RequestRegionPrefault(self);
   // Collect cleared references.
   SelfDeletingTask* clear = reference_processor_->CollectClearedReferences(self);
   // Grow the heap so that we know when to perform the next GC.
@@ -2726,6 +2810,20 @@ void Heap::LogGC(GcCause gc_cause, collector::GarbageCollector* collector) {
               << percent_free << "% free, " << PrettySize(current_heap_size) << "/"
               << PrettySize(total_memory) << ", " << "paused " << pause_string.str()
               << " total " << PrettyDuration((duration / 1000) * 1000);
+    if (gc_cpu_percent_target_ != 0.0) {
+      MutexLock mu(Thread::Current(), process_state_update_lock_);
+      LOG(INFO) << "Heap sized for " << gc_cpu_percent_target_ << "% GC CPU time: allocating "
+                << PrettySize(static_cast<uint64_t>(adaptive_heap_sizer_.GetAllocationRate()))
+                << "/s of mutator CPU time, GC "
+                << PrettyDuration(adaptive_heap_sizer_.GetGcCpuTimeNs()) << " CPU (sticky "
+                << PrettyDuration(adaptive_heap_sizer_.GetStickyGcCpuTimeNs()) << "), "
+                << PrettySize(adaptive_heap_sizer_.GetGrowBytes()) << " free after GC";
+    }
+    if (string_dedup_stats_ != nullptr) {
+      std::ostringstream oss;
+      string_dedup_stats_->Dump(oss);
+      LOG(INFO) << oss.str();
+    }
     VLOG(heap) << Dumpable<TimingLogger>(*current_gc_iteration_.GetTimings());
   }
 }
@@ -2817,12 +2915,59 @@ class ScanVisitor {
   }
 };
 
+// References to dead objects found by the threads verifying the heap in parallel. Explaining a
+// failure visits the roots, so the thread running the verification explains the first failures
+// once the other threads are done, and only counts the others.
+class VerifyFailureBuffer {
+ public:
+  struct Failure {
+    mirror::Object* obj;
+    mirror::Object* ref;
+    MemberOffset offset;
+  };
+
+  VerifyFailureBuffer() : lock_("heap verification failure lock", kGenericBottomLock) {}
+
+  void Add(mirror::Object* obj, mirror::Object* ref, MemberOffset offset) REQUIRES(!lock_) {
+    MutexLock mu(Thread::Current(), lock_);
+    if (failures_.size() < Heap::kMaxExplainedVerifyFailures) {
+      failures_.push_back({obj, ref, offset});
+    }
+    ++num_failures_;
+  }
+
+  std::vector<Failure> GetFailures() REQUIRES(!lock_) {
+    MutexLock mu(Thread::Current(), lock_);
+    return failures_;
+  }
+
+  size_t GetNumFailures() REQUIRES(!lock_) {
+    MutexLock mu(Thread::Current(), lock_);
+    return num_failures_;
+  }
+
+ private:
+  Mutex lock_;
+  std::vector<Failure> failures_ GUARDED_BY(lock_);
+  size_t num_failures_ GUARDED_BY(lock_) = 0u;
+};
+
 // Verify a reference from an object.
 class VerifyReferenceVisitor : public SingleRootVisitor {
  public:
-  VerifyReferenceVisitor(Thread* self, Heap* heap, size_t* fail_count, bool verify_referent)
+  // With `failures`, the references to dead objects are recorded there rather than counted in
+  // `fail_count` and explained.
+  VerifyReferenceVisitor(Thread* self,
+                         Heap* heap,
+                         size_t* fail_count,
+                         bool verify_referent,
+                         VerifyFailureBuffer* failures = nullptr)
       REQUIRES_SHARED(Locks::mutator_lock_)
-      : self_(self), heap_(heap), fail_count_(fail_count), verify_referent_(verify_referent) {
+      : self_(self),
+        heap_(heap),
+        fail_count_(fail_count),
+        verify_referent_(verify_referent),
+        failures_(failures) {
     CHECK_EQ(self_, Thread::Current());
   }
 
@@ -2866,15 +3011,10 @@ class VerifyReferenceVisitor : public SingleRootVisitor {
     }
   }
 
- private:
+  // Count and explain a reference from `obj`, or from a root if it is null, to the dead `ref`.
   // TODO: Fix the no thread safety analysis.
-  // Returns false on failure.
-  bool VerifyReference(mirror::Object* obj, mirror::Object* ref, MemberOffset offset) const
+  void ReportFailure(mirror::Object* obj, mirror::Object* ref, MemberOffset offset) const
       NO_THREAD_SAFETY_ANALYSIS {
-    if (ref == nullptr || IsLive(ref)) {
-      // Verify that the reference is live.
-      return true;
-    }
     CHECK_EQ(self_, Thread::Current());  // fail_count_ is private to the calling thread.
     *fail_count_ += 1;
     if (*fail_count_ == 1) {
@@ -2961,6 +3101,22 @@ class VerifyReferenceVisitor : public SingleRootVisitor {
       RootMatchesObjectVisitor visitor2(ref);
       Runtime::Current()->VisitRoots(&visitor2);
     }
+  }
+
+ private:
+  // TODO: Fix the no thread safety analysis.
+  // Returns false on failure.
+  bool VerifyReference(mirror::Object* obj, mirror::Object* ref, MemberOffset offset) const
+      NO_THREAD_SAFETY_ANALYSIS {
+    if (ref == nullptr || IsLive(ref)) {
+      // Verify that the reference is live.
+      return true;
+    }
+    if (failures_ != nullptr) {
+      failures_->Add(obj, ref, offset);
+    } else {
+      ReportFailure(obj, ref, offset);
+    }
     return false;
   }
 
@@ -2968,18 +3124,27 @@ class VerifyReferenceVisitor : public SingleRootVisitor {
   Heap* const heap_;
   size_t* const fail_count_;
   const bool verify_referent_;
+  VerifyFailureBuffer* const failures_;
 };
 
 // Verify all references within an object, for use with HeapBitmap::Visit.
 class VerifyObjectVisitor {
  public:
-  VerifyObjectVisitor(Thread* self, Heap* heap, size_t* fail_count, bool verify_referent)
-      : self_(self), heap_(heap), fail_count_(fail_count), verify_referent_(verify_referent) {}
+  VerifyObjectVisitor(Thread* self,
+                      Heap* heap,
+                      size_t* fail_count,
+                      bool verify_referent,
+                      VerifyFailureBuffer* failures = nullptr)
+      : self_(self),
+        heap_(heap),
+        fail_count_(fail_count),
+        verify_referent_(verify_referent),
+        failures_(failures) {}
 
   void operator()(mirror::Object* obj) REQUIRES_SHARED(Locks::mutator_lock_) {
     // Note: we are verifying the references in obj but not obj itself, this is because obj must
     // be live or else how did we find it in the live bitmap?
-    VerifyReferenceVisitor visitor(self_, heap_, fail_count_, verify_referent_);
+    VerifyReferenceVisitor visitor(self_, heap_, fail_count_, verify_referent_, failures_);
     // The class doesn't count as a reference but we should verify it anyways.
     obj->VisitReferences(visitor, visitor);
   }
@@ -3000,6 +3165,7 @@ class VerifyObjectVisitor {
   Heap* const heap_;
   size_t* const fail_count_;
   const bool verify_referent_;
+  VerifyFailureBuffer* const failures_;
 };
 
 void Heap::PushOnAllocationStackWithInternalGC(Thread* self, ObjPtr<mirror::Object>* obj) {
@@ -3041,7 +3207,7 @@ void Heap::PushOnThreadLocalAllocationStackWithInternalGC(Thread* self,
 }
 
 // Must do this with mutators suspended since we are directly accessing the allocation stacks.
-size_t Heap::VerifyHeapReferences(bool verify_referents) {
+size_t Heap::VerifyHeapReferences(bool verify_referents, size_t* num_explained) {
   Thread* self = Thread::Current();
   Locks::mutator_lock_->AssertExclusiveHeld(self);
   // Lets sort our allocation stacks so that we can efficiently binary search them.
@@ -3057,7 +3223,16 @@ size_t Heap::VerifyHeapReferences(bool verify_referents) {
   // 2. Allocated during the GC (pre sweep GC verification).
   // We don't want to verify the objects in the live stack since they themselves may be
   // pointing to dead objects if they are not reachable.
-  VisitObjectsPaused(visitor);
+  // All the mutators are suspended, so use all the parallel GC threads. The concurrent copying
+  // collector does not verify the heap around its collections, so the region space is only walked
+  // by the serial verification.
+  const size_t thread_count = thread_pool_ != nullptr ? parallel_gc_threads_ + 1 : 1;
+  size_t num_unexplained = 0u;
+  if (kParallelHeapVerification && thread_count > 1 && region_space_ == nullptr) {
+    num_unexplained = VerifyObjectsInParallel(self, thread_count, verify_referents, &fail_count);
+  } else {
+    VisitObjectsPaused(visitor);
+  }
   // Verify the roots:
   visitor.VerifyRoots();
   if (visitor.GetFailureCount() > 0) {
@@ -3073,9 +3248,82 @@ size_t Heap::VerifyHeapReferences(bool verify_referents) {
     }
     DumpSpaces(LOG_STREAM(ERROR));
   }
+  if (num_explained != nullptr) {
+    *num_explained = visitor.GetFailureCount() - num_unexplained;
+  }
   return visitor.GetFailureCount();
 }
 
+size_t Heap::VerifyObjectsInParallel(Thread* self,
+                                     size_t thread_count,
+                                     bool verify_referents,
+                                     size_t* fail_count) {
+  DCHECK(region_space_ == nullptr);
+  VerifyFailureBuffer failures;
+  auto add_task = [&](std::function<void(VerifyObjectVisitor&)>&& walk) {
+    // No thread safety analysis since the workers verify on behalf of this thread, which holds
+    // the mutator lock exclusively until they are done.
+    thread_pool_->AddTask(self, new FunctionTask(
+        [this, &failures, verify_referents, walk = std::move(walk)](Thread* worker)
+            NO_THREAD_SAFETY_ANALYSIS {
+          VerifyObjectVisitor visitor(worker, this, nullptr, verify_referents, &failures);
+          walk(visitor);
+        }));
+  };
+  const size_t num_chunks = thread_count * kHeapVerificationChunksPerThread;
+  // The spaces can't be added or removed while the mutators are suspended, so the bitmaps can be
+  // listed without the heap bitmap lock.
+  auto add_bitmap_tasks = [&](auto* bitmap) {
+    const uintptr_t heap_begin = bitmap->HeapBegin();
+    const uintptr_t heap_limit = bitmap->HeapLimit();
+    const size_t chunk_size = RoundUp(
+        std::max((heap_limit - heap_begin) / num_chunks, kMinimumHeapVerificationChunkSize),
+        kPageSize);
+    for (uintptr_t begin = heap_begin; begin < heap_limit; begin += chunk_size) {
+      const uintptr_t end = std::min(begin + chunk_size, heap_limit);
+      add_task([bitmap, begin, end](VerifyObjectVisitor& visitor) NO_THREAD_SAFETY_ANALYSIS {
+        bitmap->VisitMarkedRange(begin, end, visitor);
+      });
+    }
+  };
+  for (accounting::ContinuousSpaceBitmap* bitmap : live_bitmap_->continuous_space_bitmaps_) {
+    add_bitmap_tasks(bitmap);
+  }
+  for (accounting::LargeObjectBitmap* bitmap : live_bitmap_->large_object_bitmaps_) {
+    add_bitmap_tasks(bitmap);
+  }
+  thread_pool_->SetMaxActiveWorkers(thread_count - 1);
+  thread_pool_->StartWorkers(self);
+  {
+    // Meanwhile, verify the objects that are not in a bitmap. The bump pointer space walk takes
+    // the space block lock, so do this before taking the heap bitmap lock.
+    VerifyObjectVisitor visitor(self, this, nullptr, verify_referents, &failures);
+    if (bump_pointer_space_ != nullptr) {
+      bump_pointer_space_->Walk(visitor);
+    }
+    VisitAllocationStackObjects(visitor);
+  }
+  {
+    // Help the workers with the bitmaps, as VisitObjectsPaused would.
+    ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    thread_pool_->Wait(self, /* do_work= */ true, /* may_hold_locks= */ true);
+  }
+  thread_pool_->StopWorkers(self);
+
+  // Explain the first failures, with all the workers stopped.
+  VerifyReferenceVisitor reporter(self, this, fail_count, verify_referents);
+  const std::vector<VerifyFailureBuffer::Failure> recorded_failures = failures.GetFailures();
+  for (const VerifyFailureBuffer::Failure& failure : recorded_failures) {
+    reporter.ReportFailure(failure.obj, failure.ref, failure.offset);
+  }
+  const size_t num_unexplained = failures.GetNumFailures() - recorded_failures.size();
+  if (num_unexplained != 0u) {
+    LOG(ERROR) << num_unexplained << " more references to dead objects not shown";
+    *fail_count += num_unexplained;
+  }
+  return num_unexplained;
+}
+
 class VerifyReferenceCardVisitor {
  public:
   VerifyReferenceCardVisitor(Heap* heap, bool* failed)
@@ -3266,9 +3514,10 @@ void Heap::ProcessCards(TimingLogger* timings,
       TimingLogger::ScopedTiming t2("AllocSpaceClearCards", timings);
       if (clear_alloc_space_cards) {
         uint8_t* end = space->End();
-        if (space->IsImageSpace()) {
-          // Image space end is the end of the mirror objects, it is not necessarily page or card
-          // aligned. Align up so that the check in ClearCardRange does not fail.
+        if (space->IsImageSpace() || space->IsBumpPointerSpace()) {
+          // Image space end is the end of the mirror objects, and bump pointer space end is the
+          // end of the last allocation, they are not necessarily page or card aligned. Align up
+          // so that the check in ClearCardRange does not fail.
           end = AlignUp(end, accounting::CardTable::kCardSize);
         }
         card_table_->ClearCardRange(space->Begin(), end);
@@ -3466,6 +3715,24 @@ void Heap::DumpForSigQuit(std::ostream& os) {
   os << "Heap: " << GetPercentFree() << "% free, " << PrettySize(GetBytesAllocated()) << "/"
      << PrettySize(GetTotalMemory()) << "; " << GetObjectsAllocated() << " objects\n";
   DumpGcPerformanceInfo(os);
+  if (allocation_sampler_ != nullptr) {
+    allocation_sampler_->DumpSummary(os);
+    if (!allocation_profile_file_.empty()) {
+      std::string error_msg;
+      if (allocation_sampler_->DumpProfile(allocation_profile_file_, &error_msg)) {
+        os << "Wrote allocation profile to " << allocation_profile_file_ << "\n";
+      } else {
+        os << "Failed to write allocation profile: " << error_msg << "\n";
+      }
+    }
+  }
+  if (heap_census_ != nullptr) {
+    heap_census_->Dump(os, kMaxCensusClassesToDump);
+  }
+  if (string_dedup_stats_ != nullptr) {
+    string_dedup_stats_->Dump(os);
+    os << "\n";
+  }
 }
 
 size_t Heap::GetPercentFree() {
@@ -3570,6 +3837,15 @@ void Heap::GrowForUtilization(collector::GarbageCollector* collector_ran,
       grow_bytes = 0;
     }
   }
+  if (gc_cpu_percent_target_ != 0.0) {
+    // The sticky/non-sticky choice above still applies, only the heap size changes.
+    grow_bytes = adaptive_heap_sizer_.OnGcEnd(gc_type == collector::kGcTypeSticky,
+                                              GetBytesAllocatedEver(),
+                                              GetTotalGcCpuTime(),
+                                              ProcessCpuNanoTime(),
+                                              GetMaxMemory());
+    target_size = bytes_allocated + static_cast<uint64_t>(grow_bytes * multiplier);
+  }
   CHECK_LE(target_size, std::numeric_limits<size_t>::max());
   if (!ignore_target_footprint_) {
     SetIdealFootprint(target_size);
@@ -3820,6 +4096,43 @@ void Heap::RequestTrim(Thread* self) {
   task_processor_->AddTask(self, added_task);
 }
 
+class Heap::RegionPrefaultTask : public HeapTask {
+ public:
+  RegionPrefaultTask() : HeapTask(NanoTime()) { }
+  void Run(Thread* self) override {
+    gc::Heap* heap = Runtime::Current()->GetHeap();
+    size_t num_prefaulted = heap->region_space_->PrefaultFreeRegions(heap->num_prefaulted_regions_);
+    VLOG(heap) << "Prefaulted " << num_prefaulted << " free regions";
+    heap->ClearPendingRegionPrefault(self);
+  }
+};
+
+void Heap::ClearPendingRegionPrefault(Thread* self) {
+  MutexLock mu(self, *pending_task_lock_);
+  pending_region_prefault_ = nullptr;
+}
+
+void Heap::RequestRegionPrefault(Thread* self) {
+  // Only keep the pool filled while the process cares about pauses, an idle process gives the
+  // pool back in TrimSpaces.
+  if (region_space_ == nullptr ||
+      num_prefaulted_regions_ == 0u ||
+      !CareAboutPauseTimes() ||
+      !CanAddHeapTask(self)) {
+    return;
+  }
+  RegionPrefaultTask* added_task = nullptr;
+  {
+    MutexLock mu(self, *pending_task_lock_);
+    if (pending_region_prefault_ != nullptr) {
+      return;
+    }
+    added_task = new RegionPrefaultTask();
+    pending_region_prefault_ = added_task;
+  }
+  task_processor_->AddTask(self, added_task);
+}
+
 void Heap::IncrementNumberOfBytesFreedRevoke(size_t freed_bytes_revoke) {
   size_t previous_num_bytes_freed_revoke =
       num_bytes_freed_revoke_.fetch_add(freed_bytes_revoke, std::memory_order_relaxed);
@@ -4047,6 +4360,9 @@ void Heap::VisitAllocationRecords(RootVisitor* visitor) const {
       GetAllocationRecords()->VisitRoots(visitor);
     }
   }
+  if (allocation_sampler_ != nullptr) {
+    allocation_sampler_->VisitRoots(visitor);
+  }
 }
 
 void Heap::SweepAllocationRecords(IsMarkedVisitor* visitor) const {
@@ -4056,6 +4372,9 @@ void Heap::SweepAllocationRecords(IsMarkedVisitor* visitor) const {
       GetAllocationRecords()->SweepAllocationRecords(visitor);
     }
   }
+  if (allocation_sampler_ != nullptr) {
+    allocation_sampler_->Sweep(visitor);
+  }
 }
 
 void Heap::AllowNewAllocationRecords() const {
@@ -4065,6 +4384,9 @@ void Heap::AllowNewAllocationRecords() const {
   if (allocation_records != nullptr) {
     allocation_records->AllowNewAllocationRecords();
   }
+  if (allocation_sampler_ != nullptr) {
+    allocation_sampler_->Allow();
+  }
 }
 
 void Heap::DisallowNewAllocationRecords() const {
@@ -4074,6 +4396,9 @@ void Heap::DisallowNewAllocationRecords() const {
   if (allocation_records != nullptr) {
     allocation_records->DisallowNewAllocationRecords();
   }
+  if (allocation_sampler_ != nullptr) {
+    allocation_sampler_->Disallow();
+  }
 }
 
 void Heap::BroadcastForNewAllocationRecords() const {
@@ -4085,6 +4410,9 @@ void Heap::BroadcastForNewAllocationRecords() const {
   if (allocation_records != nullptr) {
     allocation_records->BroadcastForNewAllocationRecords();
   }
+  if (allocation_sampler_ != nullptr) {
+    allocation_sampler_->Broadcast(/* broadcast_for_checkpoint= */ false);
+  }
 }
 
 void Heap::CheckGcStressMode(Thread* self, ObjPtr<mirror::Object>* obj) {
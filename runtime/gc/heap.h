@@ -31,6 +31,7 @@
 #include "base/runtime_debug.h"
 #include "base/safe_map.h"
 #include "base/time_utils.h"
+#include "gc/adaptive_heap_sizer.h"
 #include "gc/collector/gc_type.h"
 #include "gc/collector/iteration.h"
 #include "gc/collector_type.h"
@@ -68,6 +69,9 @@ namespace gc {
 
 class AllocationListener;
 class AllocRecordObjectMap;
+class AllocationSampler;
+class HeapCensus;
+class StringDedupStats;
 class GcPauseListener;
 class HeapTask;
 class ReferenceProcessor;
@@ -87,6 +91,7 @@ class RememberedSet;
 namespace collector {
 class ConcurrentCopying;
 class GarbageCollector;
+class MarkCompact;
 class MarkSweep;
 class SemiSpace;
 }  // namespace collector
@@ -142,6 +147,8 @@ class Heap {
   static constexpr size_t kDefaultLongPauseLogThreshold = MsToNs(5);
   static constexpr size_t kDefaultLongGCLogThreshold = MsToNs(100);
   static constexpr size_t kDefaultTLABSize = 32 * KB;
+  // References to dead objects explained in the log by the parallel heap verification.
+  static constexpr size_t kMaxExplainedVerifyFailures = 16;
   static constexpr double kDefaultTargetUtilization = 0.75;
   static constexpr double kDefaultHeapGrowthMultiplier = 2.0;
   // Primitive arrays larger than this size are put in the large object space.
@@ -224,6 +231,14 @@ class Heap {
        uint64_t min_interval_homogeneous_space_compaction_by_oom,
        bool dump_region_info_before_gc,
        bool dump_region_info_after_gc,
+       size_t region_prefault_pool_size,
+       bool use_transparent_huge_pages,
+       size_t allocation_sampling_interval,
+       const std::string& allocation_profile_file,
+       double gc_cpu_percent_target,
+       bool use_heap_census,
+       bool use_rosalloc_per_cpu_runs,
+       bool use_string_dedup_stats,
        space::ImageSpaceLoadingOrder image_space_loading_order);
 
   ~Heap();
@@ -332,8 +347,10 @@ class Heap {
 
   // Check sanity of all live references.
   void VerifyHeap() REQUIRES(!Locks::heap_bitmap_lock_);
-  // Returns how many failures occured.
-  size_t VerifyHeapReferences(bool verify_referents = true)
+  // Returns how many failures occured. When the heap is verified in parallel, only the first
+  // kMaxExplainedVerifyFailures references to dead objects are explained in the log, the others
+  // are only counted. The number of failures explained is stored in `num_explained` if not null.
+  size_t VerifyHeapReferences(bool verify_referents = true, size_t* num_explained = nullptr)
       REQUIRES(Locks::mutator_lock_, !*gc_complete_lock_);
   bool VerifyMissingCardMarks()
       REQUIRES(Locks::heap_bitmap_lock_, Locks::mutator_lock_);
@@ -359,6 +376,12 @@ class Heap {
   // Returns true if there is any chance that the object (obj) will move.
   bool IsMovableObject(ObjPtr<mirror::Object> obj) const REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Returns true if classes may be allocated in a moving space. The mark-compact collector updates
+  // references before it moves objects, so it cannot follow an already updated class pointer.
+  bool CanMoveClasses() const {
+    return kMovingClasses && foreground_collector_type_ != kCollectorTypeCMC;
+  }
+
   // Enables us to compacting GC until objects are released.
   void IncrementDisableMovingGC(Thread* self) REQUIRES(!*gc_complete_lock_);
   void DecrementDisableMovingGC(Thread* self) REQUIRES(!*gc_complete_lock_);
@@ -519,6 +542,31 @@ class Heap {
     return low_memory_mode_;
   }
 
+  // Returns true if RosAlloc caches its runs per CPU instead of per thread.
+  bool UseRosAllocPerCpuRuns() const {
+    return use_rosalloc_per_cpu_runs_;
+  }
+
+  // Returns true if the heap is backed by transparent huge pages.
+  bool UseTransparentHugePages() const {
+    return use_transparent_huge_pages_;
+  }
+
+  // Returns the sampling allocation profiler, or null if it is not enabled.
+  AllocationSampler* GetAllocationSampler() const {
+    return allocation_sampler_.get();
+  }
+
+  // Returns the per-class census of the last full GC, or null if it is not enabled.
+  HeapCensus* GetHeapCensus() const {
+    return heap_census_.get();
+  }
+
+  // Returns the duplicate string statistics of the last full GC, or null if they are not enabled.
+  StringDedupStats* GetStringDedupStats() const {
+    return string_dedup_stats_.get();
+  }
+
   // Returns the heap growth multiplier, this affects how much we grow the heap after a GC.
   // Scales heap growth, min free, and max free.
   double HeapGrowthMultiplier() const;
@@ -826,6 +874,9 @@ class Heap {
   // Request an asynchronous trim.
   void RequestTrim(Thread* self) REQUIRES(!*pending_task_lock_);
 
+  // Request the asynchronous prefaulting of the next free regions of the region space.
+  void RequestRegionPrefault(Thread* self) REQUIRES(!*pending_task_lock_);
+
   // Request asynchronous GC.
   void RequestConcurrentGC(Thread* self, GcCause cause, bool force_full)
       REQUIRES(!*pending_task_lock_);
@@ -927,6 +978,7 @@ class Heap {
   class ConcurrentGCTask;
   class CollectorTransitionTask;
   class HeapTrimTask;
+  class RegionPrefaultTask;
   class TriggerPostForkCCGcTask;
 
   // Compact source space to target space. Returns the collector used.
@@ -935,7 +987,8 @@ class Heap {
                                        GcCause gc_cause)
       REQUIRES(Locks::mutator_lock_);
 
-  void LogGC(GcCause gc_cause, collector::GarbageCollector* collector);
+  void LogGC(GcCause gc_cause, collector::GarbageCollector* collector)
+      REQUIRES(!process_state_update_lock_);
   void StartGC(Thread* self, GcCause cause, CollectorType collector_type)
       REQUIRES(!*gc_complete_lock_);
   void FinishGC(Thread* self, collector::GcType gc_type) REQUIRES(!*gc_complete_lock_);
@@ -969,19 +1022,22 @@ class Heap {
         allocator_type != kAllocatorTypeTLAB &&
         allocator_type != kAllocatorTypeRegion;
   }
-  static ALWAYS_INLINE bool AllocatorMayHaveConcurrentGC(AllocatorType allocator_type) {
+  ALWAYS_INLINE bool AllocatorMayHaveConcurrentGC(AllocatorType allocator_type) const {
     if (kUseReadBarrier) {
       // Read barrier may have the TLAB allocator but is always concurrent. TODO: clean this up.
       return true;
     }
-    return
-        allocator_type != kAllocatorTypeTLAB &&
-        allocator_type != kAllocatorTypeBumpPointer;
+    if (allocator_type != kAllocatorTypeTLAB && allocator_type != kAllocatorTypeBumpPointer) {
+      return true;
+    }
+    // The bump pointer allocators only back a concurrent collector with CC or mark-compact.
+    return collector_type_ == kCollectorTypeCC || collector_type_ == kCollectorTypeCMC;
   }
   static bool IsMovingGc(CollectorType collector_type) {
     return
         collector_type == kCollectorTypeCC ||
         collector_type == kCollectorTypeSS ||
+        collector_type == kCollectorTypeCMC ||
         collector_type == kCollectorTypeCCBackground ||
         collector_type == kCollectorTypeHomogeneousSpaceCompact;
   }
@@ -1158,6 +1214,7 @@ class Heap {
 
   void ClearConcurrentGCRequest();
   void ClearPendingTrim(Thread* self) REQUIRES(!*pending_task_lock_);
+  void ClearPendingRegionPrefault(Thread* self) REQUIRES(!*pending_task_lock_);
   void ClearPendingCollectorTransition(Thread* self) REQUIRES(!*pending_task_lock_);
 
   // What kind of concurrency behavior is the runtime after? Currently true for concurrent mark
@@ -1165,6 +1222,7 @@ class Heap {
   bool IsGcConcurrent() const ALWAYS_INLINE {
     return collector_type_ == kCollectorTypeCC ||
         collector_type_ == kCollectorTypeCMS ||
+        collector_type_ == kCollectorTypeCMC ||
         collector_type_ == kCollectorTypeCCBackground;
   }
 
@@ -1181,6 +1239,19 @@ class Heap {
   template <typename Visitor>
   ALWAYS_INLINE void VisitObjectsInternalRegionSpace(Visitor&& visitor)
       REQUIRES(Locks::mutator_lock_, !Locks::heap_bitmap_lock_, !*gc_complete_lock_);
+  template <typename Visitor>
+  ALWAYS_INLINE void VisitAllocationStackObjects(Visitor&& visitor)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Verify the references of the objects of the heap for VerifyHeapReferences, with the heap
+  // thread pool splitting the spaces among `thread_count` threads. Adds the number of references
+  // to dead objects to `fail_count`, and returns how many of them were not explained. The heap
+  // must not have a region space.
+  size_t VerifyObjectsInParallel(Thread* self,
+                                 size_t thread_count,
+                                 bool verify_referents,
+                                 size_t* fail_count)
+      REQUIRES(Locks::mutator_lock_, !Locks::heap_bitmap_lock_, !*gc_complete_lock_);
 
   void UpdateGcCountRateHistograms() REQUIRES(gc_complete_lock_);
 
@@ -1280,6 +1351,9 @@ class Heap {
   // Boolean for if we are in low memory mode.
   const bool low_memory_mode_;
 
+  // Whether RosAlloc caches its runs per CPU rather than per thread.
+  const bool use_rosalloc_per_cpu_runs_;
+
   // If we get a pause longer than long pause log threshold, then we print out the GC after it
   // finishes.
   const size_t long_pause_log_threshold_;
@@ -1364,6 +1438,12 @@ class Heap {
   Mutex process_state_update_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   size_t min_foreground_target_footprint_ GUARDED_BY(process_state_update_lock_);
 
+  // Percentage of CPU time the GC should take, set by -XX:GcCpuPercentTarget. When non-zero,
+  // GrowForUtilization sizes the heap with adaptive_heap_sizer_ instead of the target utilization
+  // and min/max free.
+  const double gc_cpu_percent_target_;
+  AdaptiveHeapSizer adaptive_heap_sizer_ GUARDED_BY(process_state_update_lock_);
+
   // When num_bytes_allocated_ exceeds this amount then a concurrent GC should be requested so that
   // it completes ahead of an allocation failing.
   // A multiple of this is also used to determine when to trigger a GC in response to native
@@ -1505,6 +1585,7 @@ class Heap {
 
   std::vector<collector::GarbageCollector*> garbage_collectors_;
   collector::SemiSpace* semi_space_collector_;
+  collector::MarkCompact* mark_compact_collector_;
   collector::ConcurrentCopying* active_concurrent_copying_collector_;
   collector::ConcurrentCopying* young_concurrent_copying_collector_;
   collector::ConcurrentCopying* concurrent_copying_collector_;
@@ -1540,6 +1621,7 @@ class Heap {
   // Active tasks which we can modify (change target time, desired collector type, etc..).
   CollectorTransitionTask* pending_collector_transition_ GUARDED_BY(pending_task_lock_);
   HeapTrimTask* pending_heap_trim_ GUARDED_BY(pending_task_lock_);
+  RegionPrefaultTask* pending_region_prefault_ GUARDED_BY(pending_task_lock_);
 
   // Whether or not we use homogeneous space compaction to avoid OOM errors.
   bool use_homogeneous_space_compaction_for_oom_;
@@ -1595,6 +1677,25 @@ class Heap {
   bool dump_region_info_before_gc_;
   bool dump_region_info_after_gc_;
 
+  // Number of free regions of the region space to keep prefaulted after a GC, set by
+  // -XX:RegionPrefaultPoolSize. Zero disables prefaulting.
+  const size_t num_prefaulted_regions_;
+
+  // Turned on by -XX:UseTransparentHugePages to back the region space, the large object space
+  // and the JIT code cache with transparent huge pages.
+  const bool use_transparent_huge_pages_;
+
+  // Sampling allocation profiler, created when -XX:AllocationSamplingInterval is set.
+  std::unique_ptr<AllocationSampler> allocation_sampler_;
+  // Where the sampled profile is written on SIGQUIT, set by -XX:AllocationProfileFile.
+  const std::string allocation_profile_file_;
+
+  // Per-class census taken by full GCs, created when -XX:HeapCensus is set.
+  std::unique_ptr<HeapCensus> heap_census_;
+
+  // Duplicate string statistics taken by full CC GCs, created when -XX:StringDedupStats is set.
+  std::unique_ptr<StringDedupStats> string_dedup_stats_;
+
   // Boot image spaces.
   std::vector<space::ImageSpace*> boot_image_spaces_;
 
@@ -1612,6 +1713,7 @@ class Heap {
   friend class CollectorTransitionTask;
   friend class collector::GarbageCollector;
   friend class collector::ConcurrentCopying;
+  friend class collector::MarkCompact;
   friend class collector::MarkSweep;
   friend class collector::SemiSpace;
   friend class GCCriticalSection;
@@ -1621,6 +1723,7 @@ class Heap {
   friend class VerifyReferenceCardVisitor;
   friend class VerifyReferenceVisitor;
   friend class VerifyObjectVisitor;
+  friend class ParallelSweepHeapTest;  // For CollectGarbageInternal.
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(Heap);
 };
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_HEAP_CENSUS_INL_H_
+#define ART_RUNTIME_GC_HEAP_CENSUS_INL_H_
+
+#include "heap_census.h"
+
+#include "mirror/object-inl.h"
+
+namespace art {
+namespace gc {
+
+inline void HeapCensus::Table::AddObject(mirror::Object* obj) {
+  // The class is read without a read barrier, HeapCensus::Publish finds where it is now.
+  Entry& entry = entries_[obj->GetClass<kVerifyNone, kWithoutReadBarrier>()];
+  ++entry.instances;
+  entry.bytes += obj->SizeOf<kVerifyNone>();
+}
+
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_HEAP_CENSUS_INL_H_
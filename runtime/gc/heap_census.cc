@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "heap_census.h"
+
+#include <algorithm>
+#include <ostream>
+
+#include "base/utils.h"
+#include "dex/descriptors_names.h"
+#include "mirror/class-inl.h"
+#include "object_callbacks.h"
+#include "thread-current-inl.h"
+
+namespace art {
+namespace gc {
+
+void HeapCensus::Table::Merge(const Table& other) {
+  for (const auto& pair : other.entries_) {
+    Entry& entry = entries_[pair.first];
+    entry.instances += pair.second.instances;
+    entry.bytes += pair.second.bytes;
+  }
+}
+
+HeapCensus::HeapCensus()
+    : lock_("heap census lock", kGenericBottomLock),
+      num_censuses_(0u) {}
+
+void HeapCensus::Publish(const Table& table,
+                         IsMarkedVisitor* visitor,
+                         const std::string& collector_name) {
+  // The same class may have been counted at its old and new address, and classes of different
+  // class loaders may share a descriptor. Merge them by descriptor.
+  std::unordered_map<std::string, size_t> indexes;
+  std::vector<ClassCount> class_counts;
+  std::string temp;
+  for (const auto& pair : table.entries_) {
+    mirror::Object* klass = visitor->IsMarked(pair.first);
+    DCHECK(klass != nullptr) << "Unmarked class of a marked object";
+    if (klass == nullptr) {
+      continue;
+    }
+    std::string descriptor = klass->AsClass()->GetDescriptor(&temp);
+    auto it = indexes.find(descriptor);
+    if (it == indexes.end()) {
+      it = indexes.emplace(descriptor, class_counts.size()).first;
+      class_counts.push_back({descriptor, 0u, 0u});
+    }
+    class_counts[it->second].instances += pair.second.instances;
+    class_counts[it->second].bytes += pair.second.bytes;
+  }
+  std::sort(class_counts.begin(),
+            class_counts.end(),
+            [](const ClassCount& lhs, const ClassCount& rhs) { return lhs.bytes > rhs.bytes; });
+
+  MutexLock mu(Thread::Current(), lock_);
+  class_counts_ = std::move(class_counts);
+  collector_name_ = collector_name;
+  ++num_censuses_;
+}
+
+void HeapCensus::Dump(std::ostream& os, size_t max_classes) {
+  MutexLock mu(Thread::Current(), lock_);
+  if (num_censuses_ == 0u) {
+    os << "Heap census: no full collection yet\n";
+    return;
+  }
+  uint64_t total_instances = 0u;
+  uint64_t total_bytes = 0u;
+  for (const ClassCount& class_count : class_counts_) {
+    total_instances += class_count.instances;
+    total_bytes += class_count.bytes;
+  }
+  os << "Heap census of the last " << collector_name_ << ": " << total_instances
+     << " objects, " << PrettySize(total_bytes) << " in " << class_counts_.size()
+     << " classes\n";
+  const size_t num_classes = std::min(max_classes, class_counts_.size());
+  for (size_t i = 0; i != num_classes; ++i) {
+    const ClassCount& class_count = class_counts_[i];
+    os << "  " << PrettySize(class_count.bytes) << " in " << class_count.instances << " "
+       << PrettyDescriptor(class_count.descriptor.c_str()) << "\n";
+  }
+}
+
+std::vector<HeapCensus::ClassCount> HeapCensus::GetClassCounts() {
+  MutexLock mu(Thread::Current(), lock_);
+  return class_counts_;
+}
+
+}  // namespace gc
+}  // namespace art
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_HEAP_CENSUS_H_
+#define ART_RUNTIME_GC_HEAP_CENSUS_H_
+
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/mutex.h"
+
+namespace art {
+
+class IsMarkedVisitor;
+
+namespace mirror {
+class Class;
+class Object;
+}  // namespace mirror
+
+namespace gc {
+
+// Per-class instance counts and sizes of the objects marked by the last full collection, enabled
+// with -XX:HeapCensus.
+//
+// The collectors count the objects as they mark them, each marking thread in its own Table, and
+// merge the tables once marking is done. The census then names the classes, before the GC lets
+// them be unloaded or moved. Objects of the immune spaces, such as the boot image, are not
+// marked and therefore not counted.
+class HeapCensus {
+ public:
+  struct ClassCount {
+    std::string descriptor;
+    uint64_t instances;
+    uint64_t bytes;
+  };
+
+  // Counts of a marking thread, keyed by class. Not thread safe.
+  class Table {
+   public:
+    ALWAYS_INLINE void AddObject(mirror::Object* obj) REQUIRES_SHARED(Locks::mutator_lock_);
+
+    void Merge(const Table& other);
+
+    bool IsEmpty() const {
+      return entries_.empty();
+    }
+
+    void Clear() {
+      entries_.clear();
+    }
+
+   private:
+    struct Entry {
+      uint64_t instances = 0u;
+      uint64_t bytes = 0u;
+    };
+
+    std::unordered_map<mirror::Class*, Entry> entries_;
+
+    friend class HeapCensus;
+  };
+
+  HeapCensus();
+
+  // Replace the census with the counts of `table`. `visitor` gives the current address of the
+  // classes counted while marking, which must all be marked.
+  void Publish(const Table& table, IsMarkedVisitor* visitor, const std::string& collector_name)
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(!lock_);
+
+  // Print the classes with the most bytes, for SIGQUIT.
+  void Dump(std::ostream& os, size_t max_classes) REQUIRES(!lock_);
+
+  // Return the last census, sorted by decreasing bytes.
+  std::vector<ClassCount> GetClassCounts() REQUIRES(!lock_);
+
+ private:
+  Mutex lock_;
+  std::vector<ClassCount> class_counts_ GUARDED_BY(lock_);
+  std::string collector_name_ GUARDED_BY(lock_);
+  size_t num_censuses_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(HeapCensus);
+};
+
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_HEAP_CENSUS_H_
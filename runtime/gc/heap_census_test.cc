@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "heap_census-inl.h"
+
+#include <sstream>
+
+#include "class_root.h"
+#include "common_runtime_test.h"
+#include "handle_scope-inl.h"
+#include "mirror/class-alloc-inl.h"
+#include "mirror/class-inl.h"
+#include "mirror/object-inl.h"
+#include "mirror/string-alloc-inl.h"
+#include "object_callbacks.h"
+#include "scoped_thread_state_change-inl.h"
+
+namespace art {
+namespace gc {
+
+class HeapCensusTest : public CommonRuntimeTest {};
+
+// Every object is marked and none moved.
+class IdentityIsMarkedVisitor : public IsMarkedVisitor {
+ public:
+  mirror::Object* IsMarked(mirror::Object* obj) override {
+    return obj;
+  }
+};
+
+TEST_F(HeapCensusTest, CountMergeAndPublish) {
+  Thread* self = Thread::Current();
+  ScopedObjectAccess soa(self);
+  StackHandleScope<3> hs(self);
+  Handle<mirror::Object> object = hs.NewHandle(GetClassRoot<mirror::Object>()->AllocObject(self));
+  Handle<mirror::String> string1 =
+      hs.NewHandle(mirror::String::AllocFromModifiedUtf8(self, "a string of some length"));
+  Handle<mirror::String> string2 =
+      hs.NewHandle(mirror::String::AllocFromModifiedUtf8(self, "another string"));
+  ASSERT_TRUE(object != nullptr);
+  ASSERT_TRUE(string1 != nullptr);
+  ASSERT_TRUE(string2 != nullptr);
+
+  // Count as two marking threads would.
+  HeapCensus::Table table;
+  HeapCensus::Table other_table;
+  EXPECT_TRUE(table.IsEmpty());
+  table.AddObject(object.Get());
+  table.AddObject(string1.Get());
+  other_table.AddObject(string2.Get());
+  table.Merge(other_table);
+  EXPECT_FALSE(table.IsEmpty());
+
+  HeapCensus census;
+  IdentityIsMarkedVisitor visitor;
+  census.Publish(table, &visitor, "test collector");
+  std::vector<HeapCensus::ClassCount> class_counts = census.GetClassCounts();
+  ASSERT_EQ(2u, class_counts.size());
+  // The strings take more bytes than the object.
+  EXPECT_EQ("Ljava/lang/String;", class_counts[0].descriptor);
+  EXPECT_EQ(2u, class_counts[0].instances);
+  EXPECT_EQ(string1->SizeOf() + string2->SizeOf(), class_counts[0].bytes);
+  EXPECT_EQ("Ljava/lang/Object;", class_counts[1].descriptor);
+  EXPECT_EQ(1u, class_counts[1].instances);
+  EXPECT_EQ(object->SizeOf(), class_counts[1].bytes);
+
+  std::ostringstream oss;
+  census.Dump(oss, /* max_classes= */ 1u);
+  EXPECT_NE(oss.str().find("test collector"), std::string::npos) << oss.str();
+  EXPECT_NE(oss.str().find("java.lang.String"), std::string::npos) << oss.str();
+  EXPECT_EQ(oss.str().find("java.lang.Object"), std::string::npos) << oss.str();
+
+  // A new census replaces the last one.
+  table.Clear();
+  census.Publish(table, &visitor, "test collector");
+  EXPECT_TRUE(census.GetClassCounts().empty());
+}
+
+}  // namespace gc
+}  // namespace art
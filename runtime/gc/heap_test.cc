@@ -14,16 +14,28 @@
  * limitations under the License.
  */
 
+#include <atomic>
+#include <set>
+#include <vector>
+
 #include "class_linker-inl.h"
 #include "common_runtime_test.h"
 #include "gc/accounting/card_table-inl.h"
 #include "gc/accounting/space_bitmap-inl.h"
+#include "gc/scoped_gc_critical_section.h"
+#include "gc/space/bump_pointer_space.h"
+#include "gc/space/region_space.h"
 #include "handle_scope-inl.h"
+#include "jni/java_vm_ext.h"
+#include "mirror/array-alloc-inl.h"
 #include "mirror/class-inl.h"
 #include "mirror/object-inl.h"
 #include "mirror/object_array-alloc-inl.h"
 #include "mirror/object_array-inl.h"
+#include "object_callbacks.h"
 #include "scoped_thread_state_change-inl.h"
+#include "thread_list.h"
+#include "thread_pool.h"
 
 namespace art {
 namespace gc {
@@ -94,6 +106,39 @@ TEST_F(HeapTest, HeapBitmapCapacityTest) {
   bitmap.Set(fake_end_of_heap_object);
 }
 
+TEST_F(HeapTest, PrefaultFreeRegions) {
+  static constexpr size_t kNumRegions = 16;
+  static constexpr size_t kPoolRegions = 4;
+  MemMap mem_map = space::RegionSpace::CreateMemMap(
+      "prefault test region space",
+      kNumRegions * space::RegionSpace::kRegionSize,
+      /*requested_begin=*/ nullptr,
+      /*use_huge_pages=*/ false);
+  ASSERT_TRUE(mem_map.IsValid());
+  std::unique_ptr<space::RegionSpace> region_space(
+      space::RegionSpace::Create("prefault test region space",
+                                 std::move(mem_map),
+                                 /*use_generational_cc=*/ false,
+                                 /*use_huge_pages=*/ false));
+  size_t num_prefaulted = region_space->PrefaultFreeRegions(kPoolRegions);
+  if (kIsDebugBuild) {
+    // Free regions are protected in debug builds, so none are prefaulted.
+    EXPECT_EQ(0u, num_prefaulted);
+    EXPECT_EQ(0u, region_space->ReleasePrefaultedRegions());
+    return;
+  }
+  if (num_prefaulted == 0u) {
+    printf("WARNING: TEST DISABLED FOR KERNELS WITHOUT MADV_POPULATE_WRITE\n");
+    return;
+  }
+  EXPECT_EQ(kPoolRegions, num_prefaulted);
+  // The pool is already full.
+  EXPECT_EQ(0u, region_space->PrefaultFreeRegions(kPoolRegions));
+  EXPECT_EQ(kPoolRegions * space::RegionSpace::kRegionSize,
+            region_space->ReleasePrefaultedRegions());
+  EXPECT_EQ(0u, region_space->ReleasePrefaultedRegions());
+}
+
 TEST_F(HeapTest, DumpGCPerformanceOnShutdown) {
   Runtime::Current()->GetHeap()->CollectGarbage(/* clear_soft_references= */ false);
   Runtime::Current()->SetDumpGCPerformanceOnShutdown(true);
@@ -111,5 +156,348 @@ TEST_F(ZygoteHeapTest, PreZygoteFork) {
   Runtime::Current()->GetHeap()->PreZygoteFork();
 }
 
+class MarkCompactHeapTest : public CommonRuntimeTest {
+ protected:
+  void SetUpRuntimeOptions(RuntimeOptions* options) override {
+    CommonRuntimeTest::SetUpRuntimeOptions(options);
+    options->push_back(std::make_pair("-Xgc:CMC", nullptr));
+  }
+
+  // Build chains of arrays allocated with `allocator_type` while collections run.
+  void BuildChainsWhileCollecting(AllocatorType allocator_type) {
+    Heap* heap = Runtime::Current()->GetHeap();
+    ASSERT_EQ(kCollectorTypeCMC, heap->CurrentCollectorType());
+    static constexpr size_t kCollections = 8;
+    static constexpr size_t kChainLength = 1024;
+    Thread* self = Thread::Current();
+    std::atomic<bool> done(false);
+    ThreadPool thread_pool("mark compact test thread pool", 1);
+    thread_pool.AddTask(self, new FunctionTask([heap, &done](Thread* worker ATTRIBUTE_UNUSED) {
+      for (size_t i = 0; i != kCollections; ++i) {
+        heap->CollectGarbage(/* clear_soft_references= */ false);
+      }
+      done.store(true, std::memory_order_release);
+    }));
+    ScopedObjectAccess soa(self);
+    StackHandleScope<3> hs(self);
+    Handle<mirror::Class> c(
+        hs.NewHandle(class_linker_->FindSystemClass(self, "[Ljava/lang/Object;")));
+    // Each new array holds a new string and the previous array of the chain, which is then only
+    // reachable from the new objects while the collections mark concurrently.
+    MutableHandle<mirror::ObjectArray<mirror::Object>> head(
+        hs.NewHandle<mirror::ObjectArray<mirror::Object>>(nullptr));
+    MutableHandle<mirror::String> string(hs.NewHandle<mirror::String>(nullptr));
+    auto check_chain = [&head](size_t length) REQUIRES_SHARED(Locks::mutator_lock_) {
+      ObjPtr<mirror::ObjectArray<mirror::Object>> array = head.Get();
+      for (size_t i = length; i != 0; --i) {
+        ASSERT_TRUE(array != nullptr);
+        ObjPtr<mirror::Object> element = array->Get(0);
+        ASSERT_TRUE(element != nullptr);
+        ASSERT_TRUE(element->IsString());
+        ASSERT_EQ(std::to_string(i - 1), element->AsString()->ToModifiedUtf8());
+        ObjPtr<mirror::Object> next = array->Get(1);
+        array = (next != nullptr) ? next->AsObjectArray<mirror::Object>() : nullptr;
+      }
+      ASSERT_TRUE(array == nullptr);
+    };
+    thread_pool.StartWorkers(self);
+    size_t length = 0;
+    while (!done.load(std::memory_order_acquire)) {
+      std::string value = std::to_string(length);
+      string.Assign(mirror::String::AllocFromModifiedUtf8(self, value.c_str()));
+      ASSERT_TRUE(string != nullptr);
+      ObjPtr<mirror::ObjectArray<mirror::Object>> array =
+          mirror::ObjectArray<mirror::Object>::Alloc(self, c.Get(), 2, allocator_type);
+      ASSERT_TRUE(array != nullptr);
+      array->Set<false>(0, string.Get());
+      array->Set<false>(1, head.Get());
+      head.Assign(array);
+      if (++length == kChainLength) {
+        check_chain(length);
+        head.Assign(nullptr);
+        length = 0;
+      }
+      // Let the collector thread suspend this thread.
+      self->AllowThreadSuspension();
+    }
+    {
+      ScopedThreadSuspension sts(self, kNative);
+      thread_pool.Wait(self, /* do_work= */ false, /* may_hold_locks= */ false);
+      thread_pool.StopWorkers(self);
+    }
+    check_chain(length);
+  }
+};
+
+TEST_F(MarkCompactHeapTest, CompactsBumpPointerSpace) {
+  // Read barrier builds always use the concurrent copying collector.
+  TEST_DISABLED_FOR_READ_BARRIER();
+  Heap* heap = Runtime::Current()->GetHeap();
+  ASSERT_EQ(kCollectorTypeCMC, heap->CurrentCollectorType());
+  static constexpr size_t kLength = 1024;
+  ScopedObjectAccess soa(Thread::Current());
+  StackHandleScope<2> hs(soa.Self());
+  Handle<mirror::Class> c(
+      hs.NewHandle(class_linker_->FindSystemClass(soa.Self(), "[Ljava/lang/Object;")));
+  Handle<mirror::ObjectArray<mirror::Object>> array(hs.NewHandle(
+      mirror::ObjectArray<mirror::Object>::Alloc(soa.Self(), c.Get(), kLength)));
+  ASSERT_TRUE(array != nullptr);
+  for (size_t i = 0; i < kLength; ++i) {
+    // Interleave garbage with the kept strings so that every string has to slide down.
+    ASSERT_TRUE(mirror::String::AllocFromModifiedUtf8(soa.Self(), "garbage") != nullptr);
+    std::string value = std::to_string(i);
+    array->Set<false>(i, mirror::String::AllocFromModifiedUtf8(soa.Self(), value.c_str()));
+  }
+  space::ContinuousSpace* space = heap->FindContinuousSpaceFromObject(array.Get(), false);
+  ASSERT_TRUE(space != nullptr);
+  ASSERT_TRUE(space->IsBumpPointerSpace());
+  const size_t size_before = space->Size();
+  {
+    ScopedThreadSuspension sts(soa.Self(), kSuspended);
+    heap->CollectGarbage(/* clear_soft_references= */ false);
+  }
+  EXPECT_LT(space->Size(), size_before);
+  for (size_t i = 0; i < kLength; ++i) {
+    ObjPtr<mirror::Object> element = array->Get(i);
+    ASSERT_TRUE(element != nullptr);
+    ASSERT_TRUE(element->IsString());
+    EXPECT_EQ(std::to_string(i), element->AsString()->ToModifiedUtf8());
+  }
+}
+
+TEST_F(MarkCompactHeapTest, KeepsObjectsAllocatedDuringMarking) {
+  // Read barrier builds always use the concurrent copying collector.
+  TEST_DISABLED_FOR_READ_BARRIER();
+  BuildChainsWhileCollecting(Runtime::Current()->GetHeap()->GetCurrentAllocator());
+}
+
+TEST_F(MarkCompactHeapTest, UpdatesNonMovingObjectsAllocatedDuringCollection) {
+  // Read barrier builds always use the concurrent copying collector.
+  TEST_DISABLED_FOR_READ_BARRIER();
+  // The arrays do not move but point to moving strings, and are not marked when allocated after
+  // the remark pause.
+  BuildChainsWhileCollecting(Runtime::Current()->GetHeap()->GetCurrentNonMovingAllocator());
+}
+
+
+class VerifyingHeapTest : public CommonRuntimeTest {
+  void SetUpRuntimeOptions(RuntimeOptions* options) override {
+    CommonRuntimeTest::SetUpRuntimeOptions(options);
+    // The concurrent copying collector does not verify the heap around its collections.
+    options->push_back(std::make_pair("-Xgc:CMS,preverify,postverify", nullptr));
+    options->push_back(std::make_pair("-XX:ParallelGCThreads=4", nullptr));
+  }
+};
+
+TEST_F(VerifyingHeapTest, VerifyHeapReferencesInParallel) {
+  // Read barrier builds always use the concurrent copying collector.
+  TEST_DISABLED_FOR_READ_BARRIER();
+  Heap* heap = Runtime::Current()->GetHeap();
+  ASSERT_EQ(kCollectorTypeCMS, heap->CurrentCollectorType());
+  ASSERT_TRUE(heap->GetThreadPool() != nullptr);
+  static constexpr size_t kLength = 4096;
+  ScopedObjectAccess soa(Thread::Current());
+  StackHandleScope<2> hs(soa.Self());
+  Handle<mirror::Class> c(
+      hs.NewHandle(class_linker_->FindSystemClass(soa.Self(), "[Ljava/lang/Object;")));
+  Handle<mirror::ObjectArray<mirror::Object>> array(hs.NewHandle(
+      mirror::ObjectArray<mirror::Object>::Alloc(soa.Self(), c.Get(), kLength)));
+  ASSERT_TRUE(array != nullptr);
+  for (size_t i = 0; i < kLength; ++i) {
+    ASSERT_TRUE(mirror::String::AllocFromModifiedUtf8(soa.Self(), "garbage") != nullptr);
+    array->Set<false>(i, mirror::String::AllocFromModifiedUtf8(soa.Self(), "kept"));
+  }
+  ScopedThreadSuspension sts(soa.Self(), kSuspended);
+  // The collection verifies the heap before and after, and aborts on a failure.
+  heap->CollectGarbage(/* clear_soft_references= */ false);
+  ScopedGCCriticalSection gcs(soa.Self(), kGcCauseDebugger, kCollectorTypeDebugger);
+  ScopedSuspendAll ssa(__FUNCTION__);
+  EXPECT_EQ(0u, heap->VerifyHeapReferences());
+}
+
+TEST_F(VerifyingHeapTest, CountsReferencesToDeadObjects) {
+  // Read barrier builds always use the concurrent copying collector.
+  TEST_DISABLED_FOR_READ_BARRIER();
+  Heap* heap = Runtime::Current()->GetHeap();
+  ASSERT_EQ(kCollectorTypeCMS, heap->CurrentCollectorType());
+  ASSERT_TRUE(heap->GetThreadPool() != nullptr);
+  static constexpr size_t kNumDeadReferences = 3 * Heap::kMaxExplainedVerifyFailures;
+  ScopedObjectAccess soa(Thread::Current());
+  StackHandleScope<3> hs(soa.Self());
+  Handle<mirror::Class> c(
+      hs.NewHandle(class_linker_->FindSystemClass(soa.Self(), "[Ljava/lang/Object;")));
+  Handle<mirror::ObjectArray<mirror::Object>> array(hs.NewHandle(
+      mirror::ObjectArray<mirror::Object>::Alloc(soa.Self(), c.Get(), kNumDeadReferences)));
+  ASSERT_TRUE(array != nullptr);
+  Handle<mirror::String> string(
+      hs.NewHandle(mirror::String::AllocFromModifiedUtf8(soa.Self(), "a live string")));
+  ASSERT_TRUE(string != nullptr);
+  // An address inside a live object is not a live object.
+  mirror::Object* dead = reinterpret_cast<mirror::Object*>(
+      reinterpret_cast<uint8_t*>(string.Get()) + kObjectAlignment);
+  ScopedThreadSuspension sts(soa.Self(), kSuspended);
+  ScopedGCCriticalSection gcs(soa.Self(), kGcCauseDebugger, kCollectorTypeDebugger);
+  ScopedSuspendAll ssa(__FUNCTION__);
+  for (size_t i = 0; i < kNumDeadReferences; ++i) {
+    array->SetWithoutChecksAndWriteBarrier<false, false, kVerifyNone>(i, dead);
+  }
+  size_t num_explained = 0u;
+  EXPECT_EQ(kNumDeadReferences, heap->VerifyHeapReferences(/* verify_referents= */ true,
+                                                           &num_explained));
+  EXPECT_EQ(Heap::kMaxExplainedVerifyFailures, num_explained);
+  // Let the collections verify the heap again.
+  for (size_t i = 0; i < kNumDeadReferences; ++i) {
+    array->SetWithoutChecksAndWriteBarrier<false, false, kVerifyNone>(i, nullptr);
+  }
+}
+
+class ParallelSweepHeapTest : public CommonRuntimeTest {
+ protected:
+  void SetUpRuntimeOptions(RuntimeOptions* options) override {
+    CommonRuntimeTest::SetUpRuntimeOptions(options);
+    // Keep the mark sweep collector when the tests switch the process state.
+    options->push_back(std::make_pair("-Xgc:CMS", nullptr));
+    options->push_back(std::make_pair("-XX:BackgroundGC=CMS", nullptr));
+    options->push_back(std::make_pair("-XX:ParallelGCThreads=4", nullptr));
+    options->push_back(std::make_pair("-XX:ConcGCThreads=4", nullptr));
+    // No collection for allocation while the tests fill the allocation stack.
+    options->push_back(std::make_pair("-Xms64m", nullptr));
+  }
+
+  struct StickySweepResult {
+    uint64_t freed_objects;
+    int64_t freed_bytes;
+    uint64_t freed_large_objects;
+    int64_t freed_large_object_bytes;
+    bool swept_in_parallel;
+  };
+
+  // Allocates the same kept and garbage objects, some of them in the large object space, then
+  // runs a sticky collection, which sweeps them from the allocation stack. The collector sweeps
+  // with the heap thread pool only in a jank perceptible process state.
+  StickySweepResult RunStickyCollection(bool jank_perceptible) {
+    static constexpr size_t kLength = 16 * KB;
+    static constexpr size_t kLargeArrayInterval = 256;
+    Runtime* runtime = Runtime::Current();
+    Heap* heap = runtime->GetHeap();
+    runtime->UpdateProcessState(
+        jank_perceptible ? kProcessStateJankPerceptible : kProcessStateJankImperceptible);
+    Thread* self = Thread::Current();
+    heap->CollectGarbage(/* clear_soft_references= */ false);
+    StickySweepResult result;
+    {
+      ScopedObjectAccess soa(self);
+      StackHandleScope<2> hs(self);
+      Handle<mirror::Class> c(
+          hs.NewHandle(class_linker_->FindSystemClass(self, "[Ljava/lang/Object;")));
+      Handle<mirror::ObjectArray<mirror::Object>> array(
+          hs.NewHandle(mirror::ObjectArray<mirror::Object>::Alloc(self, c.Get(), kLength)));
+      EXPECT_TRUE(array != nullptr);
+      for (size_t i = 0; i < kLength; ++i) {
+        EXPECT_TRUE(mirror::String::AllocFromModifiedUtf8(self, "garbage") != nullptr);
+        ObjPtr<mirror::Object> kept = (i % kLargeArrayInterval == 0)
+            ? ObjPtr<mirror::Object>(mirror::ByteArray::Alloc(self, 16 * KB))
+            : ObjPtr<mirror::Object>(mirror::String::AllocFromModifiedUtf8(self, "kept"));
+        array->Set<false>(i, kept);
+        if (i % kLargeArrayInterval == kLargeArrayInterval / 2) {
+          EXPECT_TRUE(mirror::ByteArray::Alloc(self, 16 * KB) != nullptr);
+        }
+      }
+      ScopedThreadSuspension sts(self, kSuspended);
+      EXPECT_EQ(collector::kGcTypeSticky,
+                heap->CollectGarbageInternal(collector::kGcTypeSticky,
+                                             kGcCauseExplicit,
+                                             /* clear_soft_references= */ false));
+      collector::Iteration* iteration = heap->GetCurrentGcIteration();
+      result.freed_objects = iteration->GetFreedObjects();
+      result.freed_bytes = iteration->GetFreedBytes();
+      result.freed_large_objects = iteration->GetFreedLargeObjects();
+      result.freed_large_object_bytes = iteration->GetFreedLargeObjectBytes();
+      result.swept_in_parallel =
+          iteration->GetTimings()->FindTimingIndex("ParallelSweepArray", 0u) !=
+          TimingLogger::kIndexNotFound;
+    }
+    return result;
+  }
+
+  // Sweeps the system weaks with a visitor for which every other one of `kNumWeaks` new JNI weak
+  // globals is dead, and returns how many of these the sweep cleared.
+  size_t SweepJniWeakGlobals(ThreadPool* thread_pool, size_t thread_count) {
+    static constexpr size_t kNumWeaks = 1024;
+    class DeadSetVisitor : public IsMarkedVisitor {
+     public:
+      explicit DeadSetVisitor(const std::set<mirror::Object*>* dead) : dead_(dead) {}
+
+      // Only reads the dead set, so the holders can be swept in parallel.
+      mirror::Object* IsMarked(mirror::Object* obj) override {
+        return dead_->find(obj) != dead_->end() ? nullptr : obj;
+      }
+
+     private:
+      const std::set<mirror::Object*>* const dead_;
+    };
+    Thread* self = Thread::Current();
+    JavaVMExt* vm = Runtime::Current()->GetJavaVM();
+    ScopedObjectAccess soa(self);
+    StackHandleScope<2> hs(self);
+    Handle<mirror::Class> c(
+        hs.NewHandle(class_linker_->FindSystemClass(self, "[Ljava/lang/Object;")));
+    Handle<mirror::ObjectArray<mirror::Object>> array(
+        hs.NewHandle(mirror::ObjectArray<mirror::Object>::Alloc(self, c.Get(), kNumWeaks)));
+    EXPECT_TRUE(array != nullptr);
+    std::vector<jweak> weaks;
+    std::set<mirror::Object*> dead;
+    for (size_t i = 0; i < kNumWeaks; ++i) {
+      ObjPtr<mirror::String> string = mirror::String::AllocFromModifiedUtf8(self, "weak");
+      EXPECT_TRUE(string != nullptr);
+      array->Set<false>(i, string);
+      weaks.push_back(vm->AddWeakGlobalRef(self, string));
+      if (i % 2u == 0u) {
+        dead.insert(string.Ptr());
+      }
+    }
+    DeadSetVisitor visitor(&dead);
+    Runtime::Current()->SweepSystemWeaks(&visitor, thread_pool, thread_count);
+    size_t cleared = 0u;
+    for (jweak weak : weaks) {
+      if (vm->IsWeakGlobalCleared(self, weak)) {
+        ++cleared;
+      }
+    }
+    for (jweak weak : weaks) {
+      vm->DeleteWeakGlobalRef(self, weak);
+    }
+    return cleared;
+  }
+};
+
+TEST_F(ParallelSweepHeapTest, StickySweepMatchesSerialSweep) {
+  // Read barrier builds always use the concurrent copying collector.
+  TEST_DISABLED_FOR_READ_BARRIER();
+  Heap* heap = Runtime::Current()->GetHeap();
+  ASSERT_EQ(kCollectorTypeCMS, heap->CurrentCollectorType());
+  ASSERT_TRUE(heap->GetThreadPool() != nullptr);
+  const StickySweepResult serial = RunStickyCollection(/* jank_perceptible= */ false);
+  const StickySweepResult parallel = RunStickyCollection(/* jank_perceptible= */ true);
+  EXPECT_FALSE(serial.swept_in_parallel);
+  EXPECT_TRUE(parallel.swept_in_parallel);
+  // At least the garbage strings and large arrays are freed, and both sweeps free the same.
+  EXPECT_GE(serial.freed_objects, 16 * KB);
+  EXPECT_GE(serial.freed_large_objects, 16 * KB / 256);
+  EXPECT_EQ(serial.freed_objects, parallel.freed_objects);
+  EXPECT_EQ(serial.freed_bytes, parallel.freed_bytes);
+  EXPECT_EQ(serial.freed_large_objects, parallel.freed_large_objects);
+  EXPECT_EQ(serial.freed_large_object_bytes, parallel.freed_large_object_bytes);
+}
+
+TEST_F(ParallelSweepHeapTest, SweepSystemWeaksMatchesSerialSweep) {
+  // Read barrier builds always use the concurrent copying collector.
+  TEST_DISABLED_FOR_READ_BARRIER();
+  ThreadPool* thread_pool = Runtime::Current()->GetHeap()->GetThreadPool();
+  ASSERT_TRUE(thread_pool != nullptr);
+  EXPECT_EQ(512u, SweepJniWeakGlobals(/* thread_pool= */ nullptr, /* thread_count= */ 1u));
+  EXPECT_EQ(512u, SweepJniWeakGlobals(thread_pool, /* thread_count= */ 4u));
+}
+
 }  // namespace gc
 }  // namespace art
@@ -39,6 +39,10 @@ namespace gc {
 
 static constexpr bool kAsyncReferenceQueueAdd = false;
 
+// Minimum number of references for each thread clearing white references. Below that, starting
+// the heap thread pool workers costs more than it saves.
+static constexpr size_t kMinReferencesPerThread = 1024;
+
 ReferenceProcessor::ReferenceProcessor()
     : collector_(nullptr),
       preserving_references_(false),
@@ -190,8 +194,7 @@ void ReferenceProcessor::ProcessReferences(bool concurrent,
     }
   }
   // Clear all remaining soft and weak references with white referents.
-  soft_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
-  weak_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
+  ClearWhiteReferences({&soft_reference_queue_, &weak_reference_queue_}, concurrent, collector);
   {
     TimingLogger::ScopedTiming t2(concurrent ? "EnqueueFinalizerReferences" :
         "(Paused)EnqueueFinalizerReferences", timings);
@@ -205,11 +208,12 @@ void ReferenceProcessor::ProcessReferences(bool concurrent,
       StopPreservingReferences(self);
     }
   }
-  // Clear all finalizer referent reachable soft and weak references with white referents.
-  soft_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
-  weak_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
-  // Clear all phantom references with white referents.
-  phantom_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
+  // Clear all finalizer referent reachable soft and weak references with white referents, and
+  // all phantom references with white referents. Clearing does not mark anything, so doing both
+  // at once sees the same referents as doing the soft and weak references first.
+  ClearWhiteReferences({&soft_reference_queue_, &weak_reference_queue_, &phantom_reference_queue_},
+                       concurrent,
+                       collector);
   // At this point all reference queues other than the cleared references should be empty.
   DCHECK(soft_reference_queue_.IsEmpty());
   DCHECK(weak_reference_queue_.IsEmpty());
@@ -229,6 +233,84 @@ void ReferenceProcessor::ProcessReferences(bool concurrent,
   }
 }
 
+// Clears the white referents of a slice of the references taken off the queues, on a heap
+// thread pool worker or on the GC-running thread.
+class ReferenceProcessor::ClearWhiteReferencesTask : public Task {
+ public:
+  ClearWhiteReferencesTask(ReferenceQueue* cleared_references,
+                           collector::GarbageCollector* collector,
+                           mirror::Reference* const* begin,
+                           mirror::Reference* const* end)
+      : cleared_references_(cleared_references), collector_(collector), begin_(begin), end_(end) {}
+
+  // Heap thread pool workers run in the native state, like the MarkSweep tasks. The GC-running
+  // thread holds the mutator lock until all the tasks are done.
+  void Run(Thread* self) override NO_THREAD_SAFETY_ANALYSIS {
+    // Collect the cleared references locally and enqueue them in one batch, so that the threads
+    // do not contend on the cleared references lock for each reference.
+    ReferenceQueue cleared(Locks::reference_queue_cleared_references_lock_);
+    for (mirror::Reference* const* it = begin_; it != end_; ++it) {
+      ReferenceQueue::ClearWhiteReference(*it, &cleared, collector_);
+    }
+    cleared_references_->AtomicEnqueueList(self, &cleared);
+  }
+
+  void Finalize() override {
+    delete this;
+  }
+
+ private:
+  ReferenceQueue* const cleared_references_;
+  collector::GarbageCollector* const collector_;
+  mirror::Reference* const* const begin_;
+  mirror::Reference* const* const end_;
+};
+
+size_t ReferenceProcessor::GetThreadCount(bool concurrent) const {
+  // Like MarkSweep, use a single thread in a background state (non jank perceptible) to leave
+  // more CPU time for the foreground apps.
+  Heap* heap = Runtime::Current()->GetHeap();
+  if (heap->GetThreadPool() == nullptr || !Runtime::Current()->InJankPerceptibleProcessState()) {
+    return 1u;
+  }
+  return (concurrent ? heap->GetConcGCThreadCount() : heap->GetParallelGCThreadCount()) + 1u;
+}
+
+void ReferenceProcessor::ClearWhiteReferences(std::initializer_list<ReferenceQueue*> queues,
+                                              bool concurrent,
+                                              collector::GarbageCollector* collector) {
+  if (GetThreadCount(concurrent) == 1u) {
+    for (ReferenceQueue* queue : queues) {
+      queue->ClearWhiteReferences(&cleared_references_, collector);
+    }
+    return;
+  }
+  std::vector<mirror::Reference*> refs;
+  for (ReferenceQueue* queue : queues) {
+    queue->DequeueAllPendingReferences(&refs);
+  }
+  const size_t thread_count =
+      std::min(GetThreadCount(concurrent), refs.size() / kMinReferencesPerThread);
+  if (thread_count <= 1u) {
+    for (mirror::Reference* ref : refs) {
+      ReferenceQueue::ClearWhiteReference(ref, &cleared_references_, collector);
+    }
+    return;
+  }
+  Thread* self = Thread::Current();
+  ThreadPool* thread_pool = Runtime::Current()->GetHeap()->GetThreadPool();
+  const size_t chunk_size = (refs.size() + thread_count - 1) / thread_count;
+  for (size_t begin = 0; begin < refs.size(); begin += chunk_size) {
+    const size_t end = std::min(begin + chunk_size, refs.size());
+    thread_pool->AddTask(self, new ClearWhiteReferencesTask(
+        &cleared_references_, collector, refs.data() + begin, refs.data() + end));
+  }
+  thread_pool->SetMaxActiveWorkers(thread_count - 1);
+  thread_pool->StartWorkers(self);
+  thread_pool->Wait(self, /* do_work= */ true, /* may_hold_locks= */ true);
+  thread_pool->StopWorkers(self);
+}
+
 // Process the "referent" field in a java.lang.ref.Reference.  If the referent has not yet been
 // marked, put it on the appropriate list in the heap for later processing.
 void ReferenceProcessor::DelayReferenceReferent(ObjPtr<mirror::Class> klass,
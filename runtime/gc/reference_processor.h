@@ -17,6 +17,8 @@
 #ifndef ART_RUNTIME_GC_REFERENCE_PROCESSOR_H_
 #define ART_RUNTIME_GC_REFERENCE_PROCESSOR_H_
 
+#include <initializer_list>
+
 #include "base/locks.h"
 #include "jni.h"
 #include "reference_queue.h"
@@ -80,7 +82,18 @@ class ReferenceProcessor {
       REQUIRES(!Locks::reference_processor_lock_);
 
  private:
+  class ClearWhiteReferencesTask;
+
   bool SlowPathEnabled() REQUIRES_SHARED(Locks::mutator_lock_);
+  // Clear the references with white referents of `queues`, like
+  // ReferenceQueue::ClearWhiteReferences. Uses the heap thread pool when there are enough
+  // references to share between threads.
+  void ClearWhiteReferences(std::initializer_list<ReferenceQueue*> queues,
+                            bool concurrent,
+                            collector::GarbageCollector* collector)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+  // Number of threads, including the calling one, to clear references with.
+  size_t GetThreadCount(bool concurrent) const;
   // Called by ProcessReferences.
   void DisableSlowPath(Thread* self) REQUIRES(Locks::reference_processor_lock_)
       REQUIRES_SHARED(Locks::mutator_lock_);
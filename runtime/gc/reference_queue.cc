@@ -56,6 +56,41 @@ void ReferenceQueue::EnqueueReference(ObjPtr<mirror::Reference> ref) {
   list_->SetPendingNext(ref);
 }
 
+void ReferenceQueue::AtomicEnqueueList(Thread* self, ReferenceQueue* other) {
+  DCHECK_NE(this, other);
+  if (other->IsEmpty()) {
+    return;
+  }
+  MutexLock mu(self, *lock_);
+  if (IsEmpty()) {
+    list_ = other->list_;
+  } else {
+    // Splice the other cycle in after list_, where EnqueueReference adds references.
+    ObjPtr<mirror::Reference> head = list_->GetPendingNext<kWithoutReadBarrier>();
+    ObjPtr<mirror::Reference> other_head = other->list_->GetPendingNext<kWithoutReadBarrier>();
+    DCHECK(head != nullptr);
+    DCHECK(other_head != nullptr);
+    other->list_->SetPendingNext(head);
+    list_->SetPendingNext(other_head);
+  }
+  other->Clear();
+}
+
+void ReferenceQueue::DequeueAllPendingReferences(std::vector<mirror::Reference*>* refs) {
+  if (IsEmpty()) {
+    return;
+  }
+  // Note: like DequeuePendingReference, this is only called from the single threaded part of
+  // ProcessReferences.
+  ObjPtr<mirror::Reference> ref = list_;
+  do {
+    ref = ref->GetPendingNext<kWithoutReadBarrier>();
+    DCHECK(ref != nullptr);
+    refs->push_back(ref.Ptr());
+  } while (ref != list_);
+  list_ = nullptr;
+}
+
 ObjPtr<mirror::Reference> ReferenceQueue::DequeuePendingReference() {
   DCHECK(!IsEmpty());
   ObjPtr<mirror::Reference> ref = list_->GetPendingNext<kWithoutReadBarrier>();
@@ -134,22 +169,32 @@ void ReferenceQueue::ClearWhiteReferences(ReferenceQueue* cleared_references,
                                           collector::GarbageCollector* collector) {
   while (!IsEmpty()) {
     ObjPtr<mirror::Reference> ref = DequeuePendingReference();
-    mirror::HeapReference<mirror::Object>* referent_addr = ref->GetReferentReferenceAddr();
-    // do_atomic_update is false because this happens during the reference processing phase where
-    // Reference.clear() would block.
-    if (!collector->IsNullOrMarkedHeapReference(referent_addr, /*do_atomic_update=*/false)) {
-      // Referent is white, clear it.
-      if (Runtime::Current()->IsActiveTransaction()) {
-        ref->ClearReferent<true>();
-      } else {
-        ref->ClearReferent<false>();
-      }
-      cleared_references->EnqueueReference(ref);
+    ClearWhiteReference(ref, cleared_references, collector);
+  }
+}
+
+void ReferenceQueue::ClearWhiteReference(ObjPtr<mirror::Reference> ref,
+                                         ReferenceQueue* cleared_references,
+                                         collector::GarbageCollector* collector) {
+  // References from DequeueAllPendingReferences are still linked.
+  if (!ref->IsUnprocessed()) {
+    ref->SetPendingNext(nullptr);
+  }
+  mirror::HeapReference<mirror::Object>* referent_addr = ref->GetReferentReferenceAddr();
+  // do_atomic_update is false because this happens during the reference processing phase where
+  // Reference.clear() would block.
+  if (!collector->IsNullOrMarkedHeapReference(referent_addr, /*do_atomic_update=*/false)) {
+    // Referent is white, clear it.
+    if (Runtime::Current()->IsActiveTransaction()) {
+      ref->ClearReferent<true>();
+    } else {
+      ref->ClearReferent<false>();
     }
-    // Delay disabling the read barrier until here so that the ClearReferent call above in
-    // transaction mode will trigger the read barrier.
-    DisableReadBarrierForReference(ref);
+    cleared_references->EnqueueReference(ref);
   }
+  // Delay disabling the read barrier until here so that the ClearReferent call above in
+  // transaction mode will trigger the read barrier.
+  DisableReadBarrierForReference(ref);
 }
 
 void ReferenceQueue::EnqueueFinalizerReferences(ReferenceQueue* cleared_references,
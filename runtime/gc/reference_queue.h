@@ -67,6 +67,17 @@ class ReferenceQueue {
   // Not thread safe, used when mutators are paused to minimize lock overhead.
   void EnqueueReference(ObjPtr<mirror::Reference> ref) REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Move all the references of `other` to this queue, leaving `other` empty. Thread safe, the
+  // lock is taken once for the whole list.
+  void AtomicEnqueueList(Thread* self, ReferenceQueue* other)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!*lock_);
+
+  // Append the references of the queue to `refs` and leave the queue empty, so that several
+  // threads can process them. Unlike DequeuePendingReference, the pendingNext fields are left
+  // set, ClearWhiteReference resets them.
+  void DequeueAllPendingReferences(std::vector<mirror::Reference*>* refs)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   // Dequeue a reference from the queue and return that dequeued reference.
   // Call DisableReadBarrierForReference for the reference that's returned from this function.
   ObjPtr<mirror::Reference> DequeuePendingReference() REQUIRES_SHARED(Locks::mutator_lock_);
@@ -74,7 +85,7 @@ class ReferenceQueue {
   // If applicable, disable the read barrier for the reference after its referent is handled (see
   // ConcurrentCopying::ProcessMarkStackRef.) This must be called for a reference that's dequeued
   // from pending queue (DequeuePendingReference).
-  void DisableReadBarrierForReference(ObjPtr<mirror::Reference> ref)
+  static void DisableReadBarrierForReference(ObjPtr<mirror::Reference> ref)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
   // Enqueues finalizer references with white referents.  White referents are blackened, moved to
@@ -95,6 +106,14 @@ class ReferenceQueue {
                             collector::GarbageCollector* collector)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // ClearWhiteReferences for a single reference taken off a queue with
+  // DequeueAllPendingReferences. Only touches `ref` and `cleared_references`, so threads may
+  // process different references concurrently with their own `cleared_references`.
+  static void ClearWhiteReference(ObjPtr<mirror::Reference> ref,
+                                  ReferenceQueue* cleared_references,
+                                  collector::GarbageCollector* collector)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   void Dump(std::ostream& os) const REQUIRES_SHARED(Locks::mutator_lock_);
   size_t GetLength() const REQUIRES_SHARED(Locks::mutator_lock_);
 
@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 
+#include <set>
 #include <sstream>
+#include <vector>
 
 #include "common_runtime_test.h"
 #include "handle_scope-inl.h"
@@ -62,6 +64,47 @@ TEST_F(ReferenceQueueTest, EnqueueDequeue) {
   ASSERT_EQ(refs, dequeued);
 }
 
+TEST_F(ReferenceQueueTest, EnqueueListDequeueAll) {
+  Thread* self = Thread::Current();
+  ScopedObjectAccess soa(self);
+  StackHandleScope<20> hs(self);
+  Mutex lock("Reference queue lock");
+  ReferenceQueue queue(&lock);
+  ReferenceQueue other(&lock);
+  auto ref_class = hs.NewHandle(
+      Runtime::Current()->GetClassLinker()->FindClass(self, "Ljava/lang/ref/WeakReference;",
+                                                      ScopedNullHandle<mirror::ClassLoader>()));
+  ASSERT_TRUE(ref_class != nullptr);
+  auto ref1(hs.NewHandle(ref_class->AllocObject(self)->AsReference()));
+  ASSERT_TRUE(ref1 != nullptr);
+  auto ref2(hs.NewHandle(ref_class->AllocObject(self)->AsReference()));
+  ASSERT_TRUE(ref2 != nullptr);
+  auto ref3(hs.NewHandle(ref_class->AllocObject(self)->AsReference()));
+  ASSERT_TRUE(ref3 != nullptr);
+
+  // Into an empty queue.
+  other.EnqueueReference(ref1.Get());
+  queue.AtomicEnqueueList(self, &other);
+  ASSERT_TRUE(other.IsEmpty());
+  ASSERT_EQ(queue.GetLength(), 1U);
+  // Into a non-empty queue.
+  other.EnqueueReference(ref2.Get());
+  other.EnqueueReference(ref3.Get());
+  queue.AtomicEnqueueList(self, &other);
+  ASSERT_TRUE(other.IsEmpty());
+  ASSERT_EQ(queue.GetLength(), 3U);
+  // An empty list is a no-op.
+  queue.AtomicEnqueueList(self, &other);
+  ASSERT_EQ(queue.GetLength(), 3U);
+
+  std::vector<mirror::Reference*> dequeued;
+  queue.DequeueAllPendingReferences(&dequeued);
+  ASSERT_TRUE(queue.IsEmpty());
+  std::set<mirror::Reference*> refs = {ref1.Get(), ref2.Get(), ref3.Get()};
+  ASSERT_EQ(refs, std::set<mirror::Reference*>(dequeued.begin(), dequeued.end()));
+  ASSERT_EQ(dequeued.size(), 3U);
+}
+
 TEST_F(ReferenceQueueTest, Dump) {
   Thread* self = Thread::Current();
   ScopedObjectAccess soa(self);
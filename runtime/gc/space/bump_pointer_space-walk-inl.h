@@ -29,7 +29,13 @@ namespace space {
 
 template <typename Visitor>
 inline void BumpPointerSpace::Walk(Visitor&& visitor) {
-  uint8_t* pos = Begin();
+  WalkFrom(Begin(), visitor);
+}
+
+template <typename Visitor>
+inline void BumpPointerSpace::WalkFrom(uint8_t* begin, Visitor&& visitor) {
+  DCHECK(begin >= Begin() && begin <= End());
+  uint8_t* pos = begin;
   uint8_t* end = End();
   uint8_t* main_end = pos;
   // Internal indirection w/ NO_THREAD_SAFETY_ANALYSIS. Optimally, we'd like to have an annotation
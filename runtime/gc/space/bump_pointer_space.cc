@@ -91,6 +91,25 @@ void BumpPointerSpace::Clear() {
   }
 }
 
+void BumpPointerSpace::CreateMarkBitmap() {
+  DCHECK(!mark_bitmap_.IsValid());
+  mark_bitmap_ = accounting::ContinuousSpaceBitmap::Create(
+      GetName() + " mark-bitmap", Begin(), NonGrowthLimitCapacity());
+  CHECK(mark_bitmap_.IsValid()) << "could not create " << GetName() << " mark bitmap";
+}
+
+void BumpPointerSpace::SetCompactedEnd(uint8_t* new_end) {
+  DCHECK_ALIGNED(new_end, kAlignment);
+  DCHECK_LE(new_end, End());
+  // Allocations expect zeroed memory past the end.
+  ZeroAndReleasePages(new_end, End() - new_end);
+  SetEnd(new_end);
+  MutexLock mu(Thread::Current(), block_lock_);
+  // All of the objects are now contiguous in the main block.
+  num_blocks_ = 0;
+  main_block_size_ = new_end - Begin();
+}
+
 void BumpPointerSpace::Dump(std::ostream& os) const {
   os << GetName() << " "
       << reinterpret_cast<void*>(Begin()) << "-" << reinterpret_cast<void*>(End()) << " - "
@@ -101,9 +101,17 @@ class BumpPointerSpace final : public ContinuousMemMapAllocSpace {
   }
 
   accounting::ContinuousSpaceBitmap* GetMarkBitmap() override {
-    return nullptr;
+    return mark_bitmap_.IsValid() ? &mark_bitmap_ : nullptr;
   }
 
+  // Create a mark bitmap covering the whole capacity, used by the mark-compact collector which
+  // marks the space in place instead of evacuating it.
+  void CreateMarkBitmap();
+
+  // Set the end of the space after the live objects were slid down to [Begin(), new_end), and
+  // release the pages past the new end.
+  void SetCompactedEnd(uint8_t* new_end) REQUIRES(!block_lock_);
+
   // Reset the space to empty.
   void Clear() override REQUIRES(!block_lock_);
 
@@ -153,6 +161,13 @@ class BumpPointerSpace final : public ContinuousMemMapAllocSpace {
       REQUIRES_SHARED(Locks::mutator_lock_)
       REQUIRES(!block_lock_);
 
+  // Visit the objects from `begin`, which must be a value End() had, so either in the main block
+  // or at the start of a block.
+  template <typename Visitor>
+  ALWAYS_INLINE void WalkFrom(uint8_t* begin, Visitor&& visitor)
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(!block_lock_);
+
   accounting::ContinuousSpaceBitmap::SweepCallback* GetSweepCallback() override;
 
   // Record objects / bytes freed.
@@ -61,6 +61,7 @@
 #include "profile/profile_compilation_info.h"
 #include "runtime.h"
 #include "space-inl.h"
+#include "thread_pool.h"
 
 namespace art {
 namespace gc {
@@ -351,6 +352,43 @@ void ImageSpace::VerifyImageAllocations() {
   }
 }
 
+// Visit the objects marked in `bitmap` within [begin, end). If parallel image relocation is
+// enabled and the runtime thread pool is available, the range is split into chunks visited by
+// the pool workers and the calling thread. Chunk boundaries are page aligned, so no two chunks
+// share a bitmap word and the visitor may update a same-sized bitmap for its own objects.
+template <typename Visitor>
+static void VisitMarkedRangeInParallel(const accounting::ContinuousSpaceBitmap* bitmap,
+                                       uintptr_t begin,
+                                       uintptr_t end,
+                                       const Visitor& visitor)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  Runtime::ScopedThreadPoolUsage stpu;
+  ThreadPool* const pool =
+      Runtime::Current()->UseParallelImageRelocation() ? stpu.GetThreadPool() : nullptr;
+  // Do not bother splitting ranges that are too small to amortize the task overhead.
+  static constexpr size_t kMinChunkSize = 256 * KB;
+  static constexpr size_t kChunksPerThread = 4u;
+  if (pool == nullptr || end - begin < 2u * kMinChunkSize) {
+    bitmap->VisitMarkedRange(begin, end, visitor);
+    return;
+  }
+  const size_t num_chunks = kChunksPerThread * (pool->GetThreadCount() + 1u);
+  const size_t chunk_size =
+      std::max(kMinChunkSize, RoundUp((end - begin + num_chunks - 1u) / num_chunks, kPageSize));
+  Thread* const self = Thread::Current();
+  for (uintptr_t chunk_begin = begin; chunk_begin < end; ) {
+    const uintptr_t chunk_end = std::min(RoundUp(chunk_begin + chunk_size, kPageSize), end);
+    pool->AddTask(self, new FunctionTask([=, &visitor](Thread*) {
+      bitmap->VisitMarkedRange(chunk_begin, chunk_end, visitor);
+    }));
+    chunk_begin = chunk_end;
+  }
+  ScopedTrace trace("Waiting for workers");
+  // Go to native since we don't want to suspend while holding the mutator lock.
+  ScopedThreadSuspension sts(self, kNative);
+  pool->Wait(self, /*do_work=*/ true, /*may_hold_locks=*/ false);
+}
+
 // Helper class for relocating from one range of memory to another.
 class RelocationRange {
  public:
@@ -1509,7 +1547,9 @@ class ImageSpace::Loader {
       uintptr_t objects_begin = reinterpret_cast<uintptr_t>(target_base + objects_section.Offset());
       uintptr_t objects_end = reinterpret_cast<uintptr_t>(target_base + objects_section.End());
       FixupObjectVisitor<ForwardObject> fixup_object_visitor(&visited_bitmap, forward_object);
-      bitmap->VisitMarkedRange(objects_begin, objects_end, fixup_object_visitor);
+      // Each object is visited exactly once and only the visited bitmap words covering the
+      // object's own chunk are written, so the fixup can be split across the thread pool.
+      VisitMarkedRangeInParallel(bitmap, objects_begin, objects_end, fixup_object_visitor);
       // Fixup image roots.
       CHECK(app_image_objects.InSource(reinterpret_cast<uintptr_t>(
           image_header->GetImageRoots<kWithoutReadBarrier>().Ptr())));
@@ -2753,7 +2793,8 @@ class ImageSpace::BootImageLoader {
 
   template <PointerSize kPointerSize>
   static void DoRelocateSpaces(ArrayRef<const std::unique_ptr<ImageSpace>>& spaces,
-                               int64_t base_diff64) REQUIRES_SHARED(Locks::mutator_lock_) {
+                               int64_t base_diff64,
+                               TimingLogger* logger) REQUIRES_SHARED(Locks::mutator_lock_) {
     DCHECK(!spaces.empty());
     gc::accounting::ContinuousSpaceBitmap patched_objects(
         gc::accounting::ContinuousSpaceBitmap::Create(
@@ -2766,7 +2807,8 @@ class ImageSpace::BootImageLoader {
     DoRelocateSpaces<kPointerSize, /*kExtension=*/ false>(
         spaces.SubArray(/*pos=*/ 0u, base_image_space_count),
         base_diff64,
-        &patched_objects);
+        &patched_objects,
+        logger);
 
     for (size_t i = base_image_space_count, size = spaces.size(); i != size; ) {
       const ImageHeader& ext_header = spaces[i]->GetImageHeader();
@@ -2775,7 +2817,8 @@ class ImageSpace::BootImageLoader {
       DoRelocateSpaces<kPointerSize, /*kExtension=*/ true>(
           spaces.SubArray(/*pos=*/ i, ext_image_space_count),
           base_diff64,
-          &patched_objects);
+          &patched_objects,
+          logger);
       i += ext_image_space_count;
     }
   }
@@ -2783,7 +2826,8 @@ class ImageSpace::BootImageLoader {
   template <PointerSize kPointerSize, bool kExtension>
   static void DoRelocateSpaces(ArrayRef<const std::unique_ptr<ImageSpace>> spaces,
                                int64_t base_diff64,
-                               gc::accounting::ContinuousSpaceBitmap* patched_objects)
+                               gc::accounting::ContinuousSpaceBitmap* patched_objects,
+                               TimingLogger* logger)
       REQUIRES_SHARED(Locks::mutator_lock_) {
     DCHECK(!spaces.empty());
     const ImageHeader& first_header = spaces.front()->GetImageHeader();
@@ -2940,37 +2984,41 @@ class ImageSpace::BootImageLoader {
       }
     }
 
+    // This is the last pass over objects and it only reads `patched_objects`, so the objects
+    // of each space can be patched in parallel.
+    TimingLogger::ScopedTiming timing("PatchObjects", logger);
+    auto patch_object = [&](mirror::Object* object) REQUIRES_SHARED(Locks::mutator_lock_) {
+      // Note: use Test() rather than Set() as this is the last time we're checking this object.
+      if (!patched_objects->Test(object)) {
+        main_patch_object_visitor.VisitObject(object);
+        ObjPtr<mirror::Class> klass = object->GetClass<kVerifyNone, kWithoutReadBarrier>();
+        if (klass->IsDexCacheClass<kVerifyNone>()) {
+          // Patch dex cache array pointers and elements.
+          ObjPtr<mirror::DexCache> dex_cache =
+              object->AsDexCache<kVerifyNone, kWithoutReadBarrier>();
+          main_patch_object_visitor.VisitDexCacheArrays(dex_cache);
+        } else if (klass == method_class || klass == constructor_class) {
+          // Patch the ArtMethod* in the mirror::Executable subobject.
+          ObjPtr<mirror::Executable> as_executable =
+              ObjPtr<mirror::Executable>::DownCast(object);
+          ArtMethod* unpatched_method = as_executable->GetArtMethod<kVerifyNone>();
+          ArtMethod* patched_method = main_relocate_visitor(unpatched_method);
+          as_executable->SetArtMethod</*kTransactionActive=*/ false,
+                                      /*kCheckTransaction=*/ true,
+                                      kVerifyNone>(patched_method);
+        }
+      }
+    };
     for (const std::unique_ptr<ImageSpace>& space : spaces) {
       const ImageHeader& image_header = space->GetImageHeader();
 
       static_assert(IsAligned<kObjectAlignment>(sizeof(ImageHeader)), "Header alignment check");
-      uint32_t objects_end = image_header.GetObjectsSection().Size();
+      uintptr_t objects_begin = reinterpret_cast<uintptr_t>(space->Begin() + sizeof(ImageHeader));
+      uintptr_t objects_end =
+          reinterpret_cast<uintptr_t>(space->Begin() + image_header.GetObjectsSection().Size());
       DCHECK_ALIGNED(objects_end, kObjectAlignment);
-      for (uint32_t pos = sizeof(ImageHeader); pos != objects_end; ) {
-        mirror::Object* object = reinterpret_cast<mirror::Object*>(space->Begin() + pos);
-        // Note: use Test() rather than Set() as this is the last time we're checking this object.
-        if (!patched_objects->Test(object)) {
-          // This is the last pass over objects, so we do not need to Set().
-          main_patch_object_visitor.VisitObject(object);
-          ObjPtr<mirror::Class> klass = object->GetClass<kVerifyNone, kWithoutReadBarrier>();
-          if (klass->IsDexCacheClass<kVerifyNone>()) {
-            // Patch dex cache array pointers and elements.
-            ObjPtr<mirror::DexCache> dex_cache =
-                object->AsDexCache<kVerifyNone, kWithoutReadBarrier>();
-            main_patch_object_visitor.VisitDexCacheArrays(dex_cache);
-          } else if (klass == method_class || klass == constructor_class) {
-            // Patch the ArtMethod* in the mirror::Executable subobject.
-            ObjPtr<mirror::Executable> as_executable =
-                ObjPtr<mirror::Executable>::DownCast(object);
-            ArtMethod* unpatched_method = as_executable->GetArtMethod<kVerifyNone>();
-            ArtMethod* patched_method = main_relocate_visitor(unpatched_method);
-            as_executable->SetArtMethod</*kTransactionActive=*/ false,
-                                        /*kCheckTransaction=*/ true,
-                                        kVerifyNone>(patched_method);
-          }
-        }
-        pos += RoundUp(object->SizeOf<kVerifyNone>(), kObjectAlignment);
-      }
+      // The live bitmap loaded from the image marks every object in the objects section.
+      VisitMarkedRangeInParallel(space->GetLiveBitmap(), objects_begin, objects_end, patch_object);
     }
     if (kIsDebugBuild && !kExtension) {
       // We used just Test() instead of Set() above but we need to use Set()
@@ -2996,9 +3044,9 @@ class ImageSpace::BootImageLoader {
     ArrayRef<const std::unique_ptr<ImageSpace>> spaces_ref(spaces);
     PointerSize pointer_size = first_space_header.GetPointerSize();
     if (pointer_size == PointerSize::k64) {
-      DoRelocateSpaces<PointerSize::k64>(spaces_ref, base_diff64);
+      DoRelocateSpaces<PointerSize::k64>(spaces_ref, base_diff64, logger);
     } else {
-      DoRelocateSpaces<PointerSize::k32>(spaces_ref, base_diff64);
+      DoRelocateSpaces<PointerSize::k32>(spaces_ref, base_diff64, logger);
     }
   }
 
@@ -16,17 +16,21 @@
 
 #include "large_object_space.h"
 
+#include <string.h>
 #include <sys/mman.h>
 
+#include <algorithm>
 #include <memory>
 
 #include <android-base/logging.h>
 
+#include "base/bit_utils.h"
 #include "base/macros.h"
 #include "base/memory_tool.h"
 #include "base/mutex-inl.h"
 #include "base/os.h"
 #include "base/stl_util.h"
+#include "base/utils.h"
 #include "gc/accounting/heap_bitmap-inl.h"
 #include "gc/accounting/space_bitmap-inl.h"
 #include "gc/heap.h"
@@ -114,10 +118,24 @@ LargeObjectSpace::LargeObjectSpace(const std::string& name, uint8_t* begin, uint
     : DiscontinuousSpace(name, kGcRetentionPolicyAlwaysCollect),
       lock_(lock_name, kAllocSpaceLock),
       num_bytes_allocated_(0), num_objects_allocated_(0), total_bytes_allocated_(0),
-      total_objects_allocated_(0), begin_(begin), end_(end) {
+      total_objects_allocated_(0), begin_(begin), end_(end), use_huge_pages_(false) {
 }
 
 
+void LargeObjectSpace::Dump(std::ostream& os) const {
+  MutexLock mu(Thread::Current(), lock_);
+  os << GetName() << " -"
+     << " begin: " << reinterpret_cast<void*>(Begin())
+     << " end: " << reinterpret_cast<void*>(End()) << "\n";
+  DumpStatsLocked(os);
+}
+
+void LargeObjectSpace::DumpStatsLocked(std::ostream& os) const {
+  os << "Allocated " << num_objects_allocated_ << " objects of "
+     << PrettySize(num_bytes_allocated_) << ", " << total_objects_allocated_ << " objects of "
+     << PrettySize(total_bytes_allocated_) << " in total\n";
+}
+
 void LargeObjectSpace::CopyLiveToMarked() {
   mark_bitmap_.CopyFrom(&live_bitmap_);
 }
@@ -146,6 +164,11 @@ mirror::Object* LargeObjectMapSpace::Alloc(Thread* self, size_t num_bytes,
     LOG(WARNING) << "Large object allocation failed: " << error_msg;
     return nullptr;
   }
+  if (use_huge_pages_ && num_bytes >= kHugePageSize) {
+    // Only the huge page aligned part of the map can be backed by a huge page. Failing is
+    // harmless, the allocation then uses small pages.
+    mem_map.MadviseHugePages(/*enable=*/ true);
+  }
   mirror::Object* const obj = reinterpret_cast<mirror::Object*>(mem_map.Begin());
   const size_t allocation_size = mem_map.BaseSize();
   MutexLock mu(self, lock_);
@@ -357,7 +380,9 @@ inline bool FreeListSpace::SortByPrevFree::operator()(const AllocationInfo* a,
   return reinterpret_cast<uintptr_t>(a) < reinterpret_cast<uintptr_t>(b);
 }
 
-FreeListSpace* FreeListSpace::Create(const std::string& name, size_t size) {
+FreeListSpace* FreeListSpace::Create(const std::string& name,
+                                     size_t size,
+                                     size_t max_cached_bytes) {
   CHECK_EQ(size % kAlignment, 0U);
   std::string error_msg;
   MemMap mem_map = MemMap::MapAnonymous(name.c_str(),
@@ -366,15 +391,23 @@ FreeListSpace* FreeListSpace::Create(const std::string& name, size_t size) {
                                         /*low_4gb=*/ true,
                                         &error_msg);
   CHECK(mem_map.IsValid()) << "Failed to allocate large object space mem map: " << error_msg;
-  return new FreeListSpace(name, std::move(mem_map), mem_map.Begin(), mem_map.End());
+  return new FreeListSpace(
+      name, std::move(mem_map), mem_map.Begin(), mem_map.End(), max_cached_bytes);
 }
 
 FreeListSpace::FreeListSpace(const std::string& name,
                              MemMap&& mem_map,
                              uint8_t* begin,
-                             uint8_t* end)
+                             uint8_t* end,
+                             size_t max_cached_bytes)
     : LargeObjectSpace(name, begin, end, "free list space lock"),
-      mem_map_(std::move(mem_map)) {
+      mem_map_(std::move(mem_map)),
+      max_cached_bytes_(max_cached_bytes),
+      cached_bytes_(0u),
+      lazy_free_bytes_(0u),
+      total_reused_cached_bytes_(0u),
+      total_released_bytes_(0u),
+      use_madv_free_(true) {
   const size_t space_capacity = end - begin;
   free_end_ = space_capacity;
   CHECK_ALIGNED(space_capacity, kAlignment);
@@ -388,10 +421,30 @@ FreeListSpace::FreeListSpace(const std::string& name,
                            &error_msg);
   CHECK(allocation_info_map_.IsValid()) << "Failed to allocate allocation info map" << error_msg;
   allocation_info_ = reinterpret_cast<AllocationInfo*>(allocation_info_map_.Begin());
+  page_state_map_ = MemMap::MapAnonymous("large object free list space page state map",
+                                         space_capacity / kAlignment,
+                                         PROT_READ | PROT_WRITE,
+                                         /*low_4gb=*/ false,
+                                         &error_msg);
+  CHECK(page_state_map_.IsValid()) << "Failed to allocate page state map" << error_msg;
+  // All the pages start zeroed.
+  page_states_ = reinterpret_cast<PageState*>(page_state_map_.Begin());
+}
+
+size_t FreeListSpace::GetFreeBinIndex(size_t num_pages) {
+  DCHECK_NE(num_pages, 0u);
+  return std::min(static_cast<size_t>(MostSignificantBit(num_pages)), kNumFreeBins - 1);
 }
 
 FreeListSpace::~FreeListSpace() {}
 
+void FreeListSpace::EnableHugePages() {
+  LargeObjectSpace::EnableHugePages();
+  if (mem_map_.MadviseHugePages(/*enable=*/ true) != 0) {
+    PLOG(WARNING) << "Failed to request transparent huge pages for " << GetName();
+  }
+}
+
 void FreeListSpace::Walk(DlMallocSpace::WalkCallback callback, void* arg) {
   MutexLock mu(Thread::Current(), lock_);
   const uintptr_t free_end_start = reinterpret_cast<uintptr_t>(end_) - free_end_;
@@ -413,15 +466,64 @@ void FreeListSpace::Walk(DlMallocSpace::WalkCallback callback, void* arg) {
 void FreeListSpace::ForEachMemMap(std::function<void(const MemMap&)> func) const {
   MutexLock mu(Thread::Current(), lock_);
   func(allocation_info_map_);
+  func(page_state_map_);
   func(mem_map_);
 }
 
 void FreeListSpace::RemoveFreePrev(AllocationInfo* info) {
   CHECK_GT(info->GetPrevFree(), 0U);
-  auto it = free_blocks_.lower_bound(info);
-  CHECK(it != free_blocks_.end());
+  FreeBlocks& free_blocks = free_blocks_[GetFreeBinIndex(info->GetPrevFree())];
+  auto it = free_blocks.lower_bound(info);
+  CHECK(it != free_blocks.end());
   CHECK_EQ(*it, info);
-  free_blocks_.erase(it);
+  free_blocks.erase(it);
+}
+
+void FreeListSpace::InsertFreePrev(AllocationInfo* info) {
+  DCHECK_GT(info->GetPrevFree(), 0U);
+  free_blocks_[GetFreeBinIndex(info->GetPrevFree())].insert(info);
+}
+
+AllocationInfo* FreeListSpace::TakeBestFitFreePrev(size_t allocation_size) {
+  AllocationInfo temp_info;
+  temp_info.SetPrevFreeBytes(allocation_size);
+  temp_info.SetByteSize(0, false);
+  // Any block of the larger bins fits, and the first one is the smallest.
+  for (size_t bin = GetFreeBinIndex(allocation_size / kAlignment); bin < kNumFreeBins; ++bin) {
+    FreeBlocks& free_blocks = free_blocks_[bin];
+    auto it = free_blocks.lower_bound(&temp_info);
+    if (it != free_blocks.end()) {
+      AllocationInfo* info = *it;
+      free_blocks.erase(it);
+      return info;
+    }
+  }
+  return nullptr;
+}
+
+bool FreeListSpace::ReservePageCache(size_t bytes) {
+  size_t cached_bytes;
+  do {
+    cached_bytes = cached_bytes_.load(std::memory_order_relaxed);
+    if (cached_bytes + bytes > max_cached_bytes_) {
+      return false;
+    }
+  } while (!cached_bytes_.CompareAndSetWeakRelaxed(cached_bytes, cached_bytes + bytes));
+  return true;
+}
+
+FreeListSpace::PageState FreeListSpace::ReleasePages(uint8_t* begin, size_t bytes) {
+#ifdef MADV_FREE
+  if (use_madv_free_.load(std::memory_order_relaxed)) {
+    if (madvise(begin, bytes, MADV_FREE) == 0) {
+      return kPageLazyFree;
+    }
+    // Not supported before Linux 4.5.
+    use_madv_free_.store(false, std::memory_order_relaxed);
+  }
+#endif
+  madvise(begin, bytes, MADV_DONTNEED);
+  return kPageZeroed;
 }
 
 size_t FreeListSpace::Free(Thread* self, mirror::Object* obj) {
@@ -434,14 +536,25 @@ size_t FreeListSpace::Free(Thread* self, mirror::Object* obj) {
   DCHECK_GT(allocation_size, 0U);
   DCHECK_ALIGNED(allocation_size, kAlignment);
 
-  // madvise the pages without lock
-  madvise(obj, allocation_size, MADV_DONTNEED);
+  // Keep the pages resident if the page cache has room, otherwise madvise them without lock.
+  uint8_t* const begin = reinterpret_cast<uint8_t*>(obj);
+  const PageState page_state =
+      ReservePageCache(allocation_size) ? kPageCached : ReleasePages(begin, allocation_size);
   if (kIsDebugBuild) {
     // Can't disallow reads since we use them to find next chunks during coalescing.
     CheckedCall(mprotect, __FUNCTION__, obj, allocation_size, PROT_READ);
   }
 
   MutexLock mu(self, lock_);
+  std::fill_n(&page_states_[GetSlotIndexForAllocationInfo(info)],
+              allocation_size / kAlignment,
+              page_state);
+  if (page_state != kPageCached) {
+    total_released_bytes_ += allocation_size;
+    if (page_state == kPageLazyFree) {
+      lazy_free_bytes_ += allocation_size;
+    }
+  }
   info->SetByteSize(allocation_size, true);  // Mark as free.
   // Look at the next chunk.
   AllocationInfo* next_info = info->GetNextInfo();
@@ -476,7 +589,7 @@ size_t FreeListSpace::Free(Thread* self, mirror::Object* obj) {
       new_free_info = next_info;
     }
     new_free_info->SetPrevFreeBytes(new_free_size);
-    free_blocks_.insert(new_free_info);
+    InsertFreePrev(new_free_info);
     info->SetByteSize(new_free_size, true);
     DCHECK_EQ(info->GetNextInfo(), new_free_info);
   }
@@ -499,59 +612,89 @@ size_t FreeListSpace::AllocationSize(mirror::Object* obj, size_t* usable_size) {
 
 mirror::Object* FreeListSpace::Alloc(Thread* self, size_t num_bytes, size_t* bytes_allocated,
                                      size_t* usable_size, size_t* bytes_tl_bulk_allocated) {
-  MutexLock mu(self, lock_);
   const size_t allocation_size = RoundUp(num_bytes, kAlignment);
-  AllocationInfo temp_info;
-  temp_info.SetPrevFreeBytes(allocation_size);
-  temp_info.SetByteSize(0, false);
-  AllocationInfo* new_info;
-  // Find the smallest chunk at least num_bytes in size.
-  auto it = free_blocks_.lower_bound(&temp_info);
-  if (it != free_blocks_.end()) {
-    AllocationInfo* info = *it;
-    free_blocks_.erase(it);
-    // Fit our object in the previous allocation info free space.
-    new_info = info->GetPrevFreeInfo();
-    // Remove the newly allocated block from the info and update the prev_free_.
-    info->SetPrevFreeBytes(info->GetPrevFreeBytes() - allocation_size);
-    if (info->GetPrevFreeBytes() > 0) {
-      AllocationInfo* new_free = info - info->GetPrevFree();
-      new_free->SetPrevFreeBytes(0);
-      new_free->SetByteSize(info->GetPrevFreeBytes(), true);
-      // If there is remaining space, insert back into the free set.
-      free_blocks_.insert(info);
-    }
-  } else {
-    // Try to steal some memory from the free space at the end of the space.
-    if (LIKELY(free_end_ >= allocation_size)) {
-      // Fit our object at the start of the end free block.
-      new_info = GetAllocationInfoForAddress(reinterpret_cast<uintptr_t>(End()) - free_end_);
-      free_end_ -= allocation_size;
+  uint8_t* obj;
+  // The pages of the allocation to zero once the lock is released.
+  size_t dirty_begin = 0u;
+  size_t dirty_end = 0u;
+  {
+    MutexLock mu(self, lock_);
+    AllocationInfo* new_info;
+    // Find the smallest chunk at least num_bytes in size.
+    AllocationInfo* info = TakeBestFitFreePrev(allocation_size);
+    if (info != nullptr) {
+      // Fit our object in the previous allocation info free space.
+      new_info = info->GetPrevFreeInfo();
+      // Remove the newly allocated block from the info and update the prev_free_.
+      info->SetPrevFreeBytes(info->GetPrevFreeBytes() - allocation_size);
+      if (info->GetPrevFreeBytes() > 0) {
+        AllocationInfo* new_free = info - info->GetPrevFree();
+        new_free->SetPrevFreeBytes(0);
+        new_free->SetByteSize(info->GetPrevFreeBytes(), true);
+        // If there is remaining space, insert back into the free set.
+        InsertFreePrev(info);
+      }
     } else {
-      return nullptr;
+      // Try to steal some memory from the free space at the end of the space.
+      if (LIKELY(free_end_ >= allocation_size)) {
+        // Fit our object at the start of the end free block.
+        new_info = GetAllocationInfoForAddress(reinterpret_cast<uintptr_t>(End()) - free_end_);
+        free_end_ -= allocation_size;
+      } else {
+        return nullptr;
+      }
+    }
+    DCHECK(bytes_allocated != nullptr);
+    *bytes_allocated = allocation_size;
+    if (usable_size != nullptr) {
+      *usable_size = allocation_size;
+    }
+    DCHECK(bytes_tl_bulk_allocated != nullptr);
+    *bytes_tl_bulk_allocated = allocation_size;
+    // Need to do these inside of the lock.
+    ++num_objects_allocated_;
+    ++total_objects_allocated_;
+    num_bytes_allocated_ += allocation_size;
+    total_bytes_allocated_ += allocation_size;
+    obj = reinterpret_cast<uint8_t*>(GetAddressForAllocationInfo(new_info));
+    // We always put our object at the start of the free block, there cannot be another free block
+    // before it.
+    if (kIsDebugBuild) {
+      CheckedCall(mprotect, __FUNCTION__, obj, allocation_size, PROT_READ | PROT_WRITE);
     }
+    new_info->SetPrevFreeBytes(0);
+    new_info->SetByteSize(allocation_size, false);
+    // Find the pages which were freed without being zeroed since.
+    PageState* page_states = &page_states_[GetSlotIndexForAllocationInfo(new_info)];
+    size_t num_cached_pages = 0u;
+    size_t num_lazy_free_pages = 0u;
+    for (size_t i = 0, num_pages = allocation_size / kAlignment; i < num_pages; ++i) {
+      if (page_states[i] != kPageZeroed) {
+        if (dirty_begin == dirty_end) {
+          dirty_begin = i;
+        }
+        dirty_end = i + 1;
+        if (page_states[i] == kPageCached) {
+          ++num_cached_pages;
+        } else {
+          ++num_lazy_free_pages;
+        }
+        page_states[i] = kPageZeroed;
+      }
+    }
+    if (num_cached_pages != 0u) {
+      const size_t reused_bytes = num_cached_pages * kAlignment;
+      DCHECK_GE(cached_bytes_.load(std::memory_order_relaxed), reused_bytes);
+      cached_bytes_.fetch_sub(reused_bytes, std::memory_order_relaxed);
+      total_reused_cached_bytes_ += reused_bytes;
+    }
+    DCHECK_GE(lazy_free_bytes_, num_lazy_free_pages * kAlignment);
+    lazy_free_bytes_ -= num_lazy_free_pages * kAlignment;
   }
-  DCHECK(bytes_allocated != nullptr);
-  *bytes_allocated = allocation_size;
-  if (usable_size != nullptr) {
-    *usable_size = allocation_size;
+  if (dirty_begin != dirty_end) {
+    memset(obj + dirty_begin * kAlignment, 0, (dirty_end - dirty_begin) * kAlignment);
   }
-  DCHECK(bytes_tl_bulk_allocated != nullptr);
-  *bytes_tl_bulk_allocated = allocation_size;
-  // Need to do these inside of the lock.
-  ++num_objects_allocated_;
-  ++total_objects_allocated_;
-  num_bytes_allocated_ += allocation_size;
-  total_bytes_allocated_ += allocation_size;
-  mirror::Object* obj = reinterpret_cast<mirror::Object*>(GetAddressForAllocationInfo(new_info));
-  // We always put our object at the start of the free block, there cannot be another free block
-  // before it.
-  if (kIsDebugBuild) {
-    CheckedCall(mprotect, __FUNCTION__, obj, allocation_size, PROT_READ | PROT_WRITE);
-  }
-  new_info->SetPrevFreeBytes(0);
-  new_info->SetByteSize(allocation_size, false);
-  return obj;
+  return reinterpret_cast<mirror::Object*>(obj);
 }
 
 void FreeListSpace::Dump(std::ostream& os) const {
@@ -559,6 +702,7 @@ void FreeListSpace::Dump(std::ostream& os) const {
   os << GetName() << " -"
      << " begin: " << reinterpret_cast<void*>(Begin())
      << " end: " << reinterpret_cast<void*>(End()) << "\n";
+  DumpStatsLocked(os);
   uintptr_t free_end_start = reinterpret_cast<uintptr_t>(end_) - free_end_;
   const AllocationInfo* cur_info =
       GetAllocationInfoForAddress(reinterpret_cast<uintptr_t>(Begin()));
@@ -581,6 +725,50 @@ void FreeListSpace::Dump(std::ostream& os) const {
   }
 }
 
+void FreeListSpace::DumpStatsLocked(std::ostream& os) const {
+  LargeObjectSpace::DumpStatsLocked(os);
+  os << "Page cache " << PrettySize(cached_bytes_.load(std::memory_order_relaxed)) << " of "
+     << PrettySize(max_cached_bytes_) << ", lazily freed " << PrettySize(lazy_free_bytes_)
+     << ", reused " << PrettySize(total_reused_cached_bytes_) << " and released "
+     << PrettySize(total_released_bytes_) << " in total\n";
+  os << "Free blocks by size:";
+  for (size_t bin = 0; bin < kNumFreeBins; ++bin) {
+    if (!free_blocks_[bin].empty()) {
+      os << " " << PrettySize((static_cast<size_t>(1u) << bin) * kAlignment) << "+: "
+         << free_blocks_[bin].size();
+    }
+  }
+  os << ", " << PrettySize(free_end_) << " free at the end\n";
+}
+
+size_t FreeListSpace::Trim() {
+  MutexLock mu(Thread::Current(), lock_);
+  // Cached pages are all free, so they can be released with the lock held.
+  size_t released_bytes = 0u;
+  const size_t num_pages = Size() / kAlignment;
+  size_t i = 0;
+  while (i < num_pages) {
+    if (page_states_[i] != kPageCached) {
+      ++i;
+      continue;
+    }
+    size_t run_end = i + 1;
+    while (run_end < num_pages && page_states_[run_end] == kPageCached) {
+      ++run_end;
+    }
+    const size_t run_bytes = (run_end - i) * kAlignment;
+    uint8_t* run_begin = reinterpret_cast<uint8_t*>(GetAllocationAddressForSlot(i));
+    madvise(run_begin, run_bytes, MADV_DONTNEED);
+    std::fill(&page_states_[i], &page_states_[run_end], kPageZeroed);
+    released_bytes += run_bytes;
+    i = run_end;
+  }
+  DCHECK_GE(cached_bytes_.load(std::memory_order_relaxed), released_bytes);
+  cached_bytes_.fetch_sub(released_bytes, std::memory_order_relaxed);
+  total_released_bytes_ += released_bytes;
+  return released_bytes;
+}
+
 bool FreeListSpace::IsZygoteLargeObject(Thread* self ATTRIBUTE_UNUSED, mirror::Object* obj) const {
   const AllocationInfo* info = GetAllocationInfoForAddress(reinterpret_cast<uintptr_t>(obj));
   DCHECK(info != nullptr);
@@ -609,7 +797,7 @@ void LargeObjectSpace::SweepCallback(size_t num_ptrs, mirror::Object** ptrs, voi
   SweepCallbackContext* context = static_cast<SweepCallbackContext*>(arg);
   space::LargeObjectSpace* space = context->space->AsLargeObjectSpace();
   Thread* self = context->self;
-  Locks::heap_bitmap_lock_->AssertExclusiveHeld(self);
+  Locks::heap_bitmap_lock_->AssertExclusiveHeld(context->heap_bitmap_lock_holder);
   // If the bitmaps aren't swapped we need to clear the bits since the GC isn't going to re-swap
   // the bitmaps as an optimization.
   if (!context->swap_bitmaps) {
@@ -18,12 +18,14 @@
 #define ART_RUNTIME_GC_SPACE_LARGE_OBJECT_SPACE_H_
 
 #include "base/allocator.h"
+#include "base/atomic.h"
 #include "base/safe_map.h"
 #include "base/tracking_safe_map.h"
 #include "dlmalloc_space.h"
 #include "space.h"
 #include "thread-current-inl.h"
 
+#include <atomic>
 #include <set>
 #include <vector>
 
@@ -103,6 +105,12 @@ class LargeObjectSpace : public DiscontinuousSpace, public AllocSpace {
   }
   void LogFragmentationAllocFailure(std::ostream& os, size_t failed_alloc_bytes) override
       REQUIRES_SHARED(Locks::mutator_lock_);
+  void Dump(std::ostream& os) const override REQUIRES(!lock_);
+
+  // Give the memory the space keeps for reuse back to the kernel. Returns the bytes released.
+  virtual size_t Trim() REQUIRES(!lock_) {
+    return 0U;
+  }
 
   // Return true if the large object is a zygote large object. Potentially slow.
   virtual bool IsZygoteLargeObject(Thread* self, mirror::Object* obj) const = 0;
@@ -116,11 +124,20 @@ class LargeObjectSpace : public DiscontinuousSpace, public AllocSpace {
   // End() from different allocations.
   virtual std::pair<uint8_t*, uint8_t*> GetBeginEndAtomic() const = 0;
 
+  // Back the large objects with transparent huge pages when possible. Must be called before the
+  // first allocation.
+  virtual void EnableHugePages() {
+    use_huge_pages_ = true;
+  }
+
  protected:
   explicit LargeObjectSpace(const std::string& name, uint8_t* begin, uint8_t* end,
                             const char* lock_name);
   static void SweepCallback(size_t num_ptrs, mirror::Object** ptrs, void* arg);
 
+  // Print the allocation statistics of the space.
+  virtual void DumpStatsLocked(std::ostream& os) const REQUIRES(lock_);
+
   // Used to ensure mutual exclusion when the allocation spaces data structures,
   // including the allocation counters below, are being modified.
   mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
@@ -141,6 +158,9 @@ class LargeObjectSpace : public DiscontinuousSpace, public AllocSpace {
   uint8_t* begin_;
   uint8_t* end_;
 
+  // Whether the large objects are backed by transparent huge pages.
+  bool use_huge_pages_;
+
   friend class Space;
 
  private:
@@ -183,12 +203,21 @@ class LargeObjectMapSpace : public LargeObjectSpace {
 };
 
 // A continuous large object space with a free-list to handle holes.
+//
+// The free blocks are binned by size, and the pages of freed objects are kept resident in a page
+// cache of bounded size, so that repeatedly allocating buffers of similar sizes doesn't pay for a
+// madvise() and the page faults each time. Pages over the bound are released with MADV_FREE, which
+// lets the kernel reclaim them only under memory pressure. Reused pages are zeroed by Alloc().
 class FreeListSpace final : public LargeObjectSpace {
  public:
   static constexpr size_t kAlignment = kPageSize;
+  // Default bound of the bytes of freed pages kept resident.
+  static constexpr size_t kDefaultMaxCachedBytes = 8 * MB;
 
   virtual ~FreeListSpace();
-  static FreeListSpace* Create(const std::string& name, size_t capacity);
+  static FreeListSpace* Create(const std::string& name,
+                               size_t capacity,
+                               size_t max_cached_bytes = kDefaultMaxCachedBytes);
   size_t AllocationSize(mirror::Object* obj, size_t* usable_size) override
       REQUIRES(lock_);
   mirror::Object* Alloc(Thread* self, size_t num_bytes, size_t* bytes_allocated,
@@ -199,9 +228,33 @@ class FreeListSpace final : public LargeObjectSpace {
   void Dump(std::ostream& os) const override REQUIRES(!lock_);
   void ForEachMemMap(std::function<void(const MemMap&)> func) const override REQUIRES(!lock_);
   std::pair<uint8_t*, uint8_t*> GetBeginEndAtomic() const override REQUIRES(!lock_);
+  void EnableHugePages() override;
+  // Release the pages of the page cache.
+  size_t Trim() override REQUIRES(!lock_);
+
+  // Returns the bytes of freed pages currently kept resident.
+  size_t GetCachedBytes() const {
+    return cached_bytes_.load(std::memory_order_relaxed);
+  }
 
  protected:
-  FreeListSpace(const std::string& name, MemMap&& mem_map, uint8_t* begin, uint8_t* end);
+  // The state of a page, which tells Alloc() whether the page must be zeroed.
+  enum PageState : uint8_t {
+    kPageZeroed = 0,  // Allocated, or free and never used or released with MADV_DONTNEED.
+    kPageCached,      // Free and kept resident by the page cache.
+    kPageLazyFree,    // Free and released with MADV_FREE, its content is undefined.
+  };
+
+  // Number of size bins of the free blocks, bin i holding the blocks of [2^i, 2^(i+1)) pages and
+  // the last bin all the larger blocks.
+  static constexpr size_t kNumFreeBins = 16;
+
+  FreeListSpace(const std::string& name,
+                MemMap&& mem_map,
+                uint8_t* begin,
+                uint8_t* end,
+                size_t max_cached_bytes);
+  static size_t GetFreeBinIndex(size_t num_pages);
   size_t GetSlotIndexForAddress(uintptr_t address) const {
     DCHECK(Contains(reinterpret_cast<mirror::Object*>(address)));
     return (address - reinterpret_cast<uintptr_t>(Begin())) / kAlignment;
@@ -217,6 +270,16 @@ class FreeListSpace final : public LargeObjectSpace {
   }
   // Removes header from the free blocks set by finding the corresponding iterator and erasing it.
   void RemoveFreePrev(AllocationInfo* info) REQUIRES(lock_);
+  // Inserts the header of a free block into the free blocks set of its size.
+  void InsertFreePrev(AllocationInfo* info) REQUIRES(lock_);
+  // Removes and returns the header of the smallest free block of at least `allocation_size` bytes,
+  // or null if there is none.
+  AllocationInfo* TakeBestFitFreePrev(size_t allocation_size) REQUIRES(lock_);
+  // Try to account for `bytes` more in the page cache. Returns false if the cache is full.
+  bool ReservePageCache(size_t bytes);
+  // Give pages back to the kernel. Returns the state of the released pages.
+  PageState ReleasePages(uint8_t* begin, size_t bytes);
+  void DumpStatsLocked(std::ostream& os) const override REQUIRES(lock_);
   bool IsZygoteLargeObject(Thread* self, mirror::Object* obj) const override;
   void SetAllLargeObjectsAsZygoteObjects(Thread* self, bool set_mark_bit) override
       REQUIRES(!lock_)
@@ -236,9 +299,26 @@ class FreeListSpace final : public LargeObjectSpace {
   MemMap allocation_info_map_;
   AllocationInfo* allocation_info_;
 
+  // Side table for the page states, one per page.
+  MemMap page_state_map_;
+  PageState* page_states_;
+
   // Free bytes at the end of the space.
   size_t free_end_ GUARDED_BY(lock_);
-  FreeBlocks free_blocks_ GUARDED_BY(lock_);
+  FreeBlocks free_blocks_[kNumFreeBins] GUARDED_BY(lock_);
+
+  // Bound and current bytes of the pages in kPageCached state. Reserved before freeing the pages
+  // without the lock and released by Alloc() and Trim() with the lock.
+  const size_t max_cached_bytes_;
+  Atomic<size_t> cached_bytes_;
+  // Bytes of the pages in kPageLazyFree state.
+  size_t lazy_free_bytes_ GUARDED_BY(lock_);
+  // Total bytes allocated from cached pages, which needed neither a madvise() nor page faults.
+  uint64_t total_reused_cached_bytes_ GUARDED_BY(lock_);
+  // Total bytes given back to the kernel by Free() and Trim().
+  uint64_t total_released_bytes_ GUARDED_BY(lock_);
+  // Cleared if the kernel doesn't support MADV_FREE.
+  std::atomic<bool> use_madv_free_;
 };
 
 }  // namespace space
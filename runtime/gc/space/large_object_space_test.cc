@@ -30,6 +30,11 @@ class LargeObjectSpaceTest : public SpaceTest<CommonRuntimeTest> {
   static constexpr size_t kNumThreads = 10;
   static constexpr size_t kNumIterations = 1000;
   void RaceTest();
+
+  void PageCacheTest(size_t max_cached_bytes);
+
+  // Allocates, writes and frees buffers of 64KB to 4MB, and returns the time taken.
+  uint64_t BufferChurnBenchmark(LargeObjectSpace* los);
 };
 
 
@@ -174,6 +179,66 @@ void LargeObjectSpaceTest::RaceTest() {
   }
 }
 
+void LargeObjectSpaceTest::PageCacheTest(size_t max_cached_bytes) {
+  static constexpr size_t kAllocationSize = 64 * KB;
+  Thread* const self = Thread::Current();
+  std::unique_ptr<FreeListSpace> los(
+      FreeListSpace::Create("large object space", 16 * MB, max_cached_bytes));
+  size_t bytes_allocated = 0, bytes_tl_bulk_allocated;
+  for (size_t i = 0; i < 4; ++i) {
+    mirror::Object* obj = los->Alloc(self, kAllocationSize, &bytes_allocated, nullptr,
+                                     &bytes_tl_bulk_allocated);
+    ASSERT_TRUE(obj != nullptr);
+    // The pages of the previous iteration are reused, and must be zeroed again.
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(obj);
+    for (size_t j = 0; j < kAllocationSize; ++j) {
+      ASSERT_EQ(bytes[j], 0u) << "Non zero byte at " << j << " in iteration " << i;
+    }
+    EXPECT_EQ(los->GetCachedBytes(), 0u);
+    memset(obj, 0xff, kAllocationSize);
+    los->Free(self, obj);
+    EXPECT_EQ(los->GetCachedBytes(), std::min(kAllocationSize, max_cached_bytes));
+  }
+  EXPECT_EQ(los->Trim(), std::min(kAllocationSize, max_cached_bytes));
+  EXPECT_EQ(los->GetCachedBytes(), 0u);
+  mirror::Object* obj = los->Alloc(self, kAllocationSize, &bytes_allocated, nullptr,
+                                   &bytes_tl_bulk_allocated);
+  ASSERT_TRUE(obj != nullptr);
+  for (size_t j = 0; j < kAllocationSize; ++j) {
+    ASSERT_EQ(reinterpret_cast<const uint8_t*>(obj)[j], 0u) << "Non zero byte at " << j;
+  }
+  los->Free(self, obj);
+}
+
+uint64_t LargeObjectSpaceTest::BufferChurnBenchmark(LargeObjectSpace* los) {
+  static constexpr size_t kIterations = 2000;
+  static constexpr size_t kMinBufferSize = 64 * KB;
+  static constexpr size_t kMaxBufferSize = 4 * MB;
+  static constexpr size_t kNumLiveBuffers = 4;
+  Thread* const self = Thread::Current();
+  size_t rand_seed = 0;
+  mirror::Object* live[kNumLiveBuffers] = {};
+  const uint64_t start_time = NanoTime();
+  for (size_t i = 0; i < kIterations; ++i) {
+    size_t slot = i % kNumLiveBuffers;
+    if (live[slot] != nullptr) {
+      los->Free(self, live[slot]);
+    }
+    size_t size =
+        kMinBufferSize + (test_rand(&rand_seed) >> 16) % (kMaxBufferSize - kMinBufferSize);
+    size_t bytes_allocated = 0, bytes_tl_bulk_allocated;
+    live[slot] = los->Alloc(self, size, &bytes_allocated, nullptr, &bytes_tl_bulk_allocated);
+    CHECK(live[slot] != nullptr);
+    // Fill the buffer as a service reading into it would.
+    memset(live[slot], static_cast<int>(i), size);
+  }
+  const uint64_t duration = NanoTime() - start_time;
+  for (mirror::Object* obj : live) {
+    los->Free(self, obj);
+  }
+  return duration;
+}
+
 TEST_F(LargeObjectSpaceTest, LargeObjectTest) {
   LargeObjectTest();
 }
@@ -182,6 +247,30 @@ TEST_F(LargeObjectSpaceTest, RaceTest) {
   RaceTest();
 }
 
+TEST_F(LargeObjectSpaceTest, PageCache) {
+  PageCacheTest(FreeListSpace::kDefaultMaxCachedBytes);
+}
+
+TEST_F(LargeObjectSpaceTest, PageCacheDisabled) {
+  PageCacheTest(/*max_cached_bytes=*/ 0u);
+}
+
+TEST_F(LargeObjectSpaceTest, BufferChurnBenchmark) {
+  std::unique_ptr<LargeObjectSpace> map_los(
+      LargeObjectMapSpace::Create("mem map large object space"));
+  std::unique_ptr<LargeObjectSpace> uncached_los(
+      FreeListSpace::Create("uncached free list large object space", 128 * MB, 0u));
+  std::unique_ptr<LargeObjectSpace> cached_los(
+      FreeListSpace::Create("free list large object space", 128 * MB));
+  for (LargeObjectSpace* los : {map_los.get(), uncached_los.get(), cached_los.get()}) {
+    uint64_t duration = BufferChurnBenchmark(los);
+    EXPECT_EQ(0U, los->GetBytesAllocated());
+    std::ostringstream oss;
+    los->Dump(oss);
+    LOG(INFO) << los->GetName() << ": " << PrettyDuration(duration) << "\n" << oss.str();
+  }
+}
+
 }  // namespace space
 }  // namespace gc
 }  // namespace art
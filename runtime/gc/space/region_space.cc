@@ -13,6 +13,9 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <string.h>
+#include <sys/mman.h>
+
 #include <deque>
 
 #include "bump_pointer_space-inl.h"
@@ -49,16 +52,22 @@ static constexpr bool kCheckLiveBytesAgainstRegionBitmap = kIsDebugBuild;
 
 MemMap RegionSpace::CreateMemMap(const std::string& name,
                                  size_t capacity,
-                                 uint8_t* requested_begin) {
+                                 uint8_t* requested_begin,
+                                 bool use_huge_pages) {
   CHECK_ALIGNED(capacity, kRegionSize);
   std::string error_msg;
-  // Ask for the capacity of an additional kRegionSize so that we can align the map by kRegionSize
-  // even if we get unaligned base address. This is necessary for the ReadBarrierTable to work.
+  // Regions must be aligned by kRegionSize for the ReadBarrierTable to work. Transparent huge
+  // pages can only back huge page aligned memory, so with them align by kHugePageSize as well.
+  const size_t alignment =
+      use_huge_pages ? std::max(kRegionSize, kHugePageSize) : kRegionSize;
+  const size_t reserved_capacity = RoundUp(capacity, alignment);
+  // Ask for the capacity of an additional `alignment` so that we can align the map even if we get
+  // unaligned base address.
   MemMap mem_map;
   while (true) {
     mem_map = MemMap::MapAnonymous(name.c_str(),
                                    requested_begin,
-                                   capacity + kRegionSize,
+                                   reserved_capacity + alignment,
                                    PROT_READ | PROT_WRITE,
                                    /*low_4gb=*/ true,
                                    /*reuse=*/ false,
@@ -77,29 +86,36 @@ MemMap RegionSpace::CreateMemMap(const std::string& name,
     MemMap::DumpMaps(LOG_STREAM(ERROR));
     return MemMap::Invalid();
   }
-  CHECK_EQ(mem_map.Size(), capacity + kRegionSize);
+  CHECK_EQ(mem_map.Size(), reserved_capacity + alignment);
   CHECK_EQ(mem_map.Begin(), mem_map.BaseBegin());
   CHECK_EQ(mem_map.Size(), mem_map.BaseSize());
-  if (IsAlignedParam(mem_map.Begin(), kRegionSize)) {
-    // Got an aligned map. Since we requested a map that's kRegionSize larger. Shrink by
-    // kRegionSize at the end.
-    mem_map.SetSize(capacity);
-  } else {
+  if (!IsAlignedParam(mem_map.Begin(), alignment)) {
     // Got an unaligned map. Align the both ends.
-    mem_map.AlignBy(kRegionSize);
+    mem_map.AlignBy(alignment);
   }
-  CHECK_ALIGNED(mem_map.Begin(), kRegionSize);
+  // Shrink the map to the requested capacity at the end.
+  mem_map.SetSize(capacity);
+  CHECK_ALIGNED_PARAM(mem_map.Begin(), alignment);
   CHECK_ALIGNED(mem_map.End(), kRegionSize);
   CHECK_EQ(mem_map.Size(), capacity);
+  if (use_huge_pages && mem_map.MadviseHugePages(/*enable=*/ true) != 0) {
+    // Not fatal, the kernel may be built without transparent huge pages.
+    PLOG(WARNING) << "Failed to request transparent huge pages for " << name;
+  }
   return mem_map;
 }
 
-RegionSpace* RegionSpace::Create(
-    const std::string& name, MemMap&& mem_map, bool use_generational_cc) {
-  return new RegionSpace(name, std::move(mem_map), use_generational_cc);
+RegionSpace* RegionSpace::Create(const std::string& name,
+                                 MemMap&& mem_map,
+                                 bool use_generational_cc,
+                                 bool use_huge_pages) {
+  return new RegionSpace(name, std::move(mem_map), use_generational_cc, use_huge_pages);
 }
 
-RegionSpace::RegionSpace(const std::string& name, MemMap&& mem_map, bool use_generational_cc)
+RegionSpace::RegionSpace(const std::string& name,
+                         MemMap&& mem_map,
+                         bool use_generational_cc,
+                         bool use_huge_pages)
     : ContinuousMemMapAllocSpace(name,
                                  std::move(mem_map),
                                  mem_map.Begin(),
@@ -108,6 +124,7 @@ RegionSpace::RegionSpace(const std::string& name, MemMap&& mem_map, bool use_gen
                                  kGcRetentionPolicyAlwaysCollect),
       region_lock_("Region lock", kRegionSpaceRegionLock),
       use_generational_cc_(use_generational_cc),
+      use_huge_pages_(use_huge_pages),
       time_(1U),
       num_regions_(mem_map_.Size() / kRegionSize),
       num_non_free_regions_(0U),
@@ -116,7 +133,8 @@ RegionSpace::RegionSpace(const std::string& name, MemMap&& mem_map, bool use_gen
       non_free_region_index_limit_(0U),
       current_region_(&full_region_),
       evac_region_(nullptr),
-      cyclic_alloc_region_index_(0U) {
+      cyclic_alloc_region_index_(0U),
+      prefault_unsupported_(false) {
   CHECK_ALIGNED(mem_map_.Size(), kRegionSize);
   CHECK_ALIGNED(mem_map_.Begin(), kRegionSize);
   DCHECK_GT(num_regions_, 0U);
@@ -418,6 +436,35 @@ static void ZeroAndProtectRegion(uint8_t* begin, uint8_t* end) {
   }
 }
 
+// Like ZeroAndProtectRegion, but only release the huge pages entirely within [begin, end).
+// Releasing part of a transparent huge page splits it, and the kernel only collapses it back
+// much later, if ever. The evacuated regions are about to be allocated into again, so the
+// partially cleared huge pages are zeroed in place instead and the zeroed ranges appended to
+// `zeroed_in_place`. They are released, and split, by an idle heap trim.
+static void ZeroAndProtectRegionKeepingHugePages(
+    uint8_t* begin,
+    uint8_t* end,
+    /* out */ std::deque<std::pair<uint8_t*, uint8_t*>>* zeroed_in_place) {
+  auto zero_in_place = [zeroed_in_place](uint8_t* zero_begin, uint8_t* zero_end) {
+    if (zero_begin < zero_end) {
+      memset(zero_begin, 0, zero_end - zero_begin);
+      zeroed_in_place->push_back(std::pair(zero_begin, zero_end));
+    }
+  };
+  uint8_t* huge_begin = AlignUp(begin, kHugePageSize);
+  uint8_t* huge_end = AlignDown(end, kHugePageSize);
+  if (huge_begin < huge_end) {
+    zero_in_place(begin, huge_begin);
+    ZeroAndReleasePages(huge_begin, huge_end - huge_begin);
+    zero_in_place(huge_end, end);
+  } else {
+    zero_in_place(begin, end);
+  }
+  if (kProtectClearedRegions) {
+    CheckedCall(mprotect, __FUNCTION__, begin, end - begin, PROT_NONE);
+  }
+}
+
 void RegionSpace::ClearFromSpace(/* out */ uint64_t* cleared_bytes,
                                  /* out */ uint64_t* cleared_objects,
                                  const bool clear_bitmap) {
@@ -499,8 +546,13 @@ void RegionSpace::ClearFromSpace(/* out */ uint64_t* cleared_bytes,
   }
 
   // Madvise the memory ranges.
+  std::deque<std::pair<uint8_t*, uint8_t*>> zeroed_in_place;
   for (const auto &iter : madvise_list) {
-    ZeroAndProtectRegion(iter.first, iter.second);
+    if (use_huge_pages_) {
+      ZeroAndProtectRegionKeepingHugePages(iter.first, iter.second, &zeroed_in_place);
+    } else {
+      ZeroAndProtectRegion(iter.first, iter.second);
+    }
     if (clear_bitmap) {
       GetLiveBitmap()->ClearRange(
           reinterpret_cast<mirror::Object*>(iter.first),
@@ -518,6 +570,19 @@ void RegionSpace::ClearFromSpace(/* out */ uint64_t* cleared_bytes,
   max_peak_num_non_free_regions_ = std::max(max_peak_num_non_free_regions_,
                                             num_non_free_regions_);
 
+  // Regions zeroed in place keep their pages, record them as prefaulted so that an idle heap
+  // trim releases them. Both the regions and `zeroed_in_place` are visited in address order.
+  auto clear_region = [&zeroed_in_place](Region* r) {
+    r->Clear(/*zero_and_release_pages=*/false);
+    while (!zeroed_in_place.empty() && zeroed_in_place.front().second <= r->Begin()) {
+      zeroed_in_place.pop_front();
+    }
+    if (!zeroed_in_place.empty() && zeroed_in_place.front().first <= r->Begin()) {
+      DCHECK_LE(r->End(), zeroed_in_place.front().second);
+      r->is_prefaulted_ = true;
+    }
+  };
+
   for (size_t i = 0; i < std::min(num_regions_, non_free_region_index_limit_); ++i) {
     Region* r = &regions_[i];
     if (r->IsInFromSpace()) {
@@ -525,17 +590,17 @@ void RegionSpace::ClearFromSpace(/* out */ uint64_t* cleared_bytes,
       *cleared_bytes += r->BytesAllocated();
       *cleared_objects += r->ObjectsAllocated();
       --num_non_free_regions_;
-      r->Clear(/*zero_and_release_pages=*/false);
+      clear_region(r);
     } else if (r->IsInUnevacFromSpace()) {
       if (r->LiveBytes() == 0) {
         DCHECK(!r->IsLargeTail());
         *cleared_bytes += r->BytesAllocated();
         *cleared_objects += r->ObjectsAllocated();
-        r->Clear(/*zero_and_release_pages=*/false);
+        clear_region(r);
         size_t free_regions = 1;
         // Also release RAM for large tails.
         while (i + free_regions < num_regions_ && regions_[i + free_regions].IsLargeTail()) {
-          regions_[i + free_regions].Clear(/*zero_and_release_pages=*/false);
+          clear_region(&regions_[i + free_regions]);
           ++free_regions;
         }
         num_non_free_regions_ -= free_regions;
@@ -771,6 +836,70 @@ void RegionSpace::Clear() {
   evac_region_ = &full_region_;
 }
 
+// MADV_POPULATE_WRITE, from Linux 5.14. Defined here for older kernel headers.
+static constexpr int kMadvPopulateWrite = 23;
+
+size_t RegionSpace::PrefaultFreeRegions(size_t num_regions) {
+  if (kProtectClearedRegions || prefault_unsupported_.load(std::memory_order_relaxed)) {
+    // Free regions are inaccessible when they are protected.
+    return 0u;
+  }
+  // Like in ClearFromSpace, gather the ranges under the lock and madvise without it.
+  std::deque<std::pair<uint8_t*, uint8_t*>> populate_list;
+  size_t num_populated = 0u;
+  {
+    MutexLock mu(Thread::Current(), region_lock_);
+    // Walk the free regions in the order AllocateRegion hands them out.
+    size_t num_free = 0u;
+    for (size_t i = 0; i < num_regions_ && num_free < num_regions; ++i) {
+      size_t region_index = kCyclicRegionAllocation
+          ? ((cyclic_alloc_region_index_ + i) % num_regions_)
+          : i;
+      Region* r = &regions_[region_index];
+      if (!r->IsFree()) {
+        continue;
+      }
+      ++num_free;
+      if (r->is_prefaulted_) {
+        continue;
+      }
+      r->is_prefaulted_ = true;
+      ++num_populated;
+      if (!populate_list.empty() && populate_list.back().second == r->Begin()) {
+        populate_list.back().second = r->End();
+      } else {
+        populate_list.push_back(std::pair(r->Begin(), r->End()));
+      }
+    }
+  }
+  // Populating is safe even if a region gets allocated meanwhile: present pages are left
+  // alone and missing ones are faulted in as zero pages, as the mutator would do.
+  for (const auto& range : populate_list) {
+    if (madvise(range.first, range.second - range.first, kMadvPopulateWrite) != 0) {
+      PLOG(WARNING) << "Cannot prefault free regions, disabling region prefaulting";
+      prefault_unsupported_.store(true, std::memory_order_relaxed);
+      return 0u;
+    }
+  }
+  return num_populated;
+}
+
+size_t RegionSpace::ReleasePrefaultedRegions() {
+  // Hold the lock while releasing the pages, a prefaulted region must not be handed out while
+  // its pages are zeroed. This only happens when trimming the heap of an idle process.
+  MutexLock mu(Thread::Current(), region_lock_);
+  size_t released_bytes = 0u;
+  for (size_t i = 0; i < num_regions_; ++i) {
+    Region* r = &regions_[i];
+    if (r->IsFree() && r->is_prefaulted_) {
+      ZeroAndReleasePages(r->Begin(), kRegionSize);
+      r->is_prefaulted_ = false;
+      released_bytes += kRegionSize;
+    }
+  }
+  return released_bytes;
+}
+
 void RegionSpace::Protect() {
   if (kProtectClearedRegions) {
     CheckedCall(mprotect, __FUNCTION__, Begin(), Size(), PROT_NONE);
@@ -1012,6 +1141,7 @@ void RegionSpace::Region::Clear(bool zero_and_release_pages) {
   }
   is_newly_allocated_ = false;
   is_a_tlab_ = false;
+  is_prefaulted_ = false;
   thread_ = nullptr;
 }
 
@@ -1063,6 +1193,7 @@ void RegionSpace::Region::MarkAsAllocated(RegionSpace* region_space, uint32_t al
   alloc_time_ = alloc_time;
   region_space->AdjustNonFreeRegionLimit(idx_);
   type_ = RegionType::kRegionTypeToSpace;
+  is_prefaulted_ = false;
   if (kProtectClearedRegions) {
     CheckedCall(mprotect, __FUNCTION__, Begin(), kRegionSize, PROT_READ | PROT_WRITE);
   }
@@ -60,9 +60,17 @@ class RegionSpace final : public ContinuousMemMapAllocSpace {
 
   // Create a region space mem map with the requested sizes. The requested base address is not
   // guaranteed to be granted, if it is required, the caller should call Begin on the returned
-  // space to confirm the request was granted.
-  static MemMap CreateMemMap(const std::string& name, size_t capacity, uint8_t* requested_begin);
-  static RegionSpace* Create(const std::string& name, MemMap&& mem_map, bool use_generational_cc);
+  // space to confirm the request was granted. With `use_huge_pages`, the map is huge page
+  // aligned and backed by transparent huge pages when the kernel supports them.
+  static MemMap CreateMemMap(const std::string& name,
+                             size_t capacity,
+                             uint8_t* requested_begin,
+                             bool use_huge_pages);
+  // `use_huge_pages` must match the argument the mem map was created with.
+  static RegionSpace* Create(const std::string& name,
+                             MemMap&& mem_map,
+                             bool use_generational_cc,
+                             bool use_huge_pages);
 
   // Allocate `num_bytes`, returns null if the space is full.
   mirror::Object* Alloc(Thread* self,
@@ -316,11 +324,26 @@ class RegionSpace final : public ContinuousMemMapAllocSpace {
                       const bool clear_bitmap)
       REQUIRES(!region_lock_);
 
+  // Populate the pages of the next `num_regions` free regions to be allocated, so that the
+  // mutators allocating in them after a GC do not take page faults. Returns the number of
+  // regions populated by this call.
+  size_t PrefaultFreeRegions(size_t num_regions) REQUIRES(!region_lock_);
+
+  // Release the pages of the prefaulted free regions to the kernel. Returns the number of bytes
+  // released.
+  size_t ReleasePrefaultedRegions() REQUIRES(!region_lock_);
+
   void AddLiveBytes(mirror::Object* ref, size_t alloc_size) {
     Region* reg = RefToRegionUnlocked(ref);
     reg->AddLiveBytes(alloc_size);
   }
 
+  // Same as AddLiveBytes, for when several GC threads may update the same region.
+  void AtomicAddLiveBytes(mirror::Object* ref, size_t alloc_size) {
+    Region* reg = RefToRegionUnlocked(ref);
+    reg->AtomicAddLiveBytes(alloc_size);
+  }
+
   void AssertAllRegionLiveBytesZeroOrCleared() REQUIRES(!region_lock_) {
     if (kIsDebugBuild) {
       MutexLock mu(Thread::Current(), region_lock_);
@@ -381,7 +404,10 @@ class RegionSpace final : public ContinuousMemMapAllocSpace {
   }
 
  private:
-  RegionSpace(const std::string& name, MemMap&& mem_map, bool use_generational_cc);
+  RegionSpace(const std::string& name,
+              MemMap&& mem_map,
+              bool use_generational_cc,
+              bool use_huge_pages);
 
   class Region {
    public:
@@ -396,6 +422,7 @@ class RegionSpace final : public ContinuousMemMapAllocSpace {
           alloc_time_(0),
           is_newly_allocated_(false),
           is_a_tlab_(false),
+          is_prefaulted_(false),
           state_(RegionState::kRegionStateAllocated),
           type_(RegionType::kRegionTypeToSpace) {}
 
@@ -411,6 +438,7 @@ class RegionSpace final : public ContinuousMemMapAllocSpace {
       live_bytes_ = static_cast<size_t>(-1);
       is_newly_allocated_ = false;
       is_a_tlab_ = false;
+      is_prefaulted_ = false;
       thread_ = nullptr;
       DCHECK_LT(begin, end);
       DCHECK_EQ(static_cast<size_t>(end - begin), kRegionSize);
@@ -561,6 +589,14 @@ class RegionSpace final : public ContinuousMemMapAllocSpace {
       DCHECK_LE(live_bytes_, BytesAllocated());
     }
 
+    void AtomicAddLiveBytes(size_t live_bytes) {
+      DCHECK(GetUseGenerationalCC() || IsInUnevacFromSpace());
+      DCHECK(!IsLargeTail());
+      DCHECK_NE(live_bytes_, static_cast<size_t>(-1));
+      size_t delta = IsLarge() ? Top() - begin_ : live_bytes;
+      reinterpret_cast<Atomic<size_t>*>(&live_bytes_)->fetch_add(delta, std::memory_order_relaxed);
+    }
+
     bool AllAllocatedBytesAreLive() const {
       return LiveBytes() == static_cast<size_t>(Top() - Begin());
     }
@@ -626,6 +662,7 @@ class RegionSpace final : public ContinuousMemMapAllocSpace {
     // special value for `live_bytes_`.
     bool is_newly_allocated_;           // True if it's allocated after the last collection.
     bool is_a_tlab_;                    // True if it's a tlab.
+    bool is_prefaulted_;                // True if it's free and its pages are populated.
     RegionState state_;                 // The region state (see RegionState).
     RegionType type_;                   // The region type (see RegionType).
 
@@ -736,6 +773,9 @@ class RegionSpace final : public ContinuousMemMapAllocSpace {
 
   // Cached version of Heap::use_generational_cc_.
   const bool use_generational_cc_;
+  // Whether the space is backed by transparent huge pages. ClearFromSpace then avoids splitting
+  // them, see ZeroAndProtectRegionKeepingHugePages.
+  const bool use_huge_pages_;
   uint32_t time_;                  // The time as the number of collections since the startup.
   size_t num_regions_;             // The number of regions in this space.
   // The number of non-free regions in this space.
@@ -771,6 +811,9 @@ class RegionSpace final : public ContinuousMemMapAllocSpace {
   // `kCyclicRegionAllocation` is true.
   size_t cyclic_alloc_region_index_ GUARDED_BY(region_lock_);
 
+  // Set when the kernel does not support populating pages ahead of time.
+  Atomic<bool> prefault_unsupported_;
+
   // Mark bitmap used by the GC.
   accounting::ContinuousSpaceBitmap mark_bitmap_;
 
@@ -54,7 +54,8 @@ RosAllocSpace::RosAllocSpace(MemMap&& mem_map,
                              size_t growth_limit,
                              bool can_move_objects,
                              size_t starting_size,
-                             bool low_memory_mode)
+                             bool low_memory_mode,
+                             bool use_per_cpu_runs)
     : MallocSpace(name,
                   std::move(mem_map),
                   begin,
@@ -64,7 +65,9 @@ RosAllocSpace::RosAllocSpace(MemMap&& mem_map,
                   true,
                   can_move_objects,
                   starting_size, initial_size),
-      rosalloc_(rosalloc), low_memory_mode_(low_memory_mode) {
+      rosalloc_(rosalloc),
+      low_memory_mode_(low_memory_mode),
+      use_per_cpu_runs_(use_per_cpu_runs) {
   CHECK(rosalloc != nullptr);
 }
 
@@ -75,6 +78,7 @@ RosAllocSpace* RosAllocSpace::CreateFromMemMap(MemMap&& mem_map,
                                                size_t growth_limit,
                                                size_t capacity,
                                                bool low_memory_mode,
+                                               bool use_per_cpu_runs,
                                                bool can_move_objects) {
   DCHECK(mem_map.IsValid());
 
@@ -85,6 +89,7 @@ RosAllocSpace* RosAllocSpace::CreateFromMemMap(MemMap&& mem_map,
                                                  initial_size,
                                                  capacity,
                                                  low_memory_mode,
+                                                 use_per_cpu_runs,
                                                  running_on_memory_tool);
   if (rosalloc == nullptr) {
     LOG(ERROR) << "Failed to initialize rosalloc for alloc space (" << name << ")";
@@ -113,7 +118,8 @@ RosAllocSpace* RosAllocSpace::CreateFromMemMap(MemMap&& mem_map,
         growth_limit,
         can_move_objects,
         starting_size,
-        low_memory_mode);
+        low_memory_mode,
+        use_per_cpu_runs);
   } else {
     return new RosAllocSpace(std::move(mem_map),
                              initial_size,
@@ -125,7 +131,8 @@ RosAllocSpace* RosAllocSpace::CreateFromMemMap(MemMap&& mem_map,
                              growth_limit,
                              can_move_objects,
                              starting_size,
-                             low_memory_mode);
+                             low_memory_mode,
+                             use_per_cpu_runs);
   }
 }
 
@@ -138,6 +145,7 @@ RosAllocSpace* RosAllocSpace::Create(const std::string& name,
                                      size_t growth_limit,
                                      size_t capacity,
                                      bool low_memory_mode,
+                                     bool use_per_cpu_runs,
                                      bool can_move_objects) {
   uint64_t start_time = 0;
   if (VLOG_IS_ON(heap) || VLOG_IS_ON(startup)) {
@@ -167,6 +175,7 @@ RosAllocSpace* RosAllocSpace::Create(const std::string& name,
                                           growth_limit,
                                           capacity,
                                           low_memory_mode,
+                                          use_per_cpu_runs,
                                           can_move_objects);
   // We start out with only the initial size possibly containing objects.
   if (VLOG_IS_ON(heap) || VLOG_IS_ON(startup)) {
@@ -179,6 +188,7 @@ RosAllocSpace* RosAllocSpace::Create(const std::string& name,
 allocator::RosAlloc* RosAllocSpace::CreateRosAlloc(void* begin, size_t morecore_start,
                                                    size_t initial_size,
                                                    size_t maximum_size, bool low_memory_mode,
+                                                   bool use_per_cpu_runs,
                                                    bool running_on_memory_tool) {
   // clear errno to allow PLOG on error
   errno = 0;
@@ -190,7 +200,8 @@ allocator::RosAlloc* RosAllocSpace::CreateRosAlloc(void* begin, size_t morecore_
       low_memory_mode ?
           art::gc::allocator::RosAlloc::kPageReleaseModeAll :
           art::gc::allocator::RosAlloc::kPageReleaseModeSizeAndEnd,
-      running_on_memory_tool);
+      running_on_memory_tool,
+      use_per_cpu_runs);
   if (rosalloc != nullptr) {
     rosalloc->SetFootprintLimit(initial_size);
   } else {
@@ -241,7 +252,8 @@ MallocSpace* RosAllocSpace::CreateInstance(MemMap&& mem_map,
         growth_limit,
         can_move_objects,
         starting_size_,
-        low_memory_mode_);
+        low_memory_mode_,
+        use_per_cpu_runs_);
   } else {
     return new RosAllocSpace(std::move(mem_map),
                              initial_size_,
@@ -253,7 +265,8 @@ MallocSpace* RosAllocSpace::CreateInstance(MemMap&& mem_map,
                              growth_limit,
                              can_move_objects,
                              starting_size_,
-                             low_memory_mode_);
+                             low_memory_mode_,
+                             use_per_cpu_runs_);
   }
 }
 
@@ -436,6 +449,7 @@ void RosAllocSpace::Clear() {
                              initial_size_,
                              NonGrowthLimitCapacity(),
                              low_memory_mode_,
+                             use_per_cpu_runs_,
                              Runtime::Current()->IsRunningOnMemoryTool());
   SetFootprintLimit(footprint_limit);
 }
@@ -43,6 +43,7 @@ class RosAllocSpace : public MallocSpace {
                                size_t growth_limit,
                                size_t capacity,
                                bool low_memory_mode,
+                               bool use_per_cpu_runs,
                                bool can_move_objects);
   static RosAllocSpace* CreateFromMemMap(MemMap&& mem_map,
                                          const std::string& name,
@@ -51,6 +52,7 @@ class RosAllocSpace : public MallocSpace {
                                          size_t growth_limit,
                                          size_t capacity,
                                          bool low_memory_mode,
+                                         bool use_per_cpu_runs,
                                          bool can_move_objects);
 
   mirror::Object* AllocWithGrowth(Thread* self, size_t num_bytes, size_t* bytes_allocated,
@@ -169,7 +171,8 @@ class RosAllocSpace : public MallocSpace {
                 size_t growth_limit,
                 bool can_move_objects,
                 size_t starting_size,
-                bool low_memory_mode);
+                bool low_memory_mode,
+                bool use_per_cpu_runs);
 
  private:
   template<bool kThreadSafe = true>
@@ -178,12 +181,12 @@ class RosAllocSpace : public MallocSpace {
 
   void* CreateAllocator(void* base, size_t morecore_start, size_t initial_size,
                         size_t maximum_size, bool low_memory_mode) override {
-    return CreateRosAlloc(
-        base, morecore_start, initial_size, maximum_size, low_memory_mode, kRunningOnMemoryTool);
+    return CreateRosAlloc(base, morecore_start, initial_size, maximum_size, low_memory_mode,
+                          use_per_cpu_runs_, kRunningOnMemoryTool);
   }
   static allocator::RosAlloc* CreateRosAlloc(void* base, size_t morecore_start, size_t initial_size,
                                              size_t maximum_size, bool low_memory_mode,
-                                             bool running_on_memory_tool);
+                                             bool use_per_cpu_runs, bool running_on_memory_tool);
 
   void InspectAllRosAlloc(void (*callback)(void *start, void *end, size_t num_bytes, void* callback_arg),
                           void* arg, bool do_null_callback_at_end)
@@ -198,6 +201,9 @@ class RosAllocSpace : public MallocSpace {
 
   const bool low_memory_mode_;
 
+  // Whether the rosalloc caches its runs per CPU rather than per thread.
+  const bool use_per_cpu_runs_;
+
   friend class collector::MarkSweep;
 
   DISALLOW_COPY_AND_ASSIGN(RosAllocSpace);
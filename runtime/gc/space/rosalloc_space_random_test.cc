@@ -16,7 +16,10 @@
 
 #include "space_test.h"
 
+#include "base/time_utils.h"
+#include "gc/allocator/rosalloc.h"
 #include "rosalloc_space.h"
+#include "thread_pool.h"
 
 namespace art {
 namespace gc {
@@ -31,10 +34,134 @@ MallocSpace* CreateRosAllocSpace(const std::string& name,
                                growth_limit,
                                capacity,
                                Runtime::Current()->GetHeap()->IsLowMemoryMode(),
+                               /*use_per_cpu_runs=*/ false,
+                               /*can_move_objects=*/ false);
+}
+
+MallocSpace* CreateRosAllocSpacePerCpu(const std::string& name,
+                                       size_t initial_size,
+                                       size_t growth_limit,
+                                       size_t capacity) {
+  return RosAllocSpace::Create(name,
+                               initial_size,
+                               growth_limit,
+                               capacity,
+                               Runtime::Current()->GetHeap()->IsLowMemoryMode(),
+                               /*use_per_cpu_runs=*/ true,
                                /*can_move_objects=*/ false);
 }
 
 TEST_SPACE_CREATE_FN_RANDOM(RosAllocSpace, CreateRosAllocSpace)
+TEST_SPACE_CREATE_FN_RANDOM(RosAllocSpacePerCpu, CreateRosAllocSpacePerCpu)
+
+// Allocates and frees random small sizes, keeping every fourth allocation alive.
+class RosAllocChurnTask : public Task {
+ public:
+  RosAllocChurnTask(allocator::RosAlloc* rosalloc, size_t seed)
+      : rosalloc_(rosalloc), seed_(seed), allocated_bytes_(0u) {}
+
+  void Run(Thread* self) override {
+    static constexpr size_t kIterations = 100000;
+    static constexpr size_t kWindow = 64;
+    static constexpr size_t kMaxSize = allocator::RosAlloc::kMaxThreadLocalBracketSize;
+    void* window[kWindow] = {};
+    for (size_t i = 0; i < kIterations; ++i) {
+      size_t size = 1u + (test_rand(&seed_) >> 16) % kMaxSize;
+      size_t bytes_allocated = 0u;
+      size_t usable_size = 0u;
+      size_t bytes_tl_bulk_allocated = 0u;
+      void* ptr = rosalloc_->Alloc(self, size, &bytes_allocated, &usable_size,
+                                   &bytes_tl_bulk_allocated);
+      ASSERT_TRUE(ptr != nullptr);
+      if (i % 4 == 0) {
+        live_.push_back(ptr);
+        allocated_bytes_ += bytes_allocated;
+        continue;
+      }
+      size_t slot = (test_rand(&seed_) >> 16) % kWindow;
+      if (window[slot] != nullptr) {
+        rosalloc_->Free(self, window[slot]);
+      }
+      window[slot] = ptr;
+    }
+    for (void* ptr : window) {
+      if (ptr != nullptr) {
+        rosalloc_->Free(self, ptr);
+      }
+    }
+    rosalloc_->RevokeThreadLocalRuns(self);
+  }
+
+  void FreeLive(Thread* self) {
+    for (void* ptr : live_) {
+      rosalloc_->Free(self, ptr);
+    }
+    live_.clear();
+  }
+
+  size_t GetLiveBytes() const {
+    return allocated_bytes_;
+  }
+
+ private:
+  allocator::RosAlloc* const rosalloc_;
+  size_t seed_;
+  size_t allocated_bytes_;
+  std::vector<void*> live_;
+};
+
+class RosAllocSpaceChurnTest : public SpaceTest<CommonRuntimeTest> {
+ protected:
+  // Churns the rosalloc of a new space from many more threads than CPUs and logs the time taken
+  // and how much of the footprint is left holding the surviving allocations.
+  void ChurnDriver(bool use_per_cpu_runs) {
+    static constexpr size_t kNumThreads = 32;
+    Thread* self = Thread::Current();
+    std::unique_ptr<RosAllocSpace> space(RosAllocSpace::Create("test",
+                                                               16 * MB,
+                                                               256 * MB,
+                                                               256 * MB,
+                                                               /*low_memory_mode=*/ false,
+                                                               use_per_cpu_runs,
+                                                               /*can_move_objects=*/ false));
+    ASSERT_TRUE(space != nullptr);
+    allocator::RosAlloc* rosalloc = space->GetRosAlloc();
+    rosalloc->SetFootprintLimit(space->Capacity());
+    std::vector<std::unique_ptr<RosAllocChurnTask>> tasks;
+    ThreadPool thread_pool("RosAlloc churn test thread pool", kNumThreads);
+    for (size_t i = 0; i < kNumThreads; ++i) {
+      tasks.emplace_back(new RosAllocChurnTask(rosalloc, /*seed=*/ 123456789 + i));
+      thread_pool.AddTask(self, tasks.back().get());
+    }
+    uint64_t start_time = NanoTime();
+    thread_pool.StartWorkers(self);
+    thread_pool.Wait(self, /*do_work=*/ false, /*may_hold_locks=*/ false);
+    uint64_t duration = NanoTime() - start_time;
+    rosalloc->RevokeAllThreadLocalRuns();
+    size_t live_bytes = 0u;
+    for (const std::unique_ptr<RosAllocChurnTask>& task : tasks) {
+      live_bytes += task->GetLiveBytes();
+    }
+    size_t footprint = rosalloc->Footprint();
+    EXPECT_GE(footprint, live_bytes);
+    LOG(INFO) << (use_per_cpu_runs ? "Per-CPU" : "Thread-local") << " runs: "
+              << PrettyDuration(duration) << ", " << PrettySize(live_bytes) << " live in a "
+              << PrettySize(footprint) << " footprint";
+    for (const std::unique_ptr<RosAllocChurnTask>& task : tasks) {
+      task->FreeLive(self);
+    }
+    rosalloc->RevokeAllThreadLocalRuns();
+    rosalloc->AssertAllThreadLocalRunsAreRevoked();
+  }
+};
+
+TEST_F(RosAllocSpaceChurnTest, ThreadLocalRuns) {
+  ChurnDriver(/*use_per_cpu_runs=*/ false);
+}
+
+TEST_F(RosAllocSpaceChurnTest, PerCpuRuns) {
+  ChurnDriver(/*use_per_cpu_runs=*/ true);
+}
 
 }  // namespace space
 }  // namespace gc
@@ -30,6 +30,7 @@ MallocSpace* CreateRosAllocSpace(const std::string& name,
                                growth_limit,
                                capacity,
                                Runtime::Current()->GetHeap()->IsLowMemoryMode(),
+                               /*use_per_cpu_runs=*/ false,
                                /*can_move_objects=*/ false);
 }
 
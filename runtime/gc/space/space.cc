@@ -88,20 +88,30 @@ DiscontinuousSpace::DiscontinuousSpace(const std::string& name,
 }
 
 collector::ObjectBytePair ContinuousMemMapAllocSpace::Sweep(bool swap_bitmaps) {
+  return SweepRange(swap_bitmaps,
+                    reinterpret_cast<uintptr_t>(Begin()),
+                    reinterpret_cast<uintptr_t>(End()),
+                    Thread::Current());
+}
+
+collector::ObjectBytePair ContinuousMemMapAllocSpace::SweepRange(bool swap_bitmaps,
+                                                                 uintptr_t sweep_begin,
+                                                                 uintptr_t sweep_end,
+                                                                 Thread* heap_bitmap_lock_holder) {
   accounting::ContinuousSpaceBitmap* live_bitmap = GetLiveBitmap();
   accounting::ContinuousSpaceBitmap* mark_bitmap = GetMarkBitmap();
   // If the bitmaps are bound then sweeping this space clearly won't do anything.
   if (live_bitmap == mark_bitmap) {
     return collector::ObjectBytePair(0, 0);
   }
-  SweepCallbackContext scc(swap_bitmaps, this);
+  SweepCallbackContext scc(swap_bitmaps, this, heap_bitmap_lock_holder);
   if (swap_bitmaps) {
     std::swap(live_bitmap, mark_bitmap);
   }
   // Bitmaps are pre-swapped for optimization which enables sweeping with the heap unlocked.
   accounting::ContinuousSpaceBitmap::SweepWalk(
-      *live_bitmap, *mark_bitmap, reinterpret_cast<uintptr_t>(Begin()),
-      reinterpret_cast<uintptr_t>(End()), GetSweepCallback(), reinterpret_cast<void*>(&scc));
+      *live_bitmap, *mark_bitmap, sweep_begin, sweep_end, GetSweepCallback(),
+      reinterpret_cast<void*>(&scc));
   return scc.freed;
 }
 
@@ -134,7 +144,16 @@ void ContinuousMemMapAllocSpace::SwapBitmaps() {
 }
 
 AllocSpace::SweepCallbackContext::SweepCallbackContext(bool swap_bitmaps_in, space::Space* space_in)
-    : swap_bitmaps(swap_bitmaps_in), space(space_in), self(Thread::Current()) {
+    : SweepCallbackContext(swap_bitmaps_in, space_in, Thread::Current()) {
+}
+
+AllocSpace::SweepCallbackContext::SweepCallbackContext(bool swap_bitmaps_in,
+                                                       space::Space* space_in,
+                                                       Thread* heap_bitmap_lock_holder_in)
+    : swap_bitmaps(swap_bitmaps_in),
+      space(space_in),
+      self(Thread::Current()),
+      heap_bitmap_lock_holder(heap_bitmap_lock_holder_in) {
 }
 
 }  // namespace space
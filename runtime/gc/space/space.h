@@ -248,9 +248,13 @@ class AllocSpace {
  protected:
   struct SweepCallbackContext {
     SweepCallbackContext(bool swap_bitmaps, space::Space* space);
+    // For sweeping on another thread than the one holding the heap bitmap lock.
+    SweepCallbackContext(bool swap_bitmaps, space::Space* space, Thread* heap_bitmap_lock_holder);
     const bool swap_bitmaps;
     space::Space* const space;
     Thread* const self;
+    // The thread holding the heap bitmap lock exclusively while the space is swept.
+    Thread* const heap_bitmap_lock_holder;
     collector::ObjectBytePair freed;
   };
 
@@ -449,6 +453,13 @@ class ContinuousMemMapAllocSpace : public MemMapSpace, public AllocSpace {
   }
 
   collector::ObjectBytePair Sweep(bool swap_bitmaps);
+  // Sweep the objects of [sweep_begin, sweep_end), which must be aligned to the heap range covered
+  // by a bitmap word so that disjoint ranges can be swept in parallel. The calling thread sweeps
+  // on behalf of `heap_bitmap_lock_holder`, which holds the heap bitmap lock exclusively.
+  collector::ObjectBytePair SweepRange(bool swap_bitmaps,
+                                      uintptr_t sweep_begin,
+                                      uintptr_t sweep_end,
+                                      Thread* heap_bitmap_lock_holder);
   virtual accounting::ContinuousSpaceBitmap::SweepCallback* GetSweepCallback() = 0;
 
  protected:
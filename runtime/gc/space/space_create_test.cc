@@ -49,6 +49,7 @@ class SpaceCreateTest : public SpaceTest<CommonRuntimeTestWithParam<MallocSpaceT
                                  growth_limit,
                                  capacity,
                                  Runtime::Current()->GetHeap()->IsLowMemoryMode(),
+                                 /*use_per_cpu_runs=*/ false,
                                  /*can_move_objects=*/ false);
   }
 };
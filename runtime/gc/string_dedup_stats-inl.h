@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_STRING_DEDUP_STATS_INL_H_
+#define ART_RUNTIME_GC_STRING_DEDUP_STATS_INL_H_
+
+#include "string_dedup_stats.h"
+
+#include "mirror/object-inl.h"
+
+namespace art {
+namespace gc {
+
+inline void StringDedupStats::Table::AddObject(mirror::Object* obj) {
+  // The string class may not have been forwarded yet, IsString() reads it without a read barrier.
+  if (obj->IsString<kVerifyNone>()) {
+    strings_.push_back(obj->AsString<kVerifyNone>().Ptr());
+  }
+}
+
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_STRING_DEDUP_STATS_INL_H_
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "string_dedup_stats.h"
+
+#include <functional>
+#include <ostream>
+#include <string_view>
+#include <unordered_set>
+
+#include "base/utils.h"
+#include "mirror/string-inl.h"
+#include "thread-current-inl.h"
+
+namespace art {
+namespace gc {
+
+namespace {
+
+// The contents of a string, its count, which holds the length and the compression flag, and its
+// characters. The identity hash code and the cached String.hashCode() are not compared.
+struct StringContents {
+  int32_t count;
+  std::string_view data;
+
+  bool operator==(const StringContents& other) const {
+    return count == other.count && data == other.data;
+  }
+};
+
+struct StringContentsHash {
+  size_t operator()(const StringContents& contents) const {
+    return std::hash<std::string_view>()(contents.data) ^ static_cast<size_t>(contents.count);
+  }
+};
+
+}  // namespace
+
+void StringDedupStats::Table::Merge(const Table& other) {
+  strings_.insert(strings_.end(), other.strings_.begin(), other.strings_.end());
+}
+
+StringDedupStats::StringDedupStats()
+    : lock_("string dedup stats lock", kGenericBottomLock),
+      num_collections_(0u) {}
+
+void StringDedupStats::Publish(const Table& table, const std::string& collector_name) {
+  // Strings are immutable, so the views stay valid as long as the strings are readable.
+  std::unordered_set<StringContents, StringContentsHash> contents;
+  contents.reserve(table.strings_.size());
+  Result result;
+  for (mirror::String* string : table.strings_) {
+    const int32_t count = string->GetCount<kVerifyNone>();
+    const size_t length = mirror::String::GetLengthFromCount(count);
+    const bool compressed = kUseStringCompression && mirror::String::IsCompressed(count);
+    std::string_view data(compressed
+                              ? reinterpret_cast<const char*>(string->GetValueCompressed())
+                              : reinterpret_cast<const char*>(string->GetValue()),
+                          compressed ? length * sizeof(uint8_t) : length * sizeof(uint16_t));
+    const size_t size = string->SizeOf<kVerifyNone>();
+    ++result.strings;
+    result.bytes += size;
+    if (!contents.insert({count, data}).second) {
+      ++result.duplicate_strings;
+      result.duplicate_bytes += size;
+    }
+  }
+
+  MutexLock mu(Thread::Current(), lock_);
+  last_result_ = result;
+  collector_name_ = collector_name;
+  ++num_collections_;
+}
+
+void StringDedupStats::Dump(std::ostream& os) {
+  MutexLock mu(Thread::Current(), lock_);
+  if (num_collections_ == 0u) {
+    os << "String dedup stats: no full collection yet";
+    return;
+  }
+  os << "String dedup stats of the last " << collector_name_ << ": "
+     << last_result_.duplicate_strings << " of " << last_result_.strings
+     << " strings are duplicates, deduplicating them would save "
+     << PrettySize(last_result_.duplicate_bytes) << " of " << PrettySize(last_result_.bytes);
+}
+
+StringDedupStats::Result StringDedupStats::GetLastResult() {
+  MutexLock mu(Thread::Current(), lock_);
+  return last_result_;
+}
+
+}  // namespace gc
+}  // namespace art
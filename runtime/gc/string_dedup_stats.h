@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_STRING_DEDUP_STATS_H_
+#define ART_RUNTIME_GC_STRING_DEDUP_STATS_H_
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/mutex.h"
+
+namespace art {
+
+namespace mirror {
+class Object;
+class String;
+}  // namespace mirror
+
+namespace gc {
+
+// Duplicate java.lang.String statistics of the last full concurrent copying collection, enabled
+// with -XX:StringDedupStats.
+//
+// Strings keep their characters inline rather than in a separate value array, so equal strings
+// cannot share their storage, and redirecting references to a canonical String would change the
+// identity of the strings. Instead, the collector finds the strings that survive a full collection
+// with the same contents as another one, and reports in the GC log how many bytes deduplicating
+// them, for example by interning, would save. Strings of the immune spaces, such as the boot image,
+// are not marked and therefore not counted.
+class StringDedupStats {
+ public:
+  struct Result {
+    // Strings seen by the collection, and the bytes they take.
+    uint64_t strings = 0u;
+    uint64_t bytes = 0u;
+    // Strings with the same contents as another one seen before them, and the bytes they take.
+    uint64_t duplicate_strings = 0u;
+    uint64_t duplicate_bytes = 0u;
+  };
+
+  // Strings found by a marking thread. Not thread safe.
+  class Table {
+   public:
+    // Record `obj` if it is a string.
+    ALWAYS_INLINE void AddObject(mirror::Object* obj) REQUIRES_SHARED(Locks::mutator_lock_);
+
+    void Merge(const Table& other);
+
+    bool IsEmpty() const {
+      return strings_.empty();
+    }
+
+    void Clear() {
+      strings_.clear();
+    }
+
+   private:
+    std::vector<mirror::String*> strings_;
+
+    friend class StringDedupStats;
+  };
+
+  StringDedupStats();
+
+  // Replace the statistics with the duplicates among the strings of `table`, which must still be
+  // readable at the addresses they were recorded at.
+  void Publish(const Table& table, const std::string& collector_name)
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(!lock_);
+
+  // Print the statistics of the last full collection, on one line.
+  void Dump(std::ostream& os) REQUIRES(!lock_);
+
+  Result GetLastResult() REQUIRES(!lock_);
+
+ private:
+  Mutex lock_;
+  Result last_result_ GUARDED_BY(lock_);
+  std::string collector_name_ GUARDED_BY(lock_);
+  size_t num_collections_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(StringDedupStats);
+};
+
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_STRING_DEDUP_STATS_H_
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "string_dedup_stats-inl.h"
+
+#include <sstream>
+
+#include "class_root.h"
+#include "common_runtime_test.h"
+#include "handle_scope-inl.h"
+#include "mirror/class-alloc-inl.h"
+#include "mirror/object-inl.h"
+#include "mirror/string-alloc-inl.h"
+#include "scoped_thread_state_change-inl.h"
+
+namespace art {
+namespace gc {
+
+class StringDedupStatsTest : public CommonRuntimeTest {};
+
+TEST_F(StringDedupStatsTest, FindDuplicates) {
+  Thread* self = Thread::Current();
+  ScopedObjectAccess soa(self);
+  StackHandleScope<5> hs(self);
+  Handle<mirror::Object> object = hs.NewHandle(GetClassRoot<mirror::Object>()->AllocObject(self));
+  Handle<mirror::String> string1 =
+      hs.NewHandle(mirror::String::AllocFromModifiedUtf8(self, "a duplicated string"));
+  Handle<mirror::String> string2 =
+      hs.NewHandle(mirror::String::AllocFromModifiedUtf8(self, "a duplicated string"));
+  Handle<mirror::String> string3 =
+      hs.NewHandle(mirror::String::AllocFromModifiedUtf8(self, "a duplicated string"));
+  // Not a duplicate although it is a prefix of the others.
+  Handle<mirror::String> string4 =
+      hs.NewHandle(mirror::String::AllocFromModifiedUtf8(self, "a duplicated"));
+  ASSERT_TRUE(object != nullptr);
+  ASSERT_TRUE(string1 != nullptr);
+  ASSERT_TRUE(string2 != nullptr);
+  ASSERT_TRUE(string3 != nullptr);
+  ASSERT_TRUE(string4 != nullptr);
+
+  StringDedupStats stats;
+  std::ostringstream oss;
+  stats.Dump(oss);
+  EXPECT_NE(oss.str().find("no full collection"), std::string::npos) << oss.str();
+
+  // Record as two marking threads would. Objects other than strings are ignored.
+  StringDedupStats::Table table;
+  StringDedupStats::Table other_table;
+  table.AddObject(object.Get());
+  EXPECT_TRUE(table.IsEmpty());
+  table.AddObject(string1.Get());
+  table.AddObject(string2.Get());
+  other_table.AddObject(string3.Get());
+  other_table.AddObject(string4.Get());
+  table.Merge(other_table);
+
+  stats.Publish(table, "test collector");
+  StringDedupStats::Result result = stats.GetLastResult();
+  EXPECT_EQ(4u, result.strings);
+  EXPECT_EQ(string1->SizeOf() * 3 + string4->SizeOf(), result.bytes);
+  EXPECT_EQ(2u, result.duplicate_strings);
+  EXPECT_EQ(string1->SizeOf() * 2, result.duplicate_bytes);
+
+  oss.str("");
+  stats.Dump(oss);
+  EXPECT_NE(oss.str().find("test collector"), std::string::npos) << oss.str();
+  EXPECT_NE(oss.str().find("2 of 4 strings"), std::string::npos) << oss.str();
+
+  // New statistics replace the last ones.
+  table.Clear();
+  stats.Publish(table, "test collector");
+  EXPECT_EQ(0u, stats.GetLastResult().strings);
+}
+
+}  // namespace gc
+}  // namespace art
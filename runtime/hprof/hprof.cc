@@ -33,10 +33,16 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <thread>
 
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <zlib.h>
 
 #include "art_field-inl.h"
 #include "art_method-inl.h"
@@ -388,29 +394,185 @@ class EndianOutputBuffered : public EndianOutput {
   std::vector<uint8_t> buffer_;
 };
 
+// Streams the records to a file through two fixed size buffers. The dumping thread fills one
+// buffer while a background writer thread writes, and optionally gzip compresses, the other one.
+// This bounds the memory used by the dump and keeps the file I/O off the thread that holds the
+// mutator lock exclusively.
 class FileEndianOutput final : public EndianOutputBuffered {
  public:
-  FileEndianOutput(File* fp, size_t reserved_size)
-      : EndianOutputBuffered(reserved_size), fp_(fp), errors_(false) {
+  static constexpr size_t kStreamBufferSize = 1 * MB;
+
+  FileEndianOutput(File* fp, size_t reserved_size, bool compress)
+      : EndianOutputBuffered(reserved_size),
+        fp_(fp),
+        compress_(compress),
+        buffers_{std::make_unique<uint8_t[]>(kStreamBufferSize),
+                 std::make_unique<uint8_t[]>(kStreamBufferSize)} {
     DCHECK(fp != nullptr);
+    if (compress_) {
+      compressed_buffer_ = std::make_unique<uint8_t[]>(kStreamBufferSize);
+      memset(&zstream_, 0, sizeof(zstream_));
+      // Add 16 to the window bits to get a gzip header and trailer. Favor speed over size since
+      // the dump is usually pulled off the device and converted anyway.
+      if (deflateInit2(&zstream_,
+                       Z_BEST_SPEED,
+                       Z_DEFLATED,
+                       MAX_WBITS + 16,
+                       MAX_MEM_LEVEL,
+                       Z_DEFAULT_STRATEGY) != Z_OK) {
+        LOG(ERROR) << "hprof: deflateInit2 failed, writing uncompressed output";
+        compress_ = false;
+        compressed_buffer_.reset();
+      }
+    }
+    writer_ = std::thread([this]() { WriterLoop(); });
   }
+
   ~FileEndianOutput() {
+    Finish();
+  }
+
+  // Write out the partially filled buffer and wait for the writer thread to finish.
+  // Returns false if any write failed, see GetError().
+  bool Finish() {
+    if (writer_.joinable()) {
+      if (fill_ != 0u) {
+        SubmitBuffer();
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finishing_ = true;
+      }
+      cond_.notify_all();
+      writer_.join();
+    }
+    return !Errors();
   }
 
   bool Errors() {
-    return errors_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_ != 0;
+  }
+
+  // The errno of the first failed write, saved on the writer thread.
+  int GetError() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
   }
 
  protected:
   void HandleFlush(const uint8_t* buffer, size_t length) override {
-    if (!errors_) {
-      errors_ = !fp_->WriteFully(buffer, length);
+    while (length != 0u) {
+      const size_t chunk = std::min(length, kStreamBufferSize - fill_);
+      memcpy(buffers_[current_].get() + fill_, buffer, chunk);
+      fill_ += chunk;
+      buffer += chunk;
+      length -= chunk;
+      if (fill_ == kStreamBufferSize) {
+        SubmitBuffer();
+      }
     }
   }
 
  private:
-  File* fp_;
-  bool errors_;
+  // Hand the current buffer to the writer thread and switch to the other one, waiting for the
+  // writer to release it first.
+  void SubmitBuffer() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this]() { return pending_ == nullptr; });
+      pending_ = buffers_[current_].get();
+      pending_length_ = fill_;
+    }
+    cond_.notify_all();
+    current_ ^= 1u;
+    fill_ = 0u;
+  }
+
+  void WriterLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cond_.wait(lock, [this]() { return pending_ != nullptr || finishing_; });
+      if (pending_ == nullptr) {
+        break;
+      }
+      const uint8_t* data = pending_;
+      const size_t length = pending_length_;
+      bool skip = error_ != 0;
+      lock.unlock();
+      bool okay = skip || Write(data, length, /*finish=*/ false);
+      const int write_errno = errno;
+      lock.lock();
+      if (!okay) {
+        SetError(write_errno);
+      }
+      pending_ = nullptr;
+      cond_.notify_all();
+    }
+    bool skip = error_ != 0;
+    lock.unlock();
+    bool okay = skip || Write(nullptr, 0u, /*finish=*/ true);
+    const int write_errno = errno;
+    if (compress_) {
+      deflateEnd(&zstream_);
+    }
+    lock.lock();
+    if (!okay) {
+      SetError(write_errno);
+    }
+  }
+
+  // Keep the first error. Compression errors do not set errno.
+  void SetError(int write_errno) {
+    if (error_ == 0) {
+      error_ = (write_errno != 0) ? write_errno : EIO;
+    }
+  }
+
+  bool Write(const uint8_t* data, size_t length, bool finish) {
+    errno = 0;
+    if (!compress_) {
+      return length == 0u || fp_->WriteFully(data, length);
+    }
+    zstream_.next_in = const_cast<uint8_t*>(data);
+    zstream_.avail_in = length;
+    const int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+    int result;
+    do {
+      zstream_.next_out = compressed_buffer_.get();
+      zstream_.avail_out = kStreamBufferSize;
+      result = deflate(&zstream_, flush);
+      if (result == Z_STREAM_ERROR) {
+        return false;
+      }
+      const size_t produced = kStreamBufferSize - zstream_.avail_out;
+      if (produced != 0u && !fp_->WriteFully(compressed_buffer_.get(), produced)) {
+        return false;
+      }
+    } while (zstream_.avail_out == 0u || (finish && result != Z_STREAM_END));
+    DCHECK_EQ(zstream_.avail_in, 0u);
+    return true;
+  }
+
+  File* const fp_;
+  bool compress_;
+
+  // Buffers filled by the dumping thread, `current_` is the one being filled.
+  std::unique_ptr<uint8_t[]> buffers_[2];
+  size_t current_ = 0u;
+  size_t fill_ = 0u;
+
+  // Only accessed by the writer thread.
+  std::unique_ptr<uint8_t[]> compressed_buffer_;
+  z_stream zstream_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  const uint8_t* pending_ = nullptr;  // Buffer handed to the writer, guarded by `mutex_`.
+  size_t pending_length_ = 0u;
+  bool finishing_ = false;
+  int error_ = 0;  // Errno of the first failed write, guarded by `mutex_`.
+  std::thread writer_;
 };
 
 class VectorEndianOuputput final : public EndianOutputBuffered {
@@ -777,11 +939,19 @@ class Hprof : public SingleRootVisitor {
 
     std::unique_ptr<File> file(new File(out_fd, filename_, true));
     bool okay;
+    // The errno of a failed write, which happens on the writer thread.
+    int error = 0;
     {
-      FileEndianOutput file_output(file.get(), max_length);
+      // Dumps with a ".gz" file name are compressed while they are being written.
+      FileEndianOutput file_output(file.get(),
+                                   max_length,
+                                   android::base::EndsWith(filename_, ".gz"));
       output_ = &file_output;
       ProcessHeap(true);
-      okay = !file_output.Errors();
+      okay = file_output.Finish();
+      if (!okay) {
+        error = file_output.GetError();
+      }
 
       if (okay) {
         // Check for expected size. Output is expected to be less-or-equal than first phase, see
@@ -792,14 +962,17 @@ class Hprof : public SingleRootVisitor {
     }
 
     if (okay) {
-      okay = file->FlushCloseOrErase() == 0;
+      // Returns a negated errno on failure.
+      const int result = file->FlushCloseOrErase();
+      okay = result == 0;
+      error = -result;
     } else {
       file->Erase();
     }
     if (!okay) {
       std::string msg(android::base::StringPrintf("Couldn't dump heap; writing \"%s\" failed: %s",
                                                   filename_.c_str(),
-                                                  strerror(errno)));
+                                                  strerror(error)));
       ThrowRuntimeException("%s", msg.c_str());
       LOG(ERROR) << msg;
     }
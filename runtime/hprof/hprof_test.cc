@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hprof.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+
+#include "android-base/file.h"
+#include "android-base/unique_fd.h"
+
+#include "common_runtime_test.h"
+#include "mirror/object-inl.h"
+#include "mirror/string.h"
+#include "scoped_thread_state_change-inl.h"
+#include "thread-current-inl.h"
+
+namespace art {
+namespace hprof {
+
+class HprofTest : public CommonRuntimeTest {
+ protected:
+  static constexpr uint8_t kTagHeapDumpEnd = 0x2c;
+
+  static uint32_t ReadU4(const std::vector<uint8_t>& data, size_t offset) {
+    return (static_cast<uint32_t>(data[offset]) << 24) |
+           (static_cast<uint32_t>(data[offset + 1]) << 16) |
+           (static_cast<uint32_t>(data[offset + 2]) << 8) |
+           static_cast<uint32_t>(data[offset + 3]);
+  }
+
+  // Check the header of a dump and walk its records up to the heap dump end record.
+  static void CheckDump(const std::vector<uint8_t>& data) {
+    static const char kMagic[] = "JAVA PROFILE 1.0.3";
+    ASSERT_GT(data.size(), sizeof(kMagic) + 3 * sizeof(uint32_t));
+    ASSERT_EQ(0, memcmp(data.data(), kMagic, sizeof(kMagic)));
+    EXPECT_EQ(sizeof(uint32_t), ReadU4(data, sizeof(kMagic)));
+    size_t offset = sizeof(kMagic) + 3 * sizeof(uint32_t);
+    size_t num_records = 0u;
+    uint8_t last_tag = 0u;
+    // Each record is a U1 tag, a U4 time and the U4 length of the body.
+    static constexpr size_t kRecordHeaderSize = sizeof(uint8_t) + 2 * sizeof(uint32_t);
+    while (offset != data.size()) {
+      ASSERT_LE(offset + kRecordHeaderSize, data.size()) << "Truncated record " << num_records;
+      last_tag = data[offset];
+      const size_t length = ReadU4(data, offset + sizeof(uint8_t) + sizeof(uint32_t));
+      offset += kRecordHeaderSize;
+      ASSERT_LE(length, data.size() - offset) << "Truncated record " << num_records;
+      offset += length;
+      ++num_records;
+    }
+    EXPECT_GT(num_records, 1u);
+    EXPECT_EQ(kTagHeapDumpEnd, last_tag);
+  }
+
+  static std::vector<uint8_t> ReadFile(const std::string& filename) {
+    std::string contents;
+    EXPECT_TRUE(android::base::ReadFileToString(filename, &contents)) << filename;
+    return std::vector<uint8_t>(contents.begin(), contents.end());
+  }
+
+  static std::vector<uint8_t> Gunzip(const std::vector<uint8_t>& compressed) {
+    std::vector<uint8_t> data;
+    z_stream zstream;
+    memset(&zstream, 0, sizeof(zstream));
+    // Add 16 to the window bits to only accept gzip input.
+    EXPECT_EQ(Z_OK, inflateInit2(&zstream, MAX_WBITS + 16));
+    zstream.next_in = const_cast<uint8_t*>(compressed.data());
+    zstream.avail_in = compressed.size();
+    uint8_t buffer[64 * KB];
+    int result;
+    do {
+      zstream.next_out = buffer;
+      zstream.avail_out = sizeof(buffer);
+      result = inflate(&zstream, Z_NO_FLUSH);
+      data.insert(data.end(), buffer, buffer + sizeof(buffer) - zstream.avail_out);
+    } while (result == Z_OK);
+    EXPECT_EQ(Z_STREAM_END, result);
+    EXPECT_EQ(0u, zstream.avail_in);
+    inflateEnd(&zstream);
+    return data;
+  }
+};
+
+TEST_F(HprofTest, DumpToFile) {
+  ScratchFile file;
+  const std::string filename = file.GetFilename() + ".hprof";
+  DumpHeap(filename.c_str(), /*fd=*/ -1, /*direct_to_ddms=*/ false);
+  std::vector<uint8_t> data = ReadFile(filename);
+  unlink(filename.c_str());
+  CheckDump(data);
+  // Larger than a stream buffer, so the writer thread wrote out full buffers as well.
+  EXPECT_GT(data.size(), 1 * MB);
+}
+
+TEST_F(HprofTest, DumpToCompressedFile) {
+  ScratchFile file;
+  const std::string filename = file.GetFilename() + ".hprof.gz";
+  DumpHeap(filename.c_str(), /*fd=*/ -1, /*direct_to_ddms=*/ false);
+  std::vector<uint8_t> compressed = ReadFile(filename);
+  unlink(filename.c_str());
+  std::vector<uint8_t> data = Gunzip(compressed);
+  CheckDump(data);
+  EXPECT_LT(compressed.size(), data.size());
+}
+
+TEST_F(HprofTest, ReportsWriteError) {
+  // Every write to /dev/full fails with ENOSPC, on the writer thread.
+  android::base::unique_fd fd(open("/dev/full", O_WRONLY | O_CLOEXEC));
+  if (fd.get() < 0) {
+    printf("WARNING: TEST DISABLED, cannot open /dev/full: %s\n", strerror(errno));
+    return;
+  }
+  Thread* self = Thread::Current();
+  DumpHeap("/dev/full", fd.get(), /*direct_to_ddms=*/ false);
+  ScopedObjectAccess soa(self);
+  ASSERT_TRUE(self->IsExceptionPending());
+  std::string message = self->GetException()->GetDetailMessage()->ToModifiedUtf8();
+  self->ClearException();
+  EXPECT_NE(std::string::npos, message.find(strerror(ENOSPC))) << message;
+}
+
+}  // namespace hprof
+}  // namespace art
@@ -64,6 +64,19 @@ void InternTable::VisitRoots(RootVisitor* visitor, VisitRootFlags flags) {
   MutexLock mu(Thread::Current(), *Locks::intern_table_lock_);
   if ((flags & kVisitRootFlagAllRoots) != 0) {
     strong_interns_.VisitRoots(visitor);
+    // The cached strings are kept alive by strong_interns_, but moving collectors need to update
+    // the cache entries too.
+    // Readers do not hold the lock, so the entries are visited through a copy.
+    for (Atomic<GcRoot<mirror::String>>& entry : strong_intern_cache_) {
+      GcRoot<mirror::String> root = entry.load(std::memory_order_relaxed);
+      if (!root.IsNull()) {
+        mirror::String* const before = root.Read<kWithoutReadBarrier>();
+        root.VisitRoot(visitor, RootInfo(kRootInternedString));
+        if (root.Read<kWithoutReadBarrier>() != before) {
+          entry.store(root, std::memory_order_release);
+        }
+      }
+    }
   } else if ((flags & kVisitRootFlagNewRoots) != 0) {
     for (auto& root : new_strong_intern_roots_) {
       ObjPtr<mirror::String> old_ref = root.Read<kWithoutReadBarrier>();
@@ -75,6 +88,8 @@ void InternTable::VisitRoots(RootVisitor* visitor, VisitRootFlags flags) {
         // concurrent moving GC.
         strong_interns_.Remove(old_ref);
         strong_interns_.Insert(new_ref);
+        // Equal strings share the cache slot, so this also replaces any stale entry for old_ref.
+        AddToStrongCache(new_ref);
       }
     }
   }
@@ -95,8 +110,16 @@ ObjPtr<mirror::String> InternTable::LookupWeak(Thread* self, ObjPtr<mirror::Stri
 }
 
 ObjPtr<mirror::String> InternTable::LookupStrong(Thread* self, ObjPtr<mirror::String> s) {
+  ObjPtr<mirror::String> cached = LookupStrongInCache(s);
+  if (cached != nullptr) {
+    return cached;
+  }
   MutexLock mu(self, *Locks::intern_table_lock_);
-  return LookupStrongLocked(s);
+  ObjPtr<mirror::String> strong = LookupStrongLocked(s);
+  if (strong != nullptr) {
+    AddToStrongCache(strong);
+  }
+  return strong;
 }
 
 ObjPtr<mirror::String> InternTable::LookupStrong(Thread* self,
@@ -106,8 +129,50 @@ ObjPtr<mirror::String> InternTable::LookupStrong(Thread* self,
   Utf8String string(utf16_length,
                     utf8_data,
                     ComputeUtf16HashFromModifiedUtf8(utf8_data, utf16_length));
+  ObjPtr<mirror::String> cached = LookupStrongInCache(string);
+  if (cached != nullptr) {
+    return cached;
+  }
   MutexLock mu(self, *Locks::intern_table_lock_);
-  return strong_interns_.Find(string);
+  ObjPtr<mirror::String> strong = strong_interns_.Find(string);
+  if (strong != nullptr) {
+    AddToStrongCache(strong);
+  }
+  return strong;
+}
+
+ObjPtr<mirror::String> InternTable::LookupStrongInCache(ObjPtr<mirror::String> s) {
+  const int32_t hash = s->GetHashCode();
+  ObjPtr<mirror::String> cached =
+      strong_intern_cache_[StrongCacheIndex(hash)].load(std::memory_order_acquire).Read();
+  if (cached != nullptr && cached->GetHashCode() == hash && cached->Equals(s)) {
+    return cached;
+  }
+  return nullptr;
+}
+
+ObjPtr<mirror::String> InternTable::LookupStrongInCache(const Utf8String& string) {
+  ObjPtr<mirror::String> cached =
+      strong_intern_cache_[StrongCacheIndex(string.GetHash())].load(std::memory_order_acquire)
+          .Read();
+  if (cached != nullptr &&
+      cached->GetHashCode() == string.GetHash() &&
+      StringHashEquals()(GcRoot<mirror::String>(cached), string)) {
+    return cached;
+  }
+  return nullptr;
+}
+
+void InternTable::AddToStrongCache(ObjPtr<mirror::String> s) {
+  strong_intern_cache_[StrongCacheIndex(s->GetHashCode())].store(GcRoot<mirror::String>(s),
+                                                                 std::memory_order_release);
+}
+
+void InternTable::RemoveFromStrongCache(ObjPtr<mirror::String> s) {
+  Atomic<GcRoot<mirror::String>>& entry = strong_intern_cache_[StrongCacheIndex(s->GetHashCode())];
+  if (entry.load(std::memory_order_relaxed).Read<kWithoutReadBarrier>() == s) {
+    entry.store(GcRoot<mirror::String>(), std::memory_order_release);
+  }
 }
 
 ObjPtr<mirror::String> InternTable::LookupWeakLocked(ObjPtr<mirror::String> s) {
@@ -133,6 +198,7 @@ ObjPtr<mirror::String> InternTable::InsertStrong(ObjPtr<mirror::String> s) {
     new_strong_intern_roots_.push_back(GcRoot<mirror::String>(s));
   }
   strong_interns_.Insert(s);
+  AddToStrongCache(s);
   return s;
 }
 
@@ -146,6 +212,7 @@ ObjPtr<mirror::String> InternTable::InsertWeak(ObjPtr<mirror::String> s) {
 }
 
 void InternTable::RemoveStrong(ObjPtr<mirror::String> s) {
+  RemoveFromStrongCache(s);
   strong_interns_.Remove(s);
 }
 
@@ -203,6 +270,12 @@ ObjPtr<mirror::String> InternTable::Insert(ObjPtr<mirror::String> s,
   if (s == nullptr) {
     return nullptr;
   }
+  // Already interned strings are found without taking the lock. Strong interns take precedence
+  // over weak ones, so a hit is the answer for weak interning as well.
+  ObjPtr<mirror::String> cached = LookupStrongInCache(s);
+  if (cached != nullptr) {
+    return cached;
+  }
   Thread* const self = Thread::Current();
   MutexLock mu(self, *Locks::intern_table_lock_);
   if (kDebugLocking && !holding_locks) {
@@ -220,6 +293,7 @@ ObjPtr<mirror::String> InternTable::Insert(ObjPtr<mirror::String> s,
     // Check the strong table for a match.
     ObjPtr<mirror::String> strong = LookupStrongLocked(s);
     if (strong != nullptr) {
+      AddToStrongCache(strong);
       return strong;
     }
     if ((!kUseReadBarrier && weak_root_state_ != gc::kWeakRootStateNoReadsOrWrites) ||
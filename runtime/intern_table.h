@@ -18,6 +18,7 @@
 #define ART_RUNTIME_INTERN_TABLE_H_
 
 #include "base/allocator.h"
+#include "base/atomic.h"
 #include "base/hash_set.h"
 #include "base/mutex.h"
 #include "gc/weak_root_state.h"
@@ -53,6 +54,11 @@ class Transaction;
  * String.intern. Some code (XML parsers being a prime example) relies on being able to intern
  * arbitrarily many strings for the duration of a parse without permanently increasing the memory
  * footprint.
+ *
+ * Strong interns are additionally published to a small direct-mapped cache indexed by hash that
+ * is read without holding the intern table lock, so that looking up an already interned string
+ * from many threads does not serialize on Locks::intern_table_lock_. Weak interns are never
+ * cached since they may be swept and reading them requires weak reference access.
  */
 class InternTable {
  public:
@@ -104,6 +110,9 @@ class InternTable {
                                StringHashEquals,
                                TrackingAllocator<GcRoot<mirror::String>, kAllocatorTagInternTable>>;
 
+  // Number of entries in the lock-free strong intern cache, must be a power of two.
+  static constexpr size_t kStrongInternCacheSize = 2048;
+
   InternTable();
 
   // Interns a potentially new string in the 'strong' table. May cause thread suspension.
@@ -319,6 +328,26 @@ class InternTable {
   void ChangeWeakRootStateLocked(gc::WeakRootState new_state)
       REQUIRES(Locks::intern_table_lock_);
 
+  // Lock-free lookups in the strong intern cache, return null on a miss.
+  ObjPtr<mirror::String> LookupStrongInCache(ObjPtr<mirror::String> s)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+  ObjPtr<mirror::String> LookupStrongInCache(const Utf8String& string)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Publish a strong intern to the cache, replacing whatever shares its slot.
+  void AddToStrongCache(ObjPtr<mirror::String> s)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
+
+  // Clear the cache slot of a strong intern that is being removed from the table.
+  void RemoveFromStrongCache(ObjPtr<mirror::String> s)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(Locks::intern_table_lock_);
+
+  static size_t StrongCacheIndex(int32_t hash) {
+    // Fold the high bits in since Java string hashes of short strings differ mostly in them.
+    const uint32_t h = static_cast<uint32_t>(hash);
+    return (h ^ (h >> 16)) & (kStrongInternCacheSize - 1u);
+  }
+
   // Wait until we can read weak roots.
   void WaitUntilAccessible(Thread* self)
       REQUIRES(Locks::intern_table_lock_) REQUIRES_SHARED(Locks::mutator_lock_);
@@ -338,6 +367,11 @@ class InternTable {
   Table weak_interns_ GUARDED_BY(Locks::intern_table_lock_);
   // Weak root state, used for concurrent system weak processing and more.
   gc::WeakRootState weak_root_state_ GUARDED_BY(Locks::intern_table_lock_);
+  // Cache of strong interns, only ever written with the intern table lock held but read without
+  // it, so entries are stored with release and loaded with acquire semantics. Every entry is also
+  // present in strong_interns_, so the entries are visited as strong roots only to let moving
+  // collectors update them. Access with read barriers.
+  Atomic<GcRoot<mirror::String>> strong_intern_cache_[kStrongInternCacheSize];
 
   friend class gc::space::ImageSpace;
   friend class linker::ImageWriter;
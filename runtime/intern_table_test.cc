@@ -17,6 +17,7 @@
 #include "intern_table.h"
 
 #include "base/hash_set.h"
+#include "base/time_utils.h"
 #include "common_runtime_test.h"
 #include "dex/utf.h"
 #include "gc_root-inl.h"
@@ -24,6 +25,7 @@
 #include "mirror/object.h"
 #include "mirror/string.h"
 #include "scoped_thread_state_change-inl.h"
+#include "thread_pool.h"
 
 namespace art {
 
@@ -234,4 +236,70 @@ TEST_F(InternTableTest, LookupStrong) {
   EXPECT_TRUE(lookup_foobbS == nullptr);
 }
 
+class InternTask : public Task {
+ public:
+  InternTask(InternTable* intern_table,
+             const std::vector<std::string>* strings,
+             size_t iterations,
+             AtomicInteger* mismatches)
+      : intern_table_(intern_table),
+        strings_(strings),
+        iterations_(iterations),
+        mismatches_(mismatches) {}
+
+  void Run(Thread* self) override {
+    ScopedObjectAccess soa(self);
+    for (size_t i = 0; i != iterations_; ++i) {
+      for (const std::string& string : *strings_) {
+        ObjPtr<mirror::String> interned = intern_table_->InternStrong(string.size(), string.c_str());
+        ObjPtr<mirror::String> lookup =
+            intern_table_->LookupStrong(self, string.size(), string.c_str());
+        if (interned == nullptr || interned != lookup || !interned->Equals(string.c_str())) {
+          ++*mismatches_;
+        }
+      }
+    }
+  }
+
+  void Finalize() override {
+    delete this;
+  }
+
+ private:
+  InternTable* const intern_table_;
+  const std::vector<std::string>* const strings_;
+  const size_t iterations_;
+  AtomicInteger* const mismatches_;
+};
+
+// Intern and look up the same strings from several threads at once, most lookups hit the
+// lock-free strong intern cache.
+TEST_F(InternTableTest, ConcurrentInternStrong) {
+  static constexpr size_t kNumThreads = 4;
+  static constexpr size_t kNumStrings = 1000;
+  static constexpr size_t kIterations = 100;
+  Thread* self = Thread::Current();
+  InternTable intern_table;
+  std::vector<std::string> strings;
+  for (size_t i = 0; i != kNumStrings; ++i) {
+    strings.push_back("string_" + std::to_string(i));
+  }
+  AtomicInteger mismatches(0);
+  ThreadPool thread_pool("Intern table test thread pool", kNumThreads);
+  for (size_t i = 0; i != kNumThreads; ++i) {
+    thread_pool.AddTask(self, new InternTask(&intern_table, &strings, kIterations, &mismatches));
+  }
+  const uint64_t start_ns = NanoTime();
+  thread_pool.StartWorkers(self);
+  thread_pool.Wait(self, /* do_work= */ true, /* may_hold_locks= */ false);
+  const uint64_t duration_ns = NanoTime() - start_ns;
+  EXPECT_EQ(0, mismatches.load(std::memory_order_seq_cst));
+  EXPECT_EQ(kNumStrings, intern_table.StrongSize());
+  const size_t operations = 2u * kNumThreads * kNumStrings * kIterations;
+  LOG(INFO) << "Intern table: " << operations << " operations from " << kNumThreads
+            << " threads in " << PrettyDuration(duration_ns) << " ("
+            << (operations * 1000u) / std::max<uint64_t>(duration_ns / 1000u, 1u)
+            << " operations/ms)";
+}
+
 }  // namespace art
@@ -17,6 +17,8 @@
 #include "jit.h"
 
 #include <dlfcn.h>
+#include <stdio.h>
+#include <unistd.h>
 
 #include "art_method-inl.h"
 #include "base/enums.h"
@@ -24,6 +26,7 @@
 #include "base/logging.h"  // For VLOG.
 #include "base/memfd.h"
 #include "base/memory_tool.h"
+#include "base/os.h"
 #include "base/runtime_debug.h"
 #include "base/scoped_flock.h"
 #include "base/utils.h"
@@ -102,6 +105,8 @@ JitOptions* JitOptions::CreateFromRuntimeArguments(const RuntimeArgumentMap& opt
       options.GetOrDefault(RuntimeArgumentMap::ProfileSaverOpts);
   jit_options->thread_pool_pthread_priority_ =
       options.GetOrDefault(RuntimeArgumentMap::JITPoolThreadPthreadPriority);
+  jit_options->persistent_cache_path_ =
+      options.GetOrDefault(RuntimeArgumentMap::JITPersistentCache);
 
   // Set default compile threshold to aide with sanity checking defaults.
   jit_options->compile_threshold_ =
@@ -971,10 +976,11 @@ class ZygoteTask final : public Task {
   DISALLOW_COPY_AND_ASSIGN(ZygoteTask);
 };
 
-class JitProfileTask final : public Task {
+// Base class for tasks compiling methods of newly registered dex files.
+class JitDexFilesTask : public Task {
  public:
-  JitProfileTask(const std::vector<std::unique_ptr<const DexFile>>& dex_files,
-                 jobject class_loader) {
+  JitDexFilesTask(const std::vector<std::unique_ptr<const DexFile>>& dex_files,
+                  jobject class_loader) {
     ScopedObjectAccess soa(Thread::Current());
     StackHandleScope<1> hs(soa.Self());
     Handle<mirror::ClassLoader> h_loader(hs.NewHandle(
@@ -990,6 +996,29 @@ class JitProfileTask final : public Task {
     class_loader_ = soa.Vm()->AddGlobalRef(soa.Self(), h_loader.Get());
   }
 
+  void Finalize() override {
+    delete this;
+  }
+
+  ~JitDexFilesTask() {
+    ScopedObjectAccess soa(Thread::Current());
+    soa.Vm()->DeleteGlobalRef(soa.Self(), class_loader_);
+  }
+
+ protected:
+  std::vector<const DexFile*> dex_files_;
+  jobject class_loader_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(JitDexFilesTask);
+};
+
+class JitProfileTask final : public JitDexFilesTask {
+ public:
+  JitProfileTask(const std::vector<std::unique_ptr<const DexFile>>& dex_files,
+                 jobject class_loader)
+      : JitDexFilesTask(dex_files, class_loader) {}
+
   void Run(Thread* self) override {
     ScopedObjectAccess soa(self);
     StackHandleScope<1> hs(self);
@@ -1016,20 +1045,36 @@ class JitProfileTask final : public Task {
         /* add_to_queue= */ true);
   }
 
-  void Finalize() override {
-    delete this;
-  }
+ private:
+  DISALLOW_COPY_AND_ASSIGN(JitProfileTask);
+};
 
-  ~JitProfileTask() {
-    ScopedObjectAccess soa(Thread::Current());
-    soa.Vm()->DeleteGlobalRef(soa.Self(), class_loader_);
+class JitPersistentCacheTask final : public JitDexFilesTask {
+ public:
+  JitPersistentCacheTask(const std::vector<std::unique_ptr<const DexFile>>& dex_files,
+                         jobject class_loader)
+      : JitDexFilesTask(dex_files, class_loader) {}
+
+  void Run(Thread* self) override {
+    // Reads the cache file before becoming runnable.
+    Runtime::Current()->GetJit()->CompileMethodsFromPersistentCache(
+        self, dex_files_, class_loader_);
   }
 
  private:
-  std::vector<const DexFile*> dex_files_;
-  jobject class_loader_;
+  DISALLOW_COPY_AND_ASSIGN(JitPersistentCacheTask);
+};
 
-  DISALLOW_COPY_AND_ASSIGN(JitProfileTask);
+class JitSavePersistentCacheTask final : public SelfDeletingTask {
+ public:
+  JitSavePersistentCacheTask() {}
+
+  void Run(Thread* self) override {
+    Runtime::Current()->GetJit()->SavePersistentCache(self);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(JitSavePersistentCacheTask);
 };
 
 static void CopyIfDifferent(void* s1, const void* s2, size_t n) {
@@ -1309,6 +1354,98 @@ void Jit::RegisterDexFiles(const std::vector<std::unique_ptr<const DexFile>>& de
       !runtime->IsJavaDebuggable()) {
     thread_pool_->AddTask(Thread::Current(), new JitProfileTask(dex_files, class_loader));
   }
+  if (!options_->GetPersistentCachePath().empty() &&
+      UseJitCompilation() &&
+      !runtime->IsJavaDebuggable() &&
+      !runtime->IsZygote()) {
+    thread_pool_->AddTask(Thread::Current(), new JitPersistentCacheTask(dex_files, class_loader));
+  }
+}
+
+uint32_t Jit::CompileMethodsFromPersistentCache(Thread* self,
+                                                const std::vector<const DexFile*>& dex_files,
+                                                jobject class_loader) {
+  const std::string& cache_path = options_->GetPersistentCachePath();
+  unix_file::FdFile cache_file(cache_path.c_str(), O_RDONLY, /*check_usage=*/ true);
+  if (cache_file.Fd() == -1) {
+    VLOG(jit) << "No persistent JIT cache: " << cache_path;
+    return 0u;
+  }
+  ProfileCompilationInfo profile_info;
+  if (!profile_info.Load(cache_file.Fd())) {
+    LOG(WARNING) << "Could not load persistent JIT cache " << cache_path;
+    return 0u;
+  }
+
+  ScopedObjectAccess soa(self);
+  StackHandleScope<1> hs(self);
+  Handle<mirror::ClassLoader> loader =
+      hs.NewHandle<mirror::ClassLoader>(soa.Decode<mirror::ClassLoader>(class_loader));
+  uint32_t added_to_queue = CompileMethodsFromProfileInfo(self,
+                                                          dex_files,
+                                                          profile_info,
+                                                          loader,
+                                                          /*add_to_queue=*/ true,
+                                                          /*compile_after_boot=*/ false);
+  VLOG(jit) << "Queued " << added_to_queue << " methods from persistent JIT cache " << cache_path;
+  return added_to_queue;
+}
+
+void Jit::ScheduleSavePersistentCache(Thread* self) {
+  if (options_->GetPersistentCachePath().empty() ||
+      Runtime::Current()->IsZygote() ||
+      thread_pool_ == nullptr) {
+    return;
+  }
+  thread_pool_->AddTask(self, new JitSavePersistentCacheTask());
+}
+
+void Jit::SavePersistentCache(Thread* self) {
+  const std::string& cache_path = options_->GetPersistentCachePath();
+  if (cache_path.empty() || Runtime::Current()->IsZygote()) {
+    return;
+  }
+  ProfileCompilationInfo profile_info;
+  {
+    ScopedObjectAccess soa(self);
+    std::vector<ArtMethod*> methods;
+    code_cache_->GetOptimizedMethods(&methods);
+    std::vector<ProfileMethodInfo> hot_methods;
+    for (ArtMethod* method : methods) {
+      // Boot class path methods are never registered through RegisterDexFiles.
+      if (method->IsObsolete() || method->GetDeclaringClass()->GetClassLoader() == nullptr) {
+        continue;
+      }
+      hot_methods.emplace_back(MethodReference(method->GetDexFile(), method->GetDexMethodIndex()));
+    }
+    if (!profile_info.AddMethods(hot_methods, ProfileCompilationInfo::MethodHotness::kFlagHot)) {
+      LOG(WARNING) << "Failed to record the methods of the persistent JIT cache";
+      return;
+    }
+  }
+
+  // Write to a temporary file and rename it, so that a crash while writing leaves the previous
+  // cache in place.
+  std::string temp_path = cache_path + ".tmp";
+  std::unique_ptr<File> file(OS::CreateEmptyFileWriteOnly(temp_path.c_str()));
+  if (file == nullptr) {
+    PLOG(WARNING) << "Could not create " << temp_path;
+    return;
+  }
+  if (!profile_info.Save(file->Fd())) {
+    LOG(WARNING) << "Could not write " << temp_path;
+    file->Erase(/*unlink=*/ true);
+    return;
+  }
+  if (file->FlushCloseOrErase() != 0) {
+    PLOG(WARNING) << "Could not flush " << temp_path;
+    unlink(temp_path.c_str());
+    return;
+  }
+  if (rename(temp_path.c_str(), cache_path.c_str()) != 0) {
+    PLOG(WARNING) << "Could not rename " << temp_path << " to " << cache_path;
+    unlink(temp_path.c_str());
+  }
 }
 
 bool Jit::CompileMethodFromProfile(Thread* self,
@@ -1399,33 +1536,12 @@ uint32_t Jit::CompileMethodsFromBootProfile(
   return added_to_queue;
 }
 
-uint32_t Jit::CompileMethodsFromProfile(
-    Thread* self,
-    const std::vector<const DexFile*>& dex_files,
-    const std::string& profile_file,
-    Handle<mirror::ClassLoader> class_loader,
-    bool add_to_queue) {
-
-  if (profile_file.empty()) {
-    LOG(WARNING) << "Expected a profile file in JIT zygote mode";
-    return 0u;
-  }
-
-  // We don't generate boot profiles on device, therefore we don't
-  // need to lock the file.
-  unix_file::FdFile profile(profile_file.c_str(), O_RDONLY, true);
-
-  if (profile.Fd() == -1) {
-    PLOG(WARNING) << "No profile: " << profile_file;
-    return 0u;
-  }
-
-  ProfileCompilationInfo profile_info;
-  if (!profile_info.Load(profile.Fd())) {
-    LOG(ERROR) << "Could not load profile file";
-    return 0u;
-  }
-  ScopedObjectAccess soa(self);
+uint32_t Jit::CompileMethodsFromProfileInfo(Thread* self,
+                                            const std::vector<const DexFile*>& dex_files,
+                                            const ProfileCompilationInfo& profile_info,
+                                            Handle<mirror::ClassLoader> class_loader,
+                                            bool add_to_queue,
+                                            bool compile_after_boot) {
   StackHandleScope<1> hs(self);
   MutableHandle<mirror::DexCache> dex_cache = hs.NewHandle<mirror::DexCache>(nullptr);
   ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
@@ -1457,11 +1573,47 @@ uint32_t Jit::CompileMethodsFromProfile(
                                    dex_cache,
                                    class_loader,
                                    add_to_queue,
-                                   /*compile_after_boot=*/true)) {
+                                   compile_after_boot)) {
         ++added_to_queue;
       }
     }
   }
+  return added_to_queue;
+}
+
+uint32_t Jit::CompileMethodsFromProfile(
+    Thread* self,
+    const std::vector<const DexFile*>& dex_files,
+    const std::string& profile_file,
+    Handle<mirror::ClassLoader> class_loader,
+    bool add_to_queue) {
+
+  if (profile_file.empty()) {
+    LOG(WARNING) << "Expected a profile file in JIT zygote mode";
+    return 0u;
+  }
+
+  // We don't generate boot profiles on device, therefore we don't
+  // need to lock the file.
+  unix_file::FdFile profile(profile_file.c_str(), O_RDONLY, true);
+
+  if (profile.Fd() == -1) {
+    PLOG(WARNING) << "No profile: " << profile_file;
+    return 0u;
+  }
+
+  ProfileCompilationInfo profile_info;
+  if (!profile_info.Load(profile.Fd())) {
+    LOG(ERROR) << "Could not load profile file";
+    return 0u;
+  }
+  ScopedObjectAccess soa(self);
+  uint32_t added_to_queue = CompileMethodsFromProfileInfo(self,
+                                                          dex_files,
+                                                          profile_info,
+                                                          class_loader,
+                                                          add_to_queue,
+                                                          /*compile_after_boot=*/ true);
 
   // Add a task to run when all compilation is done.
   JitDoneCompilingProfileTask* task = new JitDoneCompilingProfileTask(dex_files);
@@ -38,6 +38,7 @@ class ArtMethod;
 class ClassLinker;
 class DexFile;
 class OatDexFile;
+class ProfileCompilationInfo;
 struct RuntimeArgumentMap;
 union JValue;
 
@@ -112,6 +113,12 @@ class JitOptions {
     return thread_pool_pthread_priority_;
   }
 
+  // The file recording which methods had optimized JIT code in a previous run, or empty if
+  // the persistent JIT cache is disabled.
+  const std::string& GetPersistentCachePath() const {
+    return persistent_cache_path_;
+  }
+
   bool UseJitCompilation() const {
     return use_jit_compilation_;
   }
@@ -169,6 +176,7 @@ class JitOptions {
   bool dump_info_on_shutdown_;
   int thread_pool_pthread_priority_;
   ProfileSaverOptions profile_saver_options_;
+  std::string persistent_cache_path_;
 
   JitOptions()
       : use_jit_compilation_(false),
@@ -413,6 +421,21 @@ class Jit {
                                          Handle<mirror::ClassLoader> class_loader,
                                          bool add_to_queue);
 
+  // Pre-compile the methods of `dex_files` that the persistent JIT cache recorded as having
+  // optimized code in a previous run. The cache is a profile of these methods, read before
+  // becoming runnable. Return the number of methods added to the queue.
+  uint32_t CompileMethodsFromPersistentCache(Thread* self,
+                                             const std::vector<const DexFile*>& dex_files,
+                                             jobject class_loader)
+      REQUIRES(!Locks::mutator_lock_);
+
+  // Record the methods that currently have optimized code as hot methods of the persistent JIT
+  // cache profile. Does nothing if no persistent JIT cache was requested.
+  void SavePersistentCache(Thread* self) REQUIRES(!Locks::mutator_lock_);
+
+  // Like SavePersistentCache(), but from a JIT thread.
+  void ScheduleSavePersistentCache(Thread* self);
+
   // Register the dex files to the JIT. This is to perform any compilation/optimization
   // at the point of loading the dex files.
   void RegisterDexFiles(const std::vector<std::unique_ptr<const DexFile>>& dex_files,
@@ -444,6 +467,16 @@ class Jit {
  private:
   Jit(JitCodeCache* code_cache, JitOptions* options);
 
+  // Compile the methods of `dex_files` listed in `profile_info`, see CompileMethodsFromProfile().
+  // Return the number of methods added to the queue.
+  uint32_t CompileMethodsFromProfileInfo(Thread* self,
+                                         const std::vector<const DexFile*>& dex_files,
+                                         const ProfileCompilationInfo& profile_info,
+                                         Handle<mirror::ClassLoader> class_loader,
+                                         bool add_to_queue,
+                                         bool compile_after_boot)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   // Compile an individual method listed in a profile. If `add_to_queue` is
   // true and the method was resolved, return true. Otherwise return false.
   bool CompileMethodFromProfile(Thread* self,
@@ -929,6 +929,7 @@ bool JitCodeCache::Reserve(Thread* self,
                            size_t stack_map_size,
                            size_t number_of_roots,
                            ArtMethod* method,
+                           JitCodeKind kind,
                            /*out*/ArrayRef<const uint8_t>* reserved_code,
                            /*out*/ArrayRef<const uint8_t>* reserved_data) {
   code_size = OatQuickMethodHeader::InstructionAlignedSize() + code_size;
@@ -943,7 +944,7 @@ bool JitCodeCache::Reserve(Thread* self,
       MutexLock mu(self, *Locks::jit_lock_);
       WaitForPotentialCollectionToComplete(self);
       ScopedCodeCacheWrite ccw(*region);
-      code = region->AllocateCode(code_size);
+      code = region->AllocateCode(code_size, kind);
       data = region->AllocateData(data_size);
     }
     if (code == nullptr || data == nullptr) {
@@ -1069,6 +1070,10 @@ bool JitCodeCache::ShouldDoFullCollection() {
     // Always do partial collection when the code cache size is below the reserved
     // capacity.
     return false;
+  } else if (private_region_.IsCodeFragmented()) {
+    // Collect as much code as possible so that free chunks coalesce, rather than growing
+    // the code cache to work around the fragmentation.
+    return true;
   } else if (last_collection_increased_code_cache_) {
     // This time do a full collection.
     return true;
@@ -1125,6 +1130,12 @@ void JitCodeCache::GarbageCollectCache(Thread* self) {
     {
       MutexLock mu(self, *Locks::jit_lock_);
 
+      // Give the code freed by the collection back to the mspace so it can coalesce.
+      {
+        ScopedCodeCacheWrite ccw(private_region_);
+        private_region_.ReleaseCachedCode();
+      }
+
       // Increase the code cache only when we do partial collections.
       // TODO: base this strategy on how full the code cache is?
       if (do_full_collection) {
@@ -1504,6 +1515,23 @@ void* JitCodeCache::MoreCore(const void* mspace, intptr_t increment) {
       : private_region_.MoreCore(mspace, increment);
 }
 
+void JitCodeCache::GetOptimizedMethods(std::vector<ArtMethod*>* methods) {
+  MutexLock mu(Thread::Current(), *Locks::jit_lock_);
+  auto add_if_optimized = [methods](const void* code_ptr, ArtMethod* method) {
+    OatQuickMethodHeader* method_header = OatQuickMethodHeader::FromCodePointer(code_ptr);
+    if (method_header->IsOptimized() &&
+        !CodeInfo::IsBaseline(method_header->GetOptimizedCodeInfoPtr())) {
+      methods->push_back(method);
+    }
+  };
+  for (const auto& it : method_code_map_) {
+    add_if_optimized(it.first, it.second);
+  }
+  for (const auto& it : saved_compiled_methods_map_) {
+    add_if_optimized(it.second, it.first);
+  }
+}
+
 void JitCodeCache::GetProfiledMethods(const std::set<std::string>& dex_base_locations,
                                       std::vector<ProfileMethodInfo>& methods) {
   Thread* self = Thread::Current();
@@ -1820,7 +1848,9 @@ void JitCodeCache::Dump(std::ostream& os) {
      << "Total number of JIT compilations: " << number_of_compilations_ << "\n"
      << "Total number of JIT compilations for on stack replacement: "
         << number_of_osr_compilations_ << "\n"
-     << "Total number of JIT code cache collections: " << number_of_collections_ << std::endl;
+     << "Total number of JIT code cache collections: " << number_of_collections_ << "\n";
+  GetCurrentRegion()->DumpCodeAllocationStats(os);
+  os << std::flush;
   histogram_stack_map_memory_use_.PrintMemoryUse(os);
   histogram_code_memory_use_.PrintMemoryUse(os);
   histogram_profiling_info_memory_use_.PrintMemoryUse(os);
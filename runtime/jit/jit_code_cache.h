@@ -239,13 +239,15 @@ class JitCodeCache {
   const void* GetJniStubCode(ArtMethod* method) REQUIRES(!Locks::jit_lock_);
 
   // Allocate a region for both code and data in the JIT code cache.
-  // The reserved memory is left completely uninitialized.
+  // The reserved memory is left completely uninitialized. `kind` selects the segregated
+  // pool the code is allocated from.
   bool Reserve(Thread* self,
                JitMemoryRegion* region,
                size_t code_size,
                size_t stack_map_size,
                size_t number_of_roots,
                ArtMethod* method,
+               JitCodeKind kind,
                /*out*/ArrayRef<const uint8_t>* reserved_code,
                /*out*/ArrayRef<const uint8_t>* reserved_data)
       REQUIRES_SHARED(Locks::mutator_lock_)
@@ -324,6 +326,12 @@ class JitCodeCache {
 
   void* MoreCore(const void* mspace, intptr_t increment);
 
+  // Adds to `methods` all methods with optimized, non-OSR code, including pre-compiled code
+  // that has not been installed yet.
+  void GetOptimizedMethods(std::vector<ArtMethod*>* methods)
+      REQUIRES(!Locks::jit_lock_)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   // Adds to `methods` all profiled methods which are part of any of the given dex locations.
   void GetProfiledMethods(const std::set<std::string>& dex_base_locations,
                           std::vector<ProfileMethodInfo>& methods)
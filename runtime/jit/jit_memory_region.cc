@@ -19,6 +19,9 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <iterator>
+
 #include <android-base/unique_fd.h>
 #include "base/bit_utils.h"  // For RoundDown, RoundUp
 #include "base/globals.h"
@@ -27,9 +30,11 @@
 #include "base/memfd.h"
 #include "base/systrace.h"
 #include "gc/allocator/dlmalloc.h"
+#include "gc/heap.h"
 #include "jit/jit_scoped_code_cache_write.h"
 #include "oat_quick_method_header.h"
 #include "palette/palette.h"
+#include "runtime.h"
 
 using android::base::unique_fd;
 
@@ -255,6 +260,21 @@ bool JitMemoryRegion::Initialize(size_t initial_capacity,
   non_exec_pages_ = std::move(non_exec_pages);
   writable_data_pages_ = std::move(writable_data_pages);
 
+  // With -XX:UseTransparentHugePages, back the code cache with huge pages as well to reduce
+  // instruction TLB misses. The cache is shared memory when dual mapped, which the kernel may
+  // not back with huge pages, so a failure only disables them.
+  Runtime* runtime = Runtime::Current();
+  if (runtime != nullptr &&
+      runtime->GetHeap()->UseTransparentHugePages() &&
+      capacity >= kHugePageSize) {
+    for (MemMap* pages : { &data_pages_, &exec_pages_, &non_exec_pages_, &writable_data_pages_ }) {
+      if (pages->IsValid() && pages->MadviseHugePages(/*enable=*/ true) != 0) {
+        VLOG(jit) << "Failed to request transparent huge pages for " << pages->GetName() << ": "
+                  << strerror(errno);
+      }
+    }
+  }
+
   VLOG(jit) << "Created JitMemoryRegion"
             << ": data_pages=" << reinterpret_cast<void*>(data_pages_.Begin())
             << ", exec_pages=" << reinterpret_cast<void*>(exec_pages_.Begin())
@@ -288,6 +308,7 @@ bool JitMemoryRegion::Initialize(size_t initial_capacity,
     CheckedCall(mprotect, "create code heap", code_heap->Begin(), code_heap->Size(), kProtRW);
     exec_mspace_ = create_mspace_with_base(code_heap->Begin(), exec_end_, false /*locked*/);
     CHECK(exec_mspace_ != nullptr) << "create_mspace_with_base (exec) failed";
+    AddFreeCodeChunk(code_heap->Begin(), code_heap->Begin() + exec_end_);
     SetFootprintLimit(current_capacity_);
     // Protect pages containing heap metadata. Updates to the code heap toggle write permission to
     // perform the update and there are no other times write access is required.
@@ -339,7 +360,11 @@ void* JitMemoryRegion::MoreCore(const void* mspace, intptr_t increment) NO_THREA
     CHECK(exec_mspace_ != nullptr);
     const MemMap* const code_pages = GetUpdatableCodeMapping();
     void* result = code_pages->Begin() + exec_end_;
+    // The memory past the last chunk grows or shrinks with the footprint.
+    const uint8_t* chunks_end = GetCodeChunksEnd();
+    RemoveFreeCodeChunk(chunks_end, code_pages->Begin() + exec_end_);
     exec_end_ += increment;
+    AddFreeCodeChunk(chunks_end, code_pages->Begin() + exec_end_);
     return result;
   } else {
     CHECK_EQ(data_mspace_, mspace);
@@ -466,22 +491,186 @@ bool JitMemoryRegion::CommitData(ArrayRef<const uint8_t> reserved_data,
   return true;
 }
 
-const uint8_t* JitMemoryRegion::AllocateCode(size_t size) {
-  size_t alignment = GetInstructionSetAlignment(kRuntimeISA);
-  void* result = mspace_memalign(exec_mspace_, alignment, size);
-  if (UNLIKELY(result == nullptr)) {
-    return nullptr;
+std::ostream& operator<<(std::ostream& os, JitCodeKind kind) {
+  switch (kind) {
+    case JitCodeKind::kStub:
+      return os << "stub";
+    case JitCodeKind::kBaseline:
+      return os << "baseline";
+    case JitCodeKind::kOptimized:
+      return os << "optimized";
+  }
+  return os << "JitCodeKind[" << static_cast<int>(kind) << "]";
+}
+
+const uint8_t* JitMemoryRegion::AllocateCode(size_t size, JitCodeKind kind) {
+  CodeKindStats& stats = GetCodeKindStats(kind);
+  void* result = nullptr;
+  size_t size_class = CodeSizeClass(size);
+  if (size_class < kNumCodeSizeClasses) {
+    std::vector<uint8_t*>& free_list = GetCodeFreeList(kind, size_class);
+    if (!free_list.empty()) {
+      result = free_list.back();
+      free_list.pop_back();
+      size_t cached_size = mspace_usable_size(result);
+      cached_memory_for_code_ -= cached_size;
+      stats.cached_bytes -= cached_size;
+      ++stats.free_list_hits;
+    }
+  }
+  if (result == nullptr) {
+    size_t alignment = GetInstructionSetAlignment(kRuntimeISA);
+    result = mspace_memalign(exec_mspace_, alignment, size);
+    if (UNLIKELY(result == nullptr) && cached_memory_for_code_ != 0) {
+      // The cached chunks may coalesce into one large enough for this request.
+      ReleaseCachedCode();
+      result = mspace_memalign(exec_mspace_, alignment, size);
+    }
+    if (UNLIKELY(result == nullptr)) {
+      return nullptr;
+    }
+    AddCodeChunk(reinterpret_cast<uint8_t*>(result), mspace_usable_size(result));
   }
-  used_memory_for_code_ += mspace_usable_size(result);
+  size_t usable_size = mspace_usable_size(result);
+  used_memory_for_code_ += usable_size;
+  stats.used_bytes += usable_size;
+  ++stats.allocations;
+  code_kinds_.emplace(reinterpret_cast<uint8_t*>(result), kind);
   return reinterpret_cast<uint8_t*>(GetExecutableAddress(result));
 }
 
 void JitMemoryRegion::FreeCode(const uint8_t* code) {
   code = GetNonExecutableAddress(code);
-  used_memory_for_code_ -= mspace_usable_size(code);
+  size_t usable_size = mspace_usable_size(code);
+  used_memory_for_code_ -= usable_size;
+  auto it = code_kinds_.find(code);
+  DCHECK(it != code_kinds_.end());
+  JitCodeKind kind = it->second;
+  code_kinds_.erase(it);
+  CodeKindStats& stats = GetCodeKindStats(kind);
+  stats.used_bytes -= usable_size;
+  // Entries of a size class must satisfy any request of that class, so round down.
+  size_t size_class = usable_size / kCodeSizeClassGranularity;
+  if (size_class != 0u &&
+      size_class < kNumCodeSizeClasses &&
+      cached_memory_for_code_ + usable_size <= current_capacity_ / kMaxCachedCodeDivider) {
+    GetCodeFreeList(kind, size_class).push_back(const_cast<uint8_t*>(code));
+    cached_memory_for_code_ += usable_size;
+    stats.cached_bytes += usable_size;
+    return;
+  }
+  RemoveCodeChunk(code);
   mspace_free(exec_mspace_, const_cast<uint8_t*>(code));
 }
 
+void JitMemoryRegion::ReleaseCachedCode() {
+  if (cached_memory_for_code_ == 0) {
+    return;
+  }
+  for (size_t kind = 0; kind < kNumCodeKinds; ++kind) {
+    for (std::vector<uint8_t*>& free_list : code_free_lists_[kind]) {
+      for (uint8_t* code : free_list) {
+        RemoveCodeChunk(code);
+        mspace_free(exec_mspace_, code);
+      }
+      free_list.clear();
+    }
+    code_kind_stats_[kind].cached_bytes = 0;
+  }
+  cached_memory_for_code_ = 0;
+}
+
+void JitMemoryRegion::AddCodeChunk(const uint8_t* chunk, size_t size) {
+  auto next = code_chunks_.lower_bound(chunk);
+  const uint8_t* gap_begin = GetUpdatableCodeMapping()->Begin();
+  if (next != code_chunks_.begin()) {
+    auto prev = std::prev(next);
+    gap_begin = prev->first + prev->second;
+  }
+  const uint8_t* gap_end = (next != code_chunks_.end())
+      ? next->first
+      : GetUpdatableCodeMapping()->Begin() + exec_end_;
+  DCHECK_LE(gap_begin, chunk);
+  DCHECK_LE(chunk + size, gap_end);
+  RemoveFreeCodeChunk(gap_begin, gap_end);
+  AddFreeCodeChunk(gap_begin, chunk);
+  AddFreeCodeChunk(chunk + size, gap_end);
+  code_chunks_.emplace_hint(next, chunk, size);
+}
+
+void JitMemoryRegion::RemoveCodeChunk(const uint8_t* chunk) {
+  auto it = code_chunks_.find(chunk);
+  DCHECK(it != code_chunks_.end());
+  const uint8_t* gap_begin = GetUpdatableCodeMapping()->Begin();
+  if (it != code_chunks_.begin()) {
+    auto prev = std::prev(it);
+    gap_begin = prev->first + prev->second;
+  }
+  auto next = std::next(it);
+  const uint8_t* gap_end = (next != code_chunks_.end())
+      ? next->first
+      : GetUpdatableCodeMapping()->Begin() + exec_end_;
+  RemoveFreeCodeChunk(gap_begin, chunk);
+  RemoveFreeCodeChunk(chunk + it->second, gap_end);
+  AddFreeCodeChunk(gap_begin, gap_end);
+  code_chunks_.erase(it);
+}
+
+void JitMemoryRegion::AddFreeCodeChunk(const uint8_t* begin, const uint8_t* end) {
+  if (begin < end) {
+    free_code_chunks_.insert(end - begin);
+    free_code_bytes_ += end - begin;
+  }
+}
+
+void JitMemoryRegion::RemoveFreeCodeChunk(const uint8_t* begin, const uint8_t* end) {
+  if (begin < end) {
+    auto it = free_code_chunks_.find(end - begin);
+    DCHECK(it != free_code_chunks_.end());
+    free_code_chunks_.erase(it);
+    free_code_bytes_ -= end - begin;
+  }
+}
+
+const uint8_t* JitMemoryRegion::GetCodeChunksEnd() {
+  if (code_chunks_.empty()) {
+    return GetUpdatableCodeMapping()->Begin();
+  }
+  auto last = code_chunks_.rbegin();
+  return last->first + last->second;
+}
+
+void JitMemoryRegion::GetCodeFragmentation(size_t* free_bytes, size_t* largest_free_chunk) {
+  *free_bytes = free_code_bytes_ + cached_memory_for_code_;
+  *largest_free_chunk = free_code_chunks_.empty() ? 0u : *free_code_chunks_.rbegin();
+}
+
+bool JitMemoryRegion::IsCodeFragmented() {
+  size_t free_bytes;
+  size_t largest_free_chunk;
+  GetCodeFragmentation(&free_bytes, &largest_free_chunk);
+  // Consider the space fragmented when a quarter of it is free, but the largest free chunk only
+  // holds a small part of that free memory.
+  return free_bytes >= exec_end_ / 4 && largest_free_chunk < free_bytes / 8;
+}
+
+void JitMemoryRegion::DumpCodeAllocationStats(std::ostream& os) {
+  size_t free_bytes;
+  size_t largest_free_chunk;
+  GetCodeFragmentation(&free_bytes, &largest_free_chunk);
+  os << "JIT code free memory (total / largest chunk / cached): "
+     << PrettySize(free_bytes) << " / "
+     << PrettySize(largest_free_chunk) << " / "
+     << PrettySize(cached_memory_for_code_) << "\n";
+  for (size_t kind = 0; kind < kNumCodeKinds; ++kind) {
+    const CodeKindStats& stats = code_kind_stats_[kind];
+    os << "JIT " << static_cast<JitCodeKind>(kind) << " code (used / cached): "
+       << PrettySize(stats.used_bytes) << " / " << PrettySize(stats.cached_bytes)
+       << ", allocations: " << stats.allocations
+       << ", free list hits: " << stats.free_list_hits << "\n";
+  }
+}
+
 const uint8_t* JitMemoryRegion::AllocateData(size_t data_size) {
   void* result = mspace_malloc(data_mspace_, data_size);
   if (UNLIKELY(result == nullptr)) {
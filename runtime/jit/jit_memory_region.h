@@ -17,7 +17,12 @@
 #ifndef ART_RUNTIME_JIT_JIT_MEMORY_REGION_H_
 #define ART_RUNTIME_JIT_JIT_MEMORY_REGION_H_
 
+#include <map>
+#include <ostream>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "arch/instruction_set.h"
 #include "base/globals.h"
@@ -46,6 +51,17 @@ uint32_t inline ComputeRootTableSize(uint32_t number_of_roots) {
   return sizeof(uint32_t) + number_of_roots * sizeof(GcRoot<mirror::Object>);
 }
 
+// The kind of code an allocation in the code portion of a region holds. Each kind gets its own
+// segregated free lists, so that short-lived baseline code does not fragment the memory of
+// long-lived optimized code and stubs.
+enum class JitCodeKind : uint8_t {
+  kStub,
+  kBaseline,
+  kOptimized,
+  kLast = kOptimized,
+};
+std::ostream& operator<<(std::ostream& os, JitCodeKind kind);
+
 // Represents a memory region for the JIT, where code and data are stored. This class
 // provides allocation and deallocation primitives.
 class JitMemoryRegion {
@@ -63,7 +79,9 @@ class JitMemoryRegion {
         exec_pages_(),
         non_exec_pages_(),
         data_mspace_(nullptr),
-        exec_mspace_(nullptr) {}
+        exec_mspace_(nullptr),
+        cached_memory_for_code_(0),
+        free_code_bytes_(0) {}
 
   bool Initialize(size_t initial_capacity,
                   size_t max_capacity,
@@ -79,8 +97,27 @@ class JitMemoryRegion {
   // Set the footprint limit of the code cache.
   void SetFootprintLimit(size_t new_footprint) REQUIRES(Locks::jit_lock_);
 
-  const uint8_t* AllocateCode(size_t code_size) REQUIRES(Locks::jit_lock_);
+  // Allocate code of the given kind. Small allocations are first served from the segregated
+  // free lists of that kind before falling back to the mspace.
+  const uint8_t* AllocateCode(size_t code_size, JitCodeKind kind = JitCodeKind::kOptimized)
+      REQUIRES(Locks::jit_lock_);
   void FreeCode(const uint8_t* code) REQUIRES(Locks::jit_lock_);
+
+  // Return all code cached in the segregated free lists to the mspace, so that it can be
+  // coalesced with neighbouring free chunks. The code pages must be writable.
+  void ReleaseCachedCode() REQUIRES(Locks::jit_lock_);
+
+  // Return the number of free bytes within the footprint of the code mspace, and the size of the
+  // largest free chunk. Memory cached in the segregated free lists counts as free. Both are
+  // tracked when code is allocated and freed, the overhead of the mspace counts as free.
+  void GetCodeFragmentation(/*out*/ size_t* free_bytes, /*out*/ size_t* largest_free_chunk)
+      REQUIRES(Locks::jit_lock_);
+
+  // Whether free memory in the code mspace is scattered enough that allocations are likely to
+  // fail even though the region has room. Used to prefer a full collection over growing.
+  bool IsCodeFragmented() REQUIRES(Locks::jit_lock_);
+
+  void DumpCodeAllocationStats(std::ostream& os) REQUIRES(Locks::jit_lock_);
   const uint8_t* AllocateData(size_t data_size) REQUIRES(Locks::jit_lock_);
   void FreeData(const uint8_t* data) REQUIRES(Locks::jit_lock_);
   void FreeData(uint8_t* writable_data) REQUIRES(Locks::jit_lock_) = delete;
@@ -108,6 +145,16 @@ class JitMemoryRegion {
     // point to the discarded mappings.
     exec_mspace_ = nullptr;
     data_mspace_ = nullptr;
+    for (auto& free_lists : code_free_lists_) {
+      for (std::vector<uint8_t*>& free_list : free_lists) {
+        free_list.clear();
+      }
+    }
+    code_kinds_.clear();
+    cached_memory_for_code_ = 0;
+    code_chunks_.clear();
+    free_code_chunks_.clear();
+    free_code_bytes_ = 0;
   }
 
   bool IsValid() const NO_THREAD_SAFETY_ANALYSIS {
@@ -234,6 +281,48 @@ class JitMemoryRegion {
     return TranslateAddress(src_ptr, exec_pages_, non_exec_pages_);
   }
 
+  static constexpr size_t kNumCodeKinds = static_cast<size_t>(JitCodeKind::kLast) + 1;
+  // Allocations up to this size are recycled through the segregated free lists.
+  static constexpr size_t kMaxSegregatedCodeSize = 4 * KB;
+  static constexpr size_t kCodeSizeClassGranularity = 64;
+  static constexpr size_t kNumCodeSizeClasses = kMaxSegregatedCodeSize / kCodeSizeClassGranularity;
+  // At most 1/kMaxCachedCodeDivider of the code capacity is held in the free lists.
+  static constexpr size_t kMaxCachedCodeDivider = 16;
+
+  struct CodeKindStats {
+    size_t used_bytes = 0;
+    size_t allocations = 0;
+    size_t free_list_hits = 0;
+    size_t cached_bytes = 0;
+  };
+
+  // Returns the first size class whose entries are all large enough for `size` bytes.
+  static size_t CodeSizeClass(size_t size) {
+    return (size + kCodeSizeClassGranularity - 1) / kCodeSizeClassGranularity;
+  }
+
+  std::vector<uint8_t*>& GetCodeFreeList(JitCodeKind kind, size_t size_class)
+      REQUIRES(Locks::jit_lock_) {
+    DCHECK_LT(size_class, kNumCodeSizeClasses);
+    return code_free_lists_[static_cast<size_t>(kind)][size_class];
+  }
+
+  CodeKindStats& GetCodeKindStats(JitCodeKind kind) REQUIRES(Locks::jit_lock_) {
+    return code_kind_stats_[static_cast<size_t>(kind)];
+  }
+
+  // Record that the code mspace handed out or took back the chunk at `chunk`, with `size` usable
+  // bytes, and update the free chunks around it.
+  void AddCodeChunk(const uint8_t* chunk, size_t size) REQUIRES(Locks::jit_lock_);
+  void RemoveCodeChunk(const uint8_t* chunk) REQUIRES(Locks::jit_lock_);
+
+  // Record the free memory in [begin, end) of the code mspace as one chunk, or forget it.
+  void AddFreeCodeChunk(const uint8_t* begin, const uint8_t* end) REQUIRES(Locks::jit_lock_);
+  void RemoveFreeCodeChunk(const uint8_t* begin, const uint8_t* end) REQUIRES(Locks::jit_lock_);
+
+  // The start of the free memory after the last chunk of the code mspace.
+  const uint8_t* GetCodeChunksEnd() REQUIRES(Locks::jit_lock_);
+
   static int CreateZygoteMemory(size_t capacity, std::string* error_msg);
   static bool ProtectZygoteMemory(int fd, std::string* error_msg);
 
@@ -278,6 +367,28 @@ class JitMemoryRegion {
   // The opaque mspace for allocating code.
   void* exec_mspace_ GUARDED_BY(Locks::jit_lock_);
 
+  // Segregated free lists of code allocations, indexed by code kind and then by size class.
+  // Entries are addresses in the updatable code mapping, as returned by the mspace.
+  std::vector<uint8_t*> code_free_lists_[kNumCodeKinds][kNumCodeSizeClasses]
+      GUARDED_BY(Locks::jit_lock_);
+
+  // The kind of each live code allocation, keyed by its address in the updatable code mapping.
+  std::unordered_map<const uint8_t*, JitCodeKind> code_kinds_ GUARDED_BY(Locks::jit_lock_);
+
+  // The size in bytes of code memory held in the segregated free lists.
+  size_t cached_memory_for_code_ GUARDED_BY(Locks::jit_lock_);
+
+  // The usable size of each chunk allocated from the code mspace, including the chunks held in the
+  // segregated free lists, keyed by its address in the updatable code mapping.
+  std::map<const uint8_t*, size_t> code_chunks_ GUARDED_BY(Locks::jit_lock_);
+
+  // The sizes of the gaps between the chunks, up to the end of the footprint of the code mspace,
+  // and their total.
+  std::multiset<size_t> free_code_chunks_ GUARDED_BY(Locks::jit_lock_);
+  size_t free_code_bytes_ GUARDED_BY(Locks::jit_lock_);
+
+  CodeKindStats code_kind_stats_[kNumCodeKinds] GUARDED_BY(Locks::jit_lock_);
+
   friend class ScopedCodeCacheWrite;  // For GetUpdatableCodeMapping
   friend class TestZygoteMemory;
 };
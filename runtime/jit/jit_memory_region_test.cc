@@ -21,13 +21,18 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <vector>
+
 #include <android-base/unique_fd.h>
 #include <gtest/gtest.h>
 
 #include "base/globals.h"
 #include "base/memfd.h"
+#include "base/mutex.h"
 #include "base/utils.h"
 #include "common_runtime_test.h"
+#include "jit/jit_scoped_code_cache_write.h"
+#include "thread-current-inl.h"
 
 namespace art {
 namespace jit {
@@ -512,5 +517,122 @@ TEST_F(TestZygoteMemory, TestFromSharedToPrivate) {
 
 #endif  // defined (__BIONIC__)
 
+class JitMemoryRegionTest : public CommonRuntimeTest {
+ protected:
+  // The initial and maximum capacity of the regions, so that the code mspace never needs to grow.
+  static constexpr size_t kCapacity = 1 * MB;
+
+  void InitializeRegion(JitMemoryRegion* region) REQUIRES(Locks::jit_lock_) {
+    std::string error_msg;
+    ASSERT_TRUE(region->Initialize(kCapacity,
+                                   kCapacity,
+                                   /*rwx_memory_allowed=*/ true,
+                                   /*is_zygote=*/ false,
+                                   &error_msg)) << error_msg;
+  }
+};
+
+TEST_F(JitMemoryRegionTest, ReusesFreedCodeOfTheSameKind) {
+  MutexLock mu(Thread::Current(), *Locks::jit_lock_);
+  JitMemoryRegion region;
+  InitializeRegion(&region);
+  ScopedCodeCacheWrite scc(region);
+  static constexpr size_t kCodeSize = 256;
+
+  const uint8_t* baseline = region.AllocateCode(kCodeSize, JitCodeKind::kBaseline);
+  ASSERT_TRUE(baseline != nullptr);
+  const size_t used = region.GetUsedMemoryForCode();
+  size_t free_bytes;
+  size_t largest_free_chunk;
+  region.GetCodeFragmentation(&free_bytes, &largest_free_chunk);
+  region.FreeCode(baseline);
+  EXPECT_EQ(0u, region.GetUsedMemoryForCode());
+  // The freed code is cached for its kind and still counts as free.
+  size_t cached_free_bytes;
+  size_t cached_largest_free_chunk;
+  region.GetCodeFragmentation(&cached_free_bytes, &cached_largest_free_chunk);
+  EXPECT_EQ(free_bytes + used, cached_free_bytes);
+  EXPECT_EQ(largest_free_chunk, cached_largest_free_chunk);
+
+  // Other kinds do not get it.
+  const uint8_t* optimized = region.AllocateCode(kCodeSize, JitCodeKind::kOptimized);
+  ASSERT_TRUE(optimized != nullptr);
+  EXPECT_NE(baseline, optimized);
+  const uint8_t* stub = region.AllocateCode(kCodeSize, JitCodeKind::kStub);
+  ASSERT_TRUE(stub != nullptr);
+  EXPECT_NE(baseline, stub);
+
+  // The same kind does, for any size of the same size class.
+  EXPECT_EQ(baseline, region.AllocateCode(kCodeSize - 1, JitCodeKind::kBaseline));
+  region.FreeCode(baseline);
+  region.FreeCode(optimized);
+  region.FreeCode(stub);
+  EXPECT_EQ(0u, region.GetUsedMemoryForCode());
+
+  // Once released to the mspace, the cached code coalesces with the free memory around it.
+  region.GetCodeFragmentation(&cached_free_bytes, &cached_largest_free_chunk);
+  region.ReleaseCachedCode();
+  region.GetCodeFragmentation(&free_bytes, &largest_free_chunk);
+  EXPECT_EQ(cached_free_bytes, free_bytes);
+  EXPECT_GT(largest_free_chunk, cached_largest_free_chunk);
+  EXPECT_FALSE(region.IsCodeFragmented());
+}
+
+TEST_F(JitMemoryRegionTest, CodeFragmentation) {
+  MutexLock mu(Thread::Current(), *Locks::jit_lock_);
+  JitMemoryRegion region;
+  InitializeRegion(&region);
+  ScopedCodeCacheWrite scc(region);
+  // Too large for the segregated free lists, so freed code goes back to the mspace.
+  static constexpr size_t kCodeSize = 8 * KB;
+  size_t initial_free_bytes;
+  size_t initial_largest_free_chunk;
+  region.GetCodeFragmentation(&initial_free_bytes, &initial_largest_free_chunk);
+  EXPECT_EQ(initial_free_bytes, initial_largest_free_chunk);
+  EXPECT_FALSE(region.IsCodeFragmented());
+
+  // Fill the code mspace.
+  std::vector<const uint8_t*> code;
+  for (const uint8_t* c = region.AllocateCode(kCodeSize); c != nullptr;
+       c = region.AllocateCode(kCodeSize)) {
+    code.push_back(c);
+  }
+  ASSERT_GE(code.size(), 32u);
+  EXPECT_FALSE(region.IsCodeFragmented());
+
+  // Free every other allocation. The free chunks cannot coalesce, so the code is fragmented once
+  // a quarter of the code mspace is free.
+  const size_t quarter = region.GetResidentMemoryForCode() / 4;
+  bool fragmented = false;
+  for (size_t i = 0; i < code.size(); i += 2) {
+    size_t used = region.GetUsedMemoryForCode();
+    size_t free_bytes_before;
+    size_t largest_free_chunk;
+    region.GetCodeFragmentation(&free_bytes_before, &largest_free_chunk);
+    region.FreeCode(code[i]);
+    size_t free_bytes;
+    region.GetCodeFragmentation(&free_bytes, &largest_free_chunk);
+    EXPECT_EQ(free_bytes_before + used - region.GetUsedMemoryForCode(), free_bytes);
+    EXPECT_LT(largest_free_chunk, 2 * kCodeSize);
+    bool now_fragmented = region.IsCodeFragmented();
+    EXPECT_EQ(free_bytes >= quarter, now_fragmented) << i;
+    // It does not flip back while more memory is freed.
+    EXPECT_TRUE(now_fragmented || !fragmented) << i;
+    fragmented = now_fragmented;
+  }
+  EXPECT_TRUE(fragmented);
+
+  // Freeing the rest coalesces everything back into one chunk.
+  for (size_t i = 1; i < code.size(); i += 2) {
+    region.FreeCode(code[i]);
+  }
+  EXPECT_FALSE(region.IsCodeFragmented());
+  size_t free_bytes;
+  size_t largest_free_chunk;
+  region.GetCodeFragmentation(&free_bytes, &largest_free_chunk);
+  EXPECT_EQ(initial_free_bytes, free_bytes);
+  EXPECT_EQ(initial_largest_free_chunk, largest_free_chunk);
+}
+
 }  // namespace jit
 }  // namespace art
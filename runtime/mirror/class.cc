@@ -1366,7 +1366,7 @@ ObjPtr<Class> Class::CopyOf(Handle<Class> h_this,
   // to skip copying the tail part that we will overwrite here.
   CopyClassVisitor visitor(self, &h_this, new_length, sizeof(Class), imt, pointer_size);
   ObjPtr<mirror::Class> java_lang_Class = GetClassRoot<mirror::Class>(runtime->GetClassLinker());
-  ObjPtr<Object> new_class = kMovingClasses ?
+  ObjPtr<Object> new_class = heap->CanMoveClasses() ?
       heap->AllocObject(self, java_lang_Class, new_length, visitor) :
       heap->AllocNonMovableObject(self, java_lang_Class, new_length, visitor);
   if (UNLIKELY(new_class == nullptr)) {
@@ -23,6 +23,7 @@
 #include "class_linker.h"
 #include "class_root.h"
 #include "dex/dex_file_annotations.h"
+#include "gc/heap.h"
 #include "jni/jni_internal.h"
 #include "mirror/class-alloc-inl.h"
 #include "mirror/class-inl.h"
@@ -99,7 +100,7 @@ static jobject Constructor_newInstance0(JNIEnv* env, jobject javaMethod, jobject
     return nullptr;
   }
   bool movable = true;
-  if (!kMovingClasses && c->IsClassClass()) {
+  if (!Runtime::Current()->GetHeap()->CanMoveClasses() && c->IsClassClass()) {
     movable = false;
   }
 
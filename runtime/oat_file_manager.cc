@@ -631,7 +631,8 @@ std::vector<std::unique_ptr<const DexFile>> OatFileManager::OpenDexFilesFromOat(
     if (oat_file_assistant.HasOriginalDexFiles()) {
       if (Runtime::Current()->IsDexFileFallbackEnabled()) {
         static constexpr bool kVerifyChecksum = true;
-        const ArtDexFileLoader dex_file_loader;
+        ArtDexFileLoader dex_file_loader;
+        dex_file_loader.SetVerificationThreads(Runtime::Current()->GetDexVerificationThreads());
         if (!dex_file_loader.Open(dex_location,
                                   dex_location,
                                   Runtime::Current()->IsVerificationEnabled(),
@@ -789,7 +790,8 @@ std::vector<std::unique_ptr<const DexFile>> OatFileManager::OpenDexFilesFromOat_
   std::vector<std::unique_ptr<const DexFile>> dex_files;
   for (size_t i = 0; i < dex_mem_maps.size(); ++i) {
     static constexpr bool kVerifyChecksum = true;
-    const ArtDexFileLoader dex_file_loader;
+    ArtDexFileLoader dex_file_loader;
+    dex_file_loader.SetVerificationThreads(Runtime::Current()->GetDexVerificationThreads());
     std::unique_ptr<const DexFile> dex_file(dex_file_loader.Open(
         DexFileLoader::GetMultiDexLocation(i, dex_location.c_str()),
         location_checksum,
@@ -144,12 +144,24 @@ std::unique_ptr<RuntimeParser> ParsedOptions::MakeParser(bool ignore_unrecognize
       .Define("-XX:StopForNativeAllocs=_")
           .WithType<MemoryKiB>()
           .IntoKey(M::StopForNativeAllocs)
+      .Define("-XX:RegionPrefaultPoolSize=_")
+          .WithType<MemoryKiB>()
+          .IntoKey(M::RegionPrefaultPoolSize)
+      .Define("-XX:AllocationSamplingInterval=_")
+          .WithType<MemoryKiB>()
+          .IntoKey(M::AllocationSamplingInterval)
+      .Define("-XX:AllocationProfileFile=_")
+          .WithType<std::string>()
+          .IntoKey(M::AllocationProfileFile)
       .Define("-XX:HeapTargetUtilization=_")
           .WithType<double>().WithRange(0.1, 0.9)
           .IntoKey(M::HeapTargetUtilization)
       .Define("-XX:ForegroundHeapGrowthMultiplier=_")
           .WithType<double>().WithRange(0.1, 5.0)
           .IntoKey(M::ForegroundHeapGrowthMultiplier)
+      .Define("-XX:GcCpuPercentTarget=_")
+          .WithType<double>().WithRange(0.0, 50.0)
+          .IntoKey(M::GcCpuPercentTarget)
       .Define("-XX:ParallelGCThreads=_")
           .WithType<unsigned int>()
           .IntoKey(M::ParallelGCThreads)
@@ -183,6 +195,14 @@ std::unique_ptr<RuntimeParser> ParsedOptions::MakeParser(bool ignore_unrecognize
           .IntoKey(M::IgnoreMaxFootprint)
       .Define("-XX:LowMemoryMode")
           .IntoKey(M::LowMemoryMode)
+      .Define("-XX:UseTransparentHugePages")
+          .IntoKey(M::UseTransparentHugePages)
+      .Define("-XX:HeapCensus")
+          .IntoKey(M::HeapCensus)
+      .Define("-XX:RosAllocPerCpuRuns")
+          .IntoKey(M::RosAllocPerCpuRuns)
+      .Define("-XX:StringDedupStats")
+          .IntoKey(M::StringDedupStats)
       .Define("-XX:UseTLAB")
           .WithValue(true)
           .IntoKey(M::UseTLAB)
@@ -197,6 +217,10 @@ std::unique_ptr<RuntimeParser> ParsedOptions::MakeParser(bool ignore_unrecognize
           .WithType<bool>()
           .WithValueMap({{"false", false}, {"true", true}})
           .IntoKey(M::MadviseRandomAccess)
+      .Define("-XX:ParallelImageRelocation:_")
+          .WithType<bool>()
+          .WithValueMap({{"false", false}, {"true", true}})
+          .IntoKey(M::ParallelImageRelocation)
       .Define("-Xusejit:_")
           .WithType<bool>()
           .WithValueMap({{"false", false}, {"true", true}})
@@ -229,6 +253,9 @@ std::unique_ptr<RuntimeParser> ParsedOptions::MakeParser(bool ignore_unrecognize
       .Define("-Xjitpthreadpriority:_")
           .WithType<int>()
           .IntoKey(M::JITPoolThreadPthreadPriority)
+      .Define("-Xjitpersistentcache:_")
+          .WithType<std::string>()
+          .IntoKey(M::JITPersistentCache)
       .Define("-Xjitsaveprofilinginfo")
           .WithType<ProfileSaverOptions>()
           .AppendValues()
@@ -323,6 +350,9 @@ std::unique_ptr<RuntimeParser> ParsedOptions::MakeParser(bool ignore_unrecognize
           .IntoKey(M::ZygoteMaxFailedBoots)
       .Define("-Xno-dex-file-fallback")
           .IntoKey(M::NoDexFileFallback)
+      .Define("-XX:DexVerificationThreads=_")
+          .WithType<unsigned int>()
+          .IntoKey(M::DexVerificationThreads)
       .Define("-Xno-sig-chain")
           .IntoKey(M::NoSigChain)
       .Define("--cpu-abilist=_")
@@ -635,8 +665,13 @@ bool ParsedOptions::DoParse(const RuntimeOptions& options,
     }
 
     if (background_collector_type_ == gc::kCollectorTypeNone) {
-      background_collector_type_ = low_memory_mode_ ?
-          gc::kCollectorTypeSS : gc::kCollectorTypeHomogeneousSpaceCompact;
+      if (collector_type_ == gc::kCollectorTypeCMC) {
+        // The mark-compact collector already compacts, there is nothing to transition to.
+        background_collector_type_ = gc::kCollectorTypeCMC;
+      } else {
+        background_collector_type_ = low_memory_mode_ ?
+            gc::kCollectorTypeSS : gc::kCollectorTypeHomogeneousSpaceCompact;
+      }
     }
 
     args.Set(M::BackgroundGc, BackgroundGcOption { background_collector_type_ });
@@ -742,9 +777,17 @@ void ParsedOptions::Usage(const char* fmt, ...) {
   UsageMessage(stream, "  -XX:HeapMinFree=N\n");
   UsageMessage(stream, "  -XX:HeapMaxFree=N\n");
   UsageMessage(stream, "  -XX:NonMovingSpaceCapacity=N\n");
+  UsageMessage(stream, "  -XX:RegionPrefaultPoolSize=N\n");
+  UsageMessage(stream, "  -XX:AllocationSamplingInterval=N\n");
+  UsageMessage(stream, "  -XX:AllocationProfileFile=filename\n");
   UsageMessage(stream, "  -XX:HeapTargetUtilization=doublevalue\n");
   UsageMessage(stream, "  -XX:ForegroundHeapGrowthMultiplier=doublevalue\n");
+  UsageMessage(stream, "  -XX:GcCpuPercentTarget=doublevalue\n");
   UsageMessage(stream, "  -XX:LowMemoryMode\n");
+  UsageMessage(stream, "  -XX:UseTransparentHugePages\n");
+  UsageMessage(stream, "  -XX:HeapCensus\n");
+  UsageMessage(stream, "  -XX:RosAllocPerCpuRuns\n");
+  UsageMessage(stream, "  -XX:StringDedupStats\n");
   UsageMessage(stream, "  -Xprofile:{threadcpuclock,wallclock,dualclock}\n");
   UsageMessage(stream, "  -Xjitthreshold:integervalue\n");
   UsageMessage(stream, "\n");
@@ -776,6 +819,7 @@ void ParsedOptions::Usage(const char* fmt, ...) {
   UsageMessage(stream, "  -XX:StopForNativeAllocs=N\n");
   UsageMessage(stream, "  -XX:DumpNativeStackOnSigQuit=booleanvalue\n");
   UsageMessage(stream, "  -XX:MadviseRandomAccess:booleanvalue\n");
+  UsageMessage(stream, "  -XX:ParallelImageRelocation:booleanvalue\n");
   UsageMessage(stream, "  -XX:SlowDebug={false,true}\n");
   UsageMessage(stream, "  -Xmethod-trace\n");
   UsageMessage(stream, "  -Xmethod-trace-file:filename\n");
@@ -797,11 +841,14 @@ void ParsedOptions::Usage(const char* fmt, ...) {
   UsageMessage(stream, "  -Xjitwarmupthreshold:integervalue\n");
   UsageMessage(stream, "  -Xjitosrthreshold:integervalue\n");
   UsageMessage(stream, "  -Xjitprithreadweight:integervalue\n");
+  UsageMessage(stream, "  -Xjitpersistentcache:file-path\n");
   UsageMessage(stream, "  -X[no]relocate\n");
   UsageMessage(stream, "  -X[no]dex2oat (Whether to invoke dex2oat on the application)\n");
   UsageMessage(stream, "  -X[no]image-dex2oat (Whether to create and use a boot image)\n");
   UsageMessage(stream, "  -Xno-dex-file-fallback "
                        "(Don't fall back to dex files without oat files)\n");
+  UsageMessage(stream, "  -XX:DexVerificationThreads=integervalue "
+                       "(Threads verifying each large dex file opened by the runtime)\n");
   UsageMessage(stream, "  -Xplugin:<library.so> "
                        "(Load a runtime plugin, requires -Xexperimental:runtime-plugins)\n");
   UsageMessage(stream, "  -Xexperimental:runtime-plugins"
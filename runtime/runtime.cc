@@ -33,6 +33,7 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <functional>
 #include <limits>
 #include <thread>
 #include <unordered_set>
@@ -163,6 +164,7 @@
 #include "signal_set.h"
 #include "thread.h"
 #include "thread_list.h"
+#include "thread_pool.h"
 #include "ti/agent.h"
 #include "trace.h"
 #include "transaction.h"
@@ -269,6 +271,7 @@ Runtime::Runtime()
       preinitialization_transactions_(),
       verify_(verifier::VerifyMode::kNone),
       allow_dex_file_fallback_(true),
+      dex_verification_threads_(1u),
       target_sdk_version_(static_cast<uint32_t>(SdkVersion::kUnset)),
       implicit_null_checks_(false),
       implicit_so_checks_(false),
@@ -387,6 +390,8 @@ Runtime::~Runtime() {
     // JIT compiler threads. Also this should be run before marking the runtime
     // as shutting down as some tasks may require mutator access.
     jit_->DeleteThreadPool();
+    // Record the methods that got optimized code once no compilation can still be in flight.
+    jit_->SavePersistentCache(self);
   }
   if (oat_file_manager_ != nullptr) {
     oat_file_manager_->WaitForWorkersToBeCreated();
@@ -701,25 +706,63 @@ void Runtime::CallExitHook(jint status) {
   }
 }
 
-void Runtime::SweepSystemWeaks(IsMarkedVisitor* visitor) {
-  GetInternTable()->SweepInternTableWeaks(visitor);
-  GetMonitorList()->SweepMonitorList(visitor);
-  GetJavaVM()->SweepJniWeakGlobals(visitor);
-  GetHeap()->SweepAllocationRecords(visitor);
+void Runtime::SweepSystemWeaks(IsMarkedVisitor* visitor,
+                               ThreadPool* thread_pool,
+                               size_t thread_count) {
+  // The holders are independent of each other and each is guarded by its own lock, so each one
+  // is a unit of work that can be swept on its own.
+  std::vector<std::function<void()>> sweeps;
+  sweeps.push_back([&]() REQUIRES_SHARED(Locks::mutator_lock_) {
+    GetInternTable()->SweepInternTableWeaks(visitor);
+  });
+  sweeps.push_back([&]() REQUIRES_SHARED(Locks::mutator_lock_) {
+    GetMonitorList()->SweepMonitorList(visitor);
+  });
+  sweeps.push_back([&]() REQUIRES_SHARED(Locks::mutator_lock_) {
+    GetJavaVM()->SweepJniWeakGlobals(visitor);
+  });
+  sweeps.push_back([&]() REQUIRES_SHARED(Locks::mutator_lock_) {
+    GetHeap()->SweepAllocationRecords(visitor);
+  });
   if (GetJit() != nullptr) {
     // Visit JIT literal tables. Objects in these tables are classes and strings
     // and only classes can be affected by class unloading. The strings always
     // stay alive as they are strongly interned.
     // TODO: Move this closer to CleanupClassLoaders, to avoid blocking weak accesses
     // from mutators. See b/32167580.
-    GetJit()->GetCodeCache()->SweepRootTables(visitor);
+    sweeps.push_back([&]() REQUIRES_SHARED(Locks::mutator_lock_) {
+      GetJit()->GetCodeCache()->SweepRootTables(visitor);
+    });
   }
-  thread_list_->SweepInterpreterCaches(visitor);
+  sweeps.push_back([&]() REQUIRES_SHARED(Locks::mutator_lock_) {
+    thread_list_->SweepInterpreterCaches(visitor);
+  });
 
   // All other generic system-weak holders.
   for (gc::AbstractSystemWeakHolder* holder : system_weak_holders_) {
-    holder->Sweep(visitor);
+    sweeps.push_back([holder, visitor]() REQUIRES_SHARED(Locks::mutator_lock_) {
+      holder->Sweep(visitor);
+    });
+  }
+
+  if (thread_pool == nullptr || thread_count <= 1) {
+    for (const std::function<void()>& sweep : sweeps) {
+      sweep();
+    }
+    return;
   }
+  Thread* self = Thread::Current();
+  for (const std::function<void()>& sweep : sweeps) {
+    // No thread safety analysis since the workers sweep on behalf of this thread, which holds the
+    // mutator lock until they are done.
+    thread_pool->AddTask(self, new FunctionTask([&sweep](Thread*) NO_THREAD_SAFETY_ANALYSIS {
+      sweep();
+    }));
+  }
+  thread_pool->SetMaxActiveWorkers(thread_count - 1);
+  thread_pool->StartWorkers(self);
+  thread_pool->Wait(self, /* do_work= */ true, /* may_hold_locks= */ true);
+  thread_pool->StopWorkers(self);
 }
 
 bool Runtime::ParseOptions(const RuntimeOptions& raw_options,
@@ -1122,7 +1165,8 @@ static size_t OpenBootDexFiles(ArrayRef<const std::string> dex_filenames,
                                std::vector<std::unique_ptr<const DexFile>>* dex_files) {
   DCHECK(dex_files != nullptr) << "OpenDexFiles: out-param is nullptr";
   size_t failure_count = 0;
-  const ArtDexFileLoader dex_file_loader;
+  ArtDexFileLoader dex_file_loader;
+  dex_file_loader.SetVerificationThreads(Runtime::Current()->GetDexVerificationThreads());
   for (size_t i = 0; i < dex_filenames.size(); i++) {
     const char* dex_filename = dex_filenames[i].c_str();
     const char* dex_location = dex_locations[i].c_str();
@@ -1316,6 +1360,8 @@ bool Runtime::Init(RuntimeArgumentMap&& runtime_options_in) {
 
   verify_ = runtime_options.GetOrDefault(Opt::Verify);
   allow_dex_file_fallback_ = !runtime_options.Exists(Opt::NoDexFileFallback);
+  dex_verification_threads_ =
+      std::max(runtime_options.GetOrDefault(Opt::DexVerificationThreads), 1u);
 
   target_sdk_version_ = runtime_options.GetOrDefault(Opt::TargetSdkVersion);
 
@@ -1377,6 +1423,7 @@ bool Runtime::Init(RuntimeArgumentMap&& runtime_options_in) {
   bool use_generational_cc = kUseBakerReadBarrier && xgc_option.generational_cc;
 
   image_space_loading_order_ = runtime_options.GetOrDefault(Opt::ImageSpaceLoadingOrder);
+  parallel_image_relocation_ = runtime_options.GetOrDefault(Opt::ParallelImageRelocation);
 
   heap_ = new gc::Heap(runtime_options.GetOrDefault(Opt::MemoryInitialSize),
                        runtime_options.GetOrDefault(Opt::HeapGrowthLimit),
@@ -1417,6 +1464,14 @@ bool Runtime::Init(RuntimeArgumentMap&& runtime_options_in) {
                        runtime_options.GetOrDefault(Opt::HSpaceCompactForOOMMinIntervalsMs),
                        runtime_options.Exists(Opt::DumpRegionInfoBeforeGC),
                        runtime_options.Exists(Opt::DumpRegionInfoAfterGC),
+                       runtime_options.GetOrDefault(Opt::RegionPrefaultPoolSize),
+                       runtime_options.Exists(Opt::UseTransparentHugePages),
+                       runtime_options.GetOrDefault(Opt::AllocationSamplingInterval),
+                       runtime_options.ReleaseOrDefault(Opt::AllocationProfileFile),
+                       runtime_options.GetOrDefault(Opt::GcCpuPercentTarget),
+                       runtime_options.Exists(Opt::HeapCensus),
+                       runtime_options.Exists(Opt::RosAllocPerCpuRuns),
+                       runtime_options.Exists(Opt::StringDedupStats),
                        image_space_loading_order_);
 
   if (!heap_->HasBootImageSpace() && !allow_dex_file_fallback_) {
@@ -2776,6 +2831,12 @@ void Runtime::UpdateProcessState(ProcessState process_state) {
   ProcessState old_process_state = process_state_;
   process_state_ = process_state;
   GetHeap()->UpdateProcessState(old_process_state, process_state);
+  if (jit_ != nullptr &&
+      old_process_state == kProcessStateJankPerceptible &&
+      process_state == kProcessStateJankImperceptible) {
+    // Background processes may get killed without shutting down the runtime.
+    jit_->ScheduleSavePersistentCache(Thread::Current());
+  }
 }
 
 void Runtime::RegisterSensitiveThread() const {
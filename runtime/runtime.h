@@ -392,8 +392,11 @@ class Runtime {
       REQUIRES_SHARED(Locks::mutator_lock_);
 
   // Sweep system weaks, the system weak is deleted if the visitor return null. Otherwise, the
-  // system weak is updated to be the visitor's returned value.
-  void SweepSystemWeaks(IsMarkedVisitor* visitor)
+  // system weak is updated to be the visitor's returned value. With a thread pool and more than
+  // one thread, the holders are swept in parallel, so the visitor must be thread safe.
+  void SweepSystemWeaks(IsMarkedVisitor* visitor,
+                        ThreadPool* thread_pool = nullptr,
+                        size_t thread_count = 1u)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
   // Walk all reflective objects and visit their targets as well as any method/fields held by the
@@ -660,6 +663,11 @@ class Runtime {
     return allow_dex_file_fallback_;
   }
 
+  // Number of threads that may verify each dex file opened by the runtime.
+  size_t GetDexVerificationThreads() const {
+    return dex_verification_threads_;
+  }
+
   const std::vector<std::string>& GetCpuAbilist() const {
     return cpu_abilist_;
   }
@@ -972,6 +980,11 @@ class Runtime {
     return image_space_loading_order_;
   }
 
+  // Whether image relocation may split its object fixup passes across the runtime thread pool.
+  bool UseParallelImageRelocation() const {
+    return parallel_image_relocation_;
+  }
+
   bool IsVerifierMissingKThrowFatal() const {
     return verifier_missing_kthrow_fatal_;
   }
@@ -1176,6 +1189,9 @@ class Runtime {
   // available/usable.
   bool allow_dex_file_fallback_;
 
+  // The number of threads passed to the dex file loaders with SetVerificationThreads().
+  size_t dex_verification_threads_;
+
   // List of supported cpu abis.
   std::vector<std::string> cpu_abilist_;
 
@@ -1339,6 +1355,8 @@ class Runtime {
   gc::space::ImageSpaceLoadingOrder image_space_loading_order_ =
       gc::space::ImageSpaceLoadingOrder::kSystemFirst;
 
+  bool parallel_image_relocation_ = true;
+
   bool verifier_missing_kthrow_fatal_;
   bool perfetto_hprof_enabled_;
 
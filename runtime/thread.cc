@@ -2470,6 +2470,7 @@ Thread::~Thread() {
   CHECK(!ReadFlag(kCheckpointRequest));
   CHECK(!ReadFlag(kEmptyCheckpointRequest));
   CHECK(tlsPtr_.checkpoint_function == nullptr);
+  DCHECK(method_trace_buffer_ == nullptr);
   CHECK_EQ(checkpoint_overflow_.size(), 0u);
   CHECK(tlsPtr_.flip_function == nullptr);
   CHECK_EQ(tls32_.is_transitioning_to_runnable, false);
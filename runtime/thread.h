@@ -99,6 +99,7 @@ class StackedShadowFrameRecord;
 enum class SuspendReason : char;
 class Thread;
 class ThreadList;
+class TraceRingBuffer;
 enum VisitRootFlags : uint8_t;
 
 // A piece of data that can be held in the CustomTls. The destructor will be called during thread
@@ -1112,6 +1113,14 @@ class Thread {
     tls64_.trace_clock_base = clock_base;
   }
 
+  TraceRingBuffer* GetMethodTraceBuffer() const {
+    return method_trace_buffer_;
+  }
+
+  void SetMethodTraceBuffer(TraceRingBuffer* buffer) {
+    method_trace_buffer_ = buffer;
+  }
+
   BaseMutex* GetHeldMutex(LockLevel level) const {
     return tlsPtr_.held_mutexes[level];
   }
@@ -1886,6 +1895,10 @@ class Thread {
   // the caller is allowed to access all fields and methods in the Core Platform API.
   uint32_t core_platform_api_cookie_ = 0;
 
+  // Method trace events of this thread not yet written out when streaming a method trace. Owned
+  // by the Trace, which takes it back when the thread exits or the trace stops.
+  TraceRingBuffer* method_trace_buffer_ = nullptr;
+
   friend class gc::collector::SemiSpace;  // For getting stack traces.
   friend class Runtime;  // For CreatePeer.
   friend class QuickExceptionHandler;  // For dumping the stack.
@@ -23,6 +23,8 @@
 
 #include <pthread.h>
 
+#include <algorithm>
+
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 
@@ -40,10 +42,17 @@ using android::base::StringPrintf;
 
 static constexpr bool kMeasureWaitTime = false;
 
-ThreadPoolWorker::ThreadPoolWorker(ThreadPool* thread_pool, const std::string& name,
-                                   size_t stack_size)
+// Upper bound on the number of tasks a worker moves from the shared queue to its own deque at once.
+static constexpr size_t kMaxClaimedTasks = 32;
+static_assert(kMaxClaimedTasks <= WorkStealingQueue::kCapacity, "Claimed batch must fit the deque");
+
+ThreadPoolWorker::ThreadPoolWorker(ThreadPool* thread_pool,
+                                   const std::string& name,
+                                   size_t stack_size,
+                                   WorkStealingQueue* local_queue)
     : thread_pool_(thread_pool),
-      name_(name) {
+      name_(name),
+      local_queue_(local_queue) {
   // Add an inaccessible page to catch stack overflow.
   stack_size += kPageSize;
   std::string error_msg;
@@ -88,7 +97,7 @@ void ThreadPoolWorker::Run() {
   Thread* self = Thread::Current();
   Task* task = nullptr;
   thread_pool_->creation_barier_.Pass(self);
-  while ((task = thread_pool_->GetTask(self)) != nullptr) {
+  while ((task = thread_pool_->GetTask(self, local_queue_)) != nullptr) {
     task->Run(self);
     task->Finalize();
   }
@@ -120,12 +129,29 @@ void* ThreadPoolWorker::Callback(void* arg) {
 void ThreadPool::AddTask(Thread* self, Task* task) {
   MutexLock mu(self, task_queue_lock_);
   tasks_.push_back(task);
+  pending_task_count_.fetch_add(1u, std::memory_order_relaxed);
   // If we have any waiters, signal one.
   if (started_ && waiting_count_ != 0) {
     task_queue_condition_.Signal(self);
   }
 }
 
+void ThreadPool::AddTasks(Thread* self, const std::vector<Task*>& tasks) {
+  if (tasks.empty()) {
+    return;
+  }
+  MutexLock mu(self, task_queue_lock_);
+  tasks_.insert(tasks_.end(), tasks.begin(), tasks.end());
+  pending_task_count_.fetch_add(tasks.size(), std::memory_order_relaxed);
+  if (started_ && waiting_count_ != 0) {
+    if (tasks.size() == 1u) {
+      task_queue_condition_.Signal(self);
+    } else {
+      task_queue_condition_.Broadcast(self);
+    }
+  }
+}
+
 void ThreadPool::RemoveAllTasks(Thread* self) {
   // The ThreadPool is responsible for calling Finalize (which usually delete
   // the task memory) on all the tasks.
@@ -134,7 +160,16 @@ void ThreadPool::RemoveAllTasks(Thread* self) {
     task->Finalize();
   }
   MutexLock mu(self, task_queue_lock_);
+  pending_task_count_.fetch_sub(tasks_.size(), std::memory_order_relaxed);
   tasks_.clear();
+  // Tasks already claimed by workers are dropped the same way as the unclaimed ones.
+  for (const std::unique_ptr<WorkStealingQueue>& queue : worker_queues_) {
+    while (!queue->IsEmpty()) {
+      if (queue->Steal() != nullptr) {
+        pending_task_count_.fetch_sub(1u, std::memory_order_relaxed);
+      }
+    }
+  }
 }
 
 ThreadPool::ThreadPool(const char* name,
@@ -148,6 +183,7 @@ ThreadPool::ThreadPool(const char* name,
     started_(false),
     shutting_down_(false),
     waiting_count_(0),
+    pending_task_count_(0u),
     start_time_(0),
     total_wait_time_(0),
     creation_barier_(0),
@@ -165,11 +201,16 @@ void ThreadPool::CreateThreads() {
     shutting_down_ = false;
     // Add one since the caller of constructor waits on the barrier too.
     creation_barier_.Init(self, max_active_workers_);
+    // Worker deques are only ever added, and only while no worker is running, so that thieves
+    // can iterate over them without holding the task queue lock.
+    while (worker_queues_.size() < max_active_workers_) {
+      worker_queues_.push_back(std::make_unique<WorkStealingQueue>());
+    }
     while (GetThreadCount() < max_active_workers_) {
-      const std::string worker_name = StringPrintf("%s worker thread %zu", name_.c_str(),
-                                                   GetThreadCount());
-      threads_.push_back(
-          new ThreadPoolWorker(this, worker_name, worker_stack_size_));
+      const size_t index = GetThreadCount();
+      const std::string worker_name = StringPrintf("%s worker thread %zu", name_.c_str(), index);
+      threads_.push_back(new ThreadPoolWorker(
+          this, worker_name, worker_stack_size_, worker_queues_[index].get()));
     }
   }
 }
@@ -224,52 +265,117 @@ void ThreadPool::StopWorkers(Thread* self) {
   started_ = false;
 }
 
-Task* ThreadPool::GetTask(Thread* self) {
-  MutexLock mu(self, task_queue_lock_);
-  while (!IsShuttingDown()) {
-    const size_t thread_count = GetThreadCount();
-    // Ensure that we don't use more threads than the maximum active workers.
-    const size_t active_threads = thread_count - waiting_count_;
-    // <= since self is considered an active worker.
-    if (active_threads <= max_active_workers_) {
-      Task* task = TryGetTaskLocked();
-      if (task != nullptr) {
-        return task;
+Task* ThreadPool::GetTask(Thread* self, WorkStealingQueue* local_queue) {
+  // Tasks that this worker already claimed are run without any synchronization with the others.
+  Task* task = local_queue->Pop();
+  if (task != nullptr) {
+    pending_task_count_.fetch_sub(1u, std::memory_order_relaxed);
+    return task;
+  }
+  while (true) {
+    {
+      MutexLock mu(self, task_queue_lock_);
+      while (true) {
+        if (IsShuttingDown()) {
+          // We are shutting down, return null to tell the worker thread to stop looping.
+          return nullptr;
+        }
+        const size_t thread_count = GetThreadCount();
+        // Ensure that we don't use more threads than the maximum active workers.
+        const size_t active_threads = thread_count - waiting_count_;
+        // <= since self is considered an active worker.
+        if (active_threads <= max_active_workers_ && HasOutstandingTasks()) {
+          task = TryClaimTasksLocked(local_queue);
+          if (task != nullptr) {
+            return task;
+          }
+          // The shared queue is empty but other workers still hold unstarted tasks.
+          break;
+        }
+
+        ++waiting_count_;
+        if (waiting_count_ == GetThreadCount() && !HasOutstandingTasks()) {
+          // We may be done, lets broadcast to the completion condition.
+          completion_condition_.Broadcast(self);
+        }
+        const uint64_t wait_start = kMeasureWaitTime ? NanoTime() : 0;
+        task_queue_condition_.Wait(self);
+        if (kMeasureWaitTime) {
+          const uint64_t wait_end = NanoTime();
+          total_wait_time_ += wait_end - std::max(wait_start, start_time_);
+        }
+        --waiting_count_;
       }
     }
-
-    ++waiting_count_;
-    if (waiting_count_ == GetThreadCount() && !HasOutstandingTasks()) {
-      // We may be done, lets broadcast to the completion condition.
-      completion_condition_.Broadcast(self);
-    }
-    const uint64_t wait_start = kMeasureWaitTime ? NanoTime() : 0;
-    task_queue_condition_.Wait(self);
-    if (kMeasureWaitTime) {
-      const uint64_t wait_end = NanoTime();
-      total_wait_time_ += wait_end - std::max(wait_start, start_time_);
+    // Steal outside of the lock so that thieves do not contend with AddTask. If we lose the race
+    // for the remaining tasks we go back to re-check the shared state.
+    task = TrySteal(self, local_queue);
+    if (task != nullptr) {
+      return task;
     }
-    --waiting_count_;
   }
-
-  // We are shutting down, return null to tell the worker thread to stop looping.
-  return nullptr;
 }
 
 Task* ThreadPool::TryGetTask(Thread* self) {
-  MutexLock mu(self, task_queue_lock_);
-  return TryGetTaskLocked();
+  {
+    MutexLock mu(self, task_queue_lock_);
+    Task* task = TryGetTaskLocked();
+    if (task != nullptr || !HasOutstandingTasks()) {
+      return task;
+    }
+  }
+  // The remaining tasks have all been claimed by workers, help them out.
+  return TrySteal(self, /*local_queue=*/ nullptr);
 }
 
 Task* ThreadPool::TryGetTaskLocked() {
-  if (HasOutstandingTasks()) {
+  if (HasOutstandingTasks() && !tasks_.empty()) {
     Task* task = tasks_.front();
     tasks_.pop_front();
+    pending_task_count_.fetch_sub(1u, std::memory_order_relaxed);
     return task;
   }
   return nullptr;
 }
 
+Task* ThreadPool::TryClaimTasksLocked(WorkStealingQueue* local_queue) {
+  if (!HasOutstandingTasks() || tasks_.empty()) {
+    return nullptr;
+  }
+  // Leave enough in the shared queue for the other workers to get their share.
+  const size_t count = std::clamp(tasks_.size() / (GetThreadCount() + 1u),
+                                  static_cast<size_t>(1u),
+                                  kMaxClaimedTasks);
+  // The owner pops the most recently pushed task first, so push in reverse order to keep running
+  // the batch in the order the tasks were added. Thieves take the newest tasks of the batch.
+  for (size_t i = count - 1u; i != 0u; --i) {
+    bool pushed = local_queue->Push(tasks_[i]);
+    CHECK(pushed);
+  }
+  Task* task = tasks_.front();
+  tasks_.erase(tasks_.begin(), tasks_.begin() + count);
+  pending_task_count_.fetch_sub(1u, std::memory_order_relaxed);
+  return task;
+}
+
+Task* ThreadPool::TrySteal(Thread* self, WorkStealingQueue* local_queue) {
+  // Start at a different victim for each thief to spread out contention on the deques.
+  const size_t num_queues = worker_queues_.size();
+  const size_t start = static_cast<size_t>(self->GetTid());
+  for (size_t i = 0; i != num_queues; ++i) {
+    WorkStealingQueue* victim = worker_queues_[(start + i) % num_queues].get();
+    if (victim == local_queue) {
+      continue;
+    }
+    Task* task = victim->Steal();
+    if (task != nullptr) {
+      pending_task_count_.fetch_sub(1u, std::memory_order_relaxed);
+      return task;
+    }
+  }
+  return nullptr;
+}
+
 void ThreadPool::Wait(Thread* self, bool do_work, bool may_hold_locks) {
   if (do_work) {
     CHECK(!create_peers_);
@@ -292,7 +398,7 @@ void ThreadPool::Wait(Thread* self, bool do_work, bool may_hold_locks) {
 
 size_t ThreadPool::GetTaskCount(Thread* self) {
   MutexLock mu(self, task_queue_lock_);
-  return tasks_.size();
+  return pending_task_count_.load(std::memory_order_relaxed);
 }
 
 void ThreadPool::SetPthreadPriority(int priority) {
@@ -19,9 +19,12 @@
 
 #include <deque>
 #include <functional>
+#include <memory>
 #include <vector>
 
 #include "barrier.h"
+#include "base/atomic.h"
+#include "base/bit_utils.h"
 #include "base/mem_map.h"
 #include "base/mutex.h"
 
@@ -72,6 +75,91 @@ class FunctionTask : public SelfDeletingTask {
   std::function<void(Thread*)> func_;
 };
 
+// A fixed capacity Chase-Lev work-stealing deque of tasks. The owning worker pushes and pops at
+// the bottom without synchronization beyond a fence, while any other thread may steal from the
+// top with a single CAS.
+class WorkStealingQueue {
+ public:
+  static constexpr size_t kCapacity = 256;
+
+  WorkStealingQueue() : top_(0), bottom_(0) {
+    for (Atomic<Task*>& slot : tasks_) {
+      slot.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  // Owner only. Returns false if the deque is full.
+  bool Push(Task* task) {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const int64_t top = top_.load(std::memory_order_acquire);
+    if (bottom - top >= static_cast<int64_t>(kCapacity)) {
+      return false;
+    }
+    tasks_[bottom & kMask].store(task, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Owner only. Returns the most recently pushed task, or null if the deque is empty.
+  Task* Pop() {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    Task* task = nullptr;
+    if (top <= bottom) {
+      task = tasks_[bottom & kMask].load(std::memory_order_relaxed);
+      if (top == bottom) {
+        // Last element, race against thieves for it.
+        if (!top_.compare_exchange_strong(top,
+                                          top + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+          task = nullptr;
+        }
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+      }
+    } else {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return task;
+  }
+
+  // Any thread. Returns the oldest task, or null if the deque is empty or we lost a race.
+  Task* Steal() {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top < bottom) {
+      Task* task = tasks_[top & kMask].load(std::memory_order_relaxed);
+      if (top_.compare_exchange_strong(top,
+                                       top + 1,
+                                       std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+        return task;
+      }
+    }
+    return nullptr;
+  }
+
+  bool IsEmpty() const {
+    return bottom_.load(std::memory_order_acquire) <= top_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static constexpr size_t kMask = kCapacity - 1;
+  static constexpr size_t kCacheLineSize = 64;
+  static_assert(IsPowerOfTwo(kCapacity), "Capacity must be a power of two");
+
+  // Thieves and the owner write different ends, keep them on separate cache lines.
+  alignas(kCacheLineSize) Atomic<int64_t> top_;
+  alignas(kCacheLineSize) Atomic<int64_t> bottom_;
+  Atomic<Task*> tasks_[kCapacity];
+
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingQueue);
+};
+
 class ThreadPoolWorker {
  public:
   static const size_t kDefaultStackSize = 1 * MB;
@@ -89,12 +177,17 @@ class ThreadPoolWorker {
   Thread* GetThread() const { return thread_; }
 
  protected:
-  ThreadPoolWorker(ThreadPool* thread_pool, const std::string& name, size_t stack_size);
+  ThreadPoolWorker(ThreadPool* thread_pool,
+                   const std::string& name,
+                   size_t stack_size,
+                   WorkStealingQueue* local_queue);
   static void* Callback(void* arg) REQUIRES(!Locks::mutator_lock_);
   virtual void Run();
 
   ThreadPool* const thread_pool_;
   const std::string name_;
+  // Tasks claimed by this worker, which idle workers may steal from.
+  WorkStealingQueue* const local_queue_;
   MemMap stack_;
   pthread_t pthread_;
   Thread* thread_;
@@ -124,6 +217,10 @@ class ThreadPool {
   // after running it, it is the caller's responsibility.
   void AddTask(Thread* self, Task* task) REQUIRES(!task_queue_lock_);
 
+  // Add a batch of tasks under a single acquisition of the task queue lock, waking up as many
+  // waiting workers as needed. Ownership of the tasks is the same as for AddTask.
+  void AddTasks(Thread* self, const std::vector<Task*>& tasks) REQUIRES(!task_queue_lock_);
+
   // Remove all tasks in the queue.
   void RemoveAllTasks(Thread* self) REQUIRES(!task_queue_lock_);
 
@@ -167,20 +264,28 @@ class ThreadPool {
   void WaitForWorkersToBeCreated();
 
  protected:
-  // get a task to run, blocks if there are no tasks left
-  virtual Task* GetTask(Thread* self) REQUIRES(!task_queue_lock_);
+  // Get a task to run for the worker owning `local_queue`, blocks if there are no tasks left.
+  // The worker's own deque is drained first, then a batch is claimed from the shared queue, and
+  // only then are other workers' deques stolen from.
+  virtual Task* GetTask(Thread* self, WorkStealingQueue* local_queue) REQUIRES(!task_queue_lock_);
 
   // Try to get a task, returning null if there is none available.
   Task* TryGetTask(Thread* self) REQUIRES(!task_queue_lock_);
   Task* TryGetTaskLocked() REQUIRES(task_queue_lock_);
 
+  // Move a batch of tasks from the shared queue to `local_queue` and return one of them to run.
+  Task* TryClaimTasksLocked(WorkStealingQueue* local_queue) REQUIRES(task_queue_lock_);
+
+  // Steal a task from any worker deque other than `local_queue`, without taking any lock.
+  Task* TrySteal(Thread* self, WorkStealingQueue* local_queue) REQUIRES(!task_queue_lock_);
+
   // Are we shutting down?
   bool IsShuttingDown() const REQUIRES(task_queue_lock_) {
     return shutting_down_;
   }
 
   bool HasOutstandingTasks() const REQUIRES(task_queue_lock_) {
-    return started_ && !tasks_.empty();
+    return started_ && pending_task_count_.load(std::memory_order_relaxed) != 0u;
   }
 
   const std::string name_;
@@ -191,7 +296,13 @@ class ThreadPool {
   volatile bool shutting_down_ GUARDED_BY(task_queue_lock_);
   // How many worker threads are waiting on the condition.
   volatile size_t waiting_count_ GUARDED_BY(task_queue_lock_);
+  // Tasks not yet claimed by any worker.
   std::deque<Task*> tasks_ GUARDED_BY(task_queue_lock_);
+  // Number of tasks waiting to run, either in `tasks_` or in one of the worker deques. Only
+  // incremented with the task queue lock held, but decremented lock-free when a task is claimed.
+  Atomic<size_t> pending_task_count_;
+  // One deque per worker slot, owned by the pool so that tasks survive DeleteThreads.
+  std::vector<std::unique_ptr<WorkStealingQueue>> worker_queues_;
   std::vector<ThreadPoolWorker*> threads_;
   // Work balance detection.
   uint64_t start_time_ GUARDED_BY(task_queue_lock_);
@@ -16,7 +16,9 @@
 
 #include "thread_pool.h"
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "base/atomic.h"
 #include "common_runtime_test.h"
@@ -122,6 +124,49 @@ TEST_F(ThreadPoolTest, StopWait) {
   thread_pool.Wait(self, /* do_work= */ true, false);
 }
 
+// Check that a batch of tasks added at once is run, including tasks claimed by other workers.
+TEST_F(ThreadPoolTest, AddTasks) {
+  Thread* self = Thread::Current();
+  ThreadPool thread_pool("Thread pool test thread pool", num_threads);
+  AtomicInteger count(0);
+  static const int32_t num_tasks = num_threads * 100;
+  std::vector<Task*> tasks;
+  for (int32_t i = 0; i < num_tasks; ++i) {
+    tasks.push_back(new CountTask(&count));
+  }
+  thread_pool.AddTasks(self, tasks);
+  EXPECT_EQ(static_cast<size_t>(num_tasks), thread_pool.GetTaskCount(self));
+  thread_pool.StartWorkers(self);
+  thread_pool.Wait(self, true, false);
+  EXPECT_EQ(num_tasks, count.load(std::memory_order_seq_cst));
+  EXPECT_EQ(0u, thread_pool.GetTaskCount(self));
+}
+
+TEST_F(ThreadPoolTest, WorkStealingQueue) {
+  AtomicInteger count(0);
+  std::vector<std::unique_ptr<Task>> tasks;
+  for (size_t i = 0; i < WorkStealingQueue::kCapacity; ++i) {
+    tasks.emplace_back(new CountTask(&count));
+  }
+  WorkStealingQueue queue;
+  EXPECT_TRUE(queue.IsEmpty());
+  EXPECT_EQ(nullptr, queue.Pop());
+  EXPECT_EQ(nullptr, queue.Steal());
+  for (const std::unique_ptr<Task>& task : tasks) {
+    EXPECT_TRUE(queue.Push(task.get()));
+  }
+  // The deque is full.
+  EXPECT_FALSE(queue.Push(tasks[0].get()));
+  // The owner takes the newest task while thieves take the oldest.
+  EXPECT_EQ(tasks.back().get(), queue.Pop());
+  EXPECT_EQ(tasks.front().get(), queue.Steal());
+  for (size_t i = 1; i < WorkStealingQueue::kCapacity - 1; ++i) {
+    EXPECT_EQ(tasks[i].get(), queue.Steal());
+  }
+  EXPECT_TRUE(queue.IsEmpty());
+  EXPECT_EQ(nullptr, queue.Pop());
+}
+
 class TreeTask : public Task {
  public:
   TreeTask(ThreadPool* const thread_pool, AtomicInteger* count, int depth)
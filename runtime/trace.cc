@@ -72,12 +72,20 @@ static const uint16_t kTraceRecordSizeDualClock   = 14;  // using v3 with two ti
 TraceClockSource Trace::default_clock_source_ = kDefaultTraceClockSource;
 
 Trace* volatile Trace::the_trace_ = nullptr;
+Trace* Trace::stopping_trace_ = nullptr;
 pthread_t Trace::sampling_pthread_ = 0U;
+pthread_t Trace::writer_pthread_ = 0U;
 std::unique_ptr<std::vector<ArtMethod*>> Trace::temp_stack_trace_;
 
 // The key identifying the tracer to update instrumentation.
 static constexpr const char* kTracerInstrumentationKey = "Tracer";
 
+// How often the trace writer thread drains the threads' trace ring buffers.
+static constexpr useconds_t kTraceWriterIntervalUs = 50 * 1000;
+
+// TraceRingBuffer stores the trace action in the low bits of the method pointer.
+static_assert(alignof(ArtMethod) > kTraceMethodActionMask, "ArtMethod alignment too small");
+
 static TraceAction DecodeTraceAction(uint32_t tmid) {
   return static_cast<TraceAction>(tmid & kTraceMethodActionMask);
 }
@@ -306,6 +314,33 @@ void* Trace::RunSamplingThread(void* arg) {
   return nullptr;
 }
 
+void* Trace::RunWriterThread(void* arg ATTRIBUTE_UNUSED) {
+  Runtime* runtime = Runtime::Current();
+  CHECK(runtime->AttachCurrentThread("Trace Writer", true, runtime->GetSystemThreadGroup(),
+                                     !runtime->IsAotCompiler()));
+
+  while (true) {
+    usleep(kTraceWriterIntervalUs);
+    ScopedTrace trace("Trace buffer draining");
+    Thread* self = Thread::Current();
+    ScopedObjectAccess soa(self);
+    // The trace is not deleted before StopTracing has joined this thread, so it can be drained
+    // without holding the trace lock.
+    Trace* the_trace;
+    {
+      MutexLock mu(self, *Locks::trace_lock_);
+      the_trace = the_trace_;
+    }
+    if (the_trace == nullptr) {
+      break;
+    }
+    the_trace->DrainAllTraceBuffers(self);
+  }
+
+  runtime->DetachCurrentThread();
+  return nullptr;
+}
+
 void Trace::Start(const char* trace_filename,
                   size_t buffer_size,
                   int flags,
@@ -421,6 +456,10 @@ void Trace::Start(std::unique_ptr<File>&& trace_file_in,
                                             "Sampling profiler thread");
         the_trace_->interval_us_ = interval_us;
       } else {
+        if (output_mode == TraceOutputMode::kStreaming) {
+          CHECK_PTHREAD_CALL(pthread_create, (&writer_pthread_, nullptr, &RunWriterThread, nullptr),
+                             "Trace writer thread");
+        }
         runtime->GetInstrumentation()->AddListener(the_trace_,
                                                    instrumentation::Instrumentation::kMethodEntered |
                                                    instrumentation::Instrumentation::kMethodExited |
@@ -448,6 +487,7 @@ void Trace::StopTracing(bool finish_tracing, bool flush_file) {
   Trace* the_trace = nullptr;
   Thread* const self = Thread::Current();
   pthread_t sampling_pthread = 0U;
+  pthread_t writer_pthread = 0U;
   {
     MutexLock mu(self, *Locks::trace_lock_);
     if (the_trace_ == nullptr) {
@@ -455,7 +495,9 @@ void Trace::StopTracing(bool finish_tracing, bool flush_file) {
     } else {
       the_trace = the_trace_;
       the_trace_ = nullptr;
+      stopping_trace_ = the_trace;
       sampling_pthread = sampling_pthread_;
+      writer_pthread = writer_pthread_;
     }
   }
   // Make sure that we join before we delete the trace since we don't want to have
@@ -465,6 +507,11 @@ void Trace::StopTracing(bool finish_tracing, bool flush_file) {
     CHECK_PTHREAD_CALL(pthread_join, (sampling_pthread, nullptr), "sampling thread shutdown");
     sampling_pthread_ = 0U;
   }
+  // Likewise for the trace writer thread.
+  if (writer_pthread != 0U) {
+    CHECK_PTHREAD_CALL(pthread_join, (writer_pthread, nullptr), "trace writer thread shutdown");
+    writer_pthread_ = 0U;
+  }
 
   if (the_trace != nullptr) {
     stop_alloc_counting = (the_trace->flags_ & Trace::kTraceCountAllocs) != 0;
@@ -484,8 +531,16 @@ void Trace::StopTracing(bool finish_tracing, bool flush_file) {
             instrumentation::Instrumentation::kMethodExited |
             instrumentation::Instrumentation::kMethodUnwind);
         runtime->GetInstrumentation()->DisableMethodTracing(kTracerInstrumentationKey);
+        if (the_trace->trace_output_mode_ == TraceOutputMode::kStreaming) {
+          the_trace->DetachTraceBuffers(self);
+        }
       }
     }
+    {
+      // All the ring buffers have been taken back, exiting threads have nothing left to hand over.
+      MutexLock mu(self, *Locks::trace_lock_);
+      stopping_trace_ = nullptr;
+    }
     // At this point, code may read buf_ as it's writers are shutdown
     // and the ScopedSuspendAll above has ensured all stores to buf_
     // are now visible.
@@ -616,8 +671,13 @@ void Trace::FinishTracing() {
   size_t final_offset = 0;
   std::set<ArtMethod*> visited_methods;
   if (trace_output_mode_ == TraceOutputMode::kStreaming) {
-    // Clean up.
     MutexLock mu(Thread::Current(), *streaming_lock_);
+    // Write out the events still held in the ring buffers taken back from the threads.
+    for (const std::unique_ptr<TraceRingBuffer>& buffer : detached_trace_buffers_) {
+      DrainTraceBuffer(buffer.get());
+    }
+    detached_trace_buffers_.clear();
+    // Clean up.
     STLDeleteValues(&seen_methods_);
   } else {
     final_offset = cur_offset_.load(std::memory_order_relaxed);
@@ -877,6 +937,127 @@ void Trace::FlushBuf() {
   cur_offset_.store(0, std::memory_order_relaxed);
 }
 
+void Trace::WriteNewThread(Thread* thread) {
+  if (RegisterThread(thread)) {
+    // It might be better to postpone this. Threads might not have received names...
+    std::string thread_name;
+    thread->GetThreadName(thread_name);
+    uint8_t buf[7];
+    Append2LE(buf, 0);
+    buf[2] = kOpNewThread;
+    Append2LE(buf + 3, static_cast<uint16_t>(thread->GetTid()));
+    Append2LE(buf + 5, static_cast<uint16_t>(thread_name.length()));
+    WriteToBuf(buf, sizeof(buf));
+    WriteToBuf(reinterpret_cast<const uint8_t*>(thread_name.c_str()), thread_name.length());
+  }
+}
+
+void Trace::WriteStreamingEvent(pid_t tid,
+                                ArtMethod* method,
+                                TraceAction action,
+                                uint32_t thread_clock_diff,
+                                uint32_t wall_clock_diff) {
+  if (RegisterMethod(method)) {
+    // Write a special block with the name.
+    std::string method_line(GetMethodLine(method));
+    uint8_t buf[5];
+    Append2LE(buf, 0);
+    buf[2] = kOpNewMethod;
+    Append2LE(buf + 3, static_cast<uint16_t>(method_line.length()));
+    WriteToBuf(buf, sizeof(buf));
+    WriteToBuf(reinterpret_cast<const uint8_t*>(method_line.c_str()), method_line.length());
+  }
+
+  static constexpr size_t kPacketSize = 14U;  // The maximum size of data in a packet.
+  uint8_t buf[kPacketSize];
+  uint8_t* ptr = buf;
+  Append2LE(ptr, tid);
+  Append4LE(ptr + 2, EncodeTraceMethodAndAction(method, action));
+  ptr += 6;
+
+  if (UseThreadCpuClock()) {
+    Append4LE(ptr, thread_clock_diff);
+    ptr += 4;
+  }
+  if (UseWallClock()) {
+    Append4LE(ptr, wall_clock_diff);
+  }
+  static_assert(kPacketSize == 2 + 4 + 4 + 4, "Packet size incorrect.");
+  WriteToBuf(buf, sizeof(buf));
+}
+
+TraceRingBuffer* Trace::CreateTraceBuffer(Thread* thread) {
+  DCHECK(thread->GetMethodTraceBuffer() == nullptr);
+  TraceRingBuffer* buffer = new TraceRingBuffer(thread->GetTid());
+  // Publish the buffer under the streaming lock, the trace writer thread reads it under that lock.
+  MutexLock mu(Thread::Current(), *streaming_lock_);
+  WriteNewThread(thread);
+  thread->SetMethodTraceBuffer(buffer);
+  return buffer;
+}
+
+void Trace::DrainTraceBuffer(TraceRingBuffer* buffer) {
+  const pid_t tid = buffer->GetTid();
+  buffer->Drain([&](ArtMethod* method,
+                    TraceAction action,
+                    uint32_t thread_clock_diff,
+                    uint32_t wall_clock_diff) NO_THREAD_SAFETY_ANALYSIS {
+    WriteStreamingEvent(tid, method, action, thread_clock_diff, wall_clock_diff);
+  });
+}
+
+void Trace::DrainAllTraceBuffers(Thread* self) {
+  struct PendingEvent {
+    pid_t tid;
+    ArtMethod* method;
+    TraceAction action;
+    uint32_t thread_clock_diff;
+    uint32_t wall_clock_diff;
+  };
+  std::vector<PendingEvent> events;
+  std::vector<std::unique_ptr<TraceRingBuffer>> detached_buffers;
+  // The streaming lock is held until the events are written so that a thread draining its full
+  // ring buffer in the meantime cannot write its newer events before the copied ones. It is
+  // acquired after the thread list lock, which is released as soon as the events are copied.
+  Locks::thread_list_lock_->ExclusiveLock(self);
+  streaming_lock_->ExclusiveLock(self);
+  for (Thread* thread : Runtime::Current()->GetThreadList()->GetList()) {
+    TraceRingBuffer* buffer = thread->GetMethodTraceBuffer();
+    if (buffer != nullptr) {
+      const pid_t tid = buffer->GetTid();
+      buffer->Drain([&](ArtMethod* method,
+                        TraceAction action,
+                        uint32_t thread_clock_diff,
+                        uint32_t wall_clock_diff) {
+        events.push_back({tid, method, action, thread_clock_diff, wall_clock_diff});
+      });
+    }
+  }
+  detached_buffers.swap(detached_trace_buffers_);
+  Locks::thread_list_lock_->ExclusiveUnlock(self);
+
+  for (const PendingEvent& event : events) {
+    WriteStreamingEvent(
+        event.tid, event.method, event.action, event.thread_clock_diff, event.wall_clock_diff);
+  }
+  for (const std::unique_ptr<TraceRingBuffer>& buffer : detached_buffers) {
+    DrainTraceBuffer(buffer.get());
+  }
+  streaming_lock_->ExclusiveUnlock(self);
+}
+
+void Trace::DetachTraceBuffers(Thread* self) {
+  MutexLock mu(self, *Locks::thread_list_lock_);
+  MutexLock mu2(self, *streaming_lock_);
+  for (Thread* thread : Runtime::Current()->GetThreadList()->GetList()) {
+    TraceRingBuffer* buffer = thread->GetMethodTraceBuffer();
+    if (buffer != nullptr) {
+      detached_trace_buffers_.emplace_back(buffer);
+      thread->SetMethodTraceBuffer(nullptr);
+    }
+  }
+}
+
 void Trace::LogMethodTraceEvent(Thread* thread, ArtMethod* method,
                                 instrumentation::Instrumentation::InstrumentationEvent event,
                                 uint32_t thread_clock_diff, uint32_t wall_clock_diff) {
@@ -889,28 +1070,6 @@ void Trace::LogMethodTraceEvent(Thread* thread, ArtMethod* method,
   // same pointer value.
   method = method->GetNonObsoleteMethod();
 
-  // Advance cur_offset_ atomically.
-  int32_t new_offset;
-  int32_t old_offset = 0;
-
-  // In the non-streaming case, we do a busy loop here trying to get
-  // an offset to write our record and advance cur_offset_ for the
-  // next use.
-  if (trace_output_mode_ != TraceOutputMode::kStreaming) {
-    // Although multiple threads can call this method concurrently,
-    // the compare_exchange_weak here is still atomic (by definition).
-    // A succeeding update is visible to other cores when they pass
-    // through this point.
-    old_offset = cur_offset_.load(std::memory_order_relaxed);  // Speculative read
-    do {
-      new_offset = old_offset + GetRecordSize(clock_source_);
-      if (static_cast<size_t>(new_offset) > buffer_size_) {
-        overflow_ = true;
-        return;
-      }
-    } while (!cur_offset_.compare_exchange_weak(old_offset, new_offset, std::memory_order_relaxed));
-  }
-
   TraceAction action = kTraceMethodEnter;
   switch (event) {
     case instrumentation::Instrumentation::kMethodEntered:
@@ -926,25 +1085,56 @@ void Trace::LogMethodTraceEvent(Thread* thread, ArtMethod* method,
       UNIMPLEMENTED(FATAL) << "Unexpected event: " << event;
   }
 
+  if (trace_output_mode_ == TraceOutputMode::kStreaming) {
+    if (trace_mode_ == TraceMode::kMethodTracing) {
+      // Method events are only logged by the thread itself, which is the single producer of its
+      // ring buffer. The streaming lock is only taken when the ring needs to be drained.
+      DCHECK_EQ(thread, Thread::Current());
+      TraceRingBuffer* buffer = thread->GetMethodTraceBuffer();
+      if (UNLIKELY(buffer == nullptr)) {
+        buffer = CreateTraceBuffer(thread);
+      }
+      if (UNLIKELY(!buffer->Append(method, action, thread_clock_diff, wall_clock_diff))) {
+        MutexLock mu(thread, *streaming_lock_);
+        DrainTraceBuffer(buffer);
+        bool appended = buffer->Append(method, action, thread_clock_diff, wall_clock_diff);
+        DCHECK(appended);
+      }
+    } else {
+      MutexLock mu(Thread::Current(), *streaming_lock_);  // To serialize writing.
+      WriteNewThread(thread);
+      WriteStreamingEvent(thread->GetTid(), method, action, thread_clock_diff, wall_clock_diff);
+    }
+    return;
+  }
+
+  // In the non-streaming case, we do a busy loop here trying to get
+  // an offset to write our record and advance cur_offset_ for the
+  // next use.
+  //
+  // Although multiple threads can call this method concurrently,
+  // the compare_exchange_weak here is still atomic (by definition).
+  // A succeeding update is visible to other cores when they pass
+  // through this point.
+  int32_t new_offset;
+  int32_t old_offset = cur_offset_.load(std::memory_order_relaxed);  // Speculative read
+  do {
+    new_offset = old_offset + GetRecordSize(clock_source_);
+    if (static_cast<size_t>(new_offset) > buffer_size_) {
+      overflow_ = true;
+      return;
+    }
+  } while (!cur_offset_.compare_exchange_weak(old_offset, new_offset, std::memory_order_relaxed));
+
   uint32_t method_value = EncodeTraceMethodAndAction(method, action);
 
-  // Write data into the tracing buffer (if not streaming) or into a
-  // small buffer on the stack (if streaming) which we'll put into the
-  // tracing buffer below.
+  // Write data into the tracing buffer.
   //
   // These writes to the tracing buffer are synchronised with the
   // future reads that (only) occur under FinishTracing(). The callers
   // of FinishTracing() acquire locks and (implicitly) synchronise
   // the buffer memory.
-  uint8_t* ptr;
-  static constexpr size_t kPacketSize = 14U;  // The maximum size of data in a packet.
-  uint8_t stack_buf[kPacketSize];             // Space to store a packet when in streaming mode.
-  if (trace_output_mode_ == TraceOutputMode::kStreaming) {
-    ptr = stack_buf;
-  } else {
-    ptr = buf_.get() + old_offset;
-  }
-
+  uint8_t* ptr = buf_.get() + old_offset;
   Append2LE(ptr, thread->GetTid());
   Append4LE(ptr + 2, method_value);
   ptr += 6;
@@ -956,34 +1146,6 @@ void Trace::LogMethodTraceEvent(Thread* thread, ArtMethod* method,
   if (UseWallClock()) {
     Append4LE(ptr, wall_clock_diff);
   }
-  static_assert(kPacketSize == 2 + 4 + 4 + 4, "Packet size incorrect.");
-
-  if (trace_output_mode_ == TraceOutputMode::kStreaming) {
-    MutexLock mu(Thread::Current(), *streaming_lock_);  // To serialize writing.
-    if (RegisterMethod(method)) {
-      // Write a special block with the name.
-      std::string method_line(GetMethodLine(method));
-      uint8_t buf2[5];
-      Append2LE(buf2, 0);
-      buf2[2] = kOpNewMethod;
-      Append2LE(buf2 + 3, static_cast<uint16_t>(method_line.length()));
-      WriteToBuf(buf2, sizeof(buf2));
-      WriteToBuf(reinterpret_cast<const uint8_t*>(method_line.c_str()), method_line.length());
-    }
-    if (RegisterThread(thread)) {
-      // It might be better to postpone this. Threads might not have received names...
-      std::string thread_name;
-      thread->GetThreadName(thread_name);
-      uint8_t buf2[7];
-      Append2LE(buf2, 0);
-      buf2[2] = kOpNewThread;
-      Append2LE(buf2 + 3, static_cast<uint16_t>(thread->GetTid()));
-      Append2LE(buf2 + 5, static_cast<uint16_t>(thread_name.length()));
-      WriteToBuf(buf2, sizeof(buf2));
-      WriteToBuf(reinterpret_cast<const uint8_t*>(thread_name.c_str()), thread_name.length());
-    }
-    WriteToBuf(stack_buf, sizeof(stack_buf));
-  }
 }
 
 void Trace::GetVisitedMethods(size_t buf_size,
@@ -1024,12 +1186,26 @@ void Trace::DumpThreadList(std::ostream& os) {
 
 void Trace::StoreExitingThreadInfo(Thread* thread) {
   MutexLock mu(thread, *Locks::trace_lock_);
-  if (the_trace_ != nullptr) {
+  // A trace being stopped still writes out the threads and events it has seen.
+  Trace* the_trace = (the_trace_ != nullptr) ? the_trace_ : stopping_trace_;
+  if (the_trace != nullptr) {
     std::string name;
     thread->GetThreadName(name);
     // The same thread/tid may be used multiple times. As SafeMap::Put does not allow to override
     // a previous mapping, use SafeMap::Overwrite.
-    the_trace_->exited_threads_.Overwrite(thread->GetTid(), name);
+    the_trace->exited_threads_.Overwrite(thread->GetTid(), name);
+  }
+  // Synchronize with the trace taking back or draining the buffers of all threads.
+  MutexLock mu_list(thread, *Locks::thread_list_lock_);
+  TraceRingBuffer* buffer = thread->GetMethodTraceBuffer();
+  if (buffer != nullptr) {
+    // A thread only has a ring buffer until the trace takes the buffers back, which happens before
+    // `stopping_trace_` is cleared. Hand the pending events over, they are written out on the next
+    // drain or when the trace finishes.
+    DCHECK(the_trace != nullptr);
+    MutexLock mu2(thread, *the_trace->streaming_lock_);
+    the_trace->detached_trace_buffers_.emplace_back(buffer);
+    thread->SetMethodTraceBuffer(nullptr);
   }
 }
 
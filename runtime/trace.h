@@ -27,6 +27,7 @@
 #include <vector>
 
 #include "base/atomic.h"
+#include "base/bit_utils.h"
 #include "base/locks.h"
 #include "base/macros.h"
 #include "base/os.h"
@@ -101,6 +102,69 @@ enum TraceAction {
     kTraceMethodActionMask = 0x03,  // two bits
 };
 
+// Fixed capacity single-producer single-consumer ring of method trace events of one thread, used
+// when method tracing streams its output. The owning thread appends events without taking any
+// lock. Draining is serialized by the trace's streaming lock and done either by the trace writer
+// thread or by the owner once the ring is full.
+class TraceRingBuffer {
+ public:
+  static constexpr size_t kCapacity = 2048;
+
+  explicit TraceRingBuffer(pid_t tid) : tid_(tid), head_(0u), tail_(0u) {}
+
+  pid_t GetTid() const {
+    return tid_;
+  }
+
+  // Append an event, only called by the owning thread. Returns false if the ring is full.
+  bool Append(ArtMethod* method,
+              TraceAction action,
+              uint32_t thread_clock_diff,
+              uint32_t wall_clock_diff) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == kCapacity) {
+      return false;
+    }
+    Entry& entry = entries_[tail & (kCapacity - 1u)];
+    entry.method_and_action = reinterpret_cast<uintptr_t>(method) | action;
+    entry.thread_clock_diff = thread_clock_diff;
+    entry.wall_clock_diff = wall_clock_diff;
+    tail_.store(tail + 1u, std::memory_order_release);
+    return true;
+  }
+
+  // Pass all appended events to `visitor` in order and release their slots.
+  template <typename Visitor>
+  void Drain(const Visitor& visitor) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    for (; head != tail; ++head) {
+      const Entry& entry = entries_[head & (kCapacity - 1u)];
+      visitor(reinterpret_cast<ArtMethod*>(entry.method_and_action & ~kTraceMethodActionMask),
+              static_cast<TraceAction>(entry.method_and_action & kTraceMethodActionMask),
+              entry.thread_clock_diff,
+              entry.wall_clock_diff);
+    }
+    head_.store(tail, std::memory_order_release);
+  }
+
+ private:
+  static_assert(IsPowerOfTwo(kCapacity), "Capacity must be a power of two");
+
+  struct Entry {
+    uintptr_t method_and_action;
+    uint32_t thread_clock_diff;
+    uint32_t wall_clock_diff;
+  };
+
+  const pid_t tid_;
+  Atomic<size_t> head_;  // Next entry to drain.
+  Atomic<size_t> tail_;  // Next entry to append.
+  Entry entries_[kCapacity];
+
+  DISALLOW_COPY_AND_ASSIGN(TraceRingBuffer);
+};
+
 // Class for recording event traces. Trace data is either collected
 // synchronously during execution (TracingMode::kMethodTracingActive),
 // or by a separate sampling thread (TracingMode::kSampleProfilingActive).
@@ -250,6 +314,9 @@ class Trace final : public instrumentation::InstrumentationListener {
   // The sampling interval in microseconds is passed as an argument.
   static void* RunSamplingThread(void* arg) REQUIRES(!Locks::trace_lock_);
 
+  // Periodically drains the threads' trace ring buffers when streaming a method trace.
+  static void* RunWriterThread(void* arg) REQUIRES(!Locks::trace_lock_);
+
   static void StopTracing(bool finish_tracing, bool flush_file)
       REQUIRES(!Locks::mutator_lock_, !Locks::thread_list_lock_, !Locks::trace_lock_)
       // There is an annoying issue with static functions that create a new object and call into
@@ -281,6 +348,31 @@ class Trace final : public instrumentation::InstrumentationListener {
   bool RegisterThread(Thread* thread)
       REQUIRES(streaming_lock_);
 
+  // Write the name of a newly seen thread. Used for streaming.
+  void WriteNewThread(Thread* thread)
+      REQUIRES(streaming_lock_);
+  // Write a method event, preceded by the method line of a newly seen method. Used for streaming.
+  void WriteStreamingEvent(pid_t tid,
+                           ArtMethod* method,
+                           TraceAction action,
+                           uint32_t thread_clock_diff,
+                           uint32_t wall_clock_diff)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(streaming_lock_, !unique_methods_lock_);
+
+  // Methods managing the per-thread trace ring buffers used when streaming a method trace.
+  TraceRingBuffer* CreateTraceBuffer(Thread* thread)
+      REQUIRES(!streaming_lock_);
+  void DrainTraceBuffer(TraceRingBuffer* buffer)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(streaming_lock_, !unique_methods_lock_);
+  // Copy the pending events of all threads with the thread list locked, and write them out after
+  // releasing it.
+  void DrainAllTraceBuffers(Thread* self)
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(!Locks::thread_list_lock_, !streaming_lock_, !unique_methods_lock_);
+  // Take back the buffers of all threads, all other threads must be suspended.
+  void DetachTraceBuffers(Thread* self)
+      REQUIRES(Locks::mutator_lock_, !Locks::thread_list_lock_, !streaming_lock_);
+
   // Copy a temporary buffer to the main buffer. Used for streaming. Exposed here for lock
   // annotation.
   void WriteToBuf(const uint8_t* src, size_t src_size)
@@ -302,12 +394,19 @@ class Trace final : public instrumentation::InstrumentationListener {
   // Singleton instance of the Trace or null when no method tracing is active.
   static Trace* volatile the_trace_ GUARDED_BY(Locks::trace_lock_);
 
+  // The Trace being stopped, until the ring buffers of all threads have been taken back from them.
+  // Threads exiting in the meantime hand their ring buffer over to it.
+  static Trace* stopping_trace_ GUARDED_BY(Locks::trace_lock_);
+
   // The default profiler clock source.
   static TraceClockSource default_clock_source_;
 
   // Sampling thread, non-zero when sampling.
   static pthread_t sampling_pthread_;
 
+  // Trace writer thread, non-zero when streaming a method trace.
+  static pthread_t writer_pthread_;
+
   // Used to remember an unused stack trace to avoid re-allocation during sampling.
   static std::unique_ptr<std::vector<ArtMethod*>> temp_stack_trace_;
 
@@ -376,6 +475,8 @@ class Trace final : public instrumentation::InstrumentationListener {
   Mutex* streaming_lock_;
   std::map<const DexFile*, DexIndexBitSet*> seen_methods_ GUARDED_BY(streaming_lock_);
   std::unique_ptr<ThreadIDBitSet> seen_threads_ GUARDED_BY(streaming_lock_);
+  // Ring buffers of exited threads, or of all threads once the trace stopped, not yet drained.
+  std::vector<std::unique_ptr<TraceRingBuffer>> detached_trace_buffers_ GUARDED_BY(streaming_lock_);
 
   // Bijective map from ArtMethod* to index.
   // Map from ArtMethod* to index in unique_methods_;
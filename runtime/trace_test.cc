@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace.h"
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace art {
+
+class TraceRingBufferTest : public testing::Test {
+ protected:
+  struct Event {
+    ArtMethod* method;
+    TraceAction action;
+    uint32_t thread_clock_diff;
+    uint32_t wall_clock_diff;
+  };
+
+  // Methods are never dereferenced by the ring buffer, only their alignment matters.
+  static ArtMethod* FakeMethod(size_t i) {
+    return reinterpret_cast<ArtMethod*>(static_cast<uintptr_t>(0x10000u + i * 8u));
+  }
+
+  static TraceAction ActionOf(size_t i) {
+    return static_cast<TraceAction>(i % 3u);
+  }
+
+  static std::vector<Event> DrainAll(TraceRingBuffer* buffer) {
+    std::vector<Event> events;
+    buffer->Drain([&](ArtMethod* method,
+                      TraceAction action,
+                      uint32_t thread_clock_diff,
+                      uint32_t wall_clock_diff) {
+      events.push_back({method, action, thread_clock_diff, wall_clock_diff});
+    });
+    return events;
+  }
+
+  static void CheckEvents(const std::vector<Event>& events, size_t first) {
+    for (size_t i = 0; i != events.size(); ++i) {
+      EXPECT_EQ(FakeMethod(first + i), events[i].method) << i;
+      EXPECT_EQ(ActionOf(first + i), events[i].action) << i;
+      EXPECT_EQ(first + i, events[i].thread_clock_diff) << i;
+      EXPECT_EQ(2u * (first + i), events[i].wall_clock_diff) << i;
+    }
+  }
+};
+
+TEST_F(TraceRingBufferTest, DrainsInOrder) {
+  // The ring buffer is too large for the stack.
+  std::unique_ptr<TraceRingBuffer> buffer(new TraceRingBuffer(42));
+  EXPECT_EQ(42, buffer->GetTid());
+  EXPECT_TRUE(DrainAll(buffer.get()).empty());
+
+  for (size_t i = 0; i != 10u; ++i) {
+    ASSERT_TRUE(buffer->Append(FakeMethod(i), ActionOf(i), i, 2u * i));
+  }
+  std::vector<Event> events = DrainAll(buffer.get());
+  ASSERT_EQ(10u, events.size());
+  CheckEvents(events, 0u);
+  // Drained events are not seen again.
+  EXPECT_TRUE(DrainAll(buffer.get()).empty());
+}
+
+TEST_F(TraceRingBufferTest, FullAndWrapAround) {
+  std::unique_ptr<TraceRingBuffer> buffer(new TraceRingBuffer(42));
+  constexpr size_t kCapacity = TraceRingBuffer::kCapacity;
+  for (size_t i = 0; i != kCapacity; ++i) {
+    ASSERT_TRUE(buffer->Append(FakeMethod(i), ActionOf(i), i, 2u * i));
+  }
+  // A full ring rejects events and keeps the ones it holds.
+  EXPECT_FALSE(buffer->Append(FakeMethod(kCapacity), ActionOf(kCapacity), 0u, 0u));
+  std::vector<Event> events = DrainAll(buffer.get());
+  ASSERT_EQ(kCapacity, events.size());
+  CheckEvents(events, 0u);
+
+  // Draining frees the slots. Move the next entry to the middle of the ring, so that filling the
+  // ring again wraps around its end.
+  size_t first = kCapacity;
+  for (size_t i = first; i != first + kCapacity / 2u; ++i) {
+    ASSERT_TRUE(buffer->Append(FakeMethod(i), ActionOf(i), i, 2u * i));
+  }
+  events = DrainAll(buffer.get());
+  ASSERT_EQ(kCapacity / 2u, events.size());
+  CheckEvents(events, first);
+  first += kCapacity / 2u;
+  for (size_t i = first; i != first + kCapacity; ++i) {
+    ASSERT_TRUE(buffer->Append(FakeMethod(i), ActionOf(i), i, 2u * i));
+  }
+  EXPECT_FALSE(buffer->Append(FakeMethod(0u), ActionOf(0u), 0u, 0u));
+  events = DrainAll(buffer.get());
+  ASSERT_EQ(kCapacity, events.size());
+  CheckEvents(events, first);
+  EXPECT_TRUE(DrainAll(buffer.get()).empty());
+}
+
+}  // namespace art